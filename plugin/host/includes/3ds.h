@@ -0,0 +1,421 @@
+#pragma once
+// Host stand-in for the subset of libctru used by the Artic Base server.
+// Only declarations live here, the implementations are in host/sources.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef volatile u8  vu8;
+typedef volatile u16 vu16;
+typedef volatile u32 vu32;
+typedef volatile u64 vu64;
+
+typedef s32 Result;
+typedef u32 Handle;
+typedef void (*ThreadFunc)(void*);
+
+#define BIT(n) (1U<<(n))
+#define U64_MAX UINT64_MAX
+
+#define R_SUCCEEDED(res) ((Result)(res) >= 0)
+#define R_FAILED(res)    ((Result)(res) < 0)
+#define R_LEVEL(res)       (((res)>>27)&0x1F)
+#define R_SUMMARY(res)     (((res)>>21)&0x3F)
+#define R_MODULE(res)      (((res)>>10)&0xFF)
+#define R_DESCRIPTION(res) ((res)&0x3FF)
+#define MAKERESULT(level,summary,module,description) \
+    ((((level)&0x1F)<<27) | (((summary)&0x3F)<<21) | (((module)&0xFF)<<10) | ((description)&0x3FF))
+
+enum {
+    RS_SUCCESS = 0,
+    RS_NOP = 1,
+    RS_WOULDBLOCK = 2,
+    RS_OUTOFRESOURCE = 3,
+    RS_NOTFOUND = 4,
+    RS_INVALIDSTATE = 5,
+    RS_NOTSUPPORTED = 6,
+    RS_INVALIDARG = 7,
+    RS_WRONGARG = 8,
+    RS_CANCELED = 9,
+    RS_STATUSCHANGED = 10,
+    RS_INTERNAL = 11,
+    RS_INVALIDRESVAL = 63,
+};
+
+enum {
+    RL_SUCCESS = 0,
+    RL_TEMPORARY = 26,
+    RL_PERMANENT = 27,
+    RL_USAGE = 28,
+};
+
+enum {
+    RM_COMMON = 0,
+    RM_KERNEL = 1,
+    RM_FS = 17,
+    RM_AM = 32,
+    RM_CFG = 42,
+};
+
+enum {
+    RD_SUCCESS = 0,
+    RD_INVALID_ENUM_VALUE = 1005,
+    RD_BUSY = 1008,
+    RD_OUT_OF_MEMORY = 1011,
+    RD_NOT_IMPLEMENTED = 1012,
+    RD_NOT_INITIALIZED = 1016,
+    RD_NOT_FOUND = 1018,
+};
+
+#define CUR_PROCESS_HANDLE 0xFFFF8001
+#define CUR_THREAD_HANDLE  0xFFFF8000
+#define SYSCLOCK_ARM11 268111856ULL
+
+// Results returned by the stand-in FS, matching the console values
+#define FS_RESULT_NOT_FOUND          ((Result)0xC8804478)
+#define FS_RESULT_ALREADY_EXISTS     ((Result)0xC82044BE)
+#define FS_RESULT_INVALID_HANDLE     ((Result)0xD8E007F7)
+#define FS_RESULT_INVALID_ARG        ((Result)0xE0E046BE)
+#define FS_RESULT_NOT_SUPPORTED      ((Result)0xC8A04554)
+#define FS_RESULT_OUT_OF_RANGE       ((Result)0xE0E046BD)
+
+// ---- svc ----
+Result svcGetProcessInfo(s64* out, Handle process, u32 type);
+Result svcGetProcessId(u32* out, Handle handle);
+Result svcGetThreadPriority(s32* out, Handle handle);
+Result svcCloseHandle(Handle handle);
+void svcSleepThread(s64 ns);
+u64 svcGetSystemTick(void);
+
+// ---- synchronization ----
+typedef struct { pthread_mutex_t m; bool init; } LightLock;
+typedef struct { pthread_mutex_t m; bool init; u32 counter; } RecursiveLock;
+typedef struct { pthread_cond_t c; bool init; } CondVar;
+typedef enum {
+    RESET_ONESHOT = 0,
+    RESET_STICKY = 1,
+    RESET_PULSE = 2,
+} ResetType;
+typedef struct { pthread_mutex_t m; pthread_cond_t c; int state; ResetType type; } LightEvent;
+typedef struct { pthread_mutex_t m; pthread_cond_t c; s32 current; s16 max; } LightSemaphore;
+
+void LightLock_Init(LightLock* lock);
+void LightLock_Lock(LightLock* lock);
+int  LightLock_TryLock(LightLock* lock);
+void LightLock_Unlock(LightLock* lock);
+
+void RecursiveLock_Init(RecursiveLock* lock);
+void RecursiveLock_Lock(RecursiveLock* lock);
+int  RecursiveLock_TryLock(RecursiveLock* lock);
+void RecursiveLock_Unlock(RecursiveLock* lock);
+
+void CondVar_Init(CondVar* cv);
+void CondVar_Wait(CondVar* cv, LightLock* lock);
+int  CondVar_WaitTimeout(CondVar* cv, LightLock* lock, s64 timeout_ns);
+void CondVar_WakeUp(CondVar* cv, s32 num_threads);
+static inline void CondVar_Signal(CondVar* cv) { CondVar_WakeUp(cv, 1); }
+static inline void CondVar_Broadcast(CondVar* cv) { CondVar_WakeUp(cv, -1); }
+
+void LightEvent_Init(LightEvent* event, ResetType reset_type);
+void LightEvent_Clear(LightEvent* event);
+void LightEvent_Pulse(LightEvent* event);
+void LightEvent_Signal(LightEvent* event);
+int  LightEvent_TryWait(LightEvent* event);
+void LightEvent_Wait(LightEvent* event);
+int  LightEvent_WaitTimeout(LightEvent* event, s64 timeout_ns);
+
+void LightSemaphore_Init(LightSemaphore* semaphore, s16 initial_count, s16 max_count);
+void LightSemaphore_Acquire(LightSemaphore* semaphore, s32 count);
+int  LightSemaphore_TryAcquire(LightSemaphore* semaphore, s32 count);
+void LightSemaphore_Release(LightSemaphore* semaphore, s32 count);
+
+#define AtomicIncrement(ptr) __atomic_add_fetch((u32*)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicDecrement(ptr) __atomic_sub_fetch((u32*)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicPostIncrement(ptr) __atomic_fetch_add((u32*)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicPostDecrement(ptr) __atomic_fetch_sub((u32*)(ptr), 1, __ATOMIC_SEQ_CST)
+#define AtomicSwap(ptr, value) __atomic_exchange_n((u32*)(ptr), (value), __ATOMIC_SEQ_CST)
+
+// ---- threads ----
+typedef struct Thread_tag* Thread;
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stack_size, int prio, int core_id, bool detached);
+Result threadJoin(Thread thread, u64 timeout_ns);
+void threadFree(Thread thread);
+void threadExit(int rc) __attribute__((noreturn));
+
+// ---- apt ----
+Result APT_CheckNew3DS(bool* out);
+
+// ---- FS ----
+typedef u64 FS_Archive;
+
+typedef enum {
+    FS_OPEN_READ   = BIT(0),
+    FS_OPEN_WRITE  = BIT(1),
+    FS_OPEN_CREATE = BIT(2),
+} FS_OpenFlags;
+
+typedef enum {
+    FS_WRITE_FLUSH       = BIT(0),
+    FS_WRITE_UPDATE_TIME = BIT(8),
+} FS_WriteFlags;
+
+typedef enum {
+    FS_ATTRIBUTE_DIRECTORY = BIT(0),
+    FS_ATTRIBUTE_HIDDEN    = BIT(8),
+    FS_ATTRIBUTE_ARCHIVE   = BIT(16),
+    FS_ATTRIBUTE_READ_ONLY = BIT(24),
+} FS_Attribute;
+
+typedef enum {
+    MEDIATYPE_NAND      = 0,
+    MEDIATYPE_SD        = 1,
+    MEDIATYPE_GAME_CARD = 2,
+} FS_MediaType;
+
+typedef enum {
+    ARCHIVE_ROMFS                    = 0x00000003,
+    ARCHIVE_SAVEDATA                 = 0x00000004,
+    ARCHIVE_EXTDATA                  = 0x00000006,
+    ARCHIVE_SHARED_EXTDATA           = 0x00000007,
+    ARCHIVE_SYSTEM_SAVEDATA          = 0x00000008,
+    ARCHIVE_SDMC                     = 0x00000009,
+    ARCHIVE_SDMC_WRITE_ONLY          = 0x0000000A,
+    ARCHIVE_BOSS_EXTDATA             = 0x12345678,
+    ARCHIVE_CARD_SPIFS               = 0x12345679,
+    ARCHIVE_EXTDATA_AND_BOSS_EXTDATA = 0x1234567B,
+    ARCHIVE_SYSTEM_SAVEDATA2         = 0x1234567C,
+    ARCHIVE_NAND_RW                  = 0x1234567D,
+    ARCHIVE_NAND_RO                  = 0x1234567E,
+    ARCHIVE_NAND_RO_WRITE_ACCESS     = 0x1234567F,
+    ARCHIVE_SAVEDATA_AND_CONTENT     = 0x2345678A,
+    ARCHIVE_SAVEDATA_AND_CONTENT2    = 0x2345678E,
+    ARCHIVE_NAND_CTR_FS              = 0x567890AB,
+    ARCHIVE_TWL_PHOTO                = 0x567890AC,
+    ARCHIVE_TWL_SOUND                = 0x567890AD,
+    ARCHIVE_NAND_TWL_FS              = 0x567890AE,
+    ARCHIVE_NAND_W_FS                = 0x567890AF,
+    ARCHIVE_GAMECARD_SAVEDATA        = 0x567890B1,
+    ARCHIVE_USER_SAVEDATA            = 0x567890B2,
+    ARCHIVE_DEMO_SAVEDATA            = 0x567890B4,
+} FS_ArchiveID;
+
+typedef enum {
+    PATH_INVALID = 0,
+    PATH_EMPTY   = 1,
+    PATH_BINARY  = 2,
+    PATH_ASCII   = 3,
+    PATH_UTF16   = 4,
+} FS_PathType;
+
+typedef enum {
+    SECUREVALUE_SLOT_SD = 0x1000,
+} FS_SecureValueSlot;
+
+typedef enum {
+    ARCHIVE_ACTION_COMMIT_SAVE_DATA = 0,
+    ARCHIVE_ACTION_GET_TIMESTAMP    = 1,
+    ARCHIVE_ACTION_UNKNOWN          = 0x789D,
+} FS_ArchiveAction;
+
+typedef enum {
+    SECURESAVE_ACTION_DELETE = 0,
+    SECURESAVE_ACTION_FORMAT = 1,
+} FS_SecureSaveAction;
+
+typedef struct {
+    FS_PathType type;
+    u32 size;
+    const void* data;
+} FS_Path;
+
+typedef struct {
+    u16 name[0x106];
+    char shortName[0x0A];
+    char shortExt[0x04];
+    u8 valid;
+    u8 reserved;
+    u32 attributes;
+    u64 fileSize;
+} FS_DirectoryEntry;
+
+typedef struct {
+    char productCode[0x10];
+    char companyCode[0x2];
+    u16 remasterVersion;
+} FS_ProductInfo;
+
+typedef struct {
+    FS_MediaType mediaType : 8;
+    u8 unknown;
+    u16 reserved1;
+    u64 saveId;
+    u32 reserved2;
+} FS_ExtSaveDataInfo;
+
+typedef struct {
+    FS_MediaType mediaType : 8;
+    u8 unknown;
+    u16 reserved;
+    u32 saveId;
+} FS_SystemSaveDataInfo;
+
+Handle* fsGetSessionHandle(void);
+FS_Path fsMakePath(FS_PathType type, const void* path);
+
+Result FSUSER_OpenFile(Handle* out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes);
+Result FSUSER_OpenFileDirectly(Handle* out, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 openFlags, u32 attributes);
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path);
+Result FSUSER_RenameFile(FS_Archive srcArchive, FS_Path srcPath, FS_Archive dstArchive, FS_Path dstPath);
+Result FSUSER_DeleteDirectory(FS_Archive archive, FS_Path path);
+Result FSUSER_DeleteDirectoryRecursively(FS_Archive archive, FS_Path path);
+Result FSUSER_CreateFile(FS_Archive archive, FS_Path path, u32 attributes, u64 fileSize);
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes);
+Result FSUSER_RenameDirectory(FS_Archive srcArchive, FS_Path srcPath, FS_Archive dstArchive, FS_Path dstPath);
+Result FSUSER_OpenDirectory(Handle* out, FS_Archive archive, FS_Path path);
+Result FSUSER_OpenArchive(FS_Archive* archive, FS_ArchiveID id, FS_Path path);
+Result FSUSER_ControlArchive(FS_Archive archive, FS_ArchiveAction action, void* input, u32 inputSize, void* output, u32 outputSize);
+Result FSUSER_CloseArchive(FS_Archive archive);
+Result FSUSER_GetFreeBytes(u64* freeBytes, FS_Archive archive);
+Result FSUSER_GetFormatInfo(u32* totalSize, u32* directories, u32* files, bool* duplicateData, FS_ArchiveID archiveId, FS_Path path);
+Result FSUSER_FormatSaveData(FS_ArchiveID archiveId, FS_Path path, u32 blocks, u32 directories, u32 files, u32 directoryBuckets, u32 fileBuckets, bool duplicateData);
+Result FSUSER_GetProductInfo(FS_ProductInfo* info, u32 processId);
+Result FSUSER_SetSaveDataSecureValue(u64 value, FS_SecureValueSlot slot, u32 titleUniqueId, u8 titleVariation);
+Result FSUSER_GetSaveDataSecureValue(bool* exists, u64* value, FS_SecureValueSlot slot, u32 titleUniqueId, u8 titleVariation);
+Result FSUSER_ControlSecureSave(FS_SecureSaveAction action, void* input, u32 inputSize, void* output, u32 outputSize);
+Result FSUSER_CreateExtSaveData(FS_ExtSaveDataInfo info, u32 maxDirectories, u32 maxFiles, u64 sizeLimit, u32 smdhSize, u8* smdh);
+Result FSUSER_DeleteExtSaveData(FS_ExtSaveDataInfo info);
+Result FSUSER_CreateSystemSaveData(FS_SystemSaveDataInfo info, u32 totalSize, u32 blockSize, u32 directories, u32 files, u32 directoryBuckets, u32 fileBuckets, bool duplicateData);
+
+Result FSFILE_Read(Handle handle, u32* bytesRead, u64 offset, void* buffer, u32 size);
+Result FSFILE_Write(Handle handle, u32* bytesWritten, u64 offset, const void* buffer, u32 size, u32 flags);
+Result FSFILE_GetSize(Handle handle, u64* size);
+Result FSFILE_SetSize(Handle handle, u64 size);
+Result FSFILE_GetAttributes(Handle handle, u32* attributes);
+Result FSFILE_SetAttributes(Handle handle, u32 attributes);
+Result FSFILE_Close(Handle handle);
+Result FSFILE_Flush(Handle handle);
+
+Result FSDIR_Read(Handle handle, u32* entriesRead, u32 entryCount, FS_DirectoryEntry* entries);
+Result FSDIR_Close(Handle handle);
+
+// ---- AM ----
+typedef struct {
+    u64 titleID;
+    u64 size;
+    u16 version;
+    u8 unk[6];
+} AM_TitleEntry;
+
+typedef struct {
+    u16 index;
+    u16 type;
+    u32 contentId;
+    u64 size;
+    u8 flags;
+    u8 padding[7];
+} AM_ContentInfo;
+
+Result amInit(void);
+Result amAppInit(void);
+void amExit(void);
+Handle* amGetSessionHandle(void);
+Result AM_GetTitleCount(FS_MediaType mediatype, u32* count);
+Result AM_GetTitleList(u32* titlesRead, FS_MediaType mediatype, u32 titleCount, u64* titleIds);
+Result AM_GetTitleInfo(FS_MediaType mediatype, u32 titleCount, u64* titleIds, AM_TitleEntry* titleInfo);
+Result AMAPP_GetDLCContentInfoCount(u32* count, FS_MediaType mediatype, u64 titleID);
+Result AMAPP_ListDLCContentInfos(u32* contentInfoRead, FS_MediaType mediatype, u64 titleID, u32 contentInfoCount, u32 offset, AM_ContentInfo* contentInfos);
+
+// ---- CFG ----
+Result cfguInit(void);
+void cfguExit(void);
+Result CFGU_GetConfigInfoBlk2(u32 size, u32 blkID, void* outData);
+
+// ---- HID ----
+typedef struct { s16 dx; s16 dy; } circlePosition;
+typedef struct { u16 px; u16 py; } touchPosition;
+typedef struct { s16 x; s16 y; s16 z; } accelVector;
+typedef struct { s16 x; s16 z; s16 y; } angularRate;
+
+u32 hidKeysHeld(void);
+void hidCircleRead(circlePosition* pos);
+void hidTouchRead(touchPosition* pos);
+void hidAccelRead(accelVector* vector);
+void hidGyroRead(angularRate* rate);
+void irrstCstickRead(circlePosition* pos);
+Result HIDUSER_EnableAccelerometer(void);
+Result HIDUSER_DisableAccelerometer(void);
+Result HIDUSER_EnableGyroscope(void);
+Result HIDUSER_DisableGyroscope(void);
+Result HIDUSER_GetGyroscopeRawToDpsCoefficient(float* coeff);
+
+// ---- soc ----
+Result socInit(u32* context_addr, u32 context_size);
+Result socExit(void);
+
+// ---- console ----
+// The host build logs to the terminal, consoles only exist so the logger links
+typedef enum {
+    GFX_TOP = 0,
+    GFX_BOTTOM = 1,
+} gfxScreen_t;
+
+typedef struct PrintConsole {
+    int cursorX, cursorY;
+    int windowX, windowY, windowWidth, windowHeight;
+    int fg, bg;
+    int flags;
+    bool consoleInitialised;
+} PrintConsole;
+
+PrintConsole* consoleInit(gfxScreen_t screen, PrintConsole* console);
+PrintConsole* consoleSelect(PrintConsole* console);
+void consoleClear(void);
+void consoleSetWindow(PrintConsole* console, int x, int y, int width, int height);
+
+// ---- ExHeader ----
+typedef struct {
+    u32 address;
+    u32 num_pages;
+    u32 size;
+} ExHeader_CodeSectionInfo;
+
+typedef struct {
+    char name[8];
+    u8 flags[8];
+    ExHeader_CodeSectionInfo text;
+    u32 stack_size;
+    ExHeader_CodeSectionInfo rodata;
+    u32 reserved;
+    ExHeader_CodeSectionInfo data;
+    u32 bss_size;
+} ExHeader_CodeSetInfo;
+
+typedef struct {
+    ExHeader_CodeSetInfo codeset_info;
+    u64 dependencies[48];
+    u8 system_info[0x40];
+} ExHeader_SystemControlInfo;
+
+typedef struct {
+    ExHeader_SystemControlInfo sci;
+    u8 aci[0x200];
+} ExHeader_Info;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#include "3ds.h"
+#include <mutex>
+#include <string>
+
+namespace Host {
+    // Time a storage access takes: a fixed cost per operation plus a cost per
+    // transferred KiB. Accesses to the same medium are serialized, like the
+    // single gamecard or SD bus of the console.
+    class LatencyModel {
+    public:
+        constexpr LatencyModel(u32 fixedUs, u32 usPerKiB) : fixedMicroseconds(fixedUs), microsecondsPerKiB(usPerKiB) {}
+
+        void Apply(u64 bytes);
+        bool Parse(const char* str);
+
+        u32 fixedMicroseconds;
+        u32 microsecondsPerKiB;
+
+    private:
+        std::mutex busy;
+    };
+
+    struct Config {
+        // Level 3 RomFS, either raw or with its IVFC header
+        std::string romfsImage;
+        // Extracted ExeFS sections (code.bin, icon.bin, banner.bin, logo.bin)
+        std::string exefsDir;
+        // Decrypted exheader, synthesized from code.bin if not set
+        std::string exheaderFile;
+        // Root of the save data archive
+        std::string saveDir;
+        // Root of the SD card archive, where traces are written
+        std::string sdmcDir;
+        u64 titleID = 0;
+        std::string productCode = "CTR-P-HOST";
+
+        // Roughly measured on an Old 3DS with a retail gamecard and a class 10 SD card
+        LatencyModel romfsLatency{250, 60};
+        LatencyModel saveLatency{100, 40};
+    };
+
+    extern Config config;
+
+    // Loads the exheader and code of the emulated application
+    bool LoadApplication();
+    // Address and size of the loaded code, as seen by Process_ReadCode
+    u8* GetCodeAddress();
+}
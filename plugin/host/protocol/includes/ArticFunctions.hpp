@@ -0,0 +1,34 @@
+#pragma once
+// Host stand-in for the ArticProtocol submodule: the tables the plugin fills
+// in ArticFunctions.cpp and the server uses.
+#include "ArticProtocolServer.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ArticFunctions {
+    using MethodHandler = void(*)(ArticProtocolServer::MethodInterface& mi);
+
+    // Perfect hash lookup on the 32 byte RequestPacket::method field, see
+    // ArticMethodTable.hpp. Returns nullptr if unknown.
+    MethodHandler GetMethodHandler(const char* method);
+    // Same handlers by the opcode listed by "#GetMethodOpcodes", for
+    // OpcodeRequestPackets. Returns nullptr if unknown.
+    MethodHandler GetMethodHandler(u16 opcode);
+    // Opcode of the method, -1 if unknown
+    s32 GetMethodOpcode(const char* method);
+
+    // Pipelined requests: returns false if the request has to run alone on
+    // the server thread once every request in flight finished. Otherwise
+    // requests with the same key must run in order, the others may overlap.
+    // firstParameter is the first integer parameter of the request, or 0.
+    bool GetRequestKey(u16 opcode, s64 firstParameter, u64& key);
+    // Runs task(arg) on the plugin's request workers, after the requests
+    // submitted before it with the same key
+    void SubmitRequest(u64 key, void(*task)(void*), void* arg);
+
+    // Same handlers by name, for servers that look methods up in a map
+    extern std::map<std::string, MethodHandler> functionHandlers;
+    extern std::vector<bool(*)()> setupFunctions;
+    extern std::vector<bool(*)()> destructFunctions;
+}
@@ -0,0 +1,75 @@
+#pragma once
+// Host stand-in for the ArticProtocol submodule: same types as the library,
+// wire framing as read by plugin/replaytrace.py.
+#include "3ds.h"
+
+namespace ArticProtocolCommon {
+    enum class RequestParameterType : u16 {
+        IN_INTEGER_8 = 0,
+        IN_INTEGER_16 = 1,
+        IN_INTEGER_32 = 2,
+        IN_INTEGER_64 = 3,
+        IN_SMALL_BUFFER = 4,
+        IN_BIG_BUFFER = 5,
+    };
+
+    struct RequestPacket {
+        u32 requestID;
+        char method[32];
+        u32 parameterCount;
+    };
+    static_assert(sizeof(RequestPacket) == 0x28);
+
+    // Request for the method with the opcode listed by "#GetMethodOpcodes",
+    // instead of its name. The parameters follow as for a RequestPacket. The
+    // marker is where a RequestPacket has the first character of the method
+    // name, which is never empty.
+    struct OpcodeRequestPacket {
+        u32 requestID;
+        u8 marker;          // OPCODE_REQUEST_MARKER
+        u8 parameterCount;
+        u16 opcode;
+    };
+    static_assert(sizeof(OpcodeRequestPacket) == 0x8);
+    static constexpr u8 OPCODE_REQUEST_MARKER = 0;
+
+    struct RequestParameter {
+        RequestParameterType type;
+        u16 dataSize;
+        union {
+            u8 data[0x1C];
+            // IN_BIG_BUFFER, the data follows the parameters in a DataPacket
+            struct {
+                u32 bigBufferID;
+                u32 bigBufferSize;
+            };
+        };
+    };
+    static_assert(sizeof(RequestParameter) == 0x20);
+
+    // Header of the response, and of every big buffer that follows a request
+    struct DataPacket {
+        u32 requestID;
+        union {
+            // Response, the result buffers follow: u32 ID, u32 size, data
+            struct {
+                s32 articResult;
+                s32 methodResult;
+                u32 resultSize;
+            };
+            // Big buffer parameter, its data follows
+            struct {
+                u32 bufferID;
+                u32 bufferSize;
+                u32 reserved;
+            };
+        };
+    };
+    static_assert(sizeof(DataPacket) == 0x10);
+
+    struct Buffer {
+        u32 bufferID;
+        u32 bufferSize;
+        char data[];
+    };
+}
@@ -0,0 +1,138 @@
+#pragma once
+// Host stand-in for the ArticProtocol submodule. Serves one connection with
+// the same interface the plugin handlers use. Requests are read ahead while
+// earlier ones run on the plugin's request workers, every response goes out
+// as soon as its request finishes, tagged with the request ID.
+#include "3ds.h"
+#include "ArticProtocolCommon.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+class ArticProtocolServer {
+public:
+    // Parameters and results of one request. Tests fill the parameters with
+    // the Add* methods and call the handler directly.
+    class MethodInterface {
+    public:
+        // Results larger than this fail with an internal error
+        static constexpr size_t MAX_RESULT_SIZE = 0x2000000;
+
+        MethodInterface() = default;
+        ~MethodInterface();
+
+        MethodInterface(const MethodInterface&) = delete;
+        MethodInterface& operator=(const MethodInterface&) = delete;
+
+        void AddParameterS8(s8 value);
+        void AddParameterS16(s16 value);
+        void AddParameterS32(s32 value);
+        void AddParameterS64(s64 value);
+        void AddParameterBuffer(const void* data, size_t size);
+
+        bool GetParameterS8(s8& out);
+        bool GetParameterS16(s16& out);
+        bool GetParameterS32(s32& out);
+        bool GetParameterS64(s64& out);
+        bool GetParameterBuffer(void*& buffer, size_t& size);
+        bool FinishInputParameters();
+
+        ArticProtocolCommon::Buffer* ReserveResultBuffer(u32 bufferID, size_t size);
+        ArticProtocolCommon::Buffer* ResizeLastResultBuffer(ArticProtocolCommon::Buffer* buffer, size_t newSize);
+
+        void FinishGood(int returnValue);
+        void FinishInternalError();
+
+        bool IsFinished() const { return state != State::RUNNING; }
+        bool IsGood() const { return state == State::GOOD; }
+        int GetReturnValue() const { return returnValue; }
+        // nullptr if the handler did not reserve it
+        const ArticProtocolCommon::Buffer* GetResultBuffer(u32 bufferID) const;
+        const std::vector<ArticProtocolCommon::Buffer*>& GetResultBuffers() const { return results; }
+
+        // Wire form of the parameters added with the Add* methods, for
+        // loopback clients: the RequestParameters, then a DataPacket and the
+        // data of every big buffer
+        u32 GetParameterCount() const { return static_cast<u32>(parameters.size()); }
+        std::vector<u8> SerializeParameters(u32 requestID) const;
+
+    private:
+        enum class State : u8 {
+            RUNNING,
+            GOOD,
+            INTERNAL_ERROR,
+        };
+
+        struct Parameter {
+            ArticProtocolCommon::RequestParameterType type;
+            std::vector<u8> data;
+        };
+
+        template<typename T>
+        bool GetInteger(ArticProtocolCommon::RequestParameterType type, T& out);
+
+        std::vector<Parameter> parameters;
+        size_t nextParameter = 0;
+        std::vector<ArticProtocolCommon::Buffer*> results;
+        size_t resultSize = 0;
+        State state = State::RUNNING;
+        int returnValue = 0;
+    };
+
+    static constexpr u32 MAX_PARAMETERS = 16;
+    static constexpr u32 MAX_BIG_BUFFER_SIZE = 0x1000000;
+    // Requests read whose response was not sent yet, see SetQueueDepth
+    static constexpr u32 DEFAULT_QUEUE_DEPTH = 8;
+    static constexpr u32 MAX_QUEUE_DEPTH = 32;
+
+    ArticProtocolServer(int socket_fd);
+    ~ArticProtocolServer();
+
+    // Handles requests until the client disconnects or QueryStop is called
+    void Serve();
+    // Requests in flight before the server stops reading, clamped to
+    // 1..MAX_QUEUE_DEPTH. 1 serves one request at a time. Call before Serve.
+    void SetQueueDepth(u32 depth);
+    void QueryStop();
+
+    static bool SetNonBlock(int sockFD, bool nonBlocking);
+    // Return the bytes transferred, 0 on error
+    static size_t RecvFrom(int sockFD, void* buffer, size_t size, void* addr, void* addrSize);
+    static size_t SendTo(int sockFD, void* buffer, size_t size, void* addr, void* addrSize);
+
+private:
+    using Handler = void(*)(MethodInterface& mi);
+
+    struct Request {
+        ArticProtocolServer* server;
+        MethodInterface mi;
+        // The method name is empty for requests sent by opcode
+        ArticProtocolCommon::RequestPacket packet;
+        // -1 if the method is unknown
+        s32 opcode;
+        // Orders the request against the others in flight, 0 if the first
+        // parameter is not an integer
+        s64 firstParameter;
+        Handler handler;
+    };
+
+    bool Read(void* buffer, size_t size);
+    bool Write(const void* buffer, size_t size);
+    bool ReadRequest(Request& request);
+    static void RunRequest(void* arg);
+    void Run(Request* request);
+    // Sends the response and frees the request
+    void Complete(Request* request);
+    bool SendResponse(const Request& request);
+
+    int socketFD;
+    volatile bool run = true;
+
+    u32 queueDepth = DEFAULT_QUEUE_DEPTH;
+    // Held while a response is written
+    std::mutex lock;
+    std::condition_variable requestDone;
+    // Requests read whose response was not sent yet
+    u32 inFlight = 0;
+    bool sendFailed = false;
+};
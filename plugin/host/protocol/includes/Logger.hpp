@@ -0,0 +1,30 @@
+#pragma once
+// Host stand-in for the ArticProtocol submodule: writes every line to the
+// terminal as it is logged, there is no logger thread.
+#include "3ds.h"
+#include <stdarg.h>
+#include "CTRPluginFramework/System/Mutex.hpp"
+
+class Logger {
+public:
+    Logger();
+    ~Logger();
+    void Start();
+    void End();
+    void Raw(bool isTopScr, const char* fmt, ...);
+    void Info(const char* fmt, ...);
+    void Debug(const char* fmt, ...);
+    void Warning(const char* fmt, ...);
+    void Error(const char* fmt, ...);
+    void Traffic(const char* fmt, ...);
+
+    void Wait();
+
+    bool debug_enable = false;
+    // Drops everything but errors, for the tests
+    bool quiet = false;
+private:
+    void Print(const char* tag, const char* fmt, va_list args);
+
+    CTRPluginFramework::Mutex mutex;
+};
@@ -0,0 +1,438 @@
+#include "ArticProtocolServer.hpp"
+#include "ArticFunctions.hpp"
+#include "Main.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+extern int transferedBytes;
+
+using namespace ArticProtocolCommon;
+
+ArticProtocolServer::MethodInterface::~MethodInterface() {
+    for (Buffer* buffer : results) {
+        free(buffer);
+    }
+}
+
+void ArticProtocolServer::MethodInterface::AddParameterS8(s8 value) {
+    parameters.push_back({RequestParameterType::IN_INTEGER_8, std::vector<u8>(sizeof(value))});
+    memcpy(parameters.back().data.data(), &value, sizeof(value));
+}
+
+void ArticProtocolServer::MethodInterface::AddParameterS16(s16 value) {
+    parameters.push_back({RequestParameterType::IN_INTEGER_16, std::vector<u8>(sizeof(value))});
+    memcpy(parameters.back().data.data(), &value, sizeof(value));
+}
+
+void ArticProtocolServer::MethodInterface::AddParameterS32(s32 value) {
+    parameters.push_back({RequestParameterType::IN_INTEGER_32, std::vector<u8>(sizeof(value))});
+    memcpy(parameters.back().data.data(), &value, sizeof(value));
+}
+
+void ArticProtocolServer::MethodInterface::AddParameterS64(s64 value) {
+    parameters.push_back({RequestParameterType::IN_INTEGER_64, std::vector<u8>(sizeof(value))});
+    memcpy(parameters.back().data.data(), &value, sizeof(value));
+}
+
+void ArticProtocolServer::MethodInterface::AddParameterBuffer(const void* data, size_t size) {
+    const u8* bytes = reinterpret_cast<const u8*>(data);
+    RequestParameterType type = size > sizeof(RequestParameter::data) ? RequestParameterType::IN_BIG_BUFFER : RequestParameterType::IN_SMALL_BUFFER;
+    parameters.push_back({type, std::vector<u8>(bytes, bytes + size)});
+}
+
+std::vector<u8> ArticProtocolServer::MethodInterface::SerializeParameters(u32 requestID) const {
+    std::vector<u8> out(parameters.size() * sizeof(RequestParameter));
+    u32 bigBufferCount = 0;
+    for (size_t i = 0; i < parameters.size(); i++) {
+        const Parameter& parameter = parameters[i];
+        RequestParameter wire = {};
+        wire.type = parameter.type;
+        if (parameter.type == RequestParameterType::IN_BIG_BUFFER) {
+            wire.dataSize = 2 * sizeof(u32);
+            wire.bigBufferID = bigBufferCount++;
+            wire.bigBufferSize = static_cast<u32>(parameter.data.size());
+        } else {
+            wire.dataSize = static_cast<u16>(parameter.data.size());
+            memcpy(wire.data, parameter.data.data(), parameter.data.size());
+        }
+        memcpy(out.data() + i * sizeof(RequestParameter), &wire, sizeof(wire));
+    }
+    bigBufferCount = 0;
+    for (const Parameter& parameter : parameters) {
+        if (parameter.type != RequestParameterType::IN_BIG_BUFFER) continue;
+        DataPacket header = {};
+        header.requestID = requestID;
+        header.bufferID = bigBufferCount++;
+        header.bufferSize = static_cast<u32>(parameter.data.size());
+        const u8* bytes = reinterpret_cast<const u8*>(&header);
+        out.insert(out.end(), bytes, bytes + sizeof(header));
+        out.insert(out.end(), parameter.data.begin(), parameter.data.end());
+    }
+    return out;
+}
+
+template<typename T>
+bool ArticProtocolServer::MethodInterface::GetInteger(RequestParameterType type, T& out) {
+    if (state != State::RUNNING || nextParameter >= parameters.size() || parameters[nextParameter].type != type) {
+        FinishInternalError();
+        return false;
+    }
+    memcpy(&out, parameters[nextParameter++].data.data(), sizeof(T));
+    return true;
+}
+
+bool ArticProtocolServer::MethodInterface::GetParameterS8(s8& out) {
+    return GetInteger(RequestParameterType::IN_INTEGER_8, out);
+}
+
+bool ArticProtocolServer::MethodInterface::GetParameterS16(s16& out) {
+    return GetInteger(RequestParameterType::IN_INTEGER_16, out);
+}
+
+bool ArticProtocolServer::MethodInterface::GetParameterS32(s32& out) {
+    return GetInteger(RequestParameterType::IN_INTEGER_32, out);
+}
+
+bool ArticProtocolServer::MethodInterface::GetParameterS64(s64& out) {
+    return GetInteger(RequestParameterType::IN_INTEGER_64, out);
+}
+
+bool ArticProtocolServer::MethodInterface::GetParameterBuffer(void*& buffer, size_t& size) {
+    if (state != State::RUNNING || nextParameter >= parameters.size() ||
+        (parameters[nextParameter].type != RequestParameterType::IN_SMALL_BUFFER &&
+         parameters[nextParameter].type != RequestParameterType::IN_BIG_BUFFER)) {
+        FinishInternalError();
+        return false;
+    }
+    Parameter& parameter = parameters[nextParameter++];
+    buffer = parameter.data.data();
+    size = parameter.data.size();
+    return true;
+}
+
+bool ArticProtocolServer::MethodInterface::FinishInputParameters() {
+    if (state != State::RUNNING || nextParameter != parameters.size()) {
+        FinishInternalError();
+        return false;
+    }
+    return true;
+}
+
+Buffer* ArticProtocolServer::MethodInterface::ReserveResultBuffer(u32 bufferID, size_t size) {
+    if (state != State::RUNNING || size > MAX_RESULT_SIZE - resultSize) {
+        FinishInternalError();
+        return nullptr;
+    }
+    Buffer* buffer = reinterpret_cast<Buffer*>(malloc(sizeof(Buffer) + size));
+    if (!buffer) {
+        FinishInternalError();
+        return nullptr;
+    }
+    buffer->bufferID = bufferID;
+    buffer->bufferSize = static_cast<u32>(size);
+    results.push_back(buffer);
+    resultSize += size;
+    return buffer;
+}
+
+Buffer* ArticProtocolServer::MethodInterface::ResizeLastResultBuffer(Buffer* buffer, size_t newSize) {
+    if (state != State::RUNNING || results.empty() || results.back() != buffer ||
+        newSize > MAX_RESULT_SIZE - (resultSize - buffer->bufferSize)) {
+        FinishInternalError();
+        return nullptr;
+    }
+    resultSize -= buffer->bufferSize;
+    Buffer* resized = reinterpret_cast<Buffer*>(realloc(buffer, sizeof(Buffer) + newSize));
+    if (!resized) {
+        FinishInternalError();
+        return nullptr;
+    }
+    resized->bufferSize = static_cast<u32>(newSize);
+    results.back() = resized;
+    resultSize += newSize;
+    return resized;
+}
+
+void ArticProtocolServer::MethodInterface::FinishGood(int value) {
+    if (state != State::RUNNING) return;
+    state = State::GOOD;
+    returnValue = value;
+}
+
+void ArticProtocolServer::MethodInterface::FinishInternalError() {
+    if (state != State::RUNNING) return;
+    state = State::INTERNAL_ERROR;
+}
+
+const Buffer* ArticProtocolServer::MethodInterface::GetResultBuffer(u32 bufferID) const {
+    for (const Buffer* buffer : results) {
+        if (buffer->bufferID == bufferID) return buffer;
+    }
+    return nullptr;
+}
+
+ArticProtocolServer::ArticProtocolServer(int socket_fd) : socketFD(socket_fd) {}
+
+void ArticProtocolServer::SetQueueDepth(u32 depth) {
+    queueDepth = std::clamp<u32>(depth, 1, MAX_QUEUE_DEPTH);
+}
+
+ArticProtocolServer::~ArticProtocolServer() {
+    if (socketFD >= 0) {
+        shutdown(socketFD, SHUT_RDWR);
+        close(socketFD);
+    }
+}
+
+void ArticProtocolServer::QueryStop() {
+    run = false;
+}
+
+bool ArticProtocolServer::SetNonBlock(int sockFD, bool nonBlocking) {
+    int flags = fcntl(sockFD, F_GETFL, 0);
+    if (flags < 0) return false;
+    flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(sockFD, F_SETFL, flags) == 0;
+}
+
+size_t ArticProtocolServer::RecvFrom(int sockFD, void* buffer, size_t size, void* addr, void* addrSize) {
+    while (true) {
+        ssize_t received = recvfrom(sockFD, buffer, size, 0, reinterpret_cast<struct sockaddr*>(addr), reinterpret_cast<socklen_t*>(addrSize));
+        if (received >= 0) return static_cast<size_t>(received);
+        if (errno != EWOULDBLOCK && errno != EAGAIN) return 0;
+        struct pollfd pfd = {sockFD, POLLIN, 0};
+        poll(&pfd, 1, 100);
+    }
+}
+
+size_t ArticProtocolServer::SendTo(int sockFD, void* buffer, size_t size, void* addr, void* addrSize) {
+    ssize_t sent = sendto(sockFD, buffer, size, 0, reinterpret_cast<struct sockaddr*>(addr), *reinterpret_cast<socklen_t*>(addrSize));
+    return sent < 0 ? 0 : static_cast<size_t>(sent);
+}
+
+bool ArticProtocolServer::Read(void* buffer, size_t size) {
+    u8* p = reinterpret_cast<u8*>(buffer);
+    while (size != 0) {
+        ssize_t received = recv(socketFD, p, size, 0);
+        if (received == 0) return false;
+        if (received < 0) {
+            if (errno != EWOULDBLOCK && errno != EAGAIN) return false;
+            if (!run) return false;
+            struct pollfd pfd = {socketFD, POLLIN, 0};
+            poll(&pfd, 1, 100);
+            continue;
+        }
+        p += received;
+        size -= received;
+        transferedBytes += received;
+    }
+    return true;
+}
+
+bool ArticProtocolServer::Write(const void* buffer, size_t size) {
+    const u8* p = reinterpret_cast<const u8*>(buffer);
+    while (size != 0) {
+        ssize_t sent = send(socketFD, p, size, 0);
+        if (sent < 0) {
+            if (errno != EWOULDBLOCK && errno != EAGAIN) return false;
+            if (!run) return false;
+            struct pollfd pfd = {socketFD, POLLOUT, 0};
+            poll(&pfd, 1, 100);
+            continue;
+        }
+        p += sent;
+        size -= sent;
+        transferedBytes += sent;
+    }
+    return true;
+}
+
+bool ArticProtocolServer::ReadRequest(Request& request) {
+    MethodInterface& mi = request.mi;
+    RequestPacket& packet = request.packet;
+    // Read as an opcode request first, the marker tells them apart
+    static_assert(offsetof(OpcodeRequestPacket, marker) == offsetof(RequestPacket, method));
+    OpcodeRequestPacket opcodePacket;
+    if (!Read(&opcodePacket, sizeof(opcodePacket))) {
+        return false;
+    }
+    if (opcodePacket.marker == OPCODE_REQUEST_MARKER) {
+        packet = {};
+        packet.requestID = opcodePacket.requestID;
+        packet.parameterCount = opcodePacket.parameterCount;
+        request.opcode = opcodePacket.opcode;
+    } else {
+        memcpy(&packet, &opcodePacket, sizeof(opcodePacket));
+        u8* rest = reinterpret_cast<u8*>(&packet) + sizeof(opcodePacket);
+        if (!Read(rest, sizeof(packet) - sizeof(opcodePacket))) {
+            return false;
+        }
+        packet.method[sizeof(packet.method) - 1] = '\0';
+        request.opcode = ArticFunctions::GetMethodOpcode(packet.method);
+    }
+    if (packet.parameterCount > MAX_PARAMETERS) {
+        return false;
+    }
+
+    RequestParameter parameters[MAX_PARAMETERS];
+    if (!Read(parameters, packet.parameterCount * sizeof(RequestParameter))) {
+        return false;
+    }
+    request.firstParameter = 0;
+    u32 bigBufferCount = 0;
+    for (u32 i = 0; i < packet.parameterCount; i++) {
+        const RequestParameter& parameter = parameters[i];
+        switch (parameter.type)
+        {
+        case RequestParameterType::IN_INTEGER_8:
+        {
+            s8 value;
+            memcpy(&value, parameter.data, sizeof(value));
+            mi.AddParameterS8(value);
+            if (i == 0) request.firstParameter = value;
+            break;
+        }
+        case RequestParameterType::IN_INTEGER_16:
+        {
+            s16 value;
+            memcpy(&value, parameter.data, sizeof(value));
+            mi.AddParameterS16(value);
+            if (i == 0) request.firstParameter = value;
+            break;
+        }
+        case RequestParameterType::IN_INTEGER_32:
+        {
+            s32 value;
+            memcpy(&value, parameter.data, sizeof(value));
+            mi.AddParameterS32(value);
+            // Handles are sent as 32 bit integers, keep them unsigned
+            if (i == 0) request.firstParameter = static_cast<u32>(value);
+            break;
+        }
+        case RequestParameterType::IN_INTEGER_64:
+        {
+            s64 value;
+            memcpy(&value, parameter.data, sizeof(value));
+            mi.AddParameterS64(value);
+            if (i == 0) request.firstParameter = value;
+            break;
+        }
+        case RequestParameterType::IN_SMALL_BUFFER:
+            if (parameter.dataSize > sizeof(parameter.data)) return false;
+            mi.AddParameterBuffer(parameter.data, parameter.dataSize);
+            break;
+        case RequestParameterType::IN_BIG_BUFFER:
+        {
+            // Big buffers follow the parameters in the order they are listed
+            DataPacket header;
+            if (parameter.bigBufferID != bigBufferCount++ || parameter.bigBufferSize > MAX_BIG_BUFFER_SIZE ||
+                !Read(&header, sizeof(header)) || header.requestID != packet.requestID ||
+                header.bufferID != parameter.bigBufferID || header.bufferSize != parameter.bigBufferSize) {
+                return false;
+            }
+            std::vector<u8> data(header.bufferSize);
+            if (!Read(data.data(), data.size())) return false;
+            mi.AddParameterBuffer(data.data(), data.size());
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ArticProtocolServer::SendResponse(const Request& request) {
+    const MethodInterface& mi = request.mi;
+    DataPacket header = {};
+    header.requestID = request.packet.requestID;
+    if (!request.handler) {
+        header.articResult = -1;
+    } else if (!mi.IsGood()) {
+        header.articResult = -2;
+    } else {
+        header.methodResult = mi.GetReturnValue();
+        for (const Buffer* buffer : mi.GetResultBuffers()) {
+            header.resultSize += sizeof(Buffer) + buffer->bufferSize;
+        }
+    }
+    if (!Write(&header, sizeof(header))) return false;
+    if (header.articResult != 0) return true;
+    for (const Buffer* buffer : mi.GetResultBuffers()) {
+        if (!Write(buffer, sizeof(Buffer) + buffer->bufferSize)) return false;
+    }
+    return true;
+}
+
+void ArticProtocolServer::RunRequest(void* arg) {
+    Request* request = reinterpret_cast<Request*>(arg);
+    request->server->Run(request);
+}
+
+void ArticProtocolServer::Run(Request* request) {
+    if (request->handler) {
+        request->handler(request->mi);
+        if (!request->mi.IsFinished()) {
+            logger.Error("Server: %s (%d) did not finish", request->packet.method, (int)request->opcode);
+            request->mi.FinishInternalError();
+        }
+    } else {
+        logger.Warning("Server: Unknown method %s (%d)", request->packet.method, (int)request->opcode);
+    }
+    Complete(request);
+}
+
+void ArticProtocolServer::Complete(Request* request) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!sendFailed && !SendResponse(*request)) {
+        sendFailed = true;
+    }
+    delete request;
+    inFlight--;
+    requestDone.notify_all();
+}
+
+void ArticProtocolServer::Serve() {
+    while (run) {
+        Request* request = new Request();
+        request->server = this;
+        if (!ReadRequest(*request)) {
+            delete request;
+            break;
+        }
+        request->handler = (request->opcode < 0) ? nullptr : ArticFunctions::GetMethodHandler(static_cast<u16>(request->opcode));
+
+        // Requests the plugin does not let overlap wait for every request
+        // before them and run here
+        u64 key = 0;
+        bool pipelined = request->handler && ArticFunctions::GetRequestKey(static_cast<u16>(request->opcode), request->firstParameter, key);
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            requestDone.wait(guard, [&] {
+                return sendFailed || (pipelined ? inFlight < queueDepth : inFlight == 0);
+            });
+            if (sendFailed) {
+                delete request;
+                break;
+            }
+            inFlight++;
+        }
+        if (pipelined) {
+            ArticFunctions::SubmitRequest(key, RunRequest, request);
+        } else {
+            Run(request);
+        }
+    }
+
+    // The requests in flight still use the connection
+    std::unique_lock<std::mutex> guard(lock);
+    requestDone.wait(guard, [&] { return inFlight == 0; });
+}
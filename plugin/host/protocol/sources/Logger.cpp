@@ -0,0 +1,41 @@
+#include "Logger.hpp"
+#include "CTRPluginFramework/System/Lock.hpp"
+#include <stdio.h>
+
+Logger::Logger() {}
+
+Logger::~Logger() {}
+
+void Logger::Start() {}
+
+void Logger::End() {
+    fflush(stdout);
+}
+
+void Logger::Wait() {}
+
+void Logger::Print(const char* tag, const char* fmt, va_list args) {
+    CTRPluginFramework::Lock l(mutex);
+    fputs(tag, stdout);
+    vfprintf(stdout, fmt, args);
+    fputc('\n', stdout);
+    fflush(stdout);
+}
+
+// Screen output of the plugin, the host has no screens
+void Logger::Raw(bool, const char*, ...) {}
+
+#define LOGGER_METHOD(name, tag, enabled) \
+    void Logger::name(const char* fmt, ...) { \
+        if (!(enabled)) return; \
+        va_list args; \
+        va_start(args, fmt); \
+        Print(tag, fmt, args); \
+        va_end(args); \
+    }
+
+LOGGER_METHOD(Info, "[I] ", !quiet)
+LOGGER_METHOD(Debug, "[D] ", debug_enable && !quiet)
+LOGGER_METHOD(Warning, "[W] ", !quiet)
+LOGGER_METHOD(Error, "[E] ", true)
+LOGGER_METHOD(Traffic, "[T] ", debug_enable && !quiet)
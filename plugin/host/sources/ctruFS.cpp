@@ -0,0 +1,676 @@
+// FS service of the libctru stand-in. RomFS and ExeFS are served from the
+// files given in the host config, save data from a host directory.
+#include "3ds.h"
+#include "HostConfig.hpp"
+#include "fsExtension.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+namespace {
+    enum class ArchiveKind {
+        ROMFS,
+        // Backed by a host directory
+        DIRECTORY,
+    };
+
+    struct ArchiveInfo {
+        ArchiveKind kind;
+        std::string root;
+    };
+
+    struct FileInfo {
+        int fd;
+        // Region of the host file visible through the handle
+        u64 base;
+        u64 size;
+        bool readOnly;
+        bool sized;
+        Host::LatencyModel* latency;
+    };
+
+    struct DirInfo {
+        std::vector<FS_DirectoryEntry> entries;
+        size_t next = 0;
+    };
+
+    struct FormatInfo {
+        u32 totalSize = 0x80000;
+        u32 directories = 0x10;
+        u32 files = 0x10;
+        bool duplicateData = false;
+    };
+
+    std::mutex fsLock;
+    std::map<FS_Archive, ArchiveInfo> archives;
+    std::map<Handle, FileInfo> files;
+    std::map<Handle, DirInfo> dirs;
+    std::map<u32, u64> secureValues;
+    FormatInfo formatInfo;
+    Handle nextHandle = 0x100;
+    FS_Archive nextArchive = 0x1000;
+    Handle fsSession = 0x10;
+
+    // Location of level 3 inside the RomFS image
+    u64 romfsOffset = 0;
+    u64 romfsSize = 0;
+    bool romfsProbed = false;
+
+    Result ErrnoToResult(int err) {
+        switch (err) {
+        case ENOENT:
+        case ENOTDIR:
+            return FS_RESULT_NOT_FOUND;
+        case EEXIST:
+        case ENOTEMPTY:
+            return FS_RESULT_ALREADY_EXISTS;
+        case EINVAL:
+        case EISDIR:
+            return FS_RESULT_INVALID_ARG;
+        default:
+            return FS_RESULT_NOT_SUPPORTED;
+        }
+    }
+
+    void AppendUTF8(std::string& out, u32 c) {
+        if (c < 0x80) {
+            out.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+
+    // Relative path inside an archive, rejects anything escaping its root
+    bool GetRelativePath(const FS_Path& path, std::string& out) {
+        out.clear();
+        switch (path.type) {
+        case PATH_EMPTY:
+            break;
+        case PATH_ASCII: {
+            const char* str = reinterpret_cast<const char*>(path.data);
+            out.assign(str, strnlen(str, path.size));
+            break;
+        }
+        case PATH_UTF16: {
+            const u16* str = reinterpret_cast<const u16*>(path.data);
+            for (u32 i = 0; i < path.size / sizeof(u16) && str[i] != 0; i++) {
+                AppendUTF8(out, str[i]);
+            }
+            break;
+        }
+        default:
+            return false;
+        }
+
+        size_t start = 0;
+        while (start <= out.size()) {
+            size_t end = out.find('/', start);
+            if (end == std::string::npos) end = out.size();
+            if (out.compare(start, end - start, "..") == 0) return false;
+            start = end + 1;
+        }
+        return true;
+    }
+
+    bool GetHostPath(FS_Archive archive, const FS_Path& path, std::string& out, bool allowRoot = false) {
+        auto it = archives.find(archive);
+        if (it == archives.end() || it->second.kind != ArchiveKind::DIRECTORY) return false;
+        std::string relative;
+        if (!GetRelativePath(path, relative)) return false;
+        if (!allowRoot && (relative.empty() || relative == "/")) return false;
+        out = it->second.root + "/" + relative;
+        return true;
+    }
+
+    bool ProbeRomFS() {
+        if (romfsProbed) return romfsSize != 0;
+        romfsProbed = true;
+
+        int fd = open(Host::config.romfsImage.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        fstat(fd, &st);
+
+        // IVFC header: master hash size at 0x8, level 3 size at 0x44 and
+        // block size at 0x4C. Level 3 starts at the first block boundary
+        // after the header and master hash.
+        u8 header[0x60];
+        romfsOffset = 0;
+        romfsSize = st.st_size;
+        if (pread(fd, header, sizeof(header), 0) == sizeof(header) && memcmp(header, "IVFC", 4) == 0) {
+            u32 masterHashSize, blockSizeLog2;
+            u64 level3Size;
+            memcpy(&masterHashSize, header + 0x8, sizeof(u32));
+            memcpy(&level3Size, header + 0x44, sizeof(u64));
+            memcpy(&blockSizeLog2, header + 0x4C, sizeof(u32));
+            u64 blockSize = 1ULL << blockSizeLog2;
+            romfsOffset = (sizeof(header) + masterHashSize + blockSize - 1) & ~(blockSize - 1);
+            romfsSize = level3Size;
+        }
+        close(fd);
+        return romfsOffset + romfsSize <= static_cast<u64>(st.st_size);
+    }
+
+    Handle AddFile(const FileInfo& info) {
+        Handle handle = nextHandle++;
+        files.emplace(handle, info);
+        return handle;
+    }
+
+    // Takes fsLock itself, the caller must not hold it.
+    // Binary paths used by the RomFS archive: u32 type, then type specific data.
+    // Type 0 is the RomFS of the application, type 2 an ExeFS section by name.
+    Result OpenContentFile(Handle* out, const FS_Path& filePath) {
+        if (filePath.type != PATH_BINARY || filePath.size < 0xC) return FS_RESULT_INVALID_ARG;
+        u32 type;
+        memcpy(&type, filePath.data, sizeof(u32));
+
+        if (type == 0) {
+            Host::config.romfsLatency.Apply(0);
+            std::lock_guard<std::mutex> guard(fsLock);
+            if (!ProbeRomFS()) return FS_RESULT_NOT_FOUND;
+            int fd = open(Host::config.romfsImage.c_str(), O_RDONLY);
+            if (fd < 0) return FS_RESULT_NOT_FOUND;
+            *out = AddFile({fd, romfsOffset, romfsSize, true, true, &Host::config.romfsLatency});
+            return 0;
+        }
+
+        if (type == 2) {
+            char name[9] = {0};
+            memcpy(name, reinterpret_cast<const u8*>(filePath.data) + sizeof(u32), 8);
+            std::string base = Host::config.exefsDir + "/" + name;
+            int fd = open((base + ".bin").c_str(), O_RDONLY);
+            if (fd < 0) fd = open(base.c_str(), O_RDONLY);
+            if (fd < 0) return FS_RESULT_NOT_FOUND;
+            Host::config.romfsLatency.Apply(0);
+            std::lock_guard<std::mutex> guard(fsLock);
+            *out = AddFile({fd, 0, 0, true, false, &Host::config.romfsLatency});
+            return 0;
+        }
+
+        return FS_RESULT_NOT_SUPPORTED;
+    }
+
+    Result RemoveRecursively(const std::string& path, bool keepRoot) {
+        DIR* dir = opendir(path.c_str());
+        if (!dir) return ErrnoToResult(errno);
+        while (struct dirent* ent = readdir(dir)) {
+            if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+            std::string child = path + "/" + ent->d_name;
+            struct stat st;
+            if (lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                RemoveRecursively(child, false);
+            } else {
+                unlink(child.c_str());
+            }
+        }
+        closedir(dir);
+        if (!keepRoot && rmdir(path.c_str()) != 0) return ErrnoToResult(errno);
+        return 0;
+    }
+
+    void FillDirectoryEntry(FS_DirectoryEntry& entry, const char* name, const struct stat& st) {
+        memset(&entry, 0, sizeof(entry));
+
+        // Decode UTF-8 into UTF-16, names outside the BMP are not expected in save data
+        const u8* in = reinterpret_cast<const u8*>(name);
+        size_t outLen = 0;
+        while (*in && outLen < sizeof(entry.name) / sizeof(u16) - 1) {
+            u32 c = *in++;
+            if (c >= 0xE0 && in[0] && in[1]) {
+                c = ((c & 0x0F) << 12) | ((in[0] & 0x3F) << 6) | (in[1] & 0x3F);
+                in += 2;
+            } else if (c >= 0xC0 && in[0]) {
+                c = ((c & 0x1F) << 6) | (in[0] & 0x3F);
+                in += 1;
+            }
+            entry.name[outLen++] = static_cast<u16>(c);
+        }
+
+        const char* dot = S_ISDIR(st.st_mode) ? nullptr : strrchr(name, '.');
+        size_t stemLen = dot ? static_cast<size_t>(dot - name) : strlen(name);
+        for (size_t i = 0; i < stemLen && i < 8; i++) {
+            entry.shortName[i] = static_cast<char>(toupper(name[i]));
+        }
+        for (size_t i = 0; dot && dot[i + 1] && i < 3; i++) {
+            entry.shortExt[i] = static_cast<char>(toupper(dot[i + 1]));
+        }
+        entry.valid = 1;
+        entry.attributes = S_ISDIR(st.st_mode) ? FS_ATTRIBUTE_DIRECTORY : 0;
+        entry.fileSize = S_ISDIR(st.st_mode) ? 0 : st.st_size;
+    }
+}
+
+namespace Host {
+    void LatencyModel::Apply(u64 bytes) {
+        u64 us = fixedMicroseconds + (bytes * microsecondsPerKiB) / 1024;
+        if (us == 0) return;
+        std::lock_guard<std::mutex> guard(busy);
+        svcSleepThread(us * 1000);
+    }
+
+    bool LatencyModel::Parse(const char* str) {
+        unsigned int fixedUs, usPerKiB;
+        if (sscanf(str, "%u,%u", &fixedUs, &usPerKiB) != 2) return false;
+        fixedMicroseconds = fixedUs;
+        microsecondsPerKiB = usPerKiB;
+        return true;
+    }
+}
+
+extern "C" {
+
+Handle* fsGetSessionHandle(void) {
+    return &fsSession;
+}
+
+FS_Path fsMakePath(FS_PathType type, const void* path) {
+    FS_Path p = {type, 1, path};
+    if (type == PATH_ASCII) p.size = strlen(static_cast<const char*>(path)) + 1;
+    return p;
+}
+
+Result FSUSER_OpenArchive(FS_Archive* archive, FS_ArchiveID id, FS_Path) {
+    ArchiveInfo info;
+    switch (id) {
+    case ARCHIVE_ROMFS:
+    case ARCHIVE_SAVEDATA_AND_CONTENT:
+    case ARCHIVE_SAVEDATA_AND_CONTENT2:
+        info = {ArchiveKind::ROMFS, ""};
+        break;
+    case ARCHIVE_SAVEDATA:
+    case ARCHIVE_USER_SAVEDATA:
+        if (Host::config.saveDir.empty()) return FS_RESULT_NOT_FOUND;
+        info = {ArchiveKind::DIRECTORY, Host::config.saveDir};
+        break;
+    case ARCHIVE_SDMC:
+        if (Host::config.sdmcDir.empty()) return FS_RESULT_NOT_FOUND;
+        info = {ArchiveKind::DIRECTORY, Host::config.sdmcDir};
+        break;
+    default:
+        // Extdata and system archives are not emulated
+        return FS_RESULT_NOT_FOUND;
+    }
+    Host::config.saveLatency.Apply(0);
+
+    std::lock_guard<std::mutex> guard(fsLock);
+    *archive = nextArchive++;
+    archives.emplace(*archive, info);
+    return 0;
+}
+
+Result FSUSER_CloseArchive(FS_Archive archive) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    return archives.erase(archive) ? 0 : FS_RESULT_INVALID_HANDLE;
+}
+
+Result FSUSER_OpenFileDirectly(Handle* out, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 openFlags, u32 attributes) {
+    FS_Archive archive;
+    Result res = FSUSER_OpenArchive(&archive, archiveId, archivePath);
+    if (R_FAILED(res)) return res;
+    res = FSUSER_OpenFile(out, archive, filePath, openFlags, attributes);
+    FSUSER_CloseArchive(archive);
+    return res;
+}
+
+Result FSUSER_OpenFile(Handle* out, FS_Archive archive, FS_Path path, u32 openFlags, u32) {
+    std::unique_lock<std::mutex> guard(fsLock);
+    auto it = archives.find(archive);
+    if (it == archives.end()) return FS_RESULT_INVALID_HANDLE;
+    if (it->second.kind == ArchiveKind::ROMFS) {
+        guard.unlock();
+        if (openFlags & (FS_OPEN_WRITE | FS_OPEN_CREATE)) return FS_RESULT_NOT_SUPPORTED;
+        return OpenContentFile(out, path);
+    }
+
+    std::string hostPath;
+    if (!GetHostPath(archive, path, hostPath)) return FS_RESULT_INVALID_ARG;
+    guard.unlock();
+
+    int flags = (openFlags & FS_OPEN_WRITE) ? O_RDWR : O_RDONLY;
+    if (openFlags & FS_OPEN_CREATE) flags |= O_CREAT;
+    Host::config.saveLatency.Apply(0);
+    int fd = open(hostPath.c_str(), flags, 0644);
+    if (fd < 0) return ErrnoToResult(errno);
+
+    guard.lock();
+    *out = AddFile({fd, 0, 0, !(openFlags & FS_OPEN_WRITE), false, &Host::config.saveLatency});
+    return 0;
+}
+
+Result FSUSER_CreateFile(FS_Archive archive, FS_Path path, u32, u64 fileSize) {
+    std::string hostPath;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        if (!GetHostPath(archive, path, hostPath)) return FS_RESULT_INVALID_ARG;
+    }
+    Host::config.saveLatency.Apply(0);
+    int fd = open(hostPath.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) return ErrnoToResult(errno);
+    int res = ftruncate(fd, fileSize);
+    close(fd);
+    return res == 0 ? 0 : ErrnoToResult(errno);
+}
+
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path) {
+    std::string hostPath;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        if (!GetHostPath(archive, path, hostPath)) return FS_RESULT_INVALID_ARG;
+    }
+    Host::config.saveLatency.Apply(0);
+    return unlink(hostPath.c_str()) == 0 ? 0 : ErrnoToResult(errno);
+}
+
+Result FSUSER_RenameFile(FS_Archive srcArchive, FS_Path srcPath, FS_Archive dstArchive, FS_Path dstPath) {
+    std::string src, dst;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        if (!GetHostPath(srcArchive, srcPath, src) || !GetHostPath(dstArchive, dstPath, dst)) return FS_RESULT_INVALID_ARG;
+    }
+    Host::config.saveLatency.Apply(0);
+    struct stat st;
+    if (stat(dst.c_str(), &st) == 0) return FS_RESULT_ALREADY_EXISTS;
+    return rename(src.c_str(), dst.c_str()) == 0 ? 0 : ErrnoToResult(errno);
+}
+
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32) {
+    std::string hostPath;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        if (!GetHostPath(archive, path, hostPath)) return FS_RESULT_INVALID_ARG;
+    }
+    Host::config.saveLatency.Apply(0);
+    return mkdir(hostPath.c_str(), 0755) == 0 ? 0 : ErrnoToResult(errno);
+}
+
+Result FSUSER_DeleteDirectory(FS_Archive archive, FS_Path path) {
+    std::string hostPath;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        if (!GetHostPath(archive, path, hostPath)) return FS_RESULT_INVALID_ARG;
+    }
+    Host::config.saveLatency.Apply(0);
+    return rmdir(hostPath.c_str()) == 0 ? 0 : ErrnoToResult(errno);
+}
+
+Result FSUSER_DeleteDirectoryRecursively(FS_Archive archive, FS_Path path) {
+    std::string hostPath;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        if (!GetHostPath(archive, path, hostPath)) return FS_RESULT_INVALID_ARG;
+    }
+    Host::config.saveLatency.Apply(0);
+    return RemoveRecursively(hostPath, false);
+}
+
+Result FSUSER_RenameDirectory(FS_Archive srcArchive, FS_Path srcPath, FS_Archive dstArchive, FS_Path dstPath) {
+    return FSUSER_RenameFile(srcArchive, srcPath, dstArchive, dstPath);
+}
+
+Result FSUSER_OpenDirectory(Handle* out, FS_Archive archive, FS_Path path) {
+    std::string hostPath;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        if (!GetHostPath(archive, path, hostPath, true)) return FS_RESULT_INVALID_ARG;
+    }
+    Host::config.saveLatency.Apply(0);
+
+    DirInfo info;
+    DIR* dir = opendir(hostPath.c_str());
+    if (!dir) return ErrnoToResult(errno);
+    while (struct dirent* ent = readdir(dir)) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        struct stat st;
+        if (stat((hostPath + "/" + ent->d_name).c_str(), &st) != 0) continue;
+        FillDirectoryEntry(info.entries.emplace_back(), ent->d_name, st);
+    }
+    closedir(dir);
+
+    std::lock_guard<std::mutex> guard(fsLock);
+    *out = nextHandle++;
+    dirs.emplace(*out, std::move(info));
+    return 0;
+}
+
+Result FSUSER_ControlArchive(FS_Archive archive, FS_ArchiveAction action, void*, u32, void* output, u32 outputSize) {
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        if (!archives.count(archive)) return FS_RESULT_INVALID_HANDLE;
+    }
+    switch (action) {
+    case ARCHIVE_ACTION_COMMIT_SAVE_DATA:
+        Host::config.saveLatency.Apply(0);
+        sync();
+        return 0;
+    case ARCHIVE_ACTION_GET_TIMESTAMP:
+        memset(output, 0, outputSize);
+        return 0;
+    default:
+        return FS_RESULT_NOT_SUPPORTED;
+    }
+}
+
+Result FSUSER_GetFreeBytes(u64* freeBytes, FS_Archive archive) {
+    std::string root;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        auto it = archives.find(archive);
+        if (it == archives.end()) return FS_RESULT_INVALID_HANDLE;
+        root = it->second.root;
+    }
+    struct statvfs st;
+    if (root.empty() || statvfs(root.c_str(), &st) != 0) {
+        *freeBytes = 0;
+        return 0;
+    }
+    *freeBytes = static_cast<u64>(st.f_bavail) * st.f_frsize;
+    return 0;
+}
+
+Result FSUSER_GetFormatInfo(u32* totalSize, u32* directories, u32* files, bool* duplicateData, FS_ArchiveID archiveId, FS_Path) {
+    if (archiveId != ARCHIVE_SAVEDATA && archiveId != ARCHIVE_USER_SAVEDATA) return FS_RESULT_NOT_SUPPORTED;
+    if (Host::config.saveDir.empty()) return FS_RESULT_NOT_FOUND;
+    std::lock_guard<std::mutex> guard(fsLock);
+    *totalSize = formatInfo.totalSize;
+    *directories = formatInfo.directories;
+    *files = formatInfo.files;
+    *duplicateData = formatInfo.duplicateData;
+    return 0;
+}
+
+Result FSUSER_FormatSaveData(FS_ArchiveID archiveId, FS_Path, u32 blocks, u32 directories, u32 files, u32, u32, bool duplicateData) {
+    if (archiveId != ARCHIVE_SAVEDATA && archiveId != ARCHIVE_USER_SAVEDATA) return FS_RESULT_NOT_SUPPORTED;
+    if (Host::config.saveDir.empty()) return FS_RESULT_NOT_FOUND;
+    Host::config.saveLatency.Apply(0);
+    mkdir(Host::config.saveDir.c_str(), 0755);
+    Result res = RemoveRecursively(Host::config.saveDir, true);
+    if (R_FAILED(res)) return res;
+
+    std::lock_guard<std::mutex> guard(fsLock);
+    formatInfo = {blocks * 0x200, directories, files, duplicateData};
+    return 0;
+}
+
+Result FSUSER_GetProductInfo(FS_ProductInfo* info, u32) {
+    memset(info, 0, sizeof(FS_ProductInfo));
+    memcpy(info->productCode, Host::config.productCode.c_str(), std::min(Host::config.productCode.size(), sizeof(info->productCode)));
+    memcpy(info->companyCode, "00", sizeof(info->companyCode));
+    return 0;
+}
+
+Result FSUSER_SetSaveDataSecureValue(u64 value, FS_SecureValueSlot slot, u32, u8) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    secureValues[slot] = value;
+    return 0;
+}
+
+Result FSUSER_GetSaveDataSecureValue(bool* exists, u64* value, FS_SecureValueSlot slot, u32, u8) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    auto it = secureValues.find(slot);
+    *exists = it != secureValues.end();
+    *value = *exists ? it->second : 0;
+    return 0;
+}
+
+Result FSUSER_ControlSecureSave(FS_SecureSaveAction, void*, u32, void*, u32) {
+    return 0;
+}
+
+Result FSUSER_CreateExtSaveData(FS_ExtSaveDataInfo, u32, u32, u64, u32, u8*) {
+    return FS_RESULT_NOT_SUPPORTED;
+}
+
+Result FSUSER_DeleteExtSaveData(FS_ExtSaveDataInfo) {
+    return FS_RESULT_NOT_SUPPORTED;
+}
+
+Result FSUSER_CreateSystemSaveData(FS_SystemSaveDataInfo, u32, u32, u32, u32, u32, u32, bool) {
+    return FS_RESULT_NOT_SUPPORTED;
+}
+
+Result FSFILE_Read(Handle handle, u32* bytesRead, u64 offset, void* buffer, u32 size) {
+    FileInfo info;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        auto it = files.find(handle);
+        if (it == files.end()) return FS_RESULT_INVALID_HANDLE;
+        info = it->second;
+    }
+    if (info.sized) {
+        if (offset >= info.size) size = 0;
+        else if (size > info.size - offset) size = static_cast<u32>(info.size - offset);
+    }
+    ssize_t res = size ? pread(info.fd, buffer, size, info.base + offset) : 0;
+    if (res < 0) return ErrnoToResult(errno);
+    info.latency->Apply(res);
+    *bytesRead = static_cast<u32>(res);
+    return 0;
+}
+
+Result FSFILE_Write(Handle handle, u32* bytesWritten, u64 offset, const void* buffer, u32 size, u32 flags) {
+    FileInfo info;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        auto it = files.find(handle);
+        if (it == files.end()) return FS_RESULT_INVALID_HANDLE;
+        info = it->second;
+    }
+    if (info.readOnly) return FS_RESULT_NOT_SUPPORTED;
+    ssize_t res = pwrite(info.fd, buffer, size, offset);
+    if (res < 0) return ErrnoToResult(errno);
+    if (flags & FS_WRITE_FLUSH) fdatasync(info.fd);
+    info.latency->Apply(res);
+    *bytesWritten = static_cast<u32>(res);
+    return 0;
+}
+
+Result FSFILE_GetSize(Handle handle, u64* size) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    auto it = files.find(handle);
+    if (it == files.end()) return FS_RESULT_INVALID_HANDLE;
+    if (it->second.sized) {
+        *size = it->second.size;
+        return 0;
+    }
+    struct stat st;
+    if (fstat(it->second.fd, &st) != 0) return ErrnoToResult(errno);
+    *size = st.st_size;
+    return 0;
+}
+
+Result FSFILE_SetSize(Handle handle, u64 size) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    auto it = files.find(handle);
+    if (it == files.end()) return FS_RESULT_INVALID_HANDLE;
+    if (it->second.readOnly) return FS_RESULT_NOT_SUPPORTED;
+    return ftruncate(it->second.fd, size) == 0 ? 0 : ErrnoToResult(errno);
+}
+
+Result FSFILE_GetAttributes(Handle handle, u32* attributes) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    if (!files.count(handle)) return FS_RESULT_INVALID_HANDLE;
+    *attributes = 0;
+    return 0;
+}
+
+Result FSFILE_SetAttributes(Handle handle, u32) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    return files.count(handle) ? 0 : FS_RESULT_INVALID_HANDLE;
+}
+
+Result FSFILE_Flush(Handle handle) {
+    int fd;
+    {
+        std::lock_guard<std::mutex> guard(fsLock);
+        auto it = files.find(handle);
+        if (it == files.end()) return FS_RESULT_INVALID_HANDLE;
+        fd = it->second.fd;
+    }
+    fdatasync(fd);
+    return 0;
+}
+
+Result FSFILE_Close(Handle handle) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    auto it = files.find(handle);
+    if (it == files.end()) return FS_RESULT_INVALID_HANDLE;
+    close(it->second.fd);
+    files.erase(it);
+    return 0;
+}
+
+Result FSDIR_Read(Handle handle, u32* entriesRead, u32 entryCount, FS_DirectoryEntry* entries) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    auto it = dirs.find(handle);
+    if (it == dirs.end()) return FS_RESULT_INVALID_HANDLE;
+    DirInfo& info = it->second;
+    u32 count = 0;
+    while (count < entryCount && info.next < info.entries.size()) {
+        entries[count++] = info.entries[info.next++];
+    }
+    *entriesRead = count;
+    return 0;
+}
+
+Result FSDIR_Close(Handle handle) {
+    std::lock_guard<std::mutex> guard(fsLock);
+    return dirs.erase(handle) ? 0 : FS_RESULT_INVALID_HANDLE;
+}
+
+}
+
+// Replacements for fsExtension.cpp, which talks to the FS service directly
+Result FSUSER_NewSetSaveDataSecureValue(FS_Archive, u64 value, FS_SecureValueSlot slot, bool) {
+    return FSUSER_SetSaveDataSecureValue(value, slot, 0, 0);
+}
+
+Result FSUSER_NewGetSaveDataSecureValue(bool* exists, bool* isGamecard, u64* value, FS_Archive, FS_SecureValueSlot slot) {
+    *isGamecard = true;
+    return FSUSER_GetSaveDataSecureValue(exists, value, slot, 0, 0);
+}
+
+Result FSUSER_SetThisSaveDataSecureValue(u64 value, FS_SecureValueSlot slot) {
+    return FSUSER_SetSaveDataSecureValue(value, slot, 0, 0);
+}
+
+Result FSUSER_GetThisSaveDataSecureValue(bool* exists, bool* isGamecard, u64* value, FS_SecureValueSlot slot) {
+    *isGamecard = true;
+    return FSUSER_GetSaveDataSecureValue(exists, value, slot, 0, 0);
+}
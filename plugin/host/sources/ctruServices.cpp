@@ -0,0 +1,168 @@
+// AM, CFG, HID, SOC and console services of the libctru stand-in. There are
+// no installed titles, config blocks read as zeros and the inputs are idle.
+#include "3ds.h"
+#include "amExtension.hpp"
+#include "hidExtension.hpp"
+
+#include <stdio.h>
+
+namespace {
+    Handle amSession = 0x20;
+    PrintConsole* currentConsole = nullptr;
+
+    constexpr Result AM_RESULT_NOT_FOUND = MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_AM, RD_NOT_FOUND);
+}
+
+extern "C" {
+
+Result amInit(void) {
+    return 0;
+}
+
+Result amAppInit(void) {
+    return 0;
+}
+
+void amExit(void) {
+}
+
+Handle* amGetSessionHandle(void) {
+    return &amSession;
+}
+
+Result AM_GetTitleCount(FS_MediaType, u32* count) {
+    *count = 0;
+    return 0;
+}
+
+Result AM_GetTitleList(u32* titlesRead, FS_MediaType, u32, u64*) {
+    *titlesRead = 0;
+    return 0;
+}
+
+Result AM_GetTitleInfo(FS_MediaType, u32 titleCount, u64*, AM_TitleEntry*) {
+    return titleCount ? AM_RESULT_NOT_FOUND : 0;
+}
+
+Result AMAPP_GetDLCContentInfoCount(u32*, FS_MediaType, u64) {
+    return AM_RESULT_NOT_FOUND;
+}
+
+Result AMAPP_ListDLCContentInfos(u32*, FS_MediaType, u64, u32, u32, AM_ContentInfo*) {
+    return AM_RESULT_NOT_FOUND;
+}
+
+Result cfguInit(void) {
+    return 0;
+}
+
+void cfguExit(void) {
+}
+
+Result CFGU_GetConfigInfoBlk2(u32 size, u32, void* outData) {
+    memset(outData, 0, size);
+    return 0;
+}
+
+u32 hidKeysHeld(void) {
+    return 0;
+}
+
+void hidCircleRead(circlePosition* pos) {
+    *pos = {0, 0};
+}
+
+void hidTouchRead(touchPosition* pos) {
+    *pos = {0, 0};
+}
+
+void hidAccelRead(accelVector* vector) {
+    *vector = {0, 0, 0};
+}
+
+void hidGyroRead(angularRate* rate) {
+    *rate = {0, 0, 0};
+}
+
+void irrstCstickRead(circlePosition* pos) {
+    *pos = {0, 0};
+}
+
+Result HIDUSER_EnableAccelerometer(void) {
+    return 0;
+}
+
+Result HIDUSER_DisableAccelerometer(void) {
+    return 0;
+}
+
+Result HIDUSER_EnableGyroscope(void) {
+    return 0;
+}
+
+Result HIDUSER_DisableGyroscope(void) {
+    return 0;
+}
+
+Result HIDUSER_GetGyroscopeRawToDpsCoefficient(float* coeff) {
+    *coeff = 14.375f;
+    return 0;
+}
+
+Result socInit(u32*, u32) {
+    return 0;
+}
+
+Result socExit(void) {
+    return 0;
+}
+
+PrintConsole* consoleInit(gfxScreen_t, PrintConsole* console) {
+    static PrintConsole defaultConsole;
+    if (!console) console = &defaultConsole;
+    memset(console, 0, sizeof(PrintConsole));
+    console->consoleInitialised = true;
+    currentConsole = console;
+    return console;
+}
+
+PrintConsole* consoleSelect(PrintConsole* console) {
+    PrintConsole* previous = currentConsole;
+    currentConsole = console;
+    return previous;
+}
+
+void consoleClear(void) {
+}
+
+void consoleSetWindow(PrintConsole*, int, int, int, int) {
+}
+
+}
+
+// Replacements for amExtension.cpp and hidExtension.cpp
+Result AM_GetTitleInfoIgnorePlatform(FS_MediaType mediatype, u32 titleCount, u64 *titleIds, AM_TitleEntry *titleInfo) {
+    return AM_GetTitleInfo(mediatype, titleCount, titleIds, titleInfo);
+}
+
+Result AMAPP_FindDLCContentInfos(FS_MediaType, u64, u32, u16*, AM_ContentInfo*) {
+    return AM_RESULT_NOT_FOUND;
+}
+
+Result AMAPP_GetDLCTitleInfos(FS_MediaType mediatype, u32 titleCount, u64 *titleIds, AM_TitleEntry *titleInfo) {
+    return AM_GetTitleInfo(mediatype, titleCount, titleIds, titleInfo);
+}
+
+Result AMAPP_ListDataTitleTicketInfos(u32* ticketReadCount, u64, u32, u32, AM_TicketInfo*) {
+    *ticketReadCount = 0;
+    return 0;
+}
+
+Result AMAPP_GetPatchTitleInfos(FS_MediaType mediatype, u32 titleCount, u64 *titleIds, AM_TitleEntry *titleInfo) {
+    return AM_GetTitleInfo(mediatype, titleCount, titleIds, titleInfo);
+}
+
+Result HIDUSER_GetGyroscopeCalibrateParam(GyroscopeCalibrateParam* calibrateParam) {
+    memset(calibrateParam, 0, sizeof(GyroscopeCalibrateParam));
+    return 0;
+}
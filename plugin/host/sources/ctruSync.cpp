@@ -0,0 +1,195 @@
+// Threads and synchronization primitives of the libctru stand-in, on top of pthreads.
+#include "3ds.h"
+#include <time.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void InitRecursiveMutex(pthread_mutex_t* m) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(m, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static timespec DeadlineFromNow(s64 timeout_ns) {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    s64 nsec = ts.tv_nsec + timeout_ns;
+    ts.tv_sec += nsec / 1000000000;
+    ts.tv_nsec = nsec % 1000000000;
+    return ts;
+}
+
+extern "C" {
+
+void LightLock_Init(LightLock* lock) { pthread_mutex_init(&lock->m, nullptr); lock->init = true; }
+void LightLock_Lock(LightLock* lock) { pthread_mutex_lock(&lock->m); }
+int  LightLock_TryLock(LightLock* lock) { return pthread_mutex_trylock(&lock->m) == 0 ? 0 : 1; }
+void LightLock_Unlock(LightLock* lock) { pthread_mutex_unlock(&lock->m); }
+
+void RecursiveLock_Init(RecursiveLock* lock) { InitRecursiveMutex(&lock->m); lock->init = true; lock->counter = 0; }
+void RecursiveLock_Lock(RecursiveLock* lock) { pthread_mutex_lock(&lock->m); lock->counter++; }
+int  RecursiveLock_TryLock(RecursiveLock* lock) {
+    if (pthread_mutex_trylock(&lock->m) != 0) return 1;
+    lock->counter++;
+    return 0;
+}
+void RecursiveLock_Unlock(RecursiveLock* lock) { lock->counter--; pthread_mutex_unlock(&lock->m); }
+
+void CondVar_Init(CondVar* cv) { pthread_cond_init(&cv->c, nullptr); cv->init = true; }
+void CondVar_Wait(CondVar* cv, LightLock* lock) { pthread_cond_wait(&cv->c, &lock->m); }
+int  CondVar_WaitTimeout(CondVar* cv, LightLock* lock, s64 timeout_ns) {
+    timespec ts = DeadlineFromNow(timeout_ns);
+    return pthread_cond_timedwait(&cv->c, &lock->m, &ts) == ETIMEDOUT ? 1 : 0;
+}
+void CondVar_WakeUp(CondVar* cv, s32 num_threads) {
+    if (num_threads < 0) pthread_cond_broadcast(&cv->c);
+    else for (s32 i = 0; i < num_threads; i++) pthread_cond_signal(&cv->c);
+}
+
+void LightEvent_Init(LightEvent* event, ResetType reset_type) {
+    pthread_mutex_init(&event->m, nullptr);
+    pthread_cond_init(&event->c, nullptr);
+    event->state = 0;
+    event->type = reset_type;
+}
+void LightEvent_Clear(LightEvent* event) {
+    pthread_mutex_lock(&event->m);
+    event->state = 0;
+    pthread_mutex_unlock(&event->m);
+}
+void LightEvent_Pulse(LightEvent* event) {
+    pthread_mutex_lock(&event->m);
+    pthread_cond_broadcast(&event->c);
+    pthread_mutex_unlock(&event->m);
+}
+void LightEvent_Signal(LightEvent* event) {
+    pthread_mutex_lock(&event->m);
+    event->state = 1;
+    if (event->type == RESET_ONESHOT) pthread_cond_signal(&event->c);
+    else pthread_cond_broadcast(&event->c);
+    pthread_mutex_unlock(&event->m);
+}
+int LightEvent_TryWait(LightEvent* event) {
+    pthread_mutex_lock(&event->m);
+    int signaled = event->state;
+    if (signaled && event->type == RESET_ONESHOT) event->state = 0;
+    pthread_mutex_unlock(&event->m);
+    return signaled;
+}
+void LightEvent_Wait(LightEvent* event) {
+    pthread_mutex_lock(&event->m);
+    while (!event->state) pthread_cond_wait(&event->c, &event->m);
+    if (event->type == RESET_ONESHOT) event->state = 0;
+    pthread_mutex_unlock(&event->m);
+}
+int LightEvent_WaitTimeout(LightEvent* event, s64 timeout_ns) {
+    timespec ts = DeadlineFromNow(timeout_ns);
+    int timedOut = 0;
+    pthread_mutex_lock(&event->m);
+    while (!event->state && !timedOut) timedOut = pthread_cond_timedwait(&event->c, &event->m, &ts) == ETIMEDOUT;
+    if (!timedOut && event->type == RESET_ONESHOT) event->state = 0;
+    pthread_mutex_unlock(&event->m);
+    return timedOut;
+}
+
+void LightSemaphore_Init(LightSemaphore* semaphore, s16 initial_count, s16 max_count) {
+    pthread_mutex_init(&semaphore->m, nullptr);
+    pthread_cond_init(&semaphore->c, nullptr);
+    semaphore->current = initial_count;
+    semaphore->max = max_count;
+}
+void LightSemaphore_Acquire(LightSemaphore* semaphore, s32 count) {
+    pthread_mutex_lock(&semaphore->m);
+    while (semaphore->current < count) pthread_cond_wait(&semaphore->c, &semaphore->m);
+    semaphore->current -= count;
+    pthread_mutex_unlock(&semaphore->m);
+}
+int LightSemaphore_TryAcquire(LightSemaphore* semaphore, s32 count) {
+    pthread_mutex_lock(&semaphore->m);
+    int failed = semaphore->current < count;
+    if (!failed) semaphore->current -= count;
+    pthread_mutex_unlock(&semaphore->m);
+    return failed;
+}
+void LightSemaphore_Release(LightSemaphore* semaphore, s32 count) {
+    pthread_mutex_lock(&semaphore->m);
+    semaphore->current += count;
+    pthread_cond_broadcast(&semaphore->c);
+    pthread_mutex_unlock(&semaphore->m);
+}
+
+struct Thread_tag {
+    pthread_t thread;
+    ThreadFunc entrypoint;
+    void* arg;
+    bool finished;
+};
+
+static void* ThreadEntry(void* arg) {
+    Thread t = reinterpret_cast<Thread>(arg);
+    t->entrypoint(t->arg);
+    t->finished = true;
+    return nullptr;
+}
+
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t, int, int, bool detached) {
+    // Priorities and cores are meaningless on the host, only keep the threads
+    Thread t = (Thread)calloc(1, sizeof(Thread_tag));
+    if (!t) return nullptr;
+    t->entrypoint = entrypoint;
+    t->arg = arg;
+    if (pthread_create(&t->thread, nullptr, ThreadEntry, t) != 0) {
+        free(t);
+        return nullptr;
+    }
+    if (detached) pthread_detach(t->thread);
+    return t;
+}
+
+Result threadJoin(Thread thread, u64) {
+    if (!thread) return 0;
+    pthread_join(thread->thread, nullptr);
+    return 0;
+}
+
+void threadFree(Thread thread) {
+    free(thread);
+}
+
+void threadExit(int) {
+    pthread_exit(nullptr);
+}
+
+void svcSleepThread(s64 ns) {
+    if (ns <= 0) {
+        sched_yield();
+        return;
+    }
+    timespec ts = {(time_t)(ns / 1000000000), (long)(ns % 1000000000)};
+    nanosleep(&ts, nullptr);
+}
+
+u64 svcGetSystemTick(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64)ts.tv_sec * SYSCLOCK_ARM11) + ((u64)ts.tv_nsec * SYSCLOCK_ARM11) / 1000000000ULL;
+}
+
+Result svcGetThreadPriority(s32* out, Handle) {
+    *out = 0x30;
+    return 0;
+}
+
+Result svcCloseHandle(Handle) {
+    return 0;
+}
+
+Result APT_CheckNew3DS(bool* out) {
+    *out = sysconf(_SC_NPROCESSORS_ONLN) > 2;
+    return 0;
+}
+
+}
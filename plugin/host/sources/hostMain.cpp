@@ -0,0 +1,145 @@
+// Entry point of the host build: serves one application from files on disk
+// over a regular TCP socket, with the same server loop as the plugin.
+#include "Main.hpp"
+#include "HostConfig.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "ArticFunctions.hpp"
+#include "Server.hpp"
+#include "CTRPluginFramework/Clock.hpp"
+
+Logger logger;
+int transferedBytes = 0;
+bool isControllerMode = false;
+
+PrintConsole topScreenConsole, bottomScreenConsole;
+
+namespace Host {
+    Config config;
+}
+
+static volatile sig_atomic_t should_exit = 0;
+
+static void OnSignal(int) {
+    should_exit = 1;
+}
+
+static void PrintUsage(const char* name) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --romfs <file>           RomFS image (level 3 or with IVFC header)\n"
+        "  --exefs <dir>            Extracted ExeFS (code.bin, icon.bin, banner.bin, logo.bin)\n"
+        "  --exheader <file>        Decrypted exheader, synthesized from code.bin if missing\n"
+        "  --save <dir>             Save data directory\n"
+        "  --sdmc <dir>             SD card directory\n"
+        "  --title-id <hex>         Title ID, taken from the exheader if missing\n"
+        "  --product-code <code>    Product code returned by Process_GetProductInfo\n"
+        "  --romfs-latency <us,us>  Fixed cost and cost per KiB of RomFS/ExeFS accesses (default 250,60)\n"
+        "  --save-latency <us,us>   Fixed cost and cost per KiB of save data accesses (default 100,40)\n"
+        "  --no-latency             Disable the latency model\n"
+        "  --debug                  Enable the debug log\n",
+        name);
+}
+
+static bool ParseArguments(int argc, char* argv[]) {
+    using Host::config;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        auto takeValue = [&]() {
+            if (value) i++;
+            return value != nullptr;
+        };
+
+        if (strcmp(arg, "--romfs") == 0 && takeValue()) {
+            config.romfsImage = value;
+        } else if (strcmp(arg, "--exefs") == 0 && takeValue()) {
+            config.exefsDir = value;
+        } else if (strcmp(arg, "--exheader") == 0 && takeValue()) {
+            config.exheaderFile = value;
+        } else if (strcmp(arg, "--save") == 0 && takeValue()) {
+            config.saveDir = value;
+        } else if (strcmp(arg, "--sdmc") == 0 && takeValue()) {
+            config.sdmcDir = value;
+        } else if (strcmp(arg, "--title-id") == 0 && takeValue()) {
+            config.titleID = strtoull(value, nullptr, 16);
+        } else if (strcmp(arg, "--product-code") == 0 && takeValue()) {
+            config.productCode = value;
+        } else if (strcmp(arg, "--romfs-latency") == 0 && takeValue()) {
+            if (!config.romfsLatency.Parse(value)) return false;
+        } else if (strcmp(arg, "--save-latency") == 0 && takeValue()) {
+            if (!config.saveLatency.Parse(value)) return false;
+        } else if (strcmp(arg, "--no-latency") == 0) {
+            config.romfsLatency.fixedMicroseconds = config.romfsLatency.microsecondsPerKiB = 0;
+            config.saveLatency.fixedMicroseconds = config.saveLatency.microsecondsPerKiB = 0;
+        } else if (strcmp(arg, "--debug") == 0) {
+            logger.debug_enable = true;
+        } else {
+            return false;
+        }
+    }
+    return !config.romfsImage.empty() || !config.exefsDir.empty() || !config.saveDir.empty();
+}
+
+static void Start(void*) {
+    Server::Run(nullptr);
+}
+
+int main(int argc, char* argv[]) {
+    if (!ParseArguments(argc, argv)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    // A client disconnecting mid-send must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    logger.Start();
+    logger.Info("ArticBase host v%d.%d.%d", VERSION_MAJOR, VERSION_MINOR, VERSION_REVISION);
+
+    if (!Host::LoadApplication()) {
+        logger.End();
+        return 1;
+    }
+
+    bool setupCorrect = true;
+    for (auto it = ArticFunctions::setupFunctions.begin(); it != ArticFunctions::setupFunctions.end(); it++) {
+        setupCorrect = (*it)() && setupCorrect;
+    }
+    if (!setupCorrect) {
+        logger.Error("Server: Setup failed");
+        logger.End();
+        return 1;
+    }
+
+    Thread serverThread = threadCreate(Start, nullptr, 0x1000, 0x30, -2, false);
+
+    CTRPluginFramework::Clock clock;
+    while (!should_exit) {
+        svcSleepThread(100000000);
+        if (clock.HasTimePassed(CTRPluginFramework::Seconds(1))) {
+            if (Server::IsConnected()) {
+                CTRPluginFramework::Time t = clock.GetElapsedTime();
+                float bytes = transferedBytes / t.AsSeconds();
+                transferedBytes = 0;
+                logger.Debug("Traffic: %.02f KB/s", bytes / 1000.f);
+            }
+            clock.Restart();
+        }
+    }
+
+    logger.Info("Server: Exiting");
+    Server::Stop();
+    if (serverThread) {
+        threadJoin(serverThread, U64_MAX);
+        threadFree(serverThread);
+    }
+    logger.End();
+    return 0;
+}
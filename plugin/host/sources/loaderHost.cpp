@@ -0,0 +1,114 @@
+// Application loading for the host build: stands in for the loader service
+// and for the process information the plugin reads from its host process.
+#include "3ds.h"
+#include "HostConfig.hpp"
+#include "Main.hpp"
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+namespace {
+    ExHeader_Info exheader;
+    u8* codeAddress = nullptr;
+
+    bool ReadFile(const std::string& path, std::vector<u8>& out) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        struct stat st;
+        fstat(fileno(f), &st);
+        out.resize(st.st_size);
+        bool good = fread(out.data(), 1, out.size(), f) == out.size();
+        fclose(f);
+        return good;
+    }
+
+    u32 PageCount(u32 size) {
+        return (size + 0xFFF) >> 12;
+    }
+}
+
+namespace Host {
+    bool LoadApplication() {
+        std::vector<u8> code;
+        if (!config.exefsDir.empty() && !ReadFile(config.exefsDir + "/code.bin", code)) {
+            logger.Error("Host: Cannot read %s/code.bin", config.exefsDir.c_str());
+            return false;
+        }
+
+        memset(&exheader, 0, sizeof(exheader));
+        if (!config.exheaderFile.empty()) {
+            std::vector<u8> data;
+            if (!ReadFile(config.exheaderFile, data) || data.size() < sizeof(exheader)) {
+                logger.Error("Host: Cannot read exheader %s", config.exheaderFile.c_str());
+                return false;
+            }
+            memcpy(&exheader, data.data(), sizeof(exheader));
+            // The ARM11 local capabilities start with the program ID
+            if (config.titleID == 0) memcpy(&config.titleID, exheader.aci, sizeof(u64));
+        } else {
+            // Without an exheader the whole code.bin is presented as .text
+            ExHeader_CodeSetInfo& info = exheader.sci.codeset_info;
+            memcpy(info.name, "HOST", 4);
+            info.text = {0x00100000, PageCount(code.size()), static_cast<u32>(code.size())};
+            info.stack_size = 0x4000;
+            memcpy(exheader.aci, &config.titleID, sizeof(u64));
+        }
+
+        // Sections are mapped back to back on page boundaries, like the
+        // decompressed code.bin is laid out
+        const ExHeader_CodeSetInfo& info = exheader.sci.codeset_info;
+        size_t mappedSize = static_cast<size_t>(info.text.num_pages + info.rodata.num_pages + info.data.num_pages) << 12;
+        if (mappedSize < code.size()) mappedSize = code.size();
+        codeAddress = static_cast<u8*>(calloc(1, mappedSize ? mappedSize : 1));
+        if (!codeAddress) return false;
+        if (!code.empty()) memcpy(codeAddress, code.data(), code.size());
+
+        logger.Info("Host: Title %016llX, code 0x%zX bytes", static_cast<unsigned long long>(config.titleID), mappedSize);
+        return true;
+    }
+
+    u8* GetCodeAddress() {
+        return codeAddress;
+    }
+}
+
+extern "C" {
+
+Result svcGetProcessInfo(s64* out, Handle, u32 type) {
+    switch (type) {
+    case 0x10001: // Title ID
+        *out = static_cast<s64>(Host::config.titleID);
+        return 0;
+    case 0x10005: // Start of .text
+        *out = reinterpret_cast<intptr_t>(Host::GetCodeAddress());
+        return 0;
+    default:
+        return MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_KERNEL, RD_INVALID_ENUM_VALUE);
+    }
+}
+
+Result svcGetProcessId(u32* out, Handle) {
+    *out = 0x30;
+    return 0;
+}
+
+}
+
+// Replacements for loaderCustom.cpp
+namespace ArticFunctions {
+    Result loaderInitCustom(void) {
+        return 0;
+    }
+
+    void loaderExitCustom(void) {
+    }
+
+    Result LOADER_GetLastApplicationProgramInfo(ExHeader_Info* exheaderInfo) {
+        memcpy(exheaderInfo, &exheader, sizeof(ExHeader_Info));
+        return 0;
+    }
+}
@@ -0,0 +1,186 @@
+// "#Batch" sub-call limits and ordering
+#include "Test.hpp"
+#include "ArticHandleCache.hpp"
+#include "HostConfig.hpp"
+#include <string>
+#include <vector>
+
+using namespace Test;
+
+namespace {
+    // Sub-call encoding of "#Batch", see Batch::ParseSubCall
+    class BatchBuilder {
+    public:
+        static constexpr u8 OPEN_FILE = 0;
+        static constexpr u8 OPEN_FILE_DIRECTLY = 1;
+        static constexpr u8 FILE_GET_SIZE = 2;
+        static constexpr u8 FILE_READ = 3;
+        static constexpr u8 FILE_CLOSE = 4;
+        static constexpr u8 DIR_READ = 6;
+        static constexpr u8 FLAG_HANDLE_REF = 1 << 0;
+
+        void OpenFile(FS_Archive archive, const char* path, u32 openFlags) {
+            Header(OPEN_FILE, 0);
+            Put(static_cast<s64>(archive));
+            Put<u32>(PATH_ASCII);
+            Put<u32>(static_cast<u32>(strlen(path) + 1));
+            data.insert(data.end(), path, path + strlen(path) + 1);
+            Put<s32>(openFlags);
+            Put<s32>(0);
+        }
+
+        void OpenRomFS() {
+            static const u8 romfsPath[0xC] = {};
+            Header(OPEN_FILE_DIRECTLY, 0);
+            Put<s32>(ARCHIVE_ROMFS);
+            Put<u32>(PATH_EMPTY);
+            Put<u32>(1);
+            data.push_back(0);
+            Put<u32>(PATH_BINARY);
+            Put<u32>(sizeof(romfsPath));
+            data.insert(data.end(), romfsPath, romfsPath + sizeof(romfsPath));
+            Put<s32>(FS_OPEN_READ);
+            Put<s32>(0);
+        }
+
+        // handle is a sub-call index if ref is set
+        void Read(s32 handle, bool ref, s64 offset, u32 size) {
+            Header(FILE_READ, ref ? FLAG_HANDLE_REF : 0);
+            Put(handle);
+            Put(offset);
+            Put(size);
+        }
+
+        void DirRead(s32 handle, u32 count) {
+            Header(DIR_READ, 0);
+            Put(handle);
+            Put(count);
+        }
+
+        void Close(s32 handle, bool ref) {
+            Header(FILE_CLOSE, ref ? FLAG_HANDLE_REF : 0);
+            Put(handle);
+        }
+
+        std::vector<u8> data;
+
+    private:
+        void Header(u8 op, u8 flags) {
+            data.push_back(op);
+            data.push_back(flags);
+            Put<u16>(0);
+        }
+
+        template<typename T>
+        void Put(T value) {
+            const u8* bytes = reinterpret_cast<const u8*>(&value);
+            data.insert(data.end(), bytes, bytes + sizeof(T));
+        }
+    };
+
+    struct SubCallResult {
+        Result result;
+        std::vector<u8> data;
+    };
+
+    // Returns false if the batch was rejected
+    bool RunBatch(const BatchBuilder& batch, std::vector<SubCallResult>& results) {
+        MethodInterface mi;
+        mi.AddParameterBuffer(batch.data.data(), batch.data.size());
+        Call("#Batch", mi);
+        const ArticProtocolCommon::Buffer* buffer = mi.GetResultBuffer(0);
+        if (!mi.IsGood() || mi.GetReturnValue() != 0 || !buffer) return false;
+
+        results.clear();
+        const u8* cur = reinterpret_cast<const u8*>(buffer->data);
+        const u8* end = cur + buffer->bufferSize;
+        while (cur != end) {
+            s32 result;
+            u32 size;
+            if (end - cur < 8) return false;
+            memcpy(&result, cur, sizeof(s32));
+            memcpy(&size, cur + sizeof(s32), sizeof(u32));
+            cur += 8;
+            if (static_cast<size_t>(end - cur) < size) return false;
+            results.push_back({result, std::vector<u8>(cur, cur + size)});
+            cur += size;
+        }
+        return true;
+    }
+}
+
+TEST(BatchReadsInOneRequest) {
+    BatchBuilder batch;
+    batch.OpenRomFS();
+    batch.Read(0, true, 0x100, 0x2000);
+    batch.Read(0, true, ROMFS_SIZE - 0x10, 0x100);
+    batch.Close(0, true);
+    std::vector<SubCallResult> results;
+    CHECK(RunBatch(batch, results));
+    CHECK(results.size() == 4);
+    for (const SubCallResult& result : results) {
+        CHECK(result.result == 0);
+    }
+    CHECK(results[1].data.size() == 0x2000);
+    CHECK(MatchesRomFS(results[1].data.data(), 0x100, 0x2000));
+    CHECK(results[2].data.size() == 0x10);
+    CHECK(MatchesRomFS(results[2].data.data(), ROMFS_SIZE - 0x10, 0x10));
+}
+
+TEST(BatchRejectsOversizedResults) {
+    std::vector<SubCallResult> results;
+    // A single sub-call over the limit
+    BatchBuilder read;
+    read.OpenRomFS();
+    read.Read(0, true, 0, 0xFFFFFFFF);
+    CHECK(!RunBatch(read, results));
+
+    // Entry counts whose result size wraps around in 32 bits
+    BatchBuilder dirRead;
+    dirRead.DirRead(0x1234, 0x80000000);
+    CHECK(!RunBatch(dirRead, results));
+
+    // Sub-calls within the limit adding up past the batch limit
+    BatchBuilder total;
+    total.OpenRomFS();
+    for (int i = 0; i < 3; i++) {
+        total.Read(0, true, 0, 0x100000);
+    }
+    CHECK(!RunBatch(total, results));
+
+    // Nothing was opened by the rejected batches
+    CHECK(ArticFunctions::handleCache.GetCounters().misses == 0);
+}
+
+TEST(BatchKeepsSubCallOrder) {
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+
+    // The opens around the create have to see the file missing and present.
+    // Slow FS calls give the workers time to overtake each other.
+    constexpr int ROUNDS = 16;
+    BatchBuilder batch;
+    for (int round = 0; round < ROUNDS; round++) {
+        std::string path = "/order" + std::to_string(round) + ".bin";
+        batch.OpenFile(archive, path.c_str(), FS_OPEN_READ);
+        batch.OpenFile(archive, path.c_str(), FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+        batch.Close(round * 4 + 1, true);
+        batch.OpenFile(archive, path.c_str(), FS_OPEN_READ);
+    }
+    std::vector<SubCallResult> results;
+    Host::config.saveLatency.fixedMicroseconds = 500;
+    bool ran = RunBatch(batch, results);
+    Host::config.saveLatency.fixedMicroseconds = 0;
+    CHECK(ran);
+    CHECK(results.size() == ROUNDS * 4);
+    for (int round = 0; round < ROUNDS; round++) {
+        CHECK(R_FAILED(results[round * 4].result));
+        CHECK(results[round * 4 + 1].result == 0);
+        CHECK(results[round * 4 + 2].result == 0);
+        CHECK(results[round * 4 + 3].result == 0);
+        Handle handle;
+        memcpy(&handle, results[round * 4 + 3].data.data(), sizeof(Handle));
+        CHECK(CloseFile(handle) == 0);
+    }
+    CloseArchive(archive);
+}
@@ -0,0 +1,74 @@
+// "Process_Bootstrap" and the ExeFS section reads
+#include "Test.hpp"
+#include "ArticHandleCache.hpp"
+#include "ArticBlockCache.hpp"
+
+using namespace Test;
+using ArticFunctions::BlockCache;
+
+namespace {
+    // See Bootstrap::Header
+    struct SectionHeader {
+        s32 result;
+        u32 offset;
+        u32 size;
+        u32 microseconds;
+    };
+
+    constexpr u32 ICON = 4;
+    constexpr u32 SECTION_COUNT = 7;
+    constexpr const char EXEFS_SECTIONS[] = {'i', 'b', 'l'};
+
+    bool MatchesExeFS(const u8* data, char section, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] != ExeFSByte(section, i)) return false;
+        }
+        return true;
+    }
+
+    // Checks the ExeFS sections of a bootstrap response
+    bool Bootstrap() {
+        MethodInterface mi;
+        mi.AddParameterS32(0x1000);
+        Call("Process_Bootstrap", mi);
+        const ArticProtocolCommon::Buffer* buffer = mi.GetResultBuffer(0);
+        if (!mi.IsGood() || mi.GetReturnValue() != 0 || !buffer) return false;
+
+        const u8* data = reinterpret_cast<const u8*>(buffer->data);
+        u32 sectionCount;
+        memcpy(&sectionCount, data, sizeof(u32));
+        if (sectionCount != SECTION_COUNT) return false;
+        for (u32 i = 0; i < sizeof(EXEFS_SECTIONS); i++) {
+            SectionHeader section;
+            memcpy(&section, data + 2 * sizeof(u32) + (ICON + i) * sizeof(SectionHeader), sizeof(SectionHeader));
+            if (section.result != 0 || section.size != EXEFS_SIZE || section.offset + section.size > buffer->bufferSize ||
+                !MatchesExeFS(data + section.offset, EXEFS_SECTIONS[i], section.size)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST(BootstrapReadsExeFSOncePerSession) {
+    CHECK(Bootstrap());
+    auto handles = ArticFunctions::handleCache.GetCounters();
+    CHECK(handles.misses == 3);
+    BlockCache::Counters blocks = GetStats<BlockCache::Counters>("#BlockCacheStats");
+
+    // Later reads of the sections reuse the handles and the cached data
+    CHECK(Bootstrap());
+    MethodInterface icon;
+    Call("Process_ReadIcon", icon);
+    CHECK(icon.IsGood() && icon.GetReturnValue() == 0);
+    const ArticProtocolCommon::Buffer* buffer = icon.GetResultBuffer(0);
+    CHECK(buffer && buffer->bufferSize == EXEFS_SIZE);
+    CHECK(MatchesExeFS(reinterpret_cast<const u8*>(buffer->data), 'i', EXEFS_SIZE));
+
+    auto handlesAfter = ArticFunctions::handleCache.GetCounters();
+    CHECK(handlesAfter.misses == 3);
+    CHECK(handlesAfter.hits == handles.hits + 4);
+    BlockCache::Counters blocksAfter = GetStats<BlockCache::Counters>("#BlockCacheStats");
+    CHECK(blocksAfter.hits == blocks.hits + 4);
+    CHECK(blocksAfter.insertions == blocks.insertions);
+}
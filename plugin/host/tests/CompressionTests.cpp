@@ -0,0 +1,39 @@
+// In place compression of read responses
+#include "Test.hpp"
+#include "ArticCompression.hpp"
+#include <stdlib.h>
+#include <vector>
+
+using namespace Test;
+namespace Compression = ArticFunctions::Compression;
+
+TEST(CompressionShrinksRepeatedData) {
+    std::vector<u8> data(Compression::ReserveSize(0x10000));
+    for (size_t i = 0; i < 0x10000; i++) {
+        data[i] = static_cast<u8>(i % 7);
+    }
+    Compression::Info info;
+    size_t sent = Compression::Compress(data.data(), 0x10000, info);
+    CHECK(sent != 0);
+    CHECK(sent < 0x10000);
+    CHECK(info.rawSize == 0x10000);
+}
+
+TEST(CompressionNeverGrowsTheResponse) {
+    // Only the first block compresses, by less than the size table of the
+    // whole response costs
+    constexpr u32 BLOCKS = 600;
+    constexpr size_t SIZE = static_cast<size_t>(BLOCKS) * Compression::BLOCK_SIZE;
+    std::vector<u8> data(Compression::ReserveSize(SIZE));
+    srand(1);
+    for (size_t i = 0; i < SIZE; i++) {
+        data[i] = static_cast<u8>(rand());
+    }
+    memset(data.data(), 0, 0x900);
+    std::vector<u8> raw(data.begin(), data.begin() + SIZE);
+
+    Compression::Info info;
+    size_t sent = Compression::Compress(data.data(), SIZE, info);
+    CHECK(sent == 0);
+    CHECK(memcmp(data.data(), raw.data(), SIZE) == 0);
+}
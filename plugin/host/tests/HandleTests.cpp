@@ -0,0 +1,148 @@
+// Handle cache, shared archives and the handle table
+#include "Test.hpp"
+#include "ArticHandleCache.hpp"
+#include "ArticHandleTable.hpp"
+#include <vector>
+
+using namespace Test;
+using ArticFunctions::HandleCache;
+using ArticFunctions::HandleTable;
+using ArticFunctions::HandleType;
+
+namespace {
+    // Same layout as "#ArchiveStats"
+    struct ArchiveCounters {
+        u32 opens;
+        u32 absorbed;
+        u32 open;
+    };
+
+    std::vector<HandleTable::Record> GetHandleRecords() {
+        MethodInterface mi;
+        Call("#HandleStats", mi);
+        u32 count = Get<u32>(mi);
+        std::vector<HandleTable::Record> records(count);
+        for (u32 i = 0; i < count; i++) {
+            records[i] = Get<HandleTable::Record>(mi, 0, sizeof(u32) + i * sizeof(HandleTable::Record));
+        }
+        return records;
+    }
+
+    const HandleTable::Record* FindRecord(const std::vector<HandleTable::Record>& records, u64 handle) {
+        for (const HandleTable::Record& record : records) {
+            if (record.handle == handle) return &record;
+        }
+        return nullptr;
+    }
+}
+
+TEST(HandleCacheSharesReadOnlyOpens) {
+    Handle first = OpenRomFS();
+    CHECK(first != 0);
+    Handle second = OpenRomFS();
+    CHECK(second == first);
+    HandleCache::Counters counters = ArticFunctions::handleCache.GetCounters();
+    CHECK(counters.misses == 1);
+    CHECK(counters.hits == 1);
+
+    // Still open for the second user
+    CHECK(CloseFile(first) == 0);
+    u8 data[0x100];
+    CHECK(ReadFile(second, 0x1000, data, sizeof(data)) == sizeof(data));
+    CHECK(MatchesRomFS(data, 0x1000, sizeof(data)));
+    CHECK(CloseFile(second) == 0);
+
+    // Kept open while idle
+    Handle third = OpenRomFS();
+    CHECK(third == first);
+    CHECK(CloseFile(third) == 0);
+}
+
+TEST(SharedArchivesAbsorbOpens) {
+    FS_Archive first = OpenArchive(ARCHIVE_SDMC);
+    CHECK(first != 0);
+    FS_Archive second = OpenArchive(ARCHIVE_SDMC);
+    CHECK(second == first);
+    ArchiveCounters counters = GetStats<ArchiveCounters>("#ArchiveStats");
+    CHECK(counters.opens == 1);
+    CHECK(counters.absorbed == 1);
+    CHECK(counters.open == 1);
+
+    // Usable until the last user closes it
+    CloseArchive(first);
+    Handle handle = OpenFile(second, "/shared.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(handle != 0);
+    CHECK(CloseFile(handle) == 0);
+    CloseArchive(second);
+    counters = GetStats<ArchiveCounters>("#ArchiveStats");
+    CHECK(counters.open == 0);
+    CHECK(OpenFile(second, "/shared.bin", FS_OPEN_READ) == 0);
+}
+
+TEST(HandleTableAddsAndRemoves) {
+    static HandleTable table;
+    CHECK(table.Count() == 0);
+
+    // Enough handles for the probes to wrap and collide
+    std::vector<u64> handles;
+    for (u64 i = 1; i <= HandleTable::CAPACITY / 2; i++) {
+        handles.push_back(i * 0x100 + 0x15);
+        CHECK(table.Add(handles.back(), HandleType::FILE, false, 0, static_cast<u32>(i)));
+    }
+    CHECK(table.Count() == handles.size());
+    for (size_t i = 0; i < handles.size(); i += 2) {
+        CHECK(table.Remove(handles[i]));
+    }
+    CHECK(!table.Remove(handles[0]));
+    for (size_t i = 0; i < handles.size(); i++) {
+        HandleTable::Info info;
+        CHECK(table.Get(handles[i], info) == (i % 2 != 0));
+        if (i % 2 != 0) {
+            CHECK(info.type == HandleType::FILE);
+            CHECK(info.pathHash == i + 1);
+        }
+    }
+
+    table.AddAccess(handles[1], 0x200);
+    table.AddAccess(handles[1], 0x100);
+    HandleTable::Info info;
+    CHECK(table.Get(handles[1], info));
+    CHECK(info.ops == 2);
+    CHECK(info.bytes == 0x300);
+
+    std::vector<HandleTable::Record> records(table.Count());
+    CHECK(table.Snapshot(records.data(), records.size()) == handles.size() / 2);
+
+    table.Drain([](u64, HandleType) {});
+    CHECK(table.Count() == 0);
+    CHECK(!table.Get(handles[1], info));
+}
+
+TEST(HandleStatsCountAccesses) {
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    Handle handle = OpenFile(archive, "/stats.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(handle != 0);
+
+    std::vector<u8> data(0x4000, 0x5A);
+    CHECK(WriteFile(handle, 0, data.data(), data.size()) == 0);
+    CHECK(ReadFile(handle, 0, data.data(), 0x1000) == 0x1000);
+
+    std::vector<HandleTable::Record> records = GetHandleRecords();
+    const HandleTable::Record* file = FindRecord(records, handle);
+    CHECK(file != nullptr);
+    CHECK(file->type == static_cast<u8>(HandleType::FILE));
+    CHECK(file->shared == 0);
+    CHECK(file->archive == archive);
+    CHECK(file->pathHash != 0);
+    CHECK(file->ops == 2);
+    CHECK(file->bytes == 0x5000);
+    const HandleTable::Record* archiveRecord = FindRecord(records, archive);
+    CHECK(archiveRecord != nullptr);
+    CHECK(archiveRecord->type == static_cast<u8>(HandleType::ARCHIVE));
+
+    CHECK(CloseFile(handle) == 0);
+    CHECK(FindRecord(GetHandleRecords(), handle) == nullptr);
+    CloseArchive(archive);
+    CHECK(GetHandleRecords().empty());
+}
@@ -0,0 +1,86 @@
+// Memoized responses and their invalidation
+#include "Test.hpp"
+#include "ArticMemo.hpp"
+
+using namespace Test;
+namespace Memo = ArticFunctions::Memo;
+
+namespace {
+    bool GetFreeBytes(FS_Archive archive) {
+        MethodInterface mi;
+        mi.AddParameterS64(static_cast<s64>(archive));
+        Call("FSUSER_GetFreeBytes", mi);
+        return mi.IsGood() && mi.GetReturnValue() == 0;
+    }
+
+    // Whether the call was answered from memory
+    bool GetFreeBytesHits(FS_Archive archive) {
+        u32 hits = GetStats<Memo::Counters>("#MemoStats").hits;
+        return GetFreeBytes(archive) && GetStats<Memo::Counters>("#MemoStats").hits == hits + 1;
+    }
+
+    Handle OpenSaveFileDirectly(const char* path) {
+        MethodInterface mi;
+        mi.AddParameterS32(ARCHIVE_SAVEDATA);
+        AddPath(mi, PATH_EMPTY, "", 1);
+        AddPath(mi, path);
+        mi.AddParameterS32(FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+        mi.AddParameterS32(0);
+        Call("FSUSER_OpenFileDirectly", mi);
+        return (mi.IsGood() && R_SUCCEEDED(mi.GetReturnValue())) ? Get<Handle>(mi) : 0;
+    }
+}
+
+TEST(MemoDropsFreeBytesOnEverySaveChange) {
+    // Two archives on the same save, changed through one and queried
+    // through the other
+    FS_Archive changed = OpenArchive(ARCHIVE_SAVEDATA);
+    FS_Archive queried = OpenArchive(ARCHIVE_USER_SAVEDATA);
+    CHECK(changed != 0 && queried != 0 && changed != queried);
+    CHECK(GetFreeBytes(queried));
+    CHECK(GetFreeBytesHits(queried));
+
+    // Created by a direct open
+    Handle handle = OpenSaveFileDirectly("/memo.bin");
+    CHECK(handle != 0);
+    CHECK(!GetFreeBytesHits(queried));
+    CHECK(GetFreeBytesHits(queried));
+    const u8 data[0x100] = {};
+    CHECK(WriteFile(handle, 0, data, sizeof(data)) == 0);
+    CHECK(!GetFreeBytesHits(queried));
+    CHECK(CloseFile(handle) == 0);
+
+    // Written through the other archive
+    handle = OpenFile(changed, "/memo.bin", FS_OPEN_READ | FS_OPEN_WRITE);
+    CHECK(handle != 0);
+    CHECK(GetFreeBytes(queried));
+    CHECK(GetFreeBytesHits(queried));
+    CHECK(WriteFile(handle, 0x100, data, sizeof(data)) == 0);
+    CHECK(!GetFreeBytesHits(queried));
+    CHECK(CloseFile(handle) == 0);
+
+    CloseArchive(changed);
+    CloseArchive(queried);
+}
+
+TEST(MemoKeepsFreeBytesOnReadOnlyClose) {
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    Handle handle = OpenFile(archive, "/memo.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(handle != 0);
+    const u8 data[0x100] = {};
+    CHECK(WriteFile(handle, 0, data, sizeof(data)) == 0);
+    CHECK(CloseFile(handle) == 0);
+
+    CHECK(GetFreeBytes(archive));
+    CHECK(GetFreeBytesHits(archive));
+    handle = OpenFile(archive, "/memo.bin", FS_OPEN_READ);
+    CHECK(handle != 0);
+    CHECK(CloseFile(handle) == 0);
+    handle = OpenRomFS();
+    CHECK(handle != 0);
+    CHECK(CloseFile(handle) == 0);
+    CHECK(GetFreeBytesHits(archive));
+
+    CloseArchive(archive);
+}
@@ -0,0 +1,65 @@
+// Method lookup: the name map the protocol library searches against the
+// perfect hash table of the plugin
+#include "Test.hpp"
+#include "ArticFunctions.hpp"
+#include <array>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+using namespace Test;
+
+namespace {
+    using Method = std::array<char, sizeof(ArticProtocolCommon::RequestPacket::method)>;
+
+    // Every method name as it arrives in a RequestPacket, plus one unknown
+    std::vector<Method> RequestMethods() {
+        std::vector<Method> methods;
+        for (const auto& handler : ArticFunctions::functionHandlers) {
+            Method method = {};
+            memcpy(method.data(), handler.first.data(), handler.first.size());
+            methods.push_back(method);
+        }
+        Method unknown = {};
+        memcpy(unknown.data(), "FSUSER_NoSuchMethod", sizeof("FSUSER_NoSuchMethod"));
+        methods.push_back(unknown);
+        return methods;
+    }
+
+    template<typename Lookup>
+    double NanosecondsPerLookup(const std::vector<Method>& methods, Lookup lookup) {
+        constexpr u32 ROUNDS = 20000;
+        uintptr_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (u32 round = 0; round < ROUNDS; round++) {
+            for (const Method& method : methods) {
+                sink += reinterpret_cast<uintptr_t>(lookup(method.data()));
+            }
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        volatile uintptr_t keep = sink;
+        (void)keep;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / (static_cast<double>(ROUNDS) * methods.size());
+    }
+}
+
+BENCH(MethodLookup) {
+    std::vector<Method> methods = RequestMethods();
+    CHECK(methods.size() > 1);
+
+    auto mapLookup = [](const char* method) -> ArticFunctions::MethodHandler {
+        auto it = ArticFunctions::functionHandlers.find(method);
+        return it == ArticFunctions::functionHandlers.end() ? nullptr : it->second;
+    };
+    auto tableLookup = [](const char* method) {
+        return ArticFunctions::GetMethodHandler(method);
+    };
+    // Both resolve every name to the same handler
+    for (const Method& method : methods) {
+        CHECK(mapLookup(method.data()) == tableLookup(method.data()));
+    }
+
+    double map = NanosecondsPerLookup(methods, mapLookup);
+    double table = NanosecondsPerLookup(methods, tableLookup);
+    printf("%zu methods: map %.1f ns, method table %.1f ns per lookup\n", methods.size(), map, table);
+}
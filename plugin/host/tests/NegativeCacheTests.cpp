@@ -0,0 +1,59 @@
+// Missing paths remembered by the negative cache
+#include "Test.hpp"
+#include "ArticNegativeCache.hpp"
+
+using namespace Test;
+using ArticFunctions::NegativeCache;
+
+namespace {
+    u32 Absorbed() {
+        return GetStats<NegativeCache::Counters>("#NegativeCacheStats").absorbed;
+    }
+}
+
+TEST(NegativeCacheAbsorbsRepeatedMisses) {
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    u32 absorbed = Absorbed();
+    CHECK(OpenFile(archive, "/missing.bin", FS_OPEN_READ) == 0);
+    CHECK(Absorbed() == absorbed);
+    CHECK(OpenFile(archive, "/missing.bin", FS_OPEN_READ) == 0);
+    CHECK(Absorbed() == absorbed + 1);
+    CloseArchive(archive);
+}
+
+TEST(NegativeCacheDropsMissesOfOtherArchivesOnChange) {
+    // Two archives on the same save, the file is looked up through one and
+    // created through the other
+    FS_Archive created = OpenArchive(ARCHIVE_SAVEDATA);
+    FS_Archive probed = OpenArchive(ARCHIVE_USER_SAVEDATA);
+    CHECK(created != 0 && probed != 0 && created != probed);
+
+    CHECK(OpenFile(probed, "/negative.bin", FS_OPEN_READ) == 0);
+    CHECK(OpenFile(probed, "/negative.bin", FS_OPEN_READ) == 0);
+    Handle handle = OpenFile(created, "/negative.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(handle != 0);
+    CHECK(CloseFile(handle) == 0);
+    handle = OpenFile(probed, "/negative.bin", FS_OPEN_READ);
+    CHECK(handle != 0);
+    CHECK(CloseFile(handle) == 0);
+
+    // Created with FSUSER_OpenFileDirectly, which has no archive handle
+    CHECK(OpenFile(probed, "/direct.bin", FS_OPEN_READ) == 0);
+    CHECK(OpenFile(probed, "/direct.bin", FS_OPEN_READ) == 0);
+    MethodInterface mi;
+    mi.AddParameterS32(ARCHIVE_SAVEDATA);
+    AddPath(mi, PATH_EMPTY, "", 1);
+    AddPath(mi, "/direct.bin");
+    mi.AddParameterS32(FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    mi.AddParameterS32(0);
+    Call("FSUSER_OpenFileDirectly", mi);
+    CHECK(mi.IsGood() && R_SUCCEEDED(mi.GetReturnValue()));
+    CHECK(CloseFile(Get<Handle>(mi)) == 0);
+    handle = OpenFile(probed, "/direct.bin", FS_OPEN_READ);
+    CHECK(handle != 0);
+    CHECK(CloseFile(handle) == 0);
+
+    CloseArchive(created);
+    CloseArchive(probed);
+}
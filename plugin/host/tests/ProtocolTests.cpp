@@ -0,0 +1,348 @@
+// Requests over a loopback connection to the protocol server
+#include "Test.hpp"
+#include "HostConfig.hpp"
+#include <chrono>
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace Test;
+
+namespace {
+    void AddRomFSParameters(MethodInterface& mi) {
+        static const u8 romfsPath[0xC] = {};
+        mi.AddParameterS32(ARCHIVE_ROMFS);
+        AddPath(mi, PATH_EMPTY, "", 1);
+        AddPath(mi, PATH_BINARY, romfsPath, sizeof(romfsPath));
+        mi.AddParameterS32(FS_OPEN_READ);
+        mi.AddParameterS32(0);
+    }
+
+    // Keeps up to window requests in flight on the connection, the way a
+    // pipelining client does, and checks every response it gets back
+    class Pipeline {
+    public:
+        Pipeline(Loopback& client, u32 window) : client(client), window(window) {}
+
+        // FSFILE_Read responses must hold value
+        bool Send(const char* method, const MethodInterface& mi, u32 value = 0) {
+            while (inFlight.size() >= window) {
+                if (!ReceiveOne()) return false;
+            }
+            u32 requestID = ++nextRequestID;
+            inFlight[requestID] = {method, value};
+            return client.Send(requestID, method, mi);
+        }
+
+        bool Drain() {
+            while (!inFlight.empty()) {
+                if (!ReceiveOne()) return false;
+            }
+            return true;
+        }
+
+        u32 GetSent() const {
+            return nextRequestID;
+        }
+
+        u32 GetReceived() const {
+            return received;
+        }
+
+        u32 GetErrors() const {
+            return errors;
+        }
+
+    private:
+        struct Expected {
+            const char* method;
+            u32 value;
+        };
+
+        bool ReceiveOne() {
+            MethodInterface mi;
+            u32 requestID;
+            s32 articResult;
+            if (!client.Receive(requestID, articResult, mi)) return false;
+            auto it = inFlight.find(requestID);
+            if (it == inFlight.end() || articResult != 0 || R_FAILED(mi.GetReturnValue())) {
+                errors++;
+            } else if (strcmp(it->second.method, "FSFILE_Read") == 0 && Get<u32>(mi) != it->second.value) {
+                errors++;
+            }
+            if (it != inFlight.end()) inFlight.erase(it);
+            received++;
+            return true;
+        }
+
+        Loopback& client;
+        u32 window;
+        std::map<u32, Expected> inFlight;
+        u32 nextRequestID = 0;
+        u32 received = 0;
+        u32 errors = 0;
+    };
+
+    void AddRead(MethodInterface& mi, Handle handle, u64 offset, u32 size) {
+        mi.AddParameterS32(handle);
+        mi.AddParameterS64(offset);
+        mi.AddParameterS32(size);
+    }
+
+    // Requests per second of rounds of a RomFS read, a save file read and a
+    // GetSize on each, pipelined by the client at the largest queue depth.
+    // RomFS blocks are visited 7 apart from nextBlock on, so neither the
+    // block cache nor the read-ahead answers them. save holds saveValue.
+    double MeasureThroughput(u32 queueDepth, Handle romfs, Handle save, u32 saveValue, u32 rounds, u32& nextBlock) {
+        constexpr u32 BLOCK_SIZE = 0x1000;
+        constexpr u32 BLOCK_COUNT = ROMFS_SIZE / BLOCK_SIZE;
+        Loopback client(queueDepth);
+        if (!client.IsConnected()) return 0;
+        Pipeline pipeline(client, ArticProtocolServer::MAX_QUEUE_DEPTH);
+        auto start = std::chrono::steady_clock::now();
+        for (u32 round = 0; round < rounds; round++) {
+            u64 offset = static_cast<u64>(nextBlock++ * 7 % BLOCK_COUNT) * BLOCK_SIZE;
+            u32 romfsValue = 0;
+            for (u32 i = 0; i < sizeof(u32); i++) {
+                romfsValue |= static_cast<u32>(RomFSByte(offset + i)) << (i * 8);
+            }
+            MethodInterface romfsRead, saveRead, romfsSize, saveSize;
+            AddRead(romfsRead, romfs, offset, BLOCK_SIZE);
+            AddRead(saveRead, save, 0, sizeof(u32));
+            romfsSize.AddParameterS32(romfs);
+            saveSize.AddParameterS32(save);
+            if (!pipeline.Send("FSFILE_Read", romfsRead, romfsValue) || !pipeline.Send("FSFILE_Read", saveRead, saveValue) ||
+                !pipeline.Send("FSFILE_GetSize", romfsSize) || !pipeline.Send("FSFILE_GetSize", saveSize)) {
+                return 0;
+            }
+        }
+        if (!pipeline.Drain() || pipeline.GetErrors() != 0) return 0;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return pipeline.GetSent() / seconds;
+    }
+
+    // Sends the request by opcode and waits for its response
+    bool CallOpcode(Loopback& client, u32 requestID, u16 opcode, MethodInterface& mi, s32& articResult) {
+        u32 receivedID;
+        return client.Send(requestID, opcode, mi) && client.Receive(receivedID, articResult, mi) &&
+            receivedID == requestID;
+    }
+}
+
+TEST(ProtocolDispatchesOpcodeRequests) {
+    int openOpcode = FindOpcode("FSUSER_OpenFileDirectly");
+    int sizeOpcode = FindOpcode("FSFILE_GetSize");
+    int closeOpcode = FindOpcode("FSFILE_Close");
+    CHECK(openOpcode >= 0 && sizeOpcode >= 0 && closeOpcode >= 0);
+
+    Loopback client;
+    CHECK(client.IsConnected());
+    s32 articResult;
+    MethodInterface open;
+    AddRomFSParameters(open);
+    CHECK(CallOpcode(client, 1, openOpcode, open, articResult));
+    CHECK(articResult == 0 && open.GetReturnValue() == 0);
+    Handle handle = Get<Handle>(open);
+    CHECK(handle != 0);
+
+    MethodInterface size;
+    size.AddParameterS32(handle);
+    CHECK(CallOpcode(client, 2, sizeOpcode, size, articResult));
+    CHECK(articResult == 0 && Get<u64>(size) == ROMFS_SIZE);
+
+    // Requests by name keep working on the same connection
+    MethodInterface byName;
+    byName.AddParameterS32(handle);
+    CHECK(client.Call("FSFILE_GetSize", byName));
+    CHECK(Get<u64>(byName) == ROMFS_SIZE);
+
+    MethodInterface unknown;
+    CHECK(CallOpcode(client, 3, 0xFFFF, unknown, articResult));
+    CHECK(articResult == -1);
+
+    MethodInterface close;
+    close.AddParameterS32(handle);
+    CHECK(CallOpcode(client, 4, closeOpcode, close, articResult));
+    CHECK(articResult == 0 && close.GetReturnValue() == 0);
+}
+
+BENCH(OpcodeRequests) {
+    constexpr u32 REQUESTS = 20000;
+    int sizeOpcode = FindOpcode("FSFILE_GetSize");
+    CHECK(sizeOpcode >= 0);
+    Loopback client;
+    CHECK(client.IsConnected());
+    MethodInterface open;
+    AddRomFSParameters(open);
+    CHECK(client.Call("FSUSER_OpenFileDirectly", open));
+    Handle handle = Get<Handle>(open);
+    CHECK(handle != 0);
+
+    for (bool byOpcode : {false, true}) {
+        u64 sentBefore = client.GetSentBytes();
+        auto start = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < REQUESTS; i++) {
+            MethodInterface mi;
+            mi.AddParameterS32(handle);
+            u32 receivedID;
+            s32 articResult;
+            bool sent = byOpcode ? client.Send(i, static_cast<u16>(sizeOpcode), mi) : client.Send(i, "FSFILE_GetSize", mi);
+            CHECK(sent && client.Receive(receivedID, articResult, mi) && articResult == 0);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%s: %llu bytes per request, %.0f requests/s\n", byOpcode ? "opcode" : "name  ",
+            (unsigned long long)((client.GetSentBytes() - sentBefore) / REQUESTS), REQUESTS / seconds);
+    }
+
+    MethodInterface close;
+    close.AddParameterS32(handle);
+    CHECK(client.Call("FSFILE_Close", close));
+}
+
+// Writes and reads on several files pipelined over one connection. The
+// server runs them on the request workers, a read must still see the write
+// sent just before it on the same file.
+TEST(ProtocolKeepsPerHandleOrderOfPipelinedRequests) {
+    constexpr u32 FILE_COUNT = 6;
+    constexpr u32 ROUNDS = 400;
+    constexpr u32 WRITE_SIZE = 0x4000;
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    Handle handles[FILE_COUNT];
+    for (u32 i = 0; i < FILE_COUNT; i++) {
+        std::string path = "/pipelined" + std::to_string(i) + ".bin";
+        handles[i] = OpenFile(archive, path.c_str(), FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+        CHECK(handles[i] != 0);
+    }
+
+    Loopback client;
+    CHECK(client.IsConnected());
+    Pipeline pipeline(client, ArticProtocolServer::MAX_QUEUE_DEPTH);
+
+    // Files are visited in an uneven order, with a request that runs alone
+    // once in a while
+    for (u32 round = 1; round <= ROUNDS; round++) {
+        for (u32 i = 0; i < FILE_COUNT; i++) {
+            Handle handle = handles[(i * 5 + round) % FILE_COUNT];
+            u32 value = round * FILE_COUNT + i;
+            // Large writes, so a read that overtakes one is likely
+            std::vector<u32> data(WRITE_SIZE / sizeof(u32), value);
+            MethodInterface write;
+            write.AddParameterS32(handle);
+            write.AddParameterS64(0);
+            write.AddParameterS32(WRITE_SIZE);
+            write.AddParameterS32(0);
+            write.AddParameterBuffer(data.data(), WRITE_SIZE);
+            CHECK(pipeline.Send("FSFILE_Write", write));
+            MethodInterface read;
+            AddRead(read, handle, 0, sizeof(value));
+            CHECK(pipeline.Send("FSFILE_Read", read, value));
+        }
+        if (round % 100 == 0) {
+            MethodInterface stats;
+            CHECK(pipeline.Send("#HandleStats", stats));
+        }
+    }
+    CHECK(pipeline.Drain());
+    CHECK(pipeline.GetErrors() == 0);
+    CHECK(pipeline.GetReceived() == pipeline.GetSent());
+
+    for (Handle handle : handles) {
+        CHECK(R_SUCCEEDED(CloseFile(handle)));
+    }
+    CloseArchive(archive);
+}
+
+// A slow save read sent first does not hold back the response of a quick
+// request sent after it, unless the server takes one request at a time
+TEST(ProtocolSendsResponsesAsRequestsFinish) {
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    Handle save = OpenFile(archive, "/slow.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(save != 0);
+    u32 value = 0x5A5A5A5A;
+    CHECK(WriteFile(save, 0, &value, sizeof(value)) == 0);
+    Handle romfs = OpenRomFS();
+    CHECK(romfs != 0);
+
+    u32 firstResponse[2] = {};
+    bool received = true;
+    Host::config.saveLatency.fixedMicroseconds = 20000;
+    for (u32 depth : {1, 2}) {
+        Loopback client(depth);
+        MethodInterface slow, quick;
+        AddRead(slow, save, 0, sizeof(value));
+        quick.AddParameterS32(romfs);
+        MethodInterface first, second;
+        u32 requestID = 0;
+        s32 articResult;
+        received = received && client.Send(1, "FSFILE_Read", slow) && client.Send(2, "FSFILE_GetSize", quick) &&
+            client.Receive(requestID, articResult, first);
+        firstResponse[depth - 1] = requestID;
+        received = received && client.Receive(requestID, articResult, second);
+    }
+    Host::config.saveLatency.fixedMicroseconds = 0;
+    CHECK(received);
+    CHECK(firstResponse[0] == 1);
+    CHECK(firstResponse[1] == 2);
+
+    CHECK(R_SUCCEEDED(CloseFile(romfs)));
+    CHECK(R_SUCCEEDED(CloseFile(save)));
+    CloseArchive(archive);
+}
+
+// With more than one request in flight the RomFS and save reads overlap, as
+// they use different media
+TEST(ProtocolThroughputRisesWithQueueDepth) {
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    Handle save = OpenFile(archive, "/depth.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(save != 0);
+    u32 value = 0x12345678;
+    CHECK(WriteFile(save, 0, &value, sizeof(value)) == 0);
+    Handle romfs = OpenRomFS();
+    CHECK(romfs != 0);
+
+    u32 nextBlock = 0;
+    Host::config.romfsLatency.fixedMicroseconds = 2000;
+    Host::config.saveLatency.fixedMicroseconds = 2000;
+    double shallow = MeasureThroughput(1, romfs, save, value, 12, nextBlock);
+    double deep = MeasureThroughput(4, romfs, save, value, 12, nextBlock);
+    Host::config.romfsLatency.fixedMicroseconds = 0;
+    Host::config.saveLatency.fixedMicroseconds = 0;
+    CHECK(shallow > 0);
+    CHECK(deep > shallow * 1.5);
+
+    CHECK(R_SUCCEEDED(CloseFile(romfs)));
+    CHECK(R_SUCCEEDED(CloseFile(save)));
+    CloseArchive(archive);
+}
+
+BENCH(QueueDepth) {
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    Handle save = OpenFile(archive, "/depth.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(save != 0);
+    u32 value = 0x12345678;
+    CHECK(WriteFile(save, 0, &value, sizeof(value)) == 0);
+    Handle romfs = OpenRomFS();
+    CHECK(romfs != 0);
+
+    // Default gamecard and SD timings of the host server
+    u32 nextBlock = 0;
+    Host::config.romfsLatency.fixedMicroseconds = 250;
+    Host::config.romfsLatency.microsecondsPerKiB = 60;
+    Host::config.saveLatency.fixedMicroseconds = 100;
+    Host::config.saveLatency.microsecondsPerKiB = 40;
+    for (u32 depth : {1, 2, 4, 8}) {
+        double throughput = MeasureThroughput(depth, romfs, save, value, 16, nextBlock);
+        printf("depth %u: %.0f requests/s\n", (unsigned int)depth, throughput);
+    }
+    Host::config.romfsLatency.fixedMicroseconds = Host::config.romfsLatency.microsecondsPerKiB = 0;
+    Host::config.saveLatency.fixedMicroseconds = Host::config.saveLatency.microsecondsPerKiB = 0;
+
+    CHECK(R_SUCCEEDED(CloseFile(romfs)));
+    CHECK(R_SUCCEEDED(CloseFile(save)));
+    CloseArchive(archive);
+}
@@ -0,0 +1,154 @@
+// Read-ahead and block cache in front of FSFILE_Read
+#include "Test.hpp"
+#include "ArticReadAhead.hpp"
+#include "ArticBlockCache.hpp"
+#include <vector>
+
+using namespace Test;
+using ArticFunctions::ReadAhead;
+using ArticFunctions::BlockCache;
+
+TEST(ReadAheadServesSequentialReads) {
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+
+    std::vector<u8> data(0x1000);
+    u64 offset = 0;
+    while (offset < ROMFS_SIZE) {
+        s64 read = ReadFile(handle, offset, data.data(), data.size());
+        CHECK(read == static_cast<s64>(std::min<u64>(data.size(), ROMFS_SIZE - offset)));
+        CHECK(MatchesRomFS(data.data(), offset, read));
+        offset += read;
+    }
+
+    ReadAhead::Counters counters = GetStats<ReadAhead::Counters>("#ReadAheadStats");
+    CHECK(counters.prefetches != 0);
+    CHECK(counters.prefetchedBytes != 0);
+    CHECK(counters.hits + counters.partialHits != 0);
+    CHECK(CloseFile(handle) == 0);
+}
+
+TEST(ReadAheadSurvivesRandomReads) {
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+
+    // A sequential run broken by jumps in both directions
+    static const u32 offsets[] = {0, 0x1000, 0x2000, 0x3000, 0x20000, 0x21000, 0x800, 0x22000, 0x40000 - 0x10, 0x41000};
+    std::vector<u8> data(0x1000);
+    for (u32 offset : offsets) {
+        s64 read = ReadFile(handle, offset, data.data(), data.size());
+        CHECK(read == static_cast<s64>(data.size()));
+        CHECK(MatchesRomFS(data.data(), offset, read));
+    }
+
+    // Reads past the end return what is left
+    s64 read = ReadFile(handle, ROMFS_SIZE - 100, data.data(), data.size());
+    CHECK(read == 100);
+    CHECK(MatchesRomFS(data.data(), ROMFS_SIZE - 100, read));
+    CHECK(ReadFile(handle, ROMFS_SIZE, data.data(), data.size()) == 0);
+    CHECK(CloseFile(handle) == 0);
+}
+
+TEST(BlockCacheServesRereads) {
+    // Small unaligned reads, reread after reopening the file and after a
+    // long sequential scan
+    static const struct {
+        u32 offset;
+        u32 size;
+    } reads[] = {
+        {0, 0x200}, {0x1234, 0x800}, {0x5000, 0x1000}, {0x7FF0, 0x20}, {0x10000, 0x4000},
+        {0x23456, 0x100}, {0x30000, 0x2000}, {0x41000, 0x8000}, {ROMFS_SIZE - 0x300, 0x300},
+    };
+    constexpr u32 readCount = sizeof(reads) / sizeof(reads[0]);
+    std::vector<u8> data(0x8000);
+
+    for (int round = 0; round < 3; round++) {
+        Handle handle = OpenRomFS();
+        CHECK(handle != 0);
+        BlockCache::Counters before = GetStats<BlockCache::Counters>("#BlockCacheStats");
+        for (const auto& r : reads) {
+            CHECK(ReadFile(handle, r.offset, data.data(), r.size) == r.size);
+            CHECK(MatchesRomFS(data.data(), r.offset, r.size));
+        }
+        BlockCache::Counters after = GetStats<BlockCache::Counters>("#BlockCacheStats");
+        if (round != 0) {
+            CHECK(after.hits - before.hits == readCount);
+        }
+        if (round == 1) {
+            for (u32 offset = 0; offset < ROMFS_SIZE; offset += 0x8000) {
+                CHECK(ReadFile(handle, offset, data.data(), 0x8000) >= 0);
+            }
+        }
+        CHECK(CloseFile(handle) == 0);
+    }
+}
+
+namespace {
+    // The RomFS opened through an archive, a handle of its own that shares
+    // the blocks of OpenRomFS
+    Handle OpenRomFSFile(FS_Archive archive) {
+        static const u8 romfsPath[0xC] = {};
+        MethodInterface mi;
+        mi.AddParameterS64(static_cast<s64>(archive));
+        AddPath(mi, PATH_BINARY, romfsPath, sizeof(romfsPath));
+        mi.AddParameterS32(FS_OPEN_READ);
+        mi.AddParameterS32(0);
+        Call("FSUSER_OpenFile", mi);
+        return (mi.IsGood() && R_SUCCEEDED(mi.GetReturnValue())) ? Get<Handle>(mi) : 0;
+    }
+}
+
+TEST(BlockCacheHitsKeepReadAheadSequential) {
+    std::vector<u8> data(0x1000);
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+    for (u32 offset = 0; offset < 0x10000; offset += 0x1000) {
+        CHECK(ReadFile(handle, offset, data.data(), 0x1000) == 0x1000);
+    }
+    CHECK(CloseFile(handle) == 0);
+
+    // The second handle is served from the block cache up to 0x10000, its
+    // read-ahead has to continue the stream from there on the first miss
+    FS_Archive archive = OpenArchive(ARCHIVE_ROMFS);
+    CHECK(archive != 0);
+    handle = OpenRomFSFile(archive);
+    CHECK(handle != 0);
+    BlockCache::Counters blocksBefore = GetStats<BlockCache::Counters>("#BlockCacheStats");
+    for (u32 offset = 0; offset < 0x10000; offset += 0x1000) {
+        CHECK(ReadFile(handle, offset, data.data(), 0x1000) == 0x1000);
+    }
+    BlockCache::Counters blocksAfter = GetStats<BlockCache::Counters>("#BlockCacheStats");
+    CHECK(blocksAfter.hits - blocksBefore.hits == 0x10);
+
+    ReadAhead::Counters before = GetStats<ReadAhead::Counters>("#ReadAheadStats");
+    CHECK(ReadFile(handle, 0x10000, data.data(), 0x1000) == 0x1000);
+    CHECK(ReadFile(handle, 0x11000, data.data(), 0x1000) == 0x1000);
+    CHECK(MatchesRomFS(data.data(), 0x11000, 0x1000));
+    ReadAhead::Counters after = GetStats<ReadAhead::Counters>("#ReadAheadStats");
+    CHECK(after.misses - before.misses == 1);
+    CHECK(after.hits - before.hits == 1);
+    CHECK(CloseFile(handle) == 0);
+    CloseArchive(archive);
+}
+
+TEST(RomFSArchiveOpensAreCached) {
+    FS_Archive archive = OpenArchive(ARCHIVE_ROMFS);
+    CHECK(archive != 0);
+    Handle handle = OpenRomFSFile(archive);
+    CHECK(handle != 0);
+
+    std::vector<u8> data(0x800);
+    for (int round = 0; round < 2; round++) {
+        for (u32 offset = 0x1800; offset < 0x6000; offset += 0x800) {
+            CHECK(ReadFile(handle, offset, data.data(), 0x800) == 0x800);
+            CHECK(MatchesRomFS(data.data(), offset, 0x800));
+        }
+    }
+    BlockCache::Counters blocks = GetStats<BlockCache::Counters>("#BlockCacheStats");
+    CHECK(blocks.insertions != 0);
+    CHECK(blocks.hits != 0);
+    ReadAhead::Counters stream = GetStats<ReadAhead::Counters>("#ReadAheadStats");
+    CHECK(stream.misses + stream.hits + stream.partialHits != 0);
+    CHECK(CloseFile(handle) == 0);
+    CloseArchive(archive);
+}
@@ -0,0 +1,62 @@
+// "FSFILE_ReadVector" ranges and limits
+#include "Test.hpp"
+#include <vector>
+
+using namespace Test;
+
+namespace {
+    struct Range {
+        s64 offset;
+        u32 size;
+        u32 reserved;
+    };
+
+    // Returns false if the request was rejected
+    bool ReadVector(Handle handle, const std::vector<Range>& ranges, std::vector<u32>& sizes, std::vector<u8>& data) {
+        MethodInterface mi;
+        mi.AddParameterS32(handle);
+        mi.AddParameterBuffer(ranges.data(), ranges.size() * sizeof(Range));
+        Call("FSFILE_ReadVector", mi);
+        const ArticProtocolCommon::Buffer* buffer = mi.GetResultBuffer(0);
+        if (!mi.IsGood() || mi.GetReturnValue() != 0 || !buffer) return false;
+
+        const u8* cur = reinterpret_cast<const u8*>(buffer->data);
+        sizes.resize(ranges.size());
+        memcpy(sizes.data(), cur, sizes.size() * sizeof(u32));
+        cur += sizes.size() * sizeof(u32);
+        data.assign(cur, reinterpret_cast<const u8*>(buffer->data) + buffer->bufferSize);
+        return true;
+    }
+}
+
+TEST(ReadVectorReadsRangesInOrder) {
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+    std::vector<Range> ranges = {{0x3000, 0x100, 0}, {0x10, 0x20, 0}, {0x3080, 0x200, 0}, {ROMFS_SIZE - 0x10, 0x40, 0}};
+    std::vector<u32> sizes;
+    std::vector<u8> data;
+    CHECK(ReadVector(handle, ranges, sizes, data));
+    CHECK(sizes[0] == 0x100 && sizes[1] == 0x20 && sizes[2] == 0x200 && sizes[3] == 0x10);
+    CHECK(data.size() == 0x100 + 0x20 + 0x200 + 0x10);
+    size_t at = 0;
+    for (u32 i = 0; i < ranges.size(); i++) {
+        CHECK(MatchesRomFS(data.data() + at, ranges[i].offset, sizes[i]));
+        at += sizes[i];
+    }
+    CHECK(CloseFile(handle) == 0);
+}
+
+TEST(ReadVectorRejectsOversizedRanges) {
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+    std::vector<u32> sizes;
+    std::vector<u8> data;
+    // A single range over the limit
+    CHECK(!ReadVector(handle, {{0, 0xFFFFFFFF, 0}}, sizes, data));
+    // Ranges within the limit adding up past the total
+    CHECK(!ReadVector(handle, {{0, 0x100000, 0}, {0, 0x100000, 0}, {0, 0x100000, 0}}, sizes, data));
+    // Too many ranges, and a negative offset
+    CHECK(!ReadVector(handle, std::vector<Range>(129, {0, 0x10, 0}), sizes, data));
+    CHECK(!ReadVector(handle, {{-1, 0x10, 0}}, sizes, data));
+    CHECK(CloseFile(handle) == 0);
+}
@@ -0,0 +1,43 @@
+// Per-method stats of "#Stats"
+#include "Test.hpp"
+#include "ArticStats.hpp"
+
+using namespace Test;
+using ArticFunctions::Stats::MethodStatsRecord;
+
+namespace {
+    MethodStatsRecord GetMethodStats(const char* method) {
+        MethodInterface mi;
+        Call("#Stats", mi);
+        int opcode = FindOpcode(method);
+        if (opcode < 0) return MethodStatsRecord{};
+        return Get<MethodStatsRecord>(mi, 0, sizeof(u32) + opcode * sizeof(MethodStatsRecord));
+    }
+
+    // Histogram bucket of a byte count, see Stats::Histogram
+    u32 SizeBucket(u32 bytes) {
+        bytes >>= ArticFunctions::Stats::SIZE_SHIFT;
+        return bytes == 0 ? 0 : 32 - __builtin_clz(bytes);
+    }
+}
+
+TEST(StatsCountBytesOfEveryMethod) {
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+    u8 data[0x1000];
+    CHECK(ReadFile(handle, 0, data, sizeof(data)) == sizeof(data));
+    CHECK(CloseFile(handle) == 0);
+
+    // Parameters: s32 handle, s64 offset, s32 size. Response: the data.
+    MethodStatsRecord read = GetMethodStats("FSFILE_Read");
+    CHECK(read.count == 1);
+    CHECK(read.requestBytes[SizeBucket(16)] == 1);
+    CHECK(read.responseBytes[SizeBucket(sizeof(data))] == 1);
+
+    // Parameters: s32 archive ID, two 8 byte path headers with 1 and 0xC
+    // bytes of path, s32 flags and attributes. Response: the handle.
+    MethodStatsRecord open = GetMethodStats("FSUSER_OpenFileDirectly");
+    CHECK(open.count == 1);
+    CHECK(open.requestBytes[SizeBucket(4 + 9 + 20 + 4 + 4)] == 1);
+    CHECK(open.responseBytes[SizeBucket(sizeof(Handle))] == 1);
+}
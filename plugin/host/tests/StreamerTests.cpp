@@ -0,0 +1,222 @@
+// File streaming over the side connection
+#include "Test.hpp"
+#include "ArticStreamer.hpp"
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace Test;
+using ArticFunctions::FileStreamer;
+
+namespace {
+    // Side connection of the client
+    class StreamClient {
+    public:
+        explicit StreamClient(int port) {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            struct sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (fd >= 0 && connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+                close(fd);
+                fd = -1;
+            }
+            SetTimeout(2000);
+        }
+
+        ~StreamClient() {
+            if (fd >= 0) close(fd);
+        }
+
+        bool IsConnected() const {
+            return fd >= 0;
+        }
+
+        void SetTimeout(int milliseconds) {
+            if (fd < 0) return;
+            struct timeval tv = {milliseconds / 1000, (milliseconds % 1000) * 1000};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        }
+
+        // Returns false if nothing arrives before the timeout
+        bool Receive(FileStreamer::ChunkHeader& header, std::vector<u8>& data) {
+            if (!ReceiveAll(&header, sizeof(header))) return false;
+            data.resize(header.size);
+            return ReceiveAll(data.data(), data.size());
+        }
+
+    private:
+        bool ReceiveAll(void* buffer, size_t size) {
+            u8* p = reinterpret_cast<u8*>(buffer);
+            while (size != 0) {
+                ssize_t received = recv(fd, p, size, 0);
+                if (received <= 0) return false;
+                p += received;
+                size -= received;
+            }
+            return true;
+        }
+
+        int fd = -1;
+    };
+
+    Result StreamStart(Handle handle, u64 offset, u64 size, u32 chunkSize, u32 credits, FileStreamer::StartInfo& info) {
+        MethodInterface mi;
+        mi.AddParameterS32(handle);
+        mi.AddParameterS64(offset);
+        mi.AddParameterS64(size);
+        mi.AddParameterS32(chunkSize);
+        mi.AddParameterS32(credits);
+        Call("FSFILE_StreamStart", mi);
+        info = Get<FileStreamer::StartInfo>(mi);
+        return mi.IsGood() ? mi.GetReturnValue() : -1;
+    }
+
+    Result StreamCredit(u32 streamID, u32 credits) {
+        MethodInterface mi;
+        mi.AddParameterS32(streamID);
+        mi.AddParameterS32(credits);
+        Call("FSFILE_StreamCredit", mi);
+        return mi.IsGood() ? mi.GetReturnValue() : -1;
+    }
+
+    Result StreamCancel(u32 streamID) {
+        MethodInterface mi;
+        mi.AddParameterS32(streamID);
+        Call("FSFILE_StreamCancel", mi);
+        return mi.IsGood() ? mi.GetReturnValue() : -1;
+    }
+}
+
+TEST(StreamerSendsWholeFile) {
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+    FileStreamer::StartInfo info;
+    CHECK(StreamStart(handle, 0, 0, 0x8000, 100, info) == 0);
+    CHECK(info.port == FileStreamer::PORT);
+
+    StreamClient client(info.port);
+    CHECK(client.IsConnected());
+    FileStreamer::ChunkHeader header;
+    std::vector<u8> data;
+    u64 offset = 0;
+    do {
+        CHECK(client.Receive(header, data));
+        CHECK(header.streamID == info.streamID);
+        CHECK(header.result == 0);
+        CHECK(header.offset == offset);
+        CHECK(header.size <= 0x8000);
+        CHECK(MatchesRomFS(data.data(), offset, data.size()));
+        offset += header.size;
+    } while (!(header.flags & FileStreamer::FLAG_LAST));
+    CHECK(offset == ROMFS_SIZE);
+    CHECK(!(header.flags & FileStreamer::FLAG_CANCELLED));
+    CHECK(CloseFile(handle) == 0);
+}
+
+TEST(StreamerWaitsForCredits) {
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+    FileStreamer::StartInfo info;
+    CHECK(StreamStart(handle, 0x100, 0, 0x1000, 2, info) == 0);
+
+    StreamClient client(info.port);
+    CHECK(client.IsConnected());
+    FileStreamer::ChunkHeader header;
+    std::vector<u8> data;
+    for (u32 i = 0; i < 2; i++) {
+        CHECK(client.Receive(header, data));
+        CHECK(header.offset == 0x100 + i * 0x1000);
+        CHECK(header.flags == 0);
+        CHECK(MatchesRomFS(data.data(), header.offset, data.size()));
+    }
+    client.SetTimeout(200);
+    CHECK(!client.Receive(header, data));
+
+    client.SetTimeout(2000);
+    CHECK(StreamCredit(info.streamID, 1) == 0);
+    CHECK(client.Receive(header, data));
+    CHECK(header.offset == 0x2100);
+
+    CHECK(StreamCancel(info.streamID) == 0);
+    CHECK(client.Receive(header, data));
+    CHECK(header.flags == (FileStreamer::FLAG_LAST | FileStreamer::FLAG_CANCELLED));
+    CHECK(StreamCredit(info.streamID, 1) != 0);
+    CHECK(StreamCancel(info.streamID) != 0);
+    CHECK(CloseFile(handle) == 0);
+}
+
+TEST(StreamerCancelsOnClose) {
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    Handle handle = OpenFile(archive, "/stream.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(handle != 0);
+    std::vector<u8> data(0x10000, 0xA5);
+    CHECK(WriteFile(handle, 0, data.data(), data.size()) == 0);
+
+    FileStreamer::StartInfo info;
+    CHECK(StreamStart(handle, 0, 0, 0x1000, 1, info) == 0);
+    StreamClient client(info.port);
+    CHECK(client.IsConnected());
+    FileStreamer::ChunkHeader header;
+    CHECK(client.Receive(header, data));
+    CHECK(header.flags == 0);
+
+    CHECK(CloseFile(handle) == 0);
+    CHECK(client.Receive(header, data));
+    CHECK(header.flags == (FileStreamer::FLAG_LAST | FileStreamer::FLAG_CANCELLED));
+    CHECK(StreamCredit(info.streamID, 1) != 0);
+    CloseArchive(archive);
+}
+
+TEST(StreamerCancelsOnCloseOfCachedHandle) {
+    // Both opens share one handle through the handle cache
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+    CHECK(OpenRomFS() == handle);
+
+    FileStreamer::StartInfo info;
+    CHECK(StreamStart(handle, 0, 0, 0x1000, 1, info) == 0);
+    StreamClient client(info.port);
+    CHECK(client.IsConnected());
+    FileStreamer::ChunkHeader header;
+    std::vector<u8> data;
+    CHECK(client.Receive(header, data));
+    CHECK(header.flags == 0);
+
+    // Another user still holds the handle, the stream goes on
+    CHECK(CloseFile(handle) == 0);
+    CHECK(StreamCredit(info.streamID, 1) == 0);
+    CHECK(client.Receive(header, data));
+    CHECK(header.flags == 0);
+
+    // The last close cancels it, even though the handle stays cached
+    CHECK(CloseFile(handle) == 0);
+    CHECK(client.Receive(header, data));
+    CHECK(header.flags == (FileStreamer::FLAG_LAST | FileStreamer::FLAG_CANCELLED));
+    CHECK(StreamCredit(info.streamID, 1) != 0);
+    CHECK(OpenRomFS() == handle);
+    CHECK(CloseFile(handle) == 0);
+}
+
+TEST(StreamerFreesCancelledStreamsWithoutClient) {
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+    FileStreamer::StartInfo info;
+    for (int round = 0; round < 2; round++) {
+        std::vector<u32> ids;
+        for (size_t i = 0; i < FileStreamer::MAX_STREAMS; i++) {
+            CHECK(StreamStart(handle, 0, 0, 0x1000, 1, info) == 0);
+            ids.push_back(info.streamID);
+        }
+        CHECK(StreamStart(handle, 0, 0, 0x1000, 1, info) != 0);
+        for (u32 id : ids) {
+            CHECK(StreamCancel(id) == 0);
+        }
+    }
+    CHECK(CloseFile(handle) == 0);
+}
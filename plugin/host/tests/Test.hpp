@@ -0,0 +1,128 @@
+#pragma once
+// Handler tests of the host build. Every TEST runs as its own client session:
+// the handlers are called the way the protocol server calls them and the
+// session end functions run after it. Run with "make -C plugin/host test".
+// Benchmarks are registered the same way with BENCH and only run with
+// "make -C plugin/host bench".
+#include "3ds.h"
+#include "ArticProtocolServer.hpp"
+#include <string.h>
+#include <thread>
+
+namespace Test {
+    using MethodInterface = ArticProtocolServer::MethodInterface;
+    using Function = void(*)();
+
+    struct Registration {
+        Registration(const char* name, Function function, bool benchmark = false);
+    };
+
+    // Records a failure of the running test, returns the condition
+    bool Check(bool condition, const char* expression, const char* file, int line);
+
+    // Files written before the first test. The RomFS image holds
+    // ROMFS_SIZE bytes of RomFSByte, the ExeFS sections hold EXEFS_SIZE
+    // bytes of ExeFSByte seeded with the first letter of the section.
+    static constexpr u32 ROMFS_SIZE = 300000;
+    static constexpr u32 EXEFS_SIZE = 0x2345;
+    u8 RomFSByte(u64 offset);
+    u8 ExeFSByte(char section, u64 offset);
+    // Returns true if size bytes of data match the RomFS at offset
+    bool MatchesRomFS(const void* data, u64 offset, size_t size);
+
+    // Runs the handler of the method, returns false if there is none
+    bool Call(const char* method, MethodInterface& mi);
+
+    void AddPath(MethodInterface& mi, FS_PathType type, const void* data, u32 size);
+    // NUL terminated ASCII path
+    void AddPath(MethodInterface& mi, const char* path);
+
+    // The whole RomFS with FSUSER_OpenFileDirectly, as the client opens it.
+    // Returns 0 on failure.
+    Handle OpenRomFS();
+    // FSUSER_OpenArchive, returns 0 on failure
+    FS_Archive OpenArchive(FS_ArchiveID id);
+    void CloseArchive(FS_Archive archive);
+    // FSUSER_OpenFile on the archive, returns 0 on failure
+    Handle OpenFile(FS_Archive archive, const char* path, u32 openFlags);
+    Result CloseFile(Handle handle);
+    // FSFILE_Read into out, returns the bytes read or -1 on failure
+    s64 ReadFile(Handle handle, u64 offset, void* out, u32 size);
+    Result WriteFile(Handle handle, u64 offset, const void* data, u32 size, u32 flags = 0);
+
+    // Opcode of the method from "#GetMethodOpcodes", or -1
+    int FindOpcode(const char* method);
+
+    // Client of a protocol server serving a loopback TCP connection on its
+    // own thread, the way the host server serves a client
+    class Loopback {
+    public:
+        explicit Loopback(u32 queueDepth = ArticProtocolServer::DEFAULT_QUEUE_DEPTH);
+        ~Loopback();
+
+        Loopback(const Loopback&) = delete;
+        Loopback& operator=(const Loopback&) = delete;
+
+        bool IsConnected() const {
+            return fd >= 0;
+        }
+
+        // Sends the parameters added to mi, by method name or by opcode
+        bool Send(u32 requestID, const char* method, const MethodInterface& mi);
+        bool Send(u32 requestID, u16 opcode, const MethodInterface& mi);
+        // Reads the next response into mi. articResult is 0 if the method
+        // finished, its result buffers and return value are in mi then.
+        bool Receive(u32& requestID, s32& articResult, MethodInterface& mi);
+        // Sends by name and receives the response, returns false if the
+        // method did not finish
+        bool Call(const char* method, MethodInterface& mi);
+
+        u64 GetSentBytes() const {
+            return sentBytes;
+        }
+
+    private:
+        bool SendAll(const void* data, size_t size);
+        bool ReceiveAll(void* data, size_t size);
+
+        int fd = -1;
+        ArticProtocolServer* server = nullptr;
+        std::thread thread;
+        u64 sentBytes = 0;
+    };
+
+    // Copies the result buffer, or returns a zeroed T if it is missing or short
+    template<typename T>
+    T Get(const MethodInterface& mi, u32 bufferID = 0, size_t offset = 0) {
+        T value{};
+        const ArticProtocolCommon::Buffer* buffer = mi.GetResultBuffer(bufferID);
+        if (buffer && buffer->bufferSize >= offset + sizeof(T)) {
+            memcpy(&value, buffer->data + offset, sizeof(T));
+        }
+        return value;
+    }
+
+    // Result buffer 0 of a stats method without parameters
+    template<typename T>
+    T GetStats(const char* method) {
+        MethodInterface mi;
+        Call(method, mi);
+        return Get<T>(mi);
+    }
+}
+
+#define TEST(name) \
+    static void name(); \
+    static Test::Registration name##Registration(#name, name); \
+    static void name()
+
+#define BENCH(name) \
+    static void name(); \
+    static Test::Registration name##Registration(#name, name, true); \
+    static void name()
+
+// Ends the test on failure
+#define CHECK(condition) \
+    do { \
+        if (!Test::Check((condition), #condition, __FILE__, __LINE__)) return; \
+    } while (0)
@@ -0,0 +1,383 @@
+// Runner of the host tests: writes the fixture files to a temporary
+// directory, points the libctru stand-in at them and runs every test as its
+// own session.
+#include "Test.hpp"
+#include "Main.hpp"
+#include "HostConfig.hpp"
+#include "ArticFunctions.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+Logger logger;
+int transferedBytes = 0;
+bool isControllerMode = false;
+
+PrintConsole topScreenConsole, bottomScreenConsole;
+
+namespace Host {
+    Config config;
+}
+
+namespace Test {
+    struct Entry {
+        const char* name;
+        Function function;
+        bool benchmark;
+    };
+
+    static std::vector<Entry>& Registry() {
+        static std::vector<Entry> tests;
+        return tests;
+    }
+
+    static const char* currentTest = nullptr;
+    static bool currentFailed = false;
+
+    Registration::Registration(const char* name, Function function, bool benchmark) {
+        Registry().push_back({name, function, benchmark});
+    }
+
+    bool Check(bool condition, const char* expression, const char* file, int line) {
+        if (!condition) {
+            printf("%s:%d: %s: CHECK(%s) failed\n", file, line, currentTest, expression);
+            currentFailed = true;
+        }
+        return condition;
+    }
+
+    u8 RomFSByte(u64 offset) {
+        return static_cast<u8>((offset * 7) ^ (offset >> 8) ^ (offset >> 16));
+    }
+
+    u8 ExeFSByte(char section, u64 offset) {
+        return static_cast<u8>(section + offset * 13 + (offset >> 8));
+    }
+
+    bool MatchesRomFS(const void* data, u64 offset, size_t size) {
+        const u8* bytes = reinterpret_cast<const u8*>(data);
+        for (size_t i = 0; i < size; i++) {
+            if (bytes[i] != RomFSByte(offset + i)) return false;
+        }
+        return true;
+    }
+
+    bool Call(const char* method, MethodInterface& mi) {
+        // Padded like RequestPacket::method
+        char name[sizeof(ArticProtocolCommon::RequestPacket::method)] = {};
+        strncpy(name, method, sizeof(name) - 1);
+        ArticFunctions::MethodHandler handler = ArticFunctions::GetMethodHandler(name);
+        if (!handler) return false;
+        handler(mi);
+        return true;
+    }
+
+    void AddPath(MethodInterface& mi, FS_PathType type, const void* data, u32 size) {
+        // u32 type, u32 size, data
+        std::vector<u8> path(2 * sizeof(u32) + size);
+        u32 pathType = type;
+        memcpy(path.data(), &pathType, sizeof(u32));
+        memcpy(path.data() + sizeof(u32), &size, sizeof(u32));
+        memcpy(path.data() + 2 * sizeof(u32), data, size);
+        mi.AddParameterBuffer(path.data(), path.size());
+    }
+
+    void AddPath(MethodInterface& mi, const char* path) {
+        AddPath(mi, PATH_ASCII, path, static_cast<u32>(strlen(path) + 1));
+    }
+
+    Handle OpenRomFS() {
+        static const u8 romfsPath[0xC] = {};
+        MethodInterface mi;
+        mi.AddParameterS32(ARCHIVE_ROMFS);
+        AddPath(mi, PATH_EMPTY, "", 1);
+        AddPath(mi, PATH_BINARY, romfsPath, sizeof(romfsPath));
+        mi.AddParameterS32(FS_OPEN_READ);
+        mi.AddParameterS32(0);
+        Call("FSUSER_OpenFileDirectly", mi);
+        return (mi.IsGood() && R_SUCCEEDED(mi.GetReturnValue())) ? Get<Handle>(mi) : 0;
+    }
+
+    FS_Archive OpenArchive(FS_ArchiveID id) {
+        MethodInterface mi;
+        mi.AddParameterS32(id);
+        AddPath(mi, PATH_EMPTY, "", 1);
+        Call("FSUSER_OpenArchive", mi);
+        return (mi.IsGood() && R_SUCCEEDED(mi.GetReturnValue())) ? Get<FS_Archive>(mi) : 0;
+    }
+
+    void CloseArchive(FS_Archive archive) {
+        MethodInterface mi;
+        mi.AddParameterS64(static_cast<s64>(archive));
+        Call("FSUSER_CloseArchive", mi);
+    }
+
+    Handle OpenFile(FS_Archive archive, const char* path, u32 openFlags) {
+        MethodInterface mi;
+        mi.AddParameterS64(static_cast<s64>(archive));
+        AddPath(mi, path);
+        mi.AddParameterS32(openFlags);
+        mi.AddParameterS32(0);
+        Call("FSUSER_OpenFile", mi);
+        return (mi.IsGood() && R_SUCCEEDED(mi.GetReturnValue())) ? Get<Handle>(mi) : 0;
+    }
+
+    Result CloseFile(Handle handle) {
+        MethodInterface mi;
+        mi.AddParameterS32(handle);
+        Call("FSFILE_Close", mi);
+        return mi.IsGood() ? mi.GetReturnValue() : -1;
+    }
+
+    s64 ReadFile(Handle handle, u64 offset, void* out, u32 size) {
+        MethodInterface mi;
+        mi.AddParameterS32(handle);
+        mi.AddParameterS64(offset);
+        mi.AddParameterS32(size);
+        Call("FSFILE_Read", mi);
+        const ArticProtocolCommon::Buffer* buffer = mi.GetResultBuffer(0);
+        if (!mi.IsGood() || R_FAILED(mi.GetReturnValue()) || !buffer || buffer->bufferSize > size) return -1;
+        memcpy(out, buffer->data, buffer->bufferSize);
+        return buffer->bufferSize;
+    }
+
+    Result WriteFile(Handle handle, u64 offset, const void* data, u32 size, u32 flags) {
+        MethodInterface mi;
+        mi.AddParameterS32(handle);
+        mi.AddParameterS64(offset);
+        mi.AddParameterS32(size);
+        mi.AddParameterS32(flags);
+        mi.AddParameterBuffer(data, size);
+        Call("FSFILE_Write", mi);
+        if (!mi.IsGood()) return -1;
+        if (R_SUCCEEDED(mi.GetReturnValue()) && Get<u32>(mi) != size) return -1;
+        return mi.GetReturnValue();
+    }
+
+    int FindOpcode(const char* method) {
+        MethodInterface mi;
+        Call("#GetMethodOpcodes", mi);
+        const ArticProtocolCommon::Buffer* buffer = mi.GetResultBuffer(0);
+        if (!buffer) return -1;
+        const u8* cur = reinterpret_cast<const u8*>(buffer->data);
+        u16 count;
+        memcpy(&count, cur, sizeof(u16)); cur += sizeof(u16);
+        for (u16 i = 0; i < count; i++) {
+            u16 opcode;
+            memcpy(&opcode, cur, sizeof(u16)); cur += sizeof(u16);
+            u8 length = *cur++;
+            if (std::string(reinterpret_cast<const char*>(cur), length) == method) return opcode;
+            cur += length;
+        }
+        return -1;
+    }
+
+    Loopback::Loopback(u32 queueDepth) {
+        int listenFD = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrSize = sizeof(addr);
+        if (listenFD < 0 || bind(listenFD, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listenFD, 1) != 0 || getsockname(listenFD, reinterpret_cast<struct sockaddr*>(&addr), &addrSize) != 0) {
+            if (listenFD >= 0) close(listenFD);
+            return;
+        }
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int serverFD = -1;
+        if (fd >= 0 && connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+            serverFD = accept(listenFD, nullptr, nullptr);
+        }
+        close(listenFD);
+        // Same socket setup as Server::Run
+        if (serverFD < 0 || !ArticProtocolServer::SetNonBlock(serverFD, true)) {
+            if (serverFD >= 0) close(serverFD);
+            if (fd >= 0) close(fd);
+            fd = -1;
+            return;
+        }
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        setsockopt(serverFD, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        server = new ArticProtocolServer(serverFD);
+        server->SetQueueDepth(queueDepth);
+        thread = std::thread([this] { server->Serve(); });
+    }
+
+    Loopback::~Loopback() {
+        if (fd < 0) return;
+        // The server stops once it reads the end of the connection
+        shutdown(fd, SHUT_WR);
+        thread.join();
+        delete server;
+        close(fd);
+    }
+
+    bool Loopback::SendAll(const void* data, size_t size) {
+        const u8* p = reinterpret_cast<const u8*>(data);
+        while (size != 0) {
+            ssize_t sent = send(fd, p, size, MSG_NOSIGNAL);
+            if (sent <= 0) return false;
+            p += sent;
+            size -= sent;
+            sentBytes += sent;
+        }
+        return true;
+    }
+
+    bool Loopback::ReceiveAll(void* data, size_t size) {
+        u8* p = reinterpret_cast<u8*>(data);
+        while (size != 0) {
+            ssize_t received = recv(fd, p, size, 0);
+            if (received <= 0) return false;
+            p += received;
+            size -= received;
+        }
+        return true;
+    }
+
+    bool Loopback::Send(u32 requestID, const char* method, const MethodInterface& mi) {
+        ArticProtocolCommon::RequestPacket packet = {};
+        packet.requestID = requestID;
+        strncpy(packet.method, method, sizeof(packet.method) - 1);
+        packet.parameterCount = mi.GetParameterCount();
+        std::vector<u8> parameters = mi.SerializeParameters(requestID);
+        return SendAll(&packet, sizeof(packet)) && SendAll(parameters.data(), parameters.size());
+    }
+
+    bool Loopback::Send(u32 requestID, u16 opcode, const MethodInterface& mi) {
+        ArticProtocolCommon::OpcodeRequestPacket packet = {};
+        packet.requestID = requestID;
+        packet.marker = ArticProtocolCommon::OPCODE_REQUEST_MARKER;
+        packet.parameterCount = static_cast<u8>(mi.GetParameterCount());
+        packet.opcode = opcode;
+        std::vector<u8> parameters = mi.SerializeParameters(requestID);
+        return SendAll(&packet, sizeof(packet)) && SendAll(parameters.data(), parameters.size());
+    }
+
+    bool Loopback::Receive(u32& requestID, s32& articResult, MethodInterface& mi) {
+        ArticProtocolCommon::DataPacket header;
+        if (!ReceiveAll(&header, sizeof(header))) return false;
+        requestID = header.requestID;
+        articResult = header.articResult;
+        if (articResult != 0) {
+            mi.FinishInternalError();
+            return true;
+        }
+        std::vector<u8> results(header.resultSize);
+        if (!ReceiveAll(results.data(), results.size())) return false;
+        size_t offset = 0;
+        while (offset + sizeof(ArticProtocolCommon::Buffer) <= results.size()) {
+            ArticProtocolCommon::Buffer buffer;
+            memcpy(&buffer, results.data() + offset, sizeof(buffer));
+            offset += sizeof(buffer);
+            if (buffer.bufferSize > results.size() - offset) return false;
+            ArticProtocolCommon::Buffer* copy = mi.ReserveResultBuffer(buffer.bufferID, buffer.bufferSize);
+            if (!copy) return false;
+            memcpy(copy->data, results.data() + offset, buffer.bufferSize);
+            offset += buffer.bufferSize;
+        }
+        mi.FinishGood(header.methodResult);
+        return offset == results.size();
+    }
+
+    bool Loopback::Call(const char* method, MethodInterface& mi) {
+        static u32 nextRequestID = 0;
+        u32 requestID = ++nextRequestID, receivedID;
+        s32 articResult;
+        if (!Send(requestID, method, mi) || !Receive(receivedID, articResult, mi)) return false;
+        return receivedID == requestID && articResult == 0;
+    }
+
+    static bool WriteFixtureFile(const std::string& path, u32 size, u8 (*byte)(char, u64), char seed) {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        std::vector<u8> data(size);
+        for (u32 i = 0; i < size; i++) {
+            data[i] = byte(seed, i);
+        }
+        bool written = fwrite(data.data(), 1, size, f) == size;
+        return fclose(f) == 0 && written;
+    }
+
+    static bool CreateFixture(const std::string& root) {
+        auto romfsByte = [](char, u64 offset) { return RomFSByte(offset); };
+        bool good = mkdir((root + "/exefs").c_str(), 0755) == 0 &&
+            mkdir((root + "/save").c_str(), 0755) == 0 &&
+            mkdir((root + "/sdmc").c_str(), 0755) == 0 &&
+            WriteFixtureFile(root + "/romfs.bin", ROMFS_SIZE, romfsByte, 0);
+        for (const char* section : {"code", "icon", "banner", "logo"}) {
+            good = good && WriteFixtureFile(root + "/exefs/" + section + ".bin", EXEFS_SIZE, ExeFSByte, section[0]);
+        }
+        if (!good) return false;
+
+        Host::config.romfsImage = root + "/romfs.bin";
+        Host::config.exefsDir = root + "/exefs";
+        Host::config.saveDir = root + "/save";
+        Host::config.sdmcDir = root + "/sdmc";
+        Host::config.romfsLatency.fixedMicroseconds = Host::config.romfsLatency.microsecondsPerKiB = 0;
+        Host::config.saveLatency.fixedMicroseconds = Host::config.saveLatency.microsecondsPerKiB = 0;
+        return true;
+    }
+
+    static int Run(const char* filter, bool benchmarks) {
+        int failed = 0, run = 0;
+        for (const Entry& test : Registry()) {
+            if (test.benchmark != benchmarks || (filter && !strstr(test.name, filter))) continue;
+            currentTest = test.name;
+            currentFailed = false;
+            test.function();
+            // Same as a client disconnecting
+            for (auto function : ArticFunctions::destructFunctions) {
+                function();
+            }
+            run++;
+            if (currentFailed) failed++;
+            printf("%s %s\n", currentFailed ? "FAIL" : "ok  ", test.name);
+        }
+        printf("%d of %d tests passed\n", run - failed, run);
+        return failed == 0 ? 0 : 1;
+    }
+}
+
+// Usage: ArticBaseTests [--bench] [name filter]
+int main(int argc, char* argv[]) {
+    logger.quiet = true;
+    bool benchmarks = argc > 1 && strcmp(argv[1], "--bench") == 0;
+    if (benchmarks) {
+        argc--;
+        argv++;
+    }
+
+    char rootTemplate[] = "/tmp/ArticBaseTests.XXXXXX";
+    const char* root = mkdtemp(rootTemplate);
+    if (!root || !Test::CreateFixture(root)) {
+        fprintf(stderr, "Failed to create the test fixture\n");
+        return 1;
+    }
+    if (!Host::LoadApplication()) {
+        fprintf(stderr, "Failed to load the test application\n");
+        return 1;
+    }
+    for (auto function : ArticFunctions::setupFunctions) {
+        if (!function()) {
+            fprintf(stderr, "Setup failed\n");
+            return 1;
+        }
+    }
+
+    int res = Test::Run(argc > 1 ? argv[1] : nullptr, benchmarks);
+    std::string cleanup = std::string("rm -rf ") + root;
+    if (system(cleanup.c_str()) != 0) {
+        fprintf(stderr, "Failed to remove %s\n", root);
+    }
+    return res;
+}
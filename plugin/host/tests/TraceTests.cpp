@@ -0,0 +1,57 @@
+// Request trace of "#TraceStart" and "#TraceDump"
+#include "Test.hpp"
+#include "ArticTrace.hpp"
+#include <string>
+#include <vector>
+
+using namespace Test;
+namespace Trace = ArticFunctions::Trace;
+
+namespace {
+    // Records of the trace dumped from memory, with the opcode of method
+    std::vector<Trace::Record> DumpTrace(const char* method, int& opcode) {
+        std::vector<Trace::Record> records;
+        opcode = -1;
+        MethodInterface mi;
+        mi.AddParameterS8(0);
+        Call("#TraceDump", mi);
+        const ArticProtocolCommon::Buffer* buffer = mi.GetResultBuffer(0);
+        if (!buffer || buffer->bufferSize < sizeof(Trace::Header)) return records;
+
+        const u8* cur = reinterpret_cast<const u8*>(buffer->data);
+        Trace::Header header;
+        memcpy(&header, cur, sizeof(header)); cur += sizeof(header);
+        for (u16 i = 0; i < header.methodCount; i++) {
+            u8 length = *cur++;
+            if (std::string(reinterpret_cast<const char*>(cur), length) == method) opcode = i;
+            cur += length;
+        }
+        records.resize(header.recordCount);
+        memcpy(records.data(), cur, records.size() * sizeof(Trace::Record));
+        return records;
+    }
+}
+
+TEST(TraceRecordsTargetOfEachRequest) {
+    MethodInterface start;
+    Call("#TraceStart", start);
+    CHECK(start.IsGood() && start.GetReturnValue() == 0);
+
+    Handle handle = OpenRomFS();
+    CHECK(handle != 0);
+    u8 data[0x100];
+    CHECK(ReadFile(handle, 0x1234, data, sizeof(data)) == sizeof(data));
+    CHECK(CloseFile(handle) == 0);
+
+    int readOpcode;
+    std::vector<Trace::Record> records = DumpTrace("FSFILE_Read", readOpcode);
+    CHECK(readOpcode >= 0);
+    // The trace starts after "#TraceStart": the open, the read and the close
+    CHECK(records.size() == 3);
+    CHECK(records[0].handle == handle);
+    CHECK(records[1].opcode == readOpcode);
+    CHECK(records[1].handle == handle);
+    CHECK(records[1].offset == 0x1234);
+    CHECK(records[1].size == sizeof(data));
+    CHECK(records[1].responseBytes == sizeof(data));
+}
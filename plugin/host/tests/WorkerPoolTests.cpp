@@ -0,0 +1,83 @@
+// Per-key ordering of the worker pool
+#include "Test.hpp"
+#include "ArticWorkerPool.hpp"
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace Test;
+using ArticFunctions::WorkerPool;
+
+namespace {
+    constexpr u32 KEY_COUNT = 8;
+    constexpr u32 TASKS_PER_KEY = 500;
+
+    struct KeyState {
+        Handle handle;
+        std::atomic<bool> running{};
+        u32 lastSequence = 0;
+        std::atomic<u32> errors{};
+    };
+
+    struct Task {
+        KeyState* key;
+        u32 sequence;
+    };
+
+    // Writes its sequence number to the file of its key and reads it back.
+    // A task on the same key running at the same time or out of order is an
+    // error.
+    void RunTask(void* arg) {
+        Task* task = reinterpret_cast<Task*>(arg);
+        KeyState* key = task->key;
+        if (key->running.exchange(true)) key->errors++;
+        if (key->lastSequence + 1 != task->sequence) key->errors++;
+
+        u32 bytes = 0, value = 0;
+        if (R_FAILED(FSFILE_Write(key->handle, &bytes, 0, &task->sequence, sizeof(u32), 0)) ||
+            R_FAILED(FSFILE_Read(key->handle, &bytes, 0, &value, sizeof(u32))) || value != task->sequence) {
+            key->errors++;
+        }
+        // Give tasks on other keys a chance to run meanwhile
+        if (task->sequence % 16 == 0) svcSleepThread(10000);
+
+        key->lastSequence = task->sequence;
+        key->running = false;
+    }
+}
+
+TEST(WorkerPoolKeepsPerKeyOrder) {
+    FS_Archive archive;
+    CHECK(R_SUCCEEDED(FSUSER_OpenArchive(&archive, ARCHIVE_SAVEDATA, fsMakePath(PATH_EMPTY, ""))));
+    static KeyState keys[KEY_COUNT];
+    for (u32 i = 0; i < KEY_COUNT; i++) {
+        std::string path = "/pool" + std::to_string(i) + ".bin";
+        CHECK(R_SUCCEEDED(FSUSER_OpenFile(&keys[i].handle, archive, fsMakePath(PATH_ASCII, path.c_str()),
+            FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE, 0)));
+        keys[i].lastSequence = 0;
+        keys[i].errors = 0;
+    }
+
+    CHECK(ArticFunctions::workerPool.Start(WorkerPool::MAX_WORKERS));
+    // Keys interleaved unevenly, so queued tasks of a busy key are passed over
+    std::vector<Task> tasks;
+    tasks.reserve(KEY_COUNT * TASKS_PER_KEY);
+    u32 sequences[KEY_COUNT] = {};
+    for (u32 i = 0; tasks.size() < KEY_COUNT * TASKS_PER_KEY; i++) {
+        u32 key = (i * 7 + i / 3) % KEY_COUNT;
+        if (sequences[key] == TASKS_PER_KEY) continue;
+        tasks.push_back({&keys[key], ++sequences[key]});
+    }
+    WorkerPool::Group group;
+    for (Task& task : tasks) {
+        ArticFunctions::workerPool.Submit(task.key->handle, RunTask, &task, &group);
+    }
+    group.Wait();
+
+    for (KeyState& key : keys) {
+        CHECK(key.errors == 0);
+        CHECK(key.lastSequence == TASKS_PER_KEY);
+        FSFILE_Close(key.handle);
+    }
+    FSUSER_CloseArchive(archive);
+}
@@ -0,0 +1,112 @@
+// Buffered and asynchronous writes to save data
+#include "Test.hpp"
+#include "ArticWriteBuffer.hpp"
+#include <stdlib.h>
+#include <vector>
+
+using namespace Test;
+using ArticFunctions::WriteBuffer;
+
+namespace {
+    bool SetAsyncWrites(bool enable) {
+        MethodInterface mi;
+        mi.AddParameterS8(enable ? 1 : 0);
+        Call("#SetAsyncWrites", mi);
+        return mi.IsGood() && mi.GetReturnValue() == 0;
+    }
+
+    Result FlushFile(Handle handle) {
+        MethodInterface mi;
+        mi.AddParameterS32(handle);
+        Call("FSFILE_Flush", mi);
+        return mi.IsGood() ? mi.GetReturnValue() : -1;
+    }
+
+    s64 GetFileSize(Handle handle) {
+        MethodInterface mi;
+        mi.AddParameterS32(handle);
+        Call("FSFILE_GetSize", mi);
+        return (mi.IsGood() && R_SUCCEEDED(mi.GetReturnValue())) ? Get<s64>(mi) : -1;
+    }
+
+    // Small writes all over the file, some touching or overlapping, matched
+    // against a copy kept here
+    bool WriteRandomly(Handle handle, std::vector<u8>& reference, u32 count) {
+        srand(1234);
+        std::vector<u8> data(0x400);
+        for (u32 i = 0; i < count; i++) {
+            u32 size = 1 + rand() % data.size();
+            u32 offset = rand() % (reference.size() - size);
+            if (i % 4 == 1) offset = std::min<u32>(offset, 0x800);
+            for (u32 j = 0; j < size; j++) {
+                data[j] = static_cast<u8>(rand());
+            }
+            if (WriteFile(handle, offset, data.data(), size) != 0) return false;
+            memcpy(reference.data() + offset, data.data(), size);
+        }
+        return true;
+    }
+
+    bool MatchesFile(Handle handle, const std::vector<u8>& reference) {
+        std::vector<u8> data(reference.size());
+        return ReadFile(handle, 0, data.data(), data.size()) == static_cast<s64>(data.size()) && data == reference;
+    }
+}
+
+TEST(WriteBufferMergesSmallWrites) {
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    Handle handle = OpenFile(archive, "/buffered.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(handle != 0);
+
+    std::vector<u8> reference(0x8000);
+    CHECK(WriteFile(handle, 0, reference.data(), reference.size()) == 0);
+    CHECK(WriteRandomly(handle, reference, 500));
+    // Reads see the pending data
+    CHECK(MatchesFile(handle, reference));
+
+    WriteBuffer::Counters counters = GetStats<WriteBuffer::Counters>("#WriteBufferStats");
+    CHECK(counters.writes == 501);
+    CHECK(counters.buffered == 500);
+    CHECK(counters.merged != 0);
+    CHECK(counters.fsWrites < counters.buffered);
+
+    // Writes past the end grow the file
+    const u8 tail[0x10] = {1, 2, 3};
+    CHECK(WriteFile(handle, reference.size() + 0x10, tail, sizeof(tail)) == 0);
+    CHECK(GetFileSize(handle) == static_cast<s64>(reference.size() + 0x20));
+    reference.resize(reference.size() + 0x10);
+    reference.insert(reference.end(), tail, tail + sizeof(tail));
+
+    CHECK(FlushFile(handle) == 0);
+    CHECK(CloseFile(handle) == 0);
+    handle = OpenFile(archive, "/buffered.bin", FS_OPEN_READ);
+    CHECK(handle != 0);
+    CHECK(MatchesFile(handle, reference));
+    CHECK(CloseFile(handle) == 0);
+    CloseArchive(archive);
+}
+
+TEST(WriteBufferQueuesAsyncWrites) {
+    CHECK(SetAsyncWrites(true));
+    FS_Archive archive = OpenArchive(ARCHIVE_SAVEDATA);
+    CHECK(archive != 0);
+    Handle handle = OpenFile(archive, "/async.bin", FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE);
+    CHECK(handle != 0);
+
+    std::vector<u8> reference(0x10000, 0x11);
+    CHECK(WriteFile(handle, 0, reference.data(), reference.size()) == 0);
+    CHECK(WriteRandomly(handle, reference, 300));
+    CHECK(MatchesFile(handle, reference));
+    WriteBuffer::Counters counters = GetStats<WriteBuffer::Counters>("#WriteBufferStats");
+    CHECK(counters.queued != 0);
+    CHECK(counters.deferredErrors == 0);
+
+    // Closing waits for the queued writes
+    CHECK(CloseFile(handle) == 0);
+    handle = OpenFile(archive, "/async.bin", FS_OPEN_READ);
+    CHECK(handle != 0);
+    CHECK(MatchesFile(handle, reference));
+    CHECK(CloseFile(handle) == 0);
+    CloseArchive(archive);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "3ds.h"
+#include <map>
+#include <vector>
+
+namespace ArticFunctions {
+    // Session long cache of read-only file data in fixed size blocks, shared by
+    // every handle opened on the same file. Segmented LRU: new blocks enter the
+    // probation segment and only move to the protected one when read again, so
+    // streaming through a large file cannot evict the data that is reread.
+    class BlockCache {
+    public:
+        // Reported by "#BlockCacheStats"
+        struct Counters {
+            u32 hits;
+            u32 misses;
+            u32 insertions;
+            u32 evictions;
+            u64 hitBytes;
+        };
+        static_assert(sizeof(Counters) == 0x18);
+
+        static constexpr u32 BLOCK_SIZE = 0x1000;
+        static constexpr u32 BLOCK_COUNT = BLOCK_CACHE_MEMORY / BLOCK_SIZE;
+        static constexpr u32 PROTECTED_COUNT = BLOCK_COUNT * 4 / 5;
+        // Missed reads up to this size are widened to whole blocks, so small
+        // unaligned reads can be cached too
+        static constexpr u32 MAX_FILL_SIZE = 4 * BLOCK_SIZE;
+
+        BlockCache();
+
+        // Only registered handles are cached, the file must not change while
+        // the server runs. Handles of the same file share their blocks.
+        void Register(Handle handle, s32 archiveID, const FS_Path& archivePath, const FS_Path& filePath);
+        void Unregister(Handle handle);
+        // Drops every block and file and resets the counters
+        void Clear();
+
+        // Same as FSFILE_Read, misses go through the read-ahead
+        Result Read(Handle handle, u64 offset, void* out, u32 size, u32& bytesRead);
+
+        Counters GetCounters();
+
+    private:
+        static constexpr u32 NONE = 0xFFFFFFFF;
+
+        enum class Segment : u8 {
+            FREE,
+            PROBATION,
+            PROTECTED,
+        };
+
+        struct Block {
+            u64 key;
+            u32 prev;
+            u32 next;
+            // Less than BLOCK_SIZE only for the last block of a file
+            u32 valid;
+            Segment segment;
+        };
+
+        struct List {
+            u32 head = NONE; // Most recently used
+            u32 tail = NONE;
+            u32 count = 0;
+        };
+
+        static u64 MakeKey(u32 fileID, u64 blockIndex) {
+            return (static_cast<u64>(fileID) << 40) | blockIndex;
+        }
+
+        bool Lookup(u32 fileID, u64 offset, u8* out, u32 size, u32& bytesRead);
+        void Insert(u32 fileID, u64 offset, const u8* data, u32 size, bool eof);
+        u32 AllocateBlock();
+        void Touch(u32 index);
+        List& ListOf(Segment segment);
+        void Unlink(u32 index);
+        void PushFront(u32 index, Segment segment);
+
+        LightLock lock;
+        u8* memory = nullptr;
+        Block* blocks = nullptr;
+        List freeList;
+        List probation;
+        List protectedList;
+        std::map<u64, u32> index;
+        std::map<Handle, u32> handleFiles;
+        // Identity (archive ID and paths) of every file seen this session,
+        // the position is the file ID used in the block keys
+        std::vector<std::vector<u8>> files;
+        Counters counters{};
+    };
+
+    extern BlockCache blockCache;
+}
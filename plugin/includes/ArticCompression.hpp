@@ -0,0 +1,57 @@
+#pragma once
+#include "3ds.h"
+
+namespace ArticFunctions {
+    // Optional compression of read responses, enabled per session by the
+    // client with "#SetCompression".
+    //
+    // Data is split in BLOCK_SIZE blocks, each compressed on its own in the
+    // LZ4 block format or kept raw. A compressed response has the blocks back
+    // to back followed by one u32 per block with its stored size, bit 31 set
+    // if the block is raw, and carries an Info in result buffer INFO_BUFFER_ID.
+    // Responses without it are plain data, as without compression.
+    namespace Compression {
+        struct Info {
+            u32 rawSize;
+            u32 blockSize;
+        };
+        static_assert(sizeof(Info) == 8);
+
+        struct Counters {
+            u32 compressedBlocks;
+            u32 rawBlocks;      // Sampled or compressed and not worth it
+            u32 skippedBlocks;  // Not tried because the CPU is the bottleneck
+            u32 reserved;
+            u64 rawBytes;
+            u64 sentBytes;
+            u64 microseconds;   // Spent compressing
+        };
+        static_assert(sizeof(Counters) == 0x28);
+
+        static constexpr u32 INFO_BUFFER_ID = 0x10;
+        static constexpr u32 BLOCK_SIZE = 0x4000;
+        static constexpr u32 RAW_BLOCK = 1U << 31;
+        // Part of every block compressed first, to skip incompressible ones
+        static constexpr u32 SAMPLE_SIZE = 0x400;
+        // Blocks must shrink to this fraction (in 1/16) to be sent compressed
+        static constexpr u32 MIN_RATIO_16 = 14;
+        // While compression does not pay, still try one block in this many
+        // to notice when it does again
+        static constexpr u32 PROBE_INTERVAL = 16;
+        static constexpr u32 DEFAULT_LINK_KBPS = 2000;
+
+        // linkKBps is the client estimate of the link throughput, 0 for the default
+        void Enable(bool enable, u32 linkKBps);
+        bool IsEnabled();
+        // Disables compression and resets the estimates and counters
+        void Reset();
+        Counters GetCounters();
+
+        // Space to reserve for size bytes of data, so they can be compressed in place
+        size_t ReserveSize(size_t size);
+        // Compresses size bytes in place, data must have ReserveSize(size) bytes.
+        // Returns the new size, always smaller than size, or 0 if the data was
+        // left as it is.
+        size_t Compress(u8* data, size_t size, Info& info);
+    }
+}
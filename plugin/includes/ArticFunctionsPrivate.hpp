@@ -2,13 +2,24 @@
 #include "3ds.h"
 #include "ArticProtocolCommon.hpp"
 #include "ArticProtocolServer.hpp"
+#include "ArticMethodTable.hpp"
+#include "ArticHandleTable.hpp"
 
 namespace ArticFunctions {
-    enum class HandleType {
-        FILE,
-        DIR,
-        ARCHIVE
-    };
+    // Perfect hash lookup on the 32 byte RequestPacket::method field.
+    // Returns nullptr if unknown.
+    MethodHandler GetMethodHandler(const char* method);
+    // Dense lookup by the opcode listed by "#GetMethodOpcodes"
+    MethodHandler GetMethodHandler(u16 opcode);
+    // Opcode of the method, -1 if unknown
+    s32 GetMethodOpcode(const char* method);
+
+    // Pipelined requests: returns false if the request has to run alone on
+    // the server thread once every request in flight finished. Otherwise
+    // requests with the same key must run in order, the others may overlap.
+    bool GetRequestKey(u16 opcode, s64 firstParameter, u64& key);
+    // Runs the request on the request worker pool
+    void SubmitRequest(u64 key, void(*task)(void*), void* arg);
 
     // Controller_Start
     namespace ArticController {
@@ -0,0 +1,79 @@
+#pragma once
+#include "3ds.h"
+#include <map>
+#include <vector>
+
+namespace ArticFunctions {
+    // Shares one FS handle between every open of the same read-only file and
+    // keeps it open for a while after the last close, so opening it again
+    // needs no FS call. Cached handles are owned here, the handle table only
+    // lists them as shared. At most MAX_IDLE_HANDLES are kept open without
+    // the client using them, the oldest are closed first, so the FS handle
+    // quota cannot run out.
+    class HandleCache {
+    public:
+        struct Counters {
+            u32 hits;
+            u32 misses;
+            u32 evictions;
+        };
+
+        using Key = std::vector<u8>;
+
+        static constexpr size_t MAX_IDLE_HANDLES = 8;
+        // Size of files opened without asking for it
+        static constexpr s64 UNKNOWN_SIZE = -1;
+
+        HandleCache();
+
+        // FSUSER_OpenFileDirectly
+        static Key MakeKey(s32 archiveID, const FS_Path& archivePath, const FS_Path& filePath);
+        // FSUSER_OpenFile, only for archives added with AddReadOnlyArchive
+        static Key MakeKey(FS_Archive archive, const FS_Path& filePath);
+
+        // Files of the archive cannot change while it is open
+        void AddReadOnlyArchive(FS_Archive archive);
+        bool IsReadOnlyArchive(FS_Archive archive);
+        // Called before the archive is closed, its idle handles are closed
+        void RemoveArchive(FS_Archive archive);
+
+        // Returns true and takes a reference if the file is already open
+        bool Acquire(const Key& key, Handle& handle, s64& size);
+        // Adds a handle just opened, with one reference. Returns false if
+        // the file was opened meanwhile, the handle is not cached then.
+        bool Insert(const Key& key, Handle handle, s64 size, FS_Archive archive = 0);
+        // Drops a reference. Returns false if the handle is not cached, the
+        // caller must close it then. Streams of the handle are cancelled
+        // once its last reference is dropped.
+        bool Release(Handle handle);
+        // Closes every cached handle and resets the counters
+        void Clear();
+
+        Counters GetCounters();
+
+    private:
+        struct Entry {
+            Key key;            // Empty once the archive was closed
+            s64 size;
+            FS_Archive archive;
+            u32 references;
+            u64 lastUse;
+        };
+
+        // Called without the lock, closing waits for streams and prefetches
+        // that may need it
+        static void Close(const std::vector<Handle>& handles);
+        // Takes the oldest idle handles out of the cache, the caller closes
+        // them once the lock is released
+        void EvictIdle(std::vector<Handle>& victims);
+
+        LightLock lock;
+        std::map<Handle, Entry> entries;
+        std::vector<FS_Archive> readOnlyArchives;
+        size_t idleCount = 0;
+        u64 useCounter = 0;
+        Counters counters{};
+    };
+
+    extern HandleCache handleCache;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "3ds.h"
+#include <array>
+#include <atomic>
+
+namespace ArticFunctions {
+    enum class HandleType : u8 {
+        FILE,
+        DIR,
+        ARCHIVE
+    };
+
+    // Every FS handle and archive the server has open for the client, with
+    // per-handle metadata and access counters. Open addressed with linear
+    // probing in a fixed array, so opening and closing allocate nothing.
+    // Adding and removing take a lock, lookups and counter updates do not:
+    // every slot is versioned and readers retry if it changed under them.
+    class HandleTable {
+    public:
+        struct Info {
+            HandleType type;
+            // Owned by the handle cache, which closes it
+            bool shared;
+            FS_Archive archive;     // 0 for FSUSER_OpenFileDirectly and archives
+            u32 pathHash;           // 0 if the path is not known
+            u32 ops;
+            u64 bytes;
+        };
+
+        // Wire format of one handle in the "#HandleStats" response
+        struct Record {
+            u64 handle;
+            u8 type;
+            u8 shared;
+            u16 reserved;
+            u32 pathHash;
+            u64 archive;
+            u64 bytes;
+            u32 ops;
+            u32 reserved2;
+        };
+        static_assert(sizeof(Record) == 0x28);
+
+        // Well above what a title keeps open at once
+        static constexpr u32 CAPACITY_BITS = 8;
+        static constexpr u32 CAPACITY = 1 << CAPACITY_BITS;
+
+        static u32 HashPath(const FS_Path& path);
+
+        // Returns false if the table is full, the handle is not tracked then
+        bool Add(u64 handle, HandleType type, bool shared = false, FS_Archive archive = 0, u32 pathHash = 0);
+        // Returns false if the handle was not in the table
+        bool Remove(u64 handle, Info* removed = nullptr);
+        bool Get(u64 handle, Info& out) const;
+        // Counts one operation moving bytes on the handle, if it is tracked
+        void AddAccess(u64 handle, u32 bytes);
+
+        // Copies up to maxCount records, returns the amount copied
+        u32 Snapshot(Record* out, u32 maxCount) const;
+        u32 Count() const {
+            return count.load(std::memory_order_relaxed);
+        }
+
+        // Removes every handle, calling close for those not shared. No other
+        // thread may use the table meanwhile.
+        void Drain(void (*close)(u64 handle, HandleType type));
+
+        HandleTable();
+
+    private:
+        // The kernel never hands out 0 or all ones as a handle or archive
+        static constexpr u64 EMPTY = 0;
+        static constexpr u64 TOMBSTONE = ~0ULL;
+
+        struct Slot {
+            // Odd while a writer changes the slot
+            std::atomic<u32> version{};
+            std::atomic<u64> key{EMPTY};
+            std::atomic<HandleType> type{};
+            std::atomic<bool> shared{};
+            std::atomic<u32> pathHash{};
+            std::atomic<u64> archive{};
+            std::atomic<u32> ops{};
+            std::atomic<u64> bytes{};
+        };
+
+        static u32 Home(u64 handle) {
+            return static_cast<u32>((handle * 0x9E3779B97F4A7C15ULL) >> (64 - CAPACITY_BITS));
+        }
+
+        // Slot holding the handle or nullptr, may be stale by the time it is used
+        const Slot* Find(u64 handle) const;
+
+        LightLock lock;
+        std::array<Slot, CAPACITY> slots;
+        std::atomic<u32> count{};
+    };
+
+    extern HandleTable handleTable;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "3ds.h"
+#include "ArticProtocolCommon.hpp"
+#include "ArticMethodInterface.hpp"
+#include <vector>
+
+namespace ArticFunctions {
+    // Keeps the serialized responses of methods marked with a policy in the
+    // method table, so calling one again with the same parameters sends the
+    // stored buffers without any service call. Handlers of those methods go
+    // through Replay, ReserveResultBuffer and FinishGood below, which only
+    // forward to the MethodInterface for every other method.
+    namespace Memo {
+        // When the stored responses of a method are dropped
+        enum Policy : u8 {
+            NONE = 0,       // Not memoized
+            SESSION,        // Never, the data cannot change while the title runs
+            UNTIL_WRITE,    // On every FS write, resize, create, delete or format
+            POLICY_COUNT,
+        };
+
+        // Reported by "#MemoStats"
+        struct Counters {
+            u32 hits;           // Calls answered from memory
+            u32 stores;         // Responses kept
+            u32 invalidations;  // UNTIL_WRITE responses dropped
+        };
+        static_assert(sizeof(Counters) == 0xC);
+
+        // Set up by the method dispatcher around the handler of a memoized
+        // method, found through the MethodInterface of the request
+        class Scope {
+        public:
+            Scope(u16 opcode, Policy policy, MethodInterface& mi);
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            friend bool Replay(MethodInterface& mi, const void* key, size_t keySize);
+            friend ArticProtocolCommon::Buffer* ReserveResultBuffer(MethodInterface& mi, u32 bufferID, size_t size);
+            friend void FinishGood(MethodInterface& mi, Result res);
+
+            Policy policy;
+            MethodInterface& mi;
+            // Opcode then the parameters given to Replay
+            std::vector<u8> key;
+            bool keyed = false;
+            u32 generation = 0;
+            std::vector<ArticProtocolCommon::Buffer*> buffers;
+        };
+
+        // Called once the parameters are read, with those that select the
+        // response. Returns true if a stored response was sent, the handler
+        // is done then.
+        bool Replay(MethodInterface& mi, const void* key = nullptr, size_t keySize = 0);
+        ArticProtocolCommon::Buffer* ReserveResultBuffer(MethodInterface& mi, u32 bufferID, size_t size);
+        // Keeps a copy of the response buffers if the result is a success
+        void FinishGood(MethodInterface& mi, Result res);
+
+        // Drops every stored response of methods with the policy
+        void Invalidate(Policy policy);
+        // Drops every stored response and resets the counters
+        void Clear();
+
+        Counters GetCounters();
+    }
+}
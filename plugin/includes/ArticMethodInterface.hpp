@@ -0,0 +1,108 @@
+#pragma once
+#include "3ds.h"
+#include "ArticProtocolCommon.hpp"
+#include "ArticProtocolServer.hpp"
+#include "ArticTrace.hpp"
+
+namespace ArticFunctions {
+    namespace Memo {
+        class Scope;
+    }
+
+    // What a handler sees of its request: forwards to the MethodInterface of
+    // the protocol library and counts the parameter and result bytes on the
+    // way, so every method is accounted the same way. The method dispatcher
+    // reports the counts once the handler returns.
+    class MethodInterface {
+    public:
+        explicit MethodInterface(ArticProtocolServer::MethodInterface& m) : mi(m) {}
+
+        MethodInterface(const MethodInterface&) = delete;
+        MethodInterface& operator=(const MethodInterface&) = delete;
+
+        bool GetParameterS8(s8& out) {
+            return CountParameter(mi.GetParameterS8(out), sizeof(out));
+        }
+
+        bool GetParameterS16(s16& out) {
+            return CountParameter(mi.GetParameterS16(out), sizeof(out));
+        }
+
+        bool GetParameterS32(s32& out) {
+            return CountParameter(mi.GetParameterS32(out), sizeof(out));
+        }
+
+        bool GetParameterS64(s64& out) {
+            return CountParameter(mi.GetParameterS64(out), sizeof(out));
+        }
+
+        bool GetParameterBuffer(void*& buffer, size_t& size) {
+            bool good = mi.GetParameterBuffer(buffer, size);
+            return CountParameter(good, good ? size : 0);
+        }
+
+        bool FinishInputParameters() {
+            return mi.FinishInputParameters();
+        }
+
+        ArticProtocolCommon::Buffer* ReserveResultBuffer(u32 bufferID, size_t size) {
+            ArticProtocolCommon::Buffer* buffer = mi.ReserveResultBuffer(bufferID, size);
+            if (buffer) responseBytes += size;
+            return buffer;
+        }
+
+        auto ResizeLastResultBuffer(ArticProtocolCommon::Buffer* buffer, size_t newSize) {
+            u64 oldSize = buffer->bufferSize;
+            auto resized = mi.ResizeLastResultBuffer(buffer, newSize);
+            if (resized) responseBytes = responseBytes - oldSize + newSize;
+            return resized;
+        }
+
+        void FinishGood(int returnValue) {
+            mi.FinishGood(returnValue);
+        }
+
+        void FinishInternalError() {
+            failed = true;
+            mi.FinishInternalError();
+        }
+
+        u32 GetRequestBytes() const {
+            return static_cast<u32>(requestBytes);
+        }
+
+        // Nothing but the error is sent for a failed request
+        u32 GetResponseBytes() const {
+            return failed ? 0 : static_cast<u32>(responseBytes);
+        }
+
+        // Describes the request in its trace record
+        void SetTraceTarget(u64 handle, s64 offset, u32 size) {
+            traceTarget = {handle, offset, size};
+        }
+
+        const Trace::Target& GetTraceTarget() const {
+            return traceTarget;
+        }
+
+        // Set while the handler of a memoized method runs
+        Memo::Scope* GetMemoScope() const {
+            return memoScope;
+        }
+
+    private:
+        friend class Memo::Scope;
+
+        bool CountParameter(bool good, size_t size) {
+            if (good) requestBytes += size;
+            return good;
+        }
+
+        ArticProtocolServer::MethodInterface& mi;
+        u64 requestBytes = 0;
+        u64 responseBytes = 0;
+        bool failed = false;
+        Trace::Target traceTarget{};
+        Memo::Scope* memoScope = nullptr;
+    };
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "3ds.h"
+#include <array>
+#include <utility>
+#include <type_traits>
+#include <string.h>
+#include "ArticProtocolCommon.hpp"
+#include "ArticProtocolServer.hpp"
+#include "ArticMemo.hpp"
+#include "ArticMethodInterface.hpp"
+
+namespace ArticFunctions {
+    // Called by the protocol server
+    using MethodHandler = void(*)(ArticProtocolServer::MethodInterface& mi);
+    // Implementation of a method, called through its MethodHandler
+    using HandlerFunction = void(*)(MethodInterface& mi);
+
+    static constexpr size_t METHOD_NAME_SIZE = sizeof(ArticProtocolCommon::RequestPacket::method);
+
+    template<std::size_t N>
+    constexpr auto& METHOD_NAME(char const (&s)[N]) {
+        static_assert(N < METHOD_NAME_SIZE, "String exceeds 32 bytes!");
+        return s;
+    }
+
+    // How a request may overlap with the other requests in flight on the
+    // connection, see GetRequestKey
+    enum class RequestOrder : u8 {
+        SERIAL,     // One at a time with the other SERIAL requests
+        HANDLE,     // In order with the requests on the same handle or archive, passed first
+        EXCLUSIVE,  // Alone, once every request before it finished
+    };
+
+    struct MethodEntry {
+        template<std::size_t N>
+        constexpr MethodEntry(char const (&n)[N], HandlerFunction h, Memo::Policy m = Memo::NONE)
+            : name(n), nameLength(N - 1), handler(h), memo(m), order(RequestOrder::SERIAL) {}
+
+        template<std::size_t N>
+        constexpr MethodEntry(char const (&n)[N], HandlerFunction h, RequestOrder o, Memo::Policy m = Memo::NONE)
+            : name(n), nameLength(N - 1), handler(h), memo(m), order(o) {}
+
+        const char* name;
+        size_t nameLength;
+        HandlerFunction handler;
+        // Methods with a policy keep their responses, see ArticMemo.hpp
+        Memo::Policy memo;
+        RequestOrder order;
+    };
+
+    // FNV-1a over the NUL terminated method name, never reading past the
+    // 32 bytes of RequestPacket::method. The seed is picked at compile time.
+    constexpr u32 MethodHash(const char* name, u32 seed) {
+        u32 hash = 0x811C9DC5 ^ seed;
+        for (size_t i = 0; i < METHOD_NAME_SIZE && name[i] != '\0'; i++) {
+            hash ^= static_cast<u8>(name[i]);
+            hash *= 0x01000193;
+        }
+        return hash ^ (hash >> 16);
+    }
+
+    // Perfect hash table built at compile time: every method name lands on its
+    // own slot, so a lookup is one hash, one slot read and one memcmp.
+    template<std::size_t N>
+    class MethodTable {
+    public:
+        static_assert(N < 0xFF, "Too many methods for 8 bit slots");
+
+        static constexpr size_t SLOT_COUNT = [] {
+            size_t count = 1;
+            while (count < N * 8) count <<= 1;
+            return count;
+        }();
+        static constexpr u8 EMPTY_SLOT = 0xFF;
+        static constexpr u32 MAX_SEED = 0x10000;
+
+        constexpr MethodTable(const MethodEntry (&e)[N]) : entries(ToArray(e, std::make_index_sequence<N>{})) {
+            for (seed = 0; seed < MAX_SEED; seed++) {
+                if (TryBuild()) return;
+            }
+        }
+
+        constexpr bool IsValid() const {
+            return seed < MAX_SEED;
+        }
+
+        constexpr size_t Size() const {
+            return N;
+        }
+
+        constexpr const MethodEntry& Entry(size_t index) const {
+            return entries[index];
+        }
+
+        // Returns the index of the method in the table, or -1 if not found.
+        // The index is also the opcode of the method for this build, as
+        // reported in stats and traces.
+        constexpr int Find(const char* method) const {
+            u8 index = slots[MethodHash(method, seed) & (SLOT_COUNT - 1)];
+            if (index == EMPTY_SLOT) return -1;
+            const MethodEntry& entry = entries[index];
+            if (std::is_constant_evaluated()) {
+                for (size_t i = 0; i <= entry.nameLength; i++) {
+                    if (entry.name[i] != method[i]) return -1;
+                }
+                return index;
+            }
+            // Names are shorter than the method field, so comparing the
+            // terminator as well rejects longer names with the same prefix.
+            return memcmp(entry.name, method, entry.nameLength + 1) == 0 ? index : -1;
+        }
+
+    private:
+        template<std::size_t... I>
+        static constexpr std::array<MethodEntry, N> ToArray(const MethodEntry (&e)[N], std::index_sequence<I...>) {
+            return {{e[I]...}};
+        }
+
+        constexpr bool TryBuild() {
+            slots.fill(EMPTY_SLOT);
+            for (size_t i = 0; i < N; i++) {
+                u8& slot = slots[MethodHash(entries[i].name, seed) & (SLOT_COUNT - 1)];
+                if (slot != EMPTY_SLOT) return false;
+                slot = static_cast<u8>(i);
+            }
+            return true;
+        }
+
+        std::array<MethodEntry, N> entries;
+        std::array<u8, SLOT_COUNT> slots{};
+        u32 seed = 0;
+    };
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "3ds.h"
+#include <map>
+#include <vector>
+
+namespace ArticFunctions {
+    // Remembers the files and directories an open failed to find, so a title
+    // probing the same missing path again gets the same result without an FS
+    // call. Only paths whose existence cannot change behind the server are
+    // kept: the application RomFS, and archives added here, which are
+    // read-only or only written through the server. Every create, delete and
+    // rename drops the entries of all writable archives, as several of them
+    // may be open on the same save data or extdata.
+    class NegativeCache {
+    public:
+        // Reported by "#NegativeCacheStats"
+        struct Counters {
+            u32 absorbed;       // Opens answered from the cache
+            u32 inserted;       // Missing paths remembered
+            u32 invalidations;  // Archive changes that dropped entries
+        };
+        static_assert(sizeof(Counters) == 0xC);
+
+        enum class Kind : u8 {
+            FILE,
+            DIRECTORY,
+        };
+
+        using Key = std::vector<u8>;
+
+        // One open that may be answered from the cache
+        struct Probe {
+            Key key;
+            FS_Archive archive;     // 0 for FSUSER_OpenFileDirectly
+            bool writable;
+            // Changes seen when the probe was made, a miss found after a
+            // later change may already be stale
+            u32 generation;
+        };
+
+        static constexpr size_t MAX_ENTRIES = 256;
+
+        NegativeCache();
+
+        // FSUSER_OpenFileDirectly. Returns false if misses in the archive are
+        // not remembered.
+        bool MakeProbe(s32 archiveID, const FS_Path& archivePath, const FS_Path& filePath, Probe& probe);
+        // FSUSER_OpenFile and FSUSER_OpenDirectory, same as above
+        bool MakeProbe(Kind kind, FS_Archive archive, const FS_Path& path, Probe& probe);
+
+        void AddArchive(FS_Archive archive, bool writable);
+        // Called before the archive is closed, its entries are dropped
+        void RemoveArchive(FS_Archive archive);
+        // Drops the entries of every writable archive, something was
+        // created, deleted or renamed in one of them
+        void Invalidate();
+
+        // Returns true and the result of the failed open if the path is missing
+        bool Lookup(const Probe& probe, Result& res);
+        // Remembers the result if it says the path does not exist
+        void Insert(const Probe& probe, Result res);
+        // Forgets every path and archive and resets the counters
+        void Clear();
+
+        Counters GetCounters();
+
+    private:
+        struct Entry {
+            Result result;
+            FS_Archive archive;
+            bool writable;
+            u64 lastUse;
+        };
+
+        struct Archive {
+            FS_Archive archive;
+            bool writable;
+        };
+
+        const Archive* FindArchive(FS_Archive archive) const;
+        void DropArchive(FS_Archive archive);
+
+        LightLock lock;
+        std::map<Key, Entry> entries;
+        std::vector<Archive> archives;
+        u64 useCounter = 0;
+        u32 generation = 0;
+        Counters counters{};
+    };
+
+    extern NegativeCache negativeCache;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "3ds.h"
+#include <map>
+
+namespace ArticFunctions {
+    // Detects read-only file handles that are read sequentially and reads the
+    // next window of them on the worker pool, so the following request of the
+    // stream is served from memory instead of waiting for the FS.
+    class ReadAhead {
+    public:
+        // Reported by "#ReadAheadStats"
+        struct Counters {
+            u32 hits;           // Reads served entirely from memory
+            u32 partialHits;    // Reads that started in memory and finished on the FS
+            u32 misses;         // Reads on registered handles that went to the FS
+            u32 prefetches;
+            u64 prefetchedBytes;
+            u64 wastedBytes;    // Prefetched and dropped without being served
+        };
+        static_assert(sizeof(Counters) == 0x20);
+
+        static constexpr u32 MIN_WINDOW = 0x4000;
+        static constexpr u32 MAX_WINDOW = 0x40000;
+        // Sequential reads needed before a handle starts prefetching
+        static constexpr u32 SEQUENTIAL_THRESHOLD = 2;
+
+        ReadAhead();
+
+        // Only registered handles are tracked, the data behind them must not
+        // change while they are open.
+        void Register(Handle handle);
+        // Waits for a running prefetch and drops the buffered data
+        void Unregister(Handle handle);
+        // Unregisters every handle and resets the counters, the worker pool
+        // must be stopped
+        void Clear();
+
+        // Same as FSFILE_Read, serving what it can from the prefetched window
+        Result Read(Handle handle, u64 offset, void* out, u32 size, u32& bytesRead);
+        // Follows a read served without going through Read, so the stream
+        // stays sequential across reads answered elsewhere
+        void NoteRead(Handle handle, u64 offset, u32 size);
+
+        Counters GetCounters();
+
+    private:
+        struct Stream {
+            Handle handle = 0;
+            u64 nextOffset = 0;
+            u32 sequentialReads = 0;
+            u32 window = MIN_WINDOW;
+            u8* buffer = nullptr;
+            u32 bufferCapacity = 0;
+            u64 bufferOffset = 0;
+            u32 bufferValid = 0;
+            // End of the served part of the buffer, the rest is wasted if dropped
+            u32 bufferServed = 0;
+            // The buffer ends at the end of the file
+            bool eof = false;
+            bool loading = false;
+            u64 lastUse = 0;
+        };
+
+        static void PrefetchTask(void* arg);
+        void Prefetch(Stream& stream);
+        // Copies the buffered part of a read, returns how much was copied
+        u32 ServeFromBuffer(Stream& stream, u64 offset, u8* out, u32 size, bool& complete);
+        bool ReserveBuffer(Stream& stream, u32 size);
+        void DropBuffer(Stream& stream, bool release);
+        void WaitLoaded(Stream& stream);
+
+        LightLock lock;
+        CondVar loaded;
+        std::map<Handle, Stream> streams;
+        size_t usedMemory = 0;
+        u64 useCounter = 0;
+        Counters counters{};
+    };
+
+    extern ReadAhead readAhead;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "3ds.h"
+#include "ArticMethodInterface.hpp"
+#include <array>
+#include <atomic>
+
+namespace ArticFunctions {
+    namespace Stats {
+        static constexpr size_t BUCKET_COUNT = 16;
+        // Bucket 0 holds values below 1 << shift, every other bucket doubles
+        // the range of the previous one and the last one takes everything above.
+        static constexpr u32 LATENCY_SHIFT = 2; // 4us
+        static constexpr u32 SIZE_SHIFT = 4; // 16 bytes
+
+        // Fixed buckets updated with relaxed atomics, so recording from
+        // several request threads needs no lock and no allocation.
+        class Histogram {
+        public:
+            void Add(u64 value, u32 shift);
+            u32 Get(size_t bucket) const {
+                return buckets[bucket].load(std::memory_order_relaxed);
+            }
+            void Reset();
+
+        private:
+            std::array<std::atomic<u32>, BUCKET_COUNT> buckets{};
+        };
+
+        struct MethodStats {
+            std::atomic<u32> count{};
+            std::atomic<u64> totalMicroseconds{};
+            Histogram latency;
+            Histogram requestBytes;
+            Histogram responseBytes;
+
+            void Reset();
+        };
+
+        // Wire format of one method in the "#Stats" response
+        struct MethodStatsRecord {
+            u16 opcode;
+            u16 bucketCount;
+            u32 count;
+            u64 totalMicroseconds;
+            u32 latency[BUCKET_COUNT];
+            u32 requestBytes[BUCKET_COUNT];
+            u32 responseBytes[BUCKET_COUNT];
+        };
+        static_assert(sizeof(MethodStatsRecord) == 0xD0);
+
+        void Serialize(const MethodStats& stats, u16 opcode, MethodStatsRecord& out);
+
+        // Times a request and records it in the method stats and the trace
+        // when it goes out of scope, with the payload bytes counted by its
+        // MethodInterface. Created by the method dispatcher after the
+        // MethodInterface, so it is destroyed first.
+        class RequestScope {
+        public:
+            RequestScope(MethodStats& stats, u16 opcode, const MethodInterface& mi);
+            ~RequestScope();
+
+            RequestScope(const RequestScope&) = delete;
+            RequestScope& operator=(const RequestScope&) = delete;
+
+        private:
+            MethodStats& stats;
+            u16 opcode;
+            const MethodInterface& mi;
+            u64 startTick;
+        };
+
+        // Payload bytes sent outside of any request, like the chunks the
+        // streamer pushes. Only counted with ARTIC_COUNT_COPIES.
+        void AddServedBytes(u32 bytes);
+
+        // Builds with ARTIC_COUNT_COPIES also count the payload bytes handlers
+        // copy between buffers, to compare with the response bytes they serve.
+        void AddCopiedBytes(u32 bytes);
+        // Returns the counts since the previous call and clears them
+        void TakeCopyCounts(u64& copiedBytes, u64& servedBytes);
+    }
+}
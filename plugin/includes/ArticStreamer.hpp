@@ -0,0 +1,93 @@
+#pragma once
+#include "3ds.h"
+#include <array>
+
+namespace ArticFunctions {
+    // Pushes file ranges to the client over a side connection on PORT, so a
+    // file that is read whole does not need a request per chunk. The client
+    // grants credits and every chunk takes one. A stream is only read while
+    // it has credits, and a single chunk is held at a time, so a slow client
+    // costs time but no memory.
+    class FileStreamer {
+    public:
+        // Returned by "FSFILE_StreamStart"
+        struct StartInfo {
+            s32 port;
+            u32 streamID;
+        };
+        static_assert(sizeof(StartInfo) == 8);
+
+        // Precedes the data of every chunk on the side connection
+        struct ChunkHeader {
+            u32 streamID;
+            s32 result;
+            u64 offset;
+            u32 size;
+            u32 flags;
+        };
+        static_assert(sizeof(ChunkHeader) == 0x18);
+
+        // Nothing else is sent for the stream after this chunk
+        static constexpr u32 FLAG_LAST = 1 << 0;
+        static constexpr u32 FLAG_CANCELLED = 1 << 1;
+
+        static constexpr int PORT = SERVER_PORT + 11;
+        static constexpr size_t MAX_STREAMS = 4;
+        static constexpr u32 MIN_CHUNK = 0x1000;
+        static constexpr u32 MAX_CHUNK = 0x40000;
+        static constexpr u32 DEFAULT_CHUNK = 0x10000;
+        static constexpr size_t THREAD_STACK_SIZE = 0x1000;
+
+        FileStreamer();
+
+        // Starts listening and the streaming thread if they are not running yet
+        bool Start();
+        // Drops every stream, closes the side connection and joins the thread
+        void Stop();
+
+        // A size of 0 streams until the end of the file. Chunks are only
+        // pushed once the client is connected to PORT.
+        Result Open(Handle handle, u64 offset, u64 size, u32 chunkSize, u32 credits, u32& streamID);
+        Result AddCredits(u32 streamID, u32 credits);
+        // The stream ends with a FLAG_CANCELLED chunk, or right away if no
+        // client is connected. Its handle is no longer used once this returns.
+        Result Cancel(u32 streamID);
+        // Cancels every stream on the handle, called before it is closed
+        void CancelHandle(Handle handle);
+
+    private:
+        struct Stream {
+            bool used = false;
+            bool cancelled = false;
+            // The handle is being read, it must not be closed
+            bool reading = false;
+            u32 id = 0;
+            Handle handle = 0;
+            u64 offset = 0;
+            u64 end = 0;        // 0 until the end of the file
+            u32 chunkSize = 0;
+            u32 credits = 0;
+        };
+
+        static void StreamThread(void* arg);
+        void StreamLoop();
+        bool Accept();
+        bool Send(const void* data, size_t size);
+        // Returns the next stream with something to send, round robin
+        Stream* NextStream();
+        Stream* FindStream(u32 streamID);
+        void CancelLocked(Stream& stream);
+
+        LightLock lock;
+        CondVar wake;
+        Thread thread = nullptr;
+        bool run = false;
+        int listenFD = -1;
+        int clientFD = -1;
+        std::array<Stream, MAX_STREAMS> streams;
+        size_t nextStream = 0;
+        u32 idCounter = 0;
+    };
+
+    extern FileStreamer fileStreamer;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "3ds.h"
+
+namespace ArticFunctions {
+    namespace Trace {
+        // One served request. Handle, offset and size are filled by the
+        // handlers that have them; for opens handle is the returned handle.
+        struct Record {
+            u64 startMicroseconds; // Since the trace was started
+            u64 handle;
+            s64 offset;
+            u32 size;
+            u32 serviceMicroseconds;
+            u32 responseBytes;
+            u16 opcode;
+            u16 reserved;
+        };
+        static_assert(sizeof(Record) == 0x28);
+
+        // Layout of a dumped trace: Header, then for every method in opcode
+        // order its u8 name length and name, then recordCount Records.
+        struct Header {
+            char magic[4]; // "ATRC"
+            u16 version;
+            u16 recordSize;
+            u32 recordCount;
+            // Records overwritten because the ring was full
+            u32 droppedCount;
+            u16 methodCount;
+            u16 reserved;
+        };
+        static_assert(sizeof(Header) == 0x14);
+
+        static constexpr u16 VERSION = 1;
+
+        // What a request worked on, set by its handler through
+        // MethodInterface::SetTraceTarget
+        struct Target {
+            u64 handle;
+            s64 offset;
+            u32 size;
+        };
+
+        // Allocates the ring and starts recording, clears a running trace
+        bool Start();
+        // Stops recording and frees the ring
+        void Stop();
+        bool IsEnabled();
+
+        // Called once per request when it finishes
+        void Add(u16 opcode, const Target& target, u64 startTick, u64 endTick, u32 responseBytes);
+
+        // Moves up to maxCount of the oldest records to out, returns how many.
+        // droppedCount returns the records lost since the previous call.
+        u32 Take(Record* out, u32 maxCount, u32& droppedCount);
+        u32 Count();
+    }
+}
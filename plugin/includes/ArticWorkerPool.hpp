@@ -0,0 +1,85 @@
+#pragma once
+#include "3ds.h"
+#include <array>
+
+namespace ArticFunctions {
+    // Small pool of worker threads. Tasks submitted with the same key (usually
+    // a file, directory or archive handle) run one at a time in submission
+    // order, tasks with different keys run concurrently.
+    class WorkerPool {
+    public:
+        using Task = void(*)(void* arg);
+
+        // Tracks completion of a set of submitted tasks
+        class Group {
+        public:
+            Group();
+            void Wait();
+
+        private:
+            friend class WorkerPool;
+            void Add();
+            void Done();
+
+            LightLock lock;
+            CondVar cond;
+            u32 pending = 0;
+        };
+
+        static constexpr size_t MAX_WORKERS = 4;
+        static constexpr size_t DEFAULT_WORKERS = 3;
+        static constexpr size_t MAX_QUEUED_TASKS = 64;
+        // Workers run whole handlers below the pool loop, and for "#Batch"
+        // below the sub-call dispatch too. The host build tests peak at
+        // 0xFF8 bytes on a worker, so the 0x1000 of the server thread
+        // leaves no margin and the workers get four times that.
+        static constexpr size_t WORKER_STACK_SIZE = 0x4000;
+
+        WorkerPool();
+
+        // Starts the worker threads if they are not running yet
+        bool Start(size_t workerCount);
+        // Finishes the queued tasks and joins the worker threads
+        void Stop();
+
+        // Blocks while the queue is full. If the pool could not be started
+        // the task runs on the calling thread.
+        void Submit(u64 key, Task task, void* arg, Group* group = nullptr);
+
+    private:
+        struct WorkerContext {
+            WorkerPool* pool;
+            size_t index;
+        };
+
+        struct QueuedTask {
+            u64 key;
+            Task task;
+            void* arg;
+            Group* group;
+        };
+
+        static void WorkerThread(void* arg);
+        void WorkerLoop(size_t workerIndex);
+        bool IsKeyBusy(u64 key) const;
+
+        LightLock lock;
+        CondVar taskAvailable;
+        CondVar slotAvailable;
+        std::array<QueuedTask, MAX_QUEUED_TASKS> queue;
+        size_t queuedCount = 0;
+        std::array<Thread, MAX_WORKERS> threads{};
+        std::array<WorkerContext, MAX_WORKERS> contexts{};
+        // Key each worker is currently running, used to keep per key ordering
+        std::array<u64, MAX_WORKERS> runningKeys{};
+        std::array<bool, MAX_WORKERS> running{};
+        size_t workerCount = 0;
+        bool run = false;
+    };
+
+    // Sub-calls of "#Batch" and read-ahead prefetches
+    extern WorkerPool workerPool;
+    // Pipelined requests, see SubmitRequest. Kept apart from workerPool as
+    // requests wait on tasks of that pool.
+    extern WorkerPool requestPool;
+}
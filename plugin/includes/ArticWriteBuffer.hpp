@@ -0,0 +1,132 @@
+#pragma once
+#include "3ds.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace ArticFunctions {
+    // Keeps small writes to save and extdata files in memory and merges the
+    // ones that touch or overlap, so many small FSFILE_Write calls become a
+    // few large FS writes. Pending data is written on flush, close, save
+    // commit, or when the handle runs out of room. Reads of a buffered handle
+    // see the pending data.
+    // In async mode the FS writes of buffered handles are queued to a
+    // writer thread instead, so a write is acknowledged once it is in memory.
+    // A queued write that fails is reported by the next write, read, size
+    // query, flush or close of its handle.
+    class WriteBuffer {
+    public:
+        // Reported by "#WriteBufferStats"
+        struct Counters {
+            u32 writes;         // Writes on buffered handles
+            u32 buffered;       // Writes kept in memory
+            u32 merged;         // Buffered writes that joined a pending range
+            u32 fsWrites;       // FS writes issued to flush pending ranges
+            u64 bufferedBytes;
+            u32 queued;         // Direct writes acknowledged before reaching the FS
+            u32 deferredErrors; // Queued write errors reported by a later call
+        };
+        static_assert(sizeof(Counters) == 0x20);
+
+        static constexpr size_t MAX_HANDLES = 8;
+        static constexpr u32 HANDLE_CAPACITY = WRITE_BUFFER_MEMORY / MAX_HANDLES;
+        // Larger writes gain nothing from merging and go to the FS directly
+        static constexpr u32 MAX_BUFFERED_WRITE = 0x2000;
+        // Writes wait for the writer thread once this much data is queued
+        static constexpr u32 MAX_QUEUED_BYTES = WRITE_BUFFER_MEMORY;
+        static constexpr size_t WRITER_STACK_SIZE = 0x1000;
+
+        WriteBuffer();
+
+        // Files opened for writing in these archives are buffered
+        void AddArchive(FS_Archive archive);
+        bool IsBufferedArchive(FS_Archive archive);
+        // Flushes and unregisters the handles of the archive, returns the
+        // first flush error
+        Result RemoveArchive(FS_Archive archive);
+        // Flushes every handle of the archive, before a save commit
+        Result FlushArchive(FS_Archive archive);
+
+        // Returns false if every slot is taken, the handle writes through then
+        bool Register(Handle handle, FS_Archive archive);
+        bool IsBuffered(Handle handle) const;
+        // Flushes and forgets the handle, before it is closed
+        Result Unregister(Handle handle);
+        // Leaves async mode, flushes every handle and resets the counters
+        void Clear();
+
+        // Starts or stops the writer thread, stopping waits for the queued
+        // writes. Their errors are still reported by the next call.
+        void SetAsync(bool enable);
+
+        // Same as FSFILE_Write. Buffered writes report every byte written,
+        // their errors are returned by the call that flushes them, or by a
+        // later call in async mode.
+        Result Write(Handle handle, u64 offset, const void* data, u32 size, u32 flags, u32& bytesWritten);
+        // Same as FSFILE_Read through the block cache, with pending data on top
+        Result Read(Handle handle, u64 offset, void* out, u32 size, u32& bytesRead);
+        // Same as FSFILE_GetSize, counting pending data past the end
+        Result GetSize(Handle handle, u64& size);
+        // Writes the pending data of the handle to the FS and waits for its
+        // queued writes
+        Result Flush(Handle handle);
+
+        Counters GetCounters();
+
+    private:
+        struct Slot {
+            // Read without the lock to let unbuffered handles through
+            std::atomic<Handle> handle{0};
+            FS_Archive archive = 0;
+            // Pending ranges by offset, never touching each other
+            std::map<u64, std::vector<u8>> ranges;
+            u32 pendingBytes = 0;
+            // Flags of the buffered writes, every pending range is written
+            // with all of them
+            u32 pendingFlags = 0;
+            // Writes of the handle the writer thread has not finished
+            u32 queuedJobs = 0;
+            // First queued write error not reported yet
+            Result error = 0;
+        };
+
+        struct Job {
+            Slot* slot;
+            Handle handle;
+            u64 offset;
+            std::vector<u8> data;
+            u32 flags;
+        };
+
+        Slot* Find(Handle handle);
+        bool Buffer(Slot& slot, u64 offset, const u8* data, u32 size, u32 flags);
+        // Writes or, in async mode, queues the pending ranges
+        Result FlushSlot(Slot& slot);
+        // Waits for the queued writes of the slot, returns their error
+        Result WaitSlot(Slot& slot);
+        // FlushSlot then WaitSlot, returns the earliest error
+        Result DrainSlot(Slot& slot);
+        Result TakeError(Slot& slot);
+        void WaitForRoom(u32 size);
+        void Queue(Slot& slot, u64 offset, std::vector<u8>&& data, u32 flags);
+
+        static void WriterThread(void* arg);
+        void WriterLoop();
+
+        LightLock lock;
+        CondVar jobAvailable;
+        CondVar jobDone;
+        Thread writer = nullptr;
+        bool async = false;
+        bool writerRun = false;
+        std::deque<Job> jobs;
+        u32 queuedBytes = 0;
+        std::array<Slot, MAX_HANDLES> slots;
+        std::vector<FS_Archive> archives;
+        Counters counters{};
+    };
+
+    extern WriteBuffer writeBuffer;
+}
@@ -4,3 +4,9 @@
 #define VERSION_MINOR 0
 #define VERSION_REVISION 1
 #define SERVER_PORT 5543
+#define TRACE_RECORDS 4096
+#define TRACE_AUTO_START 0
+#define ARTIC_COUNT_COPIES 0
+#define READAHEAD_MEMORY 0x100000
+#define BLOCK_CACHE_MEMORY 0x200000
+#define WRITE_BUFFER_MEMORY 0x40000
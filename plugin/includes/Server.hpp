@@ -0,0 +1,14 @@
+#pragma once
+#include "3ds.h"
+
+namespace Server {
+    // Accepts one client at a time on SERVER_PORT and serves it until Stop()
+    // is called. onDisconnect (optional) runs on the server thread after the
+    // destruct functions of every session.
+    void Run(void (*onDisconnect)(void));
+    // Makes Run() return, can be called from any thread
+    void Stop(void);
+    // Drops the current client, returns false if there is none
+    bool Restart(void);
+    bool IsConnected(void);
+}
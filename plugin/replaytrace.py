@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+
+import time
+import socket
+import struct
+import argparse
+
+# Usage:
+# replaytrace.py info "trace.atrc"
+# replaytrace.py replay "trace.atrc" "host" [--port 5543] [--fast] [--record "out.atrc"]
+#
+# Traces are written by the server to sdmc:/ArticBase/traces/<title id>_<index>.atrc
+# (see ArticTrace.hpp for the layout) or returned by "#TraceDump".
+
+TRACE_MAGIC = b"ATRC"
+TRACE_HEADER = struct.Struct("<4sHHIIHH")
+TRACE_RECORD = struct.Struct("<QQqIIIHH")
+
+ARCHIVE_ROMFS = 3
+PATH_EMPTY = 1
+PATH_BINARY = 2
+
+class Trace:
+    def __init__(self, data):
+        magic, version, record_size, count, dropped, method_count, _ = TRACE_HEADER.unpack_from(data, 0)
+        if magic != TRACE_MAGIC or version != 1 or record_size != TRACE_RECORD.size:
+            raise ValueError("Not a supported trace file")
+        offset = TRACE_HEADER.size
+        self.methods = []
+        for _ in range(method_count):
+            length = data[offset]
+            self.methods.append(data[offset + 1:offset + 1 + length].decode("ascii"))
+            offset += 1 + length
+        self.records = [TRACE_RECORD.unpack_from(data, offset + i * TRACE_RECORD.size) for i in range(count)]
+        self.dropped = dropped
+
+    def method(self, opcode):
+        return self.methods[opcode] if opcode < len(self.methods) else "#%d" % opcode
+
+# Artic Base request framing, see ArticProtocolCommon.hpp: a RequestPacket,
+# its parameters, then any big buffer parameter as a DataPacket plus data. The
+# response is a DataPacket followed by the result buffers.
+class ArticConnection:
+    PARAM_S8, PARAM_S16, PARAM_S32, PARAM_S64, PARAM_SMALL_BUFFER, PARAM_BIG_BUFFER = range(6)
+    SMALL_BUFFER_SIZE = 0x1C
+
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port), timeout=10)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.request_id = 0
+
+    def close(self):
+        self.sock.close()
+
+    def _recv(self, size):
+        data = bytearray()
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            if not chunk:
+                raise ConnectionError("Server closed the connection")
+            data += chunk
+        return bytes(data)
+
+    def call(self, method, *params):
+        self.request_id += 1
+        packet = bytearray(struct.pack("<I32sI", self.request_id, method.encode("ascii"), len(params)))
+        big_buffers = []
+        for kind, value in params:
+            if kind == self.PARAM_SMALL_BUFFER and len(value) > self.SMALL_BUFFER_SIZE:
+                kind = self.PARAM_BIG_BUFFER
+            if kind == self.PARAM_BIG_BUFFER:
+                payload = struct.pack("<II", len(big_buffers), len(value))
+                big_buffers.append(value)
+            elif kind == self.PARAM_SMALL_BUFFER:
+                payload = value
+            else:
+                payload = struct.pack("<" + "bhiq"[kind], value)
+            packet += struct.pack("<HH", kind, len(payload)) + payload.ljust(self.SMALL_BUFFER_SIZE, b"\0")
+        for buffer_id, value in enumerate(big_buffers):
+            packet += struct.pack("<IIII", self.request_id, buffer_id, len(value), 0) + value
+        self.sock.sendall(packet)
+
+        request_id, artic_result, method_result, size = struct.unpack("<IiiI", self._recv(16))
+        if request_id != self.request_id or artic_result != 0:
+            raise ConnectionError("%s failed on the server (%d)" % (method, artic_result))
+        data = self._recv(size)
+        buffers = {}
+        offset = 0
+        while offset < len(data):
+            buffer_id, buffer_size = struct.unpack_from("<II", data, offset)
+            buffers[buffer_id] = data[offset + 8:offset + 8 + buffer_size]
+            offset += 8 + buffer_size
+        return method_result & 0xFFFFFFFF, buffers
+
+def s8(v): return (ArticConnection.PARAM_S8, v)
+def s32(v): return (ArticConnection.PARAM_S32, v)
+def s64(v): return (ArticConnection.PARAM_S64, v)
+def fs_path(path_type, data): return (ArticConnection.PARAM_SMALL_BUFFER, struct.pack("<II", path_type, len(data)) + data)
+
+# Methods without parameters are replayed as they are
+NO_PARAMETERS = {"Process_GetTitleID", "Process_GetProductInfo", "Process_GetExheader", "Process_ReadIcon",
+                 "Process_ReadBanner", "Process_ReadLogo", "#GetMethodOpcodes", "#Stats"}
+
+class Replayer:
+    def __init__(self, conn, trace):
+        self.conn = conn
+        self.trace = trace
+        self.handles = {}
+        self.skipped = {}
+        self.latencies = {}
+        self.bytes_read = 0
+
+    # Returns the request to send for a record, or None if it cannot be replayed
+    def build(self, name, handle, offset, size):
+        if name in NO_PARAMETERS:
+            return ()
+        if name == "Process_ReadCode":
+            return (s32(offset), s32(size))
+        if name == "FSUSER_OpenFileDirectly":
+            # Only the application RomFS can be reopened, other paths are not traced
+            if offset != ARCHIVE_ROMFS or size != 0:
+                return None
+            return (s32(ARCHIVE_ROMFS), fs_path(PATH_EMPTY, b"\0"), fs_path(PATH_BINARY, bytes(12)), s32(1), s32(0))
+        if handle not in self.handles:
+            return None
+        live = self.handles[handle]
+        if name == "FSFILE_Read":
+            return (s32(live), s64(offset), s32(size))
+        if name in ("FSFILE_GetSize", "FSFILE_Close"):
+            return (s32(live),)
+        return None
+
+    def run(self, fast):
+        start = time.perf_counter()
+        for start_us, handle, offset, size, service_us, response_bytes, opcode, _ in self.trace.records:
+            name = self.trace.method(opcode)
+            params = self.build(name, handle, offset, size)
+            if params is None:
+                self.skipped[name] = self.skipped.get(name, 0) + 1
+                continue
+            if not fast:
+                delay = start + start_us / 1e6 - time.perf_counter()
+                if delay > 0:
+                    time.sleep(delay)
+
+            sent = time.perf_counter()
+            result, buffers = self.conn.call(name, *params)
+            self.latencies.setdefault(name, []).append(time.perf_counter() - sent)
+
+            if name == "FSUSER_OpenFileDirectly" and result == 0:
+                self.handles[handle] = struct.unpack("<I", buffers[0])[0]
+            elif name == "FSFILE_Close":
+                self.handles.pop(handle, None)
+            if name == "FSFILE_Read":
+                self.bytes_read += len(buffers.get(0, b""))
+        return time.perf_counter() - start
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+def print_info(trace):
+    print("%d requests, %d dropped" % (len(trace.records), trace.dropped))
+    if not trace.records:
+        return
+    duration = (trace.records[-1][0] + trace.records[-1][4]) / 1e6
+    print("Duration: %.2fs" % duration)
+    per_method = {}
+    for record in trace.records:
+        per_method.setdefault(trace.method(record[6]), []).append(record)
+    print("%-32s %8s %10s %10s %12s" % ("Method", "Count", "Avg (ms)", "P99 (ms)", "Bytes out"))
+    for name, records in sorted(per_method.items(), key=lambda item: -len(item[1])):
+        service = [r[4] / 1000 for r in records]
+        print("%-32s %8d %10.3f %10.3f %12d" % (name, len(records), sum(service) / len(service),
+                                                percentile(service, 0.99), sum(r[5] for r in records)))
+
+def replay(args, trace):
+    conn = ArticConnection(args.host, args.port)
+    if args.record:
+        conn.call("#TraceStart")
+    replayer = Replayer(conn, trace)
+    elapsed = replayer.run(args.fast)
+    if args.record:
+        _, buffers = conn.call("#TraceDump", s8(0))
+        with open(args.record, "wb") as f:
+            f.write(buffers[0])
+    conn.close()
+
+    replayed = sum(len(v) for v in replayer.latencies.values())
+    print("Replayed %d requests in %.3fs (%s timing)" % (replayed, elapsed, "fast" if args.fast else "original"))
+    print("Read %.2f MB, %.2f MB/s" % (replayer.bytes_read / 1e6, replayer.bytes_read / 1e6 / elapsed if elapsed else 0))
+    print("%-32s %8s %10s %10s" % ("Method", "Count", "Avg (ms)", "P99 (ms)"))
+    for name, values in sorted(replayer.latencies.items(), key=lambda item: -len(item[1])):
+        values = [v * 1000 for v in values]
+        print("%-32s %8d %10.3f %10.3f" % (name, len(values), sum(values) / len(values), percentile(values, 0.99)))
+    for name, count in sorted(replayer.skipped.items()):
+        print("Skipped %d %s" % (count, name))
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Inspect and replay Artic Base request traces")
+    sub = parser.add_subparsers(dest="command", required=True)
+    info_parser = sub.add_parser("info")
+    info_parser.add_argument("trace")
+    replay_parser = sub.add_parser("replay")
+    replay_parser.add_argument("trace")
+    replay_parser.add_argument("host")
+    replay_parser.add_argument("--port", type=int, default=5543)
+    replay_parser.add_argument("--fast", action="store_true", help="Send requests as fast as possible")
+    replay_parser.add_argument("--record", help="Trace the replay on the server and save it here")
+    args = parser.parse_args()
+
+    with open(args.trace, "rb") as f:
+        trace = Trace(f.read())
+    if args.command == "info":
+        print_info(trace)
+    else:
+        replay(args, trace)
@@ -0,0 +1,255 @@
+#include "ArticBlockCache.hpp"
+#include "ArticReadAhead.hpp"
+#include "ArticStats.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+namespace ArticFunctions {
+
+    BlockCache blockCache;
+
+    BlockCache::BlockCache() {
+        LightLock_Init(&lock);
+    }
+
+    void BlockCache::Register(Handle handle, s32 archiveID, const FS_Path& archivePath, const FS_Path& filePath) {
+        if (BLOCK_COUNT == 0) return;
+
+        std::vector<u8> identity(sizeof(s32) + 2 * sizeof(u32) + archivePath.size + 2 * sizeof(u32) + filePath.size);
+        u8* out = identity.data();
+        auto append = [&out](const void* data, size_t size) {
+            memcpy(out, data, size);
+            out += size;
+        };
+        append(&archiveID, sizeof(s32));
+        for (const FS_Path* path : {&archivePath, &filePath}) {
+            u32 type = path->type, size = path->size;
+            append(&type, sizeof(u32));
+            append(&size, sizeof(u32));
+            append(path->data, path->size);
+        }
+
+        CTRPluginFramework::Lock l(lock);
+        if (!memory) {
+            memory = reinterpret_cast<u8*>(malloc(BLOCK_COUNT * BLOCK_SIZE));
+            blocks = reinterpret_cast<Block*>(malloc(BLOCK_COUNT * sizeof(Block)));
+            if (!memory || !blocks) {
+                free(memory);
+                free(blocks);
+                memory = nullptr;
+                blocks = nullptr;
+                return;
+            }
+            for (u32 i = 0; i < BLOCK_COUNT; i++) {
+                PushFront(i, Segment::FREE);
+            }
+        }
+
+        auto it = std::find(files.begin(), files.end(), identity);
+        u32 fileID = static_cast<u32>(it - files.begin());
+        if (it == files.end()) {
+            files.push_back(std::move(identity));
+        }
+        handleFiles[handle] = fileID;
+    }
+
+    void BlockCache::Unregister(Handle handle) {
+        CTRPluginFramework::Lock l(lock);
+        handleFiles.erase(handle);
+    }
+
+    void BlockCache::Clear() {
+        CTRPluginFramework::Lock l(lock);
+        free(memory);
+        free(blocks);
+        memory = nullptr;
+        blocks = nullptr;
+        freeList = probation = protectedList = List();
+        index.clear();
+        handleFiles.clear();
+        files.clear();
+        counters = {};
+    }
+
+    BlockCache::Counters BlockCache::GetCounters() {
+        CTRPluginFramework::Lock l(lock);
+        return counters;
+    }
+
+    Result BlockCache::Read(Handle handle, u64 offset, void* out, u32 size, u32& bytesRead) {
+        u8* dst = reinterpret_cast<u8*>(out);
+        u32 fileID = 0;
+        bool registered = false;
+        bool hit = false;
+        {
+            CTRPluginFramework::Lock l(lock);
+            auto it = handleFiles.find(handle);
+            if (it != handleFiles.end()) {
+                registered = true;
+                fileID = it->second;
+                hit = Lookup(fileID, offset, dst, size, bytesRead);
+            }
+        }
+        if (!registered) {
+            return readAhead.Read(handle, offset, out, size, bytesRead);
+        }
+
+        u64 start = offset & ~static_cast<u64>(BLOCK_SIZE - 1);
+        if (hit) {
+            // Misses go through the read-ahead in whole blocks, hand it the
+            // blocks of the hit too so it still sees the stream as sequential
+            u64 hitEnd = (offset + bytesRead + BLOCK_SIZE - 1) & ~static_cast<u64>(BLOCK_SIZE - 1);
+            readAhead.NoteRead(handle, start, static_cast<u32>(hitEnd - start));
+            return 0;
+        }
+
+
+        u64 end = (offset + size + BLOCK_SIZE - 1) & ~static_cast<u64>(BLOCK_SIZE - 1);
+        u8* fill = nullptr;
+        if (end - start <= MAX_FILL_SIZE && (start != offset || end != offset + size)) {
+            fill = reinterpret_cast<u8*>(malloc(end - start));
+        }
+
+        Result res;
+        if (fill) {
+            u32 fillRead = 0;
+            u32 fillSize = static_cast<u32>(end - start);
+            u32 skip = static_cast<u32>(offset - start);
+            res = readAhead.Read(handle, start, fill, fillSize, fillRead);
+            bytesRead = 0;
+            if (R_SUCCEEDED(res)) {
+                if (fillRead > skip) {
+                    bytesRead = std::min(size, fillRead - skip);
+                    memcpy(dst, fill + skip, bytesRead);
+                    Stats::AddCopiedBytes(bytesRead);
+                }
+                CTRPluginFramework::Lock l(lock);
+                Insert(fileID, start, fill, fillRead, fillRead < fillSize);
+            }
+            free(fill);
+        } else {
+            res = readAhead.Read(handle, offset, out, size, bytesRead);
+            if (R_SUCCEEDED(res)) {
+                CTRPluginFramework::Lock l(lock);
+                Insert(fileID, offset, dst, bytesRead, bytesRead < size);
+            }
+        }
+        return res;
+    }
+
+    bool BlockCache::Lookup(u32 fileID, u64 offset, u8* out, u32 size, u32& bytesRead) {
+        if (!memory) return false;
+
+        // Check every block first, only whole hits are served from memory
+        u64 first = offset / BLOCK_SIZE;
+        u64 last = (offset + std::max<u32>(size, 1) - 1) / BLOCK_SIZE;
+        u64 available = 0;
+        for (u64 b = first; b <= last; b++) {
+            auto it = index.find(MakeKey(fileID, b));
+            if (it == index.end()) {
+                counters.misses++;
+                return false;
+            }
+            available = b * BLOCK_SIZE + blocks[it->second].valid;
+            // A short block is the end of the file, nothing follows it
+            if (blocks[it->second].valid < BLOCK_SIZE) break;
+        }
+
+        bytesRead = available > offset ? static_cast<u32>(std::min<u64>(size, available - offset)) : 0;
+        u32 copied = 0;
+        for (u64 b = first; copied < bytesRead; b++) {
+            u32 i = index[MakeKey(fileID, b)];
+            u32 blockOffset = static_cast<u32>((offset + copied) - b * BLOCK_SIZE);
+            u32 count = std::min(bytesRead - copied, blocks[i].valid - blockOffset);
+            memcpy(out + copied, memory + static_cast<size_t>(i) * BLOCK_SIZE + blockOffset, count);
+            copied += count;
+            Touch(i);
+        }
+        Stats::AddCopiedBytes(bytesRead);
+        counters.hits++;
+        counters.hitBytes += bytesRead;
+        return true;
+    }
+
+    void BlockCache::Insert(u32 fileID, u64 offset, const u8* data, u32 size, bool eof) {
+        if (!memory) return;
+
+        // Whole blocks inside the data, and the last short block at the end of the file
+        u64 b = (offset + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        u64 dataEnd = offset + size;
+        for (; b * BLOCK_SIZE < dataEnd; b++) {
+            u32 valid = static_cast<u32>(std::min<u64>(BLOCK_SIZE, dataEnd - b * BLOCK_SIZE));
+            if (valid < BLOCK_SIZE && !eof) break;
+
+            u64 key = MakeKey(fileID, b);
+            if (index.count(key)) continue;
+            u32 i = AllocateBlock();
+            blocks[i].key = key;
+            blocks[i].valid = valid;
+            memcpy(memory + static_cast<size_t>(i) * BLOCK_SIZE, data + (b * BLOCK_SIZE - offset), valid);
+            Stats::AddCopiedBytes(valid);
+            index[key] = i;
+            PushFront(i, Segment::PROBATION);
+            counters.insertions++;
+        }
+    }
+
+    u32 BlockCache::AllocateBlock() {
+        u32 i = freeList.tail;
+        if (i == NONE) {
+            // Probation is only empty if everything was reread, then the
+            // protected segment has to give its oldest block
+            i = probation.tail != NONE ? probation.tail : protectedList.tail;
+            index.erase(blocks[i].key);
+            counters.evictions++;
+        }
+        Unlink(i);
+        return i;
+    }
+
+    void BlockCache::Touch(u32 i) {
+        Unlink(i);
+        PushFront(i, Segment::PROTECTED);
+        if (protectedList.count > PROTECTED_COUNT) {
+            u32 demoted = protectedList.tail;
+            Unlink(demoted);
+            PushFront(demoted, Segment::PROBATION);
+        }
+    }
+
+    BlockCache::List& BlockCache::ListOf(Segment segment) {
+        switch (segment)
+        {
+        case Segment::PROBATION:
+            return probation;
+        case Segment::PROTECTED:
+            return protectedList;
+        default:
+            return freeList;
+        }
+    }
+
+    void BlockCache::Unlink(u32 i) {
+        Block& block = blocks[i];
+        List& list = ListOf(block.segment);
+        if (block.prev != NONE) blocks[block.prev].next = block.next;
+        else list.head = block.next;
+        if (block.next != NONE) blocks[block.next].prev = block.prev;
+        else list.tail = block.prev;
+        list.count--;
+    }
+
+    void BlockCache::PushFront(u32 i, Segment segment) {
+        Block& block = blocks[i];
+        List& list = ListOf(segment);
+        block.segment = segment;
+        block.prev = NONE;
+        block.next = list.head;
+        if (list.head != NONE) blocks[list.head].prev = i;
+        else list.tail = i;
+        list.head = i;
+        list.count++;
+    }
+}
@@ -0,0 +1,241 @@
+#include "ArticCompression.hpp"
+#include "ArticStats.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+namespace ArticFunctions {
+    namespace Compression {
+
+        static constexpr u32 HASH_BITS = 12;
+        static constexpr size_t MIN_MATCH = 4;
+        // LZ4 block format: the last 5 bytes are always literals and the last
+        // match starts at least 12 bytes before the end
+        static constexpr size_t LAST_LITERALS = 5;
+        static constexpr size_t MF_LIMIT = 12;
+
+        static CTRPluginFramework::Mutex stateMutex;
+        static bool enabled = false;
+        static float linkBytesPerTick = 0.f;
+        // Running averages over the compressed blocks
+        static float ticksPerByte = 0.f;
+        static float savedFraction = 1.f;
+        static u32 blocksSinceProbe = 0;
+        static Counters counters{};
+
+        static u32 Read32(const u8* p) {
+            u32 v;
+            memcpy(&v, p, sizeof(u32));
+            return v;
+        }
+
+        static u32 Hash(u32 sequence) {
+            return (sequence * 2654435761U) >> (32 - HASH_BITS);
+        }
+
+        static u8* WriteLength(u8* op, size_t length) {
+            for (; length >= 255; length -= 255) {
+                *op++ = 255;
+            }
+            *op++ = static_cast<u8>(length);
+            return op;
+        }
+
+        // Returns the compressed size, or 0 if it does not fit in dstCapacity
+        static size_t CompressBlock(const u8* src, size_t srcSize, u8* dst, size_t dstCapacity, u16* table) {
+            const u8* ip = src;
+            const u8* anchor = src;
+            const u8* end = src + srcSize;
+            u8* op = dst;
+            u8* opEnd = dst + dstCapacity;
+
+            memset(table, 0, sizeof(u16) << HASH_BITS);
+            if (srcSize > MF_LIMIT) {
+                const u8* matchLimit = end - MF_LIMIT;
+                ip++;
+                while (ip < matchLimit) {
+                    u32 sequence = Read32(ip);
+                    u32 h = Hash(sequence);
+                    const u8* ref = src + table[h];
+                    table[h] = static_cast<u16>(ip - src);
+                    if (Read32(ref) != sequence || ref >= ip) {
+                        // Skip faster through data that does not match
+                        ip += 1 + ((ip - anchor) >> 6);
+                        continue;
+                    }
+
+                    while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                        ip--;
+                        ref--;
+                    }
+                    const u8* matchEnd = ip + MIN_MATCH;
+                    const u8* refEnd = ref + MIN_MATCH;
+                    while (matchEnd < end - LAST_LITERALS && *matchEnd == *refEnd) {
+                        matchEnd++;
+                        refEnd++;
+                    }
+
+                    size_t literals = ip - anchor;
+                    size_t matchLength = matchEnd - ip - MIN_MATCH;
+                    if (static_cast<size_t>(opEnd - op) < 1 + literals + literals / 255 + 1 + 2 + matchLength / 255 + 1) {
+                        return 0;
+                    }
+                    u8* token = op++;
+                    *token = static_cast<u8>((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(matchLength, 15));
+                    if (literals >= 15) op = WriteLength(op, literals - 15);
+                    memcpy(op, anchor, literals);
+                    op += literals;
+                    u16 offset = static_cast<u16>(ip - ref);
+                    memcpy(op, &offset, sizeof(u16));
+                    op += sizeof(u16);
+                    if (matchLength >= 15) op = WriteLength(op, matchLength - 15);
+
+                    ip = matchEnd;
+                    anchor = ip;
+                }
+            }
+
+            size_t literals = end - anchor;
+            if (static_cast<size_t>(opEnd - op) < 1 + literals + literals / 255 + 1) {
+                return 0;
+            }
+            u8* token = op++;
+            *token = static_cast<u8>(std::min<size_t>(literals, 15) << 4);
+            if (literals >= 15) op = WriteLength(op, literals - 15);
+            memcpy(op, anchor, literals);
+            op += literals;
+            return op - dst;
+        }
+
+        void Enable(bool enable, u32 linkKBps) {
+            CTRPluginFramework::Lock l(stateMutex);
+            enabled = enable;
+            if (linkKBps == 0) linkKBps = DEFAULT_LINK_KBPS;
+            linkBytesPerTick = (linkKBps * 1000.f) / SYSCLOCK_ARM11;
+        }
+
+        bool IsEnabled() {
+            CTRPluginFramework::Lock l(stateMutex);
+            return enabled;
+        }
+
+        void Reset() {
+            CTRPluginFramework::Lock l(stateMutex);
+            enabled = false;
+            ticksPerByte = 0.f;
+            savedFraction = 1.f;
+            blocksSinceProbe = 0;
+            counters = {};
+        }
+
+        Counters GetCounters() {
+            CTRPluginFramework::Lock l(stateMutex);
+            return counters;
+        }
+
+        size_t ReserveSize(size_t size) {
+            return size + ((size + BLOCK_SIZE - 1) / BLOCK_SIZE) * sizeof(u32);
+        }
+
+        // Compressing a block pays if it takes less time than sending the
+        // bytes it saves. The time per byte is wall time, so it also grows
+        // when other threads keep the CPU busy.
+        static bool ShouldTry() {
+            CTRPluginFramework::Lock l(stateMutex);
+            if (ticksPerByte == 0.f || ticksPerByte * linkBytesPerTick < savedFraction) {
+                return true;
+            }
+            if (++blocksSinceProbe >= PROBE_INTERVAL) {
+                blocksSinceProbe = 0;
+                return true;
+            }
+            counters.skippedBlocks++;
+            return false;
+        }
+
+        static void Account(u32 rawSize, u32 storedSize, u64 ticks, bool compressed) {
+            CTRPluginFramework::Lock l(stateMutex);
+            float blockTicksPerByte = static_cast<float>(ticks) / rawSize;
+            float blockSaved = 1.f - static_cast<float>(storedSize) / rawSize;
+            ticksPerByte = ticksPerByte == 0.f ? blockTicksPerByte : ticksPerByte * 0.875f + blockTicksPerByte * 0.125f;
+            savedFraction = savedFraction * 0.875f + blockSaved * 0.125f;
+            if (compressed) counters.compressedBlocks++;
+            else counters.rawBlocks++;
+            counters.microseconds += ticks / (SYSCLOCK_ARM11 / 1000000);
+        }
+
+        size_t Compress(u8* data, size_t size, Info& info) {
+            if (size == 0) return 0;
+
+            u32 blockCount = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            u8* scratch = reinterpret_cast<u8*>(malloc(BLOCK_SIZE + (sizeof(u16) << HASH_BITS)));
+            if (!scratch) return 0;
+            u16* table = reinterpret_cast<u16*>(scratch + BLOCK_SIZE);
+            // The block sizes are kept in the reserved space after the data
+            // until every block is written
+            u8* sizes = data + size;
+
+            // Compressed blocks are never larger than their input, so every
+            // block is written at or before the place it is read from
+            u8* out = data;
+            bool anyCompressed = false;
+            // The data is overwritten once a block is compressed, so the first
+            // one has to save more than the size table costs. Later blocks
+            // never grow, which keeps the response smaller than the raw data.
+            u32 tableSize = blockCount * sizeof(u32);
+            for (u32 i = 0; i < blockCount; i++) {
+                u8* block = data + static_cast<size_t>(i) * BLOCK_SIZE;
+                u32 rawSize = std::min<size_t>(BLOCK_SIZE, size - static_cast<size_t>(i) * BLOCK_SIZE);
+                u32 stored = 0;
+                if (rawSize > SAMPLE_SIZE && ShouldTry()) {
+                    u64 start = svcGetSystemTick();
+                    u32 sampleSize = CompressBlock(block, SAMPLE_SIZE, scratch, SAMPLE_SIZE * MIN_RATIO_16 / 16, table);
+                    u32 capacity = rawSize * MIN_RATIO_16 / 16;
+                    if (!anyCompressed) {
+                        capacity = rawSize > tableSize ? std::min(capacity, rawSize - tableSize - 1) : 0;
+                    }
+                    if (sampleSize != 0 && capacity != 0) {
+                        stored = CompressBlock(block, rawSize, scratch, capacity, table);
+                    }
+                    Account(rawSize, stored ? stored : rawSize, svcGetSystemTick() - start, stored != 0);
+                }
+
+                u32 entry;
+                if (stored != 0) {
+                    memcpy(out, scratch, stored);
+                    Stats::AddCopiedBytes(stored);
+                    entry = stored;
+                    anyCompressed = true;
+                } else {
+                    // Only moves once an earlier block was compressed
+                    if (out != block) {
+                        memmove(out, block, rawSize);
+                        Stats::AddCopiedBytes(rawSize);
+                    }
+                    stored = rawSize;
+                    entry = rawSize | RAW_BLOCK;
+                }
+                memcpy(sizes + i * sizeof(u32), &entry, sizeof(u32));
+                out += stored;
+            }
+            free(scratch);
+
+            if (!anyCompressed) {
+                return 0;
+            }
+            memmove(out, sizes, tableSize);
+            out += tableSize;
+
+            info.rawSize = size;
+            info.blockSize = BLOCK_SIZE;
+            size_t sentSize = out - data;
+            {
+                CTRPluginFramework::Lock l(stateMutex);
+                counters.rawBytes += size;
+                counters.sentBytes += sentSize;
+            }
+            return sentSize;
+        }
+    }
+}
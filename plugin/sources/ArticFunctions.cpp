@@ -3,6 +3,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <algorithm>
 
 #include "ArticFunctions.hpp"
 #include "ArticFunctionsPrivate.hpp"
@@ -10,6 +11,18 @@
 #include "amExtension.hpp"
 #include "fsExtension.hpp"
 #include "hidExtension.hpp"
+#include "ArticWorkerPool.hpp"
+#include "ArticStats.hpp"
+#include "ArticTrace.hpp"
+#include "ArticReadAhead.hpp"
+#include "ArticBlockCache.hpp"
+#include "ArticCompression.hpp"
+#include "ArticStreamer.hpp"
+#include "ArticHandleCache.hpp"
+#include "ArticHandleTable.hpp"
+#include "ArticWriteBuffer.hpp"
+#include "ArticNegativeCache.hpp"
+#include "ArticMemo.hpp"
 #include "CTRPluginFramework/CTRPluginFramework.hpp"
 #include "CTRPluginFramework/Clock.hpp"
 
@@ -18,18 +31,187 @@ extern bool isControllerMode;
 namespace ArticFunctions {
 
     ExHeader_Info lastAppExheader;
-    std::map<u64, HandleType> openHandles;
     CTRPluginFramework::Mutex amMutex;
     CTRPluginFramework::Mutex cfgMutex;
 
-    void Process_GetTitleID(ArticProtocolServer::MethodInterface& mi) {
+    // Handles in the table are closed when the client goes away, unless shared
+    // (the handle cache closes those)
+    static void AddOpenHandle(u64 handle, HandleType type, FS_Archive archive = 0, u32 pathHash = 0, bool shared = false) {
+        if (!handleTable.Add(handle, type, shared, archive, pathHash)) {
+            logger.Error("HandleTable: Full, 0x%llX is not tracked", (unsigned long long)handle);
+        }
+    }
+
+    static void RemoveOpenHandle(u64 handle) {
+        handleTable.Remove(handle);
+    }
+
+    // Files of the running application (RomFS, code, ExeFS and update RomFS)
+    // cannot change while the server runs, so their reads can be kept in memory
+    static bool IsReadOnlyContent(s32 archiveID, const FS_Path& filePath, s32 openFlags) {
+        if (archiveID != ARCHIVE_ROMFS || openFlags != FS_OPEN_READ) return false;
+        if (filePath.type != PATH_BINARY || filePath.size < sizeof(u32)) return false;
+        u32 contentType;
+        memcpy(&contentType, filePath.data, sizeof(u32));
+        return contentType <= 2 || contentType == 5;
+    }
+
+    // Read-only archives are the RomFS of the application (see
+    // FSUSER_OpenArchive_), which has no archive path, so the file path
+    // identifies a file opened through any of them.
+    static void RegisterReadOnlyFile(Handle handle, const FS_Path& filePath) {
+        static const FS_Path romfsPath = {PATH_EMPTY, 1, ""};
+        readAhead.Register(handle);
+        blockCache.Register(handle, ARCHIVE_ROMFS, romfsPath, filePath);
+    }
+
+    // Takes a reference on the handle of an earlier open of the same file.
+    // The size is only looked up if it was not known and wantSize is set.
+    static bool AcquireCachedFile(const HandleCache::Key& key, Handle& out, s64& size, bool wantSize) {
+        if (!handleCache.Acquire(key, out, size)) return false;
+        u64 fileSize;
+        if (size == HandleCache::UNKNOWN_SIZE && wantSize && R_SUCCEEDED(FSFILE_GetSize(out, &fileSize))) {
+            size = static_cast<s64>(fileSize);
+        }
+        return true;
+    }
+
+    // A file just opened is shared through the handle cache if it has a key,
+    // otherwise the server closes it with the handle table
+    static void AddOpenedFile(const HandleCache::Key* key, Handle handle, s64 size, const FS_Path& filePath, FS_Archive archive = 0) {
+        bool shared = key && handleCache.Insert(*key, handle, size, archive);
+        AddOpenHandle((u64)handle, HandleType::FILE, archive, HandleTable::HashPath(filePath), shared);
+    }
+
+    static Result CloseFile(Handle handle) {
+        if (handleCache.Release(handle)) {
+            return 0;
+        }
+        fileStreamer.CancelHandle(handle);
+        blockCache.Unregister(handle);
+        readAhead.Unregister(handle);
+        // Buffered writes that fail now are reported by the close. Other
+        // handles already dropped the memoized responses when written.
+        bool buffered = writeBuffer.IsBuffered(handle);
+        Result flushRes = writeBuffer.Unregister(handle);
+        if (buffered) Memo::Invalidate(Memo::UNTIL_WRITE);
+        Result res = FSFILE_Close(handle);
+        RemoveOpenHandle((u64)handle);
+        return R_FAILED(flushRes) ? flushRes : res;
+    }
+
+    // Identical FSUSER_OpenArchive calls share one FS_Archive, which is only
+    // closed when its last user closes it
+    namespace SharedArchives {
+        // Reported by "#ArchiveStats"
+        struct Counters {
+            u32 opens;      // Archives opened on the FS
+            u32 absorbed;   // Opens served by an archive already open
+            u32 open;       // Archives currently open
+        };
+        static_assert(sizeof(Counters) == 0xC);
+
+        struct Entry {
+            std::vector<u8> key;
+            FS_Archive archive;
+            u32 references;
+        };
+
+        static CTRPluginFramework::Mutex mutex;
+        static std::vector<Entry> entries;
+        static Counters counters{};
+
+        static std::vector<u8> MakeKey(s32 archiveID, const FS_Path& path) {
+            u32 type = path.type, size = path.size;
+            std::vector<u8> key(sizeof(s32) + 2 * sizeof(u32) + size);
+            memcpy(key.data(), &archiveID, sizeof(s32));
+            memcpy(key.data() + sizeof(s32), &type, sizeof(u32));
+            memcpy(key.data() + sizeof(s32) + sizeof(u32), &size, sizeof(u32));
+            memcpy(key.data() + sizeof(s32) + 2 * sizeof(u32), path.data, size);
+            return key;
+        }
+
+        static bool Acquire(const std::vector<u8>& key, FS_Archive& archive) {
+            CTRPluginFramework::Lock l(mutex);
+            for (Entry& entry : entries) {
+                if (entry.key != key) continue;
+                entry.references++;
+                archive = entry.archive;
+                counters.absorbed++;
+                return true;
+            }
+            return false;
+        }
+
+        static void Add(const std::vector<u8>& key, FS_Archive archive) {
+            CTRPluginFramework::Lock l(mutex);
+            entries.push_back({key, archive, 1});
+            counters.opens++;
+            counters.open++;
+        }
+
+        // Returns true if the archive is still used and must stay open
+        static bool Release(FS_Archive archive) {
+            CTRPluginFramework::Lock l(mutex);
+            for (auto it = entries.begin(); it != entries.end(); it++) {
+                if (it->archive != archive) continue;
+                if (--it->references != 0) return true;
+                entries.erase(it);
+                counters.open--;
+                return false;
+            }
+            return false;
+        }
+
+        // The archives themselves are closed with the handle table
+        static void Clear() {
+            CTRPluginFramework::Lock l(mutex);
+            entries.clear();
+            counters = {};
+        }
+
+        static Counters GetCounters() {
+            CTRPluginFramework::Lock l(mutex);
+            return counters;
+        }
+    }
+
+    // Result buffer 0 for up to size bytes of file data, with room to compress
+    // them in place if the session enabled compression
+    static ArticProtocolCommon::Buffer* ReserveDataBuffer(MethodInterface& mi, size_t size, bool& compress) {
+        compress = Compression::IsEnabled();
+        return mi.ReserveResultBuffer(0, compress ? Compression::ReserveSize(size) : size);
+    }
+
+    // Sets the final size of a buffer from ReserveDataBuffer, compressing the
+    // data first when it pays off. Compressed data also gets an info buffer.
+    static bool FinishDataBuffer(MethodInterface& mi, ArticProtocolCommon::Buffer* buf, u32 dataSize, bool compress) {
+        Compression::Info info;
+        size_t compressedSize = compress ? Compression::Compress(reinterpret_cast<u8*>(buf->data), dataSize, info) : 0;
+        if (compressedSize == 0) {
+            mi.ResizeLastResultBuffer(buf, dataSize);
+            return true;
+        }
+
+        mi.ResizeLastResultBuffer(buf, compressedSize);
+        ArticProtocolCommon::Buffer* info_buf = mi.ReserveResultBuffer(Compression::INFO_BUFFER_ID, sizeof(info));
+        if (!info_buf) {
+            return false;
+        }
+        memcpy(info_buf->data, &info, sizeof(info));
+        return true;
+    }
+
+    void Process_GetTitleID(MethodInterface& mi) {
         bool good = true;
 
         if (good) good = mi.FinishInputParameters();
 
         if (!good) return;
 
-        ArticProtocolCommon::Buffer* tid_buffer = mi.ReserveResultBuffer(0, sizeof(u64));
+        if (Memo::Replay(mi)) return;
+
+        ArticProtocolCommon::Buffer* tid_buffer = Memo::ReserveResultBuffer(mi, 0, sizeof(u64));
         if (!tid_buffer) {
             return;
         }
@@ -38,17 +220,19 @@ namespace ArticFunctions {
 
         memcpy(tid_buffer->data, &out, sizeof(s64));
 
-        mi.FinishGood(0);
+        Memo::FinishGood(mi, 0);
     }
 
-    void Process_GetProductInfo(ArticProtocolServer::MethodInterface& mi) {
+    void Process_GetProductInfo(MethodInterface& mi) {
         bool good = true;
 
         if (good) good = mi.FinishInputParameters();
 
         if (!good) return;
 
-        ArticProtocolCommon::Buffer* prod_code_buffer = mi.ReserveResultBuffer(0, sizeof(FS_ProductInfo));
+        if (Memo::Replay(mi)) return;
+
+        ArticProtocolCommon::Buffer* prod_code_buffer = Memo::ReserveResultBuffer(mi, 0, sizeof(FS_ProductInfo));
         if (!prod_code_buffer) {
             return;
         }
@@ -62,26 +246,29 @@ namespace ArticFunctions {
             return;
         }
 
-        mi.FinishGood(0);
+        Memo::FinishGood(mi, 0);
     }
 
-    void Process_GetExheader(ArticProtocolServer::MethodInterface& mi) {
+    void Process_GetExheader(MethodInterface& mi) {
         bool good = true;
 
         if (good) good = mi.FinishInputParameters();
 
         if (!good) return;
 
-        ArticProtocolCommon::Buffer* exheader_buf = mi.ReserveResultBuffer(0, sizeof(lastAppExheader));
+        if (Memo::Replay(mi)) return;
+
+        ArticProtocolCommon::Buffer* exheader_buf = Memo::ReserveResultBuffer(mi, 0, sizeof(lastAppExheader));
         if (!exheader_buf) {
             return;
         }
         memcpy(exheader_buf->data, &lastAppExheader, exheader_buf->bufferSize);
+        Stats::AddCopiedBytes(exheader_buf->bufferSize);
 
-        mi.FinishGood(0);
+        Memo::FinishGood(mi, 0);
     }
 
-    void Process_ReadCode(ArticProtocolServer::MethodInterface& mi) {
+    void Process_ReadCode(MethodInterface& mi) {
         bool good = true;
         s32 offset, size;
 
@@ -97,263 +284,874 @@ namespace ArticFunctions {
         }
         u8* start_addr = reinterpret_cast<u8*>(out);
 
-        ArticProtocolCommon::Buffer* code_buf = mi.ReserveResultBuffer(0, size);
+        bool compress;
+        ArticProtocolCommon::Buffer* code_buf = ReserveDataBuffer(mi, size, compress);
         if (!code_buf) {
             return;
         }
         memcpy(code_buf->data, start_addr + offset, size);
+        Stats::AddCopiedBytes(size);
+        mi.SetTraceTarget(0, offset, size);
+        if (!FinishDataBuffer(mi, code_buf, size, compress)) {
+            return;
+        }
 
         mi.FinishGood(0);
     }
 
-    static void _Process_ReadExefs(ArticProtocolServer::MethodInterface& mi, const char* section) {
-        bool good = true;
-
-        if (good) good = mi.FinishInputParameters();
-
-        if (!good) return;
-
+    // Opens an ExeFS section of the application, like "icon" or "banner".
+    // The FS only has the sections by name, not the ExeFS as one file. They
+    // cannot change while the title runs, so the handle is shared through the
+    // handle cache and its reads go through the block cache: a section is
+    // opened and read from the FS once per session.
+    static Result OpenExefsSection(const char* section, Handle& fd, u64& file_size) {
         // Set up FS_Path structures
         u8 path[0xC] = {0};
         u32* type = (u32*)path;
         char* name = (char*)(path + sizeof(u32));
-        
+
         *type = 0x2; // ExeFS
-        strcpy(name, section); // Icon
+        strcpy(name, section);
 
         FS_Path archPath = { PATH_EMPTY, 1, "" };
         FS_Path filePath = { PATH_BINARY, sizeof(path), path };
 
-        // Open the RomFS file and mount it
-        Handle fd = 0;
+        HandleCache::Key key = HandleCache::MakeKey(ARCHIVE_ROMFS, archPath, filePath);
+        s64 size = HandleCache::UNKNOWN_SIZE;
+        if (AcquireCachedFile(key, fd, size, true)) {
+            if (size != HandleCache::UNKNOWN_SIZE) {
+                file_size = static_cast<u64>(size);
+                return 0;
+            }
+            CloseFile(fd);
+            return MAKERESULT(RL_PERMANENT, RS_INTERNAL, RM_COMMON, RD_NOT_FOUND);
+        }
+
         Result rc = FSUSER_OpenFileDirectly(&fd, ARCHIVE_ROMFS, archPath, filePath, FS_OPEN_READ, 0);
         if (R_FAILED(rc)) {
-            mi.FinishGood(rc);
-            return;
+            return rc;
         }
 
-        u64 file_size;
         rc = FSFILE_GetSize(fd, &file_size);
         if (R_FAILED(rc)) {
             FSFILE_Close(fd);
+            return rc;
+        }
+        readAhead.Register(fd);
+        blockCache.Register(fd, ARCHIVE_ROMFS, archPath, filePath);
+        AddOpenedFile(&key, fd, static_cast<s64>(file_size), filePath);
+        return rc;
+    }
+
+    static void _Process_ReadExefs(MethodInterface& mi, const char* section) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        Handle fd = 0;
+        u64 file_size;
+        Result rc = OpenExefsSection(section, fd, file_size);
+        if (R_FAILED(rc)) {
             mi.FinishGood(rc);
             return;
         }
 
-        ArticProtocolCommon::Buffer* icon_buf = mi.ReserveResultBuffer(0, static_cast<size_t>(file_size));
+        bool compress;
+        ArticProtocolCommon::Buffer* icon_buf = ReserveDataBuffer(mi, static_cast<size_t>(file_size), compress);
         if (!icon_buf) {
-            FSFILE_Close(fd);
+            CloseFile(fd);
             return;
         }
 
         u32 bytes_read;
-        rc = FSFILE_Read(fd, &bytes_read, 0, icon_buf->data, icon_buf->bufferSize);
+        rc = blockCache.Read(fd, 0, icon_buf->data, static_cast<u32>(file_size), bytes_read);
         if (R_FAILED(rc)) {
-            FSFILE_Close(fd);
+            CloseFile(fd);
             mi.ResizeLastResultBuffer(icon_buf, 0);
             mi.FinishGood(rc);
             return;
         }
 
-        mi.ResizeLastResultBuffer(icon_buf, bytes_read);
-        FSFILE_Close(fd);
+        CloseFile(fd);
+        if (!FinishDataBuffer(mi, icon_buf, bytes_read, compress)) {
+            return;
+        }
 
         mi.FinishGood(0);
     }
 
-    void Process_ReadIcon(ArticProtocolServer::MethodInterface& mi) {
+    void Process_ReadIcon(MethodInterface& mi) {
         _Process_ReadExefs(mi, "icon");
     }
 
-    void Process_ReadBanner(ArticProtocolServer::MethodInterface& mi) {
+    void Process_ReadBanner(MethodInterface& mi) {
         _Process_ReadExefs(mi, "banner");
     }
 
-    void Process_ReadLogo(ArticProtocolServer::MethodInterface& mi) {
+    void Process_ReadLogo(MethodInterface& mi) {
         _Process_ReadExefs(mi, "logo");
     }
 
-    bool GetFSPath(ArticProtocolServer::MethodInterface& mi, FS_Path& path) {
-        void* pathPtr; size_t pathSize;
-        
-        if (!mi.GetParameterBuffer(pathPtr, pathSize))
-            return false;
+    namespace Bootstrap {
+        enum Section : u32 {
+            TITLE_ID = 0,
+            PRODUCT_INFO,
+            EXHEADER,
+            CODE,
+            ICON,
+            BANNER,
+            LOGO,
+            SECTION_COUNT,
+        };
 
-        path.type = reinterpret_cast<FS_Path*>(pathPtr)->type;
-        path.size = reinterpret_cast<FS_Path*>(pathPtr)->size;
-        if (pathSize < 8 || path.size != pathSize - 0x8) {
-            mi.FinishInternalError();
-            return false;
-        }
+        static constexpr const char* EXEFS_SECTIONS[] = {"icon", "banner", "logo"};
 
-        path.data = (u8*)pathPtr + 0x8;
-        return true;
+        // Per section: the result of reading it, where its data is in the
+        // response and how long the server took to read it
+        struct SectionHeader {
+            s32 result;
+            u32 offset;
+            u32 size;
+            u32 microseconds;
+        };
+        static_assert(sizeof(SectionHeader) == 0x10);
+
+        // Response layout: a Header, then the data of every section at the
+        // offset its SectionHeader gives, from the start of the response
+        struct Header {
+            u32 sectionCount;
+            // Code mapped by the application, the CODE section may hold only
+            // the start of it. The rest is read with Process_ReadCode.
+            u32 codeSize;
+            SectionHeader sections[SECTION_COUNT];
+        };
+        static_assert(sizeof(Header) == 0x78);
+
+        static u32 TicksToMicroseconds(u64 ticks) {
+            return static_cast<u32>(ticks / (SYSCLOCK_ARM11 / 1000000));
+        }
     }
 
-    void FSUSER_OpenFileDirectly_(ArticProtocolServer::MethodInterface& mi) {
+    // s32 maximum code size. Returns, in one response, everything the client
+    // asks for when it connects: the same data as Process_GetTitleID,
+    // Process_GetProductInfo, Process_GetExheader, Process_ReadCode from offset
+    // 0, Process_ReadIcon, Process_ReadBanner and Process_ReadLogo. A section
+    // that fails only has its result set. See Bootstrap::Header for the layout.
+    void Process_Bootstrap(MethodInterface& mi) {
+        using namespace Bootstrap;
         bool good = true;
+        s32 maxCodeSize;
 
-        s32 archiveID;
-        FS_Path archPath;
-        FS_Path filePath;
-        s32 openFlags;
-        s32 attributes;
+        if (good) good = mi.GetParameterS32(maxCodeSize);
 
-        if (good) good = mi.GetParameterS32(archiveID);
-        if (good) good = GetFSPath(mi, archPath);
-        if (good) good = GetFSPath(mi, filePath);
-        if (good) good = mi.GetParameterS32(openFlags);
-        if (good) good = mi.GetParameterS32(attributes);
-        
         if (good) good = mi.FinishInputParameters();
 
         if (!good) return;
 
-        Handle out;
-        Result res = FSUSER_OpenFileDirectly(&out, (FS_ArchiveID)archiveID, archPath, filePath, openFlags, attributes);
-
-        if (R_FAILED(res)) {
-            mi.FinishGood(res);
+        if (maxCodeSize < 0) {
+            mi.FinishInternalError();
             return;
         }
 
-        ArticProtocolCommon::Buffer* handle_buf = mi.ReserveResultBuffer(0, sizeof(Handle));
-        if (!handle_buf) {
-            FSFILE_Close(out);
-            return;
-        }
+        // Time spent on each section, the client compares it with the round
+        // trip of the separate call it replaces
+        Header header{};
+        header.sectionCount = SECTION_COUNT;
+        u64 start = svcGetSystemTick();
+        u64 phaseStart = start;
+        auto endPhase = [&](Section section) {
+            u64 now = svcGetSystemTick();
+            header.sections[section].microseconds += TicksToMicroseconds(now - phaseStart);
+            phaseStart = now;
+        };
 
-        *reinterpret_cast<Handle*>(handle_buf->data) = out;
-        openHandles[(u64)out] = HandleType::FILE;
+        // Sizes first, so the whole response is reserved once and every
+        // section is read straight into it
+        s64 codeStart = 0;
+        const ExHeader_CodeSetInfo& codeSet = lastAppExheader.sci.codeset_info;
+        header.codeSize = (codeSet.text.num_pages + codeSet.rodata.num_pages + codeSet.data.num_pages) * 0x1000;
+        header.sections[CODE].result = svcGetProcessInfo(&codeStart, CUR_PROCESS_HANDLE, 0x10005);
+        header.sections[TITLE_ID].size = sizeof(u64);
+        header.sections[PRODUCT_INFO].size = sizeof(FS_ProductInfo);
+        header.sections[EXHEADER].size = sizeof(lastAppExheader);
+        if (R_SUCCEEDED(header.sections[CODE].result)) {
+            header.sections[CODE].size = std::min<u32>(header.codeSize, static_cast<u32>(maxCodeSize));
+        }
 
-        mi.FinishGood(res);
-    }
+        Handle exefs[std::size(EXEFS_SECTIONS)] = {};
+        for (size_t i = 0; i < std::size(EXEFS_SECTIONS); i++) {
+            SectionHeader& section = header.sections[ICON + i];
+            u64 file_size = 0;
+            section.result = OpenExefsSection(EXEFS_SECTIONS[i], exefs[i], file_size);
+            if (R_SUCCEEDED(section.result)) section.size = static_cast<u32>(file_size);
+            else exefs[i] = 0;
+            endPhase(static_cast<Section>(ICON + i));
+        }
 
-    void FSUSER_OpenArchive_(ArticProtocolServer::MethodInterface& mi) {
-        bool good = true;
+        size_t totalSize = sizeof(Header);
+        for (SectionHeader& section : header.sections) {
+            section.offset = static_cast<u32>(totalSize);
+            totalSize += section.size;
+        }
 
-        s32 archiveID;
-        FS_Path archPath;
+        bool compress;
+        ArticProtocolCommon::Buffer* bootstrap_buf = ReserveDataBuffer(mi, totalSize, compress);
+        if (!bootstrap_buf) {
+            for (Handle fd : exefs) {
+                if (fd) CloseFile(fd);
+            }
+            return;
+        }
+        u8* data = reinterpret_cast<u8*>(bootstrap_buf->data);
+        phaseStart = svcGetSystemTick();
 
-        if (good) good = mi.GetParameterS32(archiveID);
-        if (good) good = GetFSPath(mi, archPath);
-        
-        if (good) good = mi.FinishInputParameters();
+        s64 titleID = 0;
+        header.sections[TITLE_ID].result = svcGetProcessInfo(&titleID, CUR_PROCESS_HANDLE, 0x10001);
+        memcpy(data + header.sections[TITLE_ID].offset, &titleID, sizeof(u64));
+        endPhase(TITLE_ID);
 
-        if (!good) return;
+        // A failed query must not leak whatever the buffer held before
+        FS_ProductInfo* productInfo = reinterpret_cast<FS_ProductInfo*>(data + header.sections[PRODUCT_INFO].offset);
+        memset(productInfo, 0, sizeof(FS_ProductInfo));
+        u32 pid;
+        Result res = svcGetProcessId(&pid, CUR_PROCESS_HANDLE);
+        if (R_SUCCEEDED(res)) res = FSUSER_GetProductInfo(productInfo, pid);
+        header.sections[PRODUCT_INFO].result = res;
+        endPhase(PRODUCT_INFO);
 
-        FS_Archive out;
-        Result res = FSUSER_OpenArchive(&out, (FS_ArchiveID)archiveID, archPath);
+        memcpy(data + header.sections[EXHEADER].offset, &lastAppExheader, sizeof(lastAppExheader));
+        Stats::AddCopiedBytes(sizeof(lastAppExheader));
+        endPhase(EXHEADER);
 
-        if (R_FAILED(res)) {
-            mi.FinishGood(res);
-            return;
+        if (header.sections[CODE].size != 0) {
+            memcpy(data + header.sections[CODE].offset, reinterpret_cast<u8*>(codeStart), header.sections[CODE].size);
+            Stats::AddCopiedBytes(header.sections[CODE].size);
+        }
+        endPhase(CODE);
+
+        for (size_t i = 0; i < std::size(EXEFS_SECTIONS); i++) {
+            SectionHeader& section = header.sections[ICON + i];
+            if (!exefs[i]) continue;
+            u32 bytes_read = 0;
+            section.result = blockCache.Read(exefs[i], 0, data + section.offset, section.size, bytes_read);
+            CloseFile(exefs[i]);
+            // A short read leaves the rest of the section zeroed
+            if (R_FAILED(section.result)) bytes_read = 0;
+            memset(data + section.offset + bytes_read, 0, section.size - bytes_read);
+            endPhase(static_cast<Section>(ICON + i));
         }
 
-        ArticProtocolCommon::Buffer* handle_buf = mi.ReserveResultBuffer(0, sizeof(FS_Archive));
-        if (!handle_buf) {
-            FSUSER_CloseArchive(out);
+        memcpy(data, &header, sizeof(Header));
+        mi.SetTraceTarget(0, 0, totalSize);
+        logger.Debug("Bootstrap: %u bytes in %u us (tid %u, product %u, exheader %u, code %u, icon %u, banner %u, logo %u us)",
+            (unsigned int)totalSize, (unsigned int)TicksToMicroseconds(svcGetSystemTick() - start),
+            (unsigned int)header.sections[TITLE_ID].microseconds, (unsigned int)header.sections[PRODUCT_INFO].microseconds,
+            (unsigned int)header.sections[EXHEADER].microseconds, (unsigned int)header.sections[CODE].microseconds,
+            (unsigned int)header.sections[ICON].microseconds, (unsigned int)header.sections[BANNER].microseconds,
+            (unsigned int)header.sections[LOGO].microseconds);
+        if (!FinishDataBuffer(mi, bootstrap_buf, totalSize, compress)) {
             return;
         }
 
-        *reinterpret_cast<FS_Archive*>(handle_buf->data) = out;
-        openHandles[(u64)out] = HandleType::ARCHIVE;
+        mi.FinishGood(0);
+    }
 
-        mi.FinishGood(res);
+    namespace RomFSMetadata {
+        // RomFS level 3 layout
+        struct Level3Header {
+            u32 headerSize;
+            u32 dirHashOffset;
+            u32 dirHashSize;
+            u32 dirMetaOffset;
+            u32 dirMetaSize;
+            u32 fileHashOffset;
+            u32 fileHashSize;
+            u32 fileMetaOffset;
+            u32 fileMetaSize;
+            u32 fileDataOffset;
+        };
+        static_assert(sizeof(Level3Header) == 0x28);
+
+        struct DirMeta {
+            u32 parent;
+            u32 nextSibling;
+            u32 firstChildDir;
+            u32 firstFile;
+            u32 nextHash;
+            u32 nameSize;
+        };
+        static_assert(sizeof(DirMeta) == 0x18);
+
+        struct FileMeta {
+            u32 parent;
+            u32 nextSibling;
+            u64 dataOffset;
+            u64 dataSize;
+            u32 nextHash;
+            u32 nameSize;
+        };
+        static_assert(sizeof(FileMeta) == 0x20);
+
+        // Response layout: a Header, then every directory as a DirEntry and
+        // every file as a FileEntry, each followed by its UTF-16 name. Packed,
+        // may be unaligned. Parents are directory indexes, the root is index 0
+        // and its own parent. File offsets are from the start of the RomFS.
+        struct Header {
+            u32 dirCount;
+            u32 fileCount;
+        };
+
+        struct DirEntry {
+            u32 parent;
+            u16 nameLength;
+        } __attribute__((packed));
+        static_assert(sizeof(DirEntry) == 6);
+
+        struct FileEntry {
+            u32 parent;
+            u64 offset;
+            u64 size;
+            u16 nameLength;
+        } __attribute__((packed));
+        static_assert(sizeof(FileEntry) == 0x16);
+
+        // Larger tables are not a RomFS the client should mirror
+        static constexpr u32 MAX_TABLE_SIZE = 0x400000;
+
+        // Offsets of the entries of a metadata table, in table order. Returns
+        // false if an entry does not fit in the table.
+        template <typename T>
+        static bool IndexTable(const u8* table, u32 size, std::vector<u32>& offsets) {
+            u32 offset = 0;
+            while (offset < size) {
+                T entry;
+                if (size - offset < sizeof(T)) return false;
+                memcpy(&entry, table + offset, sizeof(T));
+                if (entry.nameSize > size - offset - sizeof(T) || entry.nameSize % sizeof(u16) != 0) return false;
+                offsets.push_back(offset);
+                offset += (sizeof(T) + entry.nameSize + 3) & ~3U;
+            }
+            return true;
+        }
+
+        static bool FindIndex(const std::vector<u32>& offsets, u32 offset, u32& index) {
+            auto it = std::lower_bound(offsets.begin(), offsets.end(), offset);
+            if (it == offsets.end() || *it != offset) return false;
+            index = static_cast<u32>(it - offsets.begin());
+            return true;
+        }
     }
 
-    void FSUSER_CloseArchive_(ArticProtocolServer::MethodInterface& mi) {
+    // Returns the directory and file tree of the application RomFS, so the
+    // client can resolve paths and list directories without requests. See
+    // RomFSMetadata::Header for the layout.
+    void Process_ReadRomFSMetadata(MethodInterface& mi) {
+        using namespace RomFSMetadata;
         bool good = true;
 
-        FS_Archive archive;
-
-        if (good) good = mi.GetParameterS64(*reinterpret_cast<s64*>(&archive));
-        
         if (good) good = mi.FinishInputParameters();
 
         if (!good) return;
 
-        Result res = FSUSER_CloseArchive(archive);
-        openHandles.erase((u64)archive);
+        u8 path[0xC] = {0}; // RomFS
+        FS_Path archPath = { PATH_EMPTY, 1, "" };
+        FS_Path filePath = { PATH_BINARY, sizeof(path), path };
 
-        mi.FinishGood(res);
-    }
+        Handle fd = 0;
+        Result rc = FSUSER_OpenFileDirectly(&fd, ARCHIVE_ROMFS, archPath, filePath, FS_OPEN_READ, 0);
+        if (R_FAILED(rc)) {
+            mi.FinishGood(rc);
+            return;
+        }
 
-    void FSUSER_OpenFile_(ArticProtocolServer::MethodInterface& mi) {
-        bool good = true;
+        bool complete = true;
+        auto readAll = [fd, &complete](u64 offset, void* out, u32 size) {
+            u32 bytes_read = 0;
+            Result res = FSFILE_Read(fd, &bytes_read, offset, out, size);
+            if (bytes_read != size) complete = false;
+            return res;
+        };
 
-        FS_Archive archive;
-        FS_Path filePath;
-        s32 openFlags;
-        s32 attributes;
+        Level3Header header;
+        rc = readAll(0, &header, sizeof(header));
+        if (R_SUCCEEDED(rc) && (!complete || header.headerSize != sizeof(header) || header.dirMetaSize < sizeof(DirMeta) ||
+            header.dirMetaSize > MAX_TABLE_SIZE || header.fileMetaSize > MAX_TABLE_SIZE)) {
+            logger.Error("RomFSMetadata: Invalid level 3 header");
+            FSFILE_Close(fd);
+            mi.FinishInternalError();
+            return;
+        }
 
-        if (good) good = mi.GetParameterS64(*reinterpret_cast<s64*>(&archive));
-        if (good) good = GetFSPath(mi, filePath);
-        if (good) good = mi.GetParameterS32(openFlags);
-        if (good) good = mi.GetParameterS32(attributes);
-        
-        if (good) good = mi.FinishInputParameters();
+        u8* dirTable = nullptr;
+        u8* fileTable = nullptr;
+        if (R_SUCCEEDED(rc)) {
+            dirTable = (u8*)malloc(header.dirMetaSize + header.fileMetaSize);
+            if (!dirTable) {
+                FSFILE_Close(fd);
+                mi.FinishInternalError();
+                return;
+            }
+            fileTable = dirTable + header.dirMetaSize;
+            rc = readAll(header.dirMetaOffset, dirTable, header.dirMetaSize);
+        }
+        if (R_SUCCEEDED(rc)) {
+            rc = readAll(header.fileMetaOffset, fileTable, header.fileMetaSize);
+        }
+        FSFILE_Close(fd);
+        if (R_FAILED(rc)) {
+            free(dirTable);
+            mi.FinishGood(rc);
+            return;
+        }
 
-        if (!good) return;
+        std::vector<u32> dirOffsets, fileOffsets;
+        bool valid = complete && IndexTable<DirMeta>(dirTable, header.dirMetaSize, dirOffsets) &&
+            IndexTable<FileMeta>(fileTable, header.fileMetaSize, fileOffsets) && !dirOffsets.empty();
+        size_t size = sizeof(Header);
+        for (size_t i = 0; valid && i < dirOffsets.size(); i++) {
+            size += sizeof(DirEntry) + reinterpret_cast<DirMeta*>(dirTable + dirOffsets[i])->nameSize;
+        }
+        for (size_t i = 0; valid && i < fileOffsets.size(); i++) {
+            size += sizeof(FileEntry) + reinterpret_cast<FileMeta*>(fileTable + fileOffsets[i])->nameSize;
+        }
+        if (!valid) {
+            logger.Error("RomFSMetadata: Invalid metadata tables");
+            free(dirTable);
+            mi.FinishInternalError();
+            return;
+        }
 
-        Handle out;
-        Result res = FSUSER_OpenFile(&out, archive, filePath, openFlags, attributes);
+        bool compress;
+        ArticProtocolCommon::Buffer* meta_buf = ReserveDataBuffer(mi, size, compress);
+        if (!meta_buf) {
+            free(dirTable);
+            return;
+        }
 
-        if (R_FAILED(res)) {
-            mi.FinishGood(res);
+        u8* out = reinterpret_cast<u8*>(meta_buf->data);
+        Header outHeader = {static_cast<u32>(dirOffsets.size()), static_cast<u32>(fileOffsets.size())};
+        memcpy(out, &outHeader, sizeof(Header)); out += sizeof(Header);
+        for (size_t i = 0; valid && i < dirOffsets.size(); i++) {
+            DirMeta meta;
+            memcpy(&meta, dirTable + dirOffsets[i], sizeof(DirMeta));
+            u32 parent = 0;
+            valid = FindIndex(dirOffsets, meta.parent, parent);
+            DirEntry entry = {parent, static_cast<u16>(meta.nameSize / sizeof(u16))};
+            memcpy(out, &entry, sizeof(DirEntry)); out += sizeof(DirEntry);
+            memcpy(out, dirTable + dirOffsets[i] + sizeof(DirMeta), meta.nameSize); out += meta.nameSize;
+        }
+        for (size_t i = 0; valid && i < fileOffsets.size(); i++) {
+            FileMeta meta;
+            memcpy(&meta, fileTable + fileOffsets[i], sizeof(FileMeta));
+            u32 parent = 0;
+            valid = FindIndex(dirOffsets, meta.parent, parent);
+            FileEntry entry = {parent, header.fileDataOffset + meta.dataOffset, meta.dataSize, static_cast<u16>(meta.nameSize / sizeof(u16))};
+            memcpy(out, &entry, sizeof(FileEntry)); out += sizeof(FileEntry);
+            memcpy(out, fileTable + fileOffsets[i] + sizeof(FileMeta), meta.nameSize); out += meta.nameSize;
+        }
+        free(dirTable);
+        if (!valid) {
+            logger.Error("RomFSMetadata: Invalid parent offset");
+            mi.ResizeLastResultBuffer(meta_buf, 0);
+            mi.FinishInternalError();
             return;
         }
 
-        ArticProtocolCommon::Buffer* handle_buf = mi.ReserveResultBuffer(0, sizeof(Handle));
-        if (!handle_buf) {
-            FSFILE_Close(out);
+        if (!FinishDataBuffer(mi, meta_buf, size, compress)) {
             return;
         }
+        mi.FinishGood(0);
+    }
 
-        *reinterpret_cast<Handle*>(handle_buf->data) = out;
+    // Application RomFS kept open for the whole session by Process_ReadRomFS
+    namespace RawRomFS {
+        static Handle handle = 0;
+        static u64 size = 0;
 
-        // Citra always asks for the size after opening a file, provided it here.
-        u64 fileSize;
-        Result res2 = FSFILE_GetSize(out, &fileSize);
-        if (R_SUCCEEDED(res2)) {
-            ArticProtocolCommon::Buffer* size_buf = mi.ReserveResultBuffer(1, sizeof(u64));
-            if (!size_buf) {
+        static Result Open() {
+            if (handle) return 0;
+
+            u8 path[0xC] = {0}; // RomFS
+            FS_Path archPath = { PATH_EMPTY, 1, "" };
+            FS_Path filePath = { PATH_BINARY, sizeof(path), path };
+
+            Handle out;
+            Result res = FSUSER_OpenFileDirectly(&out, ARCHIVE_ROMFS, archPath, filePath, FS_OPEN_READ, 0);
+            if (R_FAILED(res)) return res;
+            res = FSFILE_GetSize(out, &size);
+            if (R_FAILED(res)) {
                 FSFILE_Close(out);
-                return;
+                return res;
             }
-
-            *reinterpret_cast<u64*>(size_buf->data) = fileSize;
+            handle = out;
+            readAhead.Register(handle);
+            blockCache.Register(handle, ARCHIVE_ROMFS, archPath, filePath);
+            return 0;
         }
-        openHandles[(u64)out] = HandleType::FILE;
 
-        mi.FinishGood(res);
+        static void Close() {
+            if (!handle) return;
+            blockCache.Unregister(handle);
+            readAhead.Unregister(handle);
+            FSFILE_Close(handle);
+            handle = 0;
+            size = 0;
+        }
     }
 
-    void FSUSER_CreateFile_(ArticProtocolServer::MethodInterface& mi) {
+    // s64 offset, s32 size. Reads the application RomFS (level 3) by absolute
+    // offset, without opening a handle per file. Reads are cut at the end of
+    // level 3, the FS does not serve the hash levels behind it.
+    void Process_ReadRomFS(MethodInterface& mi) {
         bool good = true;
+        s32 size;
+        s64 offset;
+        u32 bytes_read = 0;
 
-        FS_Archive archive;
-        FS_Path filePath;
-        s32 attributes;
-        s64 fileSize;
+        if (good) good = mi.GetParameterS64(offset);
+        if (good) good = mi.GetParameterS32(size);
 
-        if (good) good = mi.GetParameterS64(*reinterpret_cast<s64*>(&archive));
-        if (good) good = GetFSPath(mi, filePath);
-        if (good) good = mi.GetParameterS32(attributes);
-        if (good) good = mi.GetParameterS64(fileSize);
-        
         if (good) good = mi.FinishInputParameters();
 
         if (!good) return;
 
-        Handle out;
-        Result res = FSUSER_CreateFile(archive, filePath, attributes, fileSize);
-
-        mi.FinishGood(res);
-    }
+        if (offset < 0 || size < 0) {
+            mi.FinishInternalError();
+            return;
+        }
 
-    void FSUSER_DeleteFile_(ArticProtocolServer::MethodInterface& mi) {
-        bool good = true;
+        Result res = RawRomFS::Open();
+        if (R_FAILED(res)) {
+            mi.FinishGood(res);
+            return;
+        }
+        if (static_cast<u64>(offset) >= RawRomFS::size) {
+            size = 0;
+        } else {
+            size = static_cast<s32>(std::min<u64>(size, RawRomFS::size - offset));
+        }
+        mi.SetTraceTarget(RawRomFS::handle, offset, size);
+
+        bool compress;
+        ArticProtocolCommon::Buffer* read_buf = ReserveDataBuffer(mi, size, compress);
+        if (!read_buf) {
+            return;
+        }
+
+        if (size != 0) {
+            res = blockCache.Read(RawRomFS::handle, offset, read_buf->data, size, bytes_read);
+        }
+        if (R_FAILED(res)) {
+            mi.ResizeLastResultBuffer(read_buf, 0);
+            mi.FinishGood(res);
+            return;
+        }
+
+        if (!FinishDataBuffer(mi, read_buf, bytes_read, compress)) {
+            return;
+        }
+        mi.FinishGood(0);
+    }
+
+    bool GetFSPath(MethodInterface& mi, FS_Path& path) {
+        void* pathPtr; size_t pathSize;
+        
+        if (!mi.GetParameterBuffer(pathPtr, pathSize))
+            return false;
+
+        path.type = reinterpret_cast<FS_Path*>(pathPtr)->type;
+        path.size = reinterpret_cast<FS_Path*>(pathPtr)->size;
+        if (pathSize < 8 || path.size != pathSize - 0x8) {
+            mi.FinishInternalError();
+            return false;
+        }
+
+        path.data = (u8*)pathPtr + 0x8;
+        return true;
+    }
+
+    // Something was created, deleted or renamed in an archive
+    static void ArchiveChanged() {
+        negativeCache.Invalidate();
+        Memo::Invalidate(Memo::UNTIL_WRITE);
+    }
+
+    // Save and extdata archives, whose files are written in small pieces
+    static bool IsWriteBufferedArchive(s32 archiveID) {
+        switch (archiveID)
+        {
+        case ARCHIVE_SAVEDATA:
+        case ARCHIVE_EXTDATA:
+        case ARCHIVE_SHARED_EXTDATA:
+        case ARCHIVE_SYSTEM_SAVEDATA:
+        case ARCHIVE_USER_SAVEDATA:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void FSUSER_OpenFileDirectly_(MethodInterface& mi) {
+        bool good = true;
+
+        s32 archiveID;
+        FS_Path archPath;
+        FS_Path filePath;
+        s32 openFlags;
+        s32 attributes;
+
+        if (good) good = mi.GetParameterS32(archiveID);
+        if (good) good = GetFSPath(mi, archPath);
+        if (good) good = GetFSPath(mi, filePath);
+        if (good) good = mi.GetParameterS32(openFlags);
+        if (good) good = mi.GetParameterS32(attributes);
+        
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        Handle out;
+        Result res = 0;
+        NegativeCache::Probe probe;
+        bool probed = !(openFlags & FS_OPEN_CREATE) && negativeCache.MakeProbe(archiveID, archPath, filePath, probe);
+        if (probed && negativeCache.Lookup(probe, res)) {
+            mi.FinishGood(res);
+            return;
+        }
+
+        bool readOnly = IsReadOnlyContent(archiveID, filePath, openFlags);
+        HandleCache::Key key;
+        s64 size;
+        bool cached = false;
+        if (readOnly) {
+            key = HandleCache::MakeKey(archiveID, archPath, filePath);
+            cached = AcquireCachedFile(key, out, size, false);
+        }
+        if (!cached) {
+            res = FSUSER_OpenFileDirectly(&out, (FS_ArchiveID)archiveID, archPath, filePath, openFlags, attributes);
+            if (probed) negativeCache.Insert(probe, res);
+            else if (openFlags & FS_OPEN_CREATE) ArchiveChanged();
+        }
+
+        if (R_FAILED(res)) {
+            mi.FinishGood(res);
+            return;
+        }
+
+        ArticProtocolCommon::Buffer* handle_buf = mi.ReserveResultBuffer(0, sizeof(Handle));
+        if (!handle_buf) {
+            if (cached) handleCache.Release(out);
+            else FSFILE_Close(out);
+            return;
+        }
+
+        *reinterpret_cast<Handle*>(handle_buf->data) = out;
+        if (!cached) {
+            if (readOnly) {
+                readAhead.Register(out);
+                blockCache.Register(out, archiveID, archPath, filePath);
+            }
+            AddOpenedFile(readOnly ? &key : nullptr, out, HandleCache::UNKNOWN_SIZE, filePath);
+        }
+
+        // Keep enough to reopen RomFS/ExeFS on replay: archive ID and content type
+        u32 contentType = 0;
+        if (filePath.type == PATH_BINARY && filePath.size >= sizeof(u32)) {
+            memcpy(&contentType, filePath.data, sizeof(u32));
+        }
+        mi.SetTraceTarget(out, archiveID, contentType);
+
+        mi.FinishGood(res);
+    }
+
+    void FSUSER_OpenArchive_(MethodInterface& mi) {
+        bool good = true;
+
+        s32 archiveID;
+        FS_Path archPath;
+
+        if (good) good = mi.GetParameterS32(archiveID);
+        if (good) good = GetFSPath(mi, archPath);
+        
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        FS_Archive out;
+        Result res = 0;
+        std::vector<u8> key = SharedArchives::MakeKey(archiveID, archPath);
+        bool shared = SharedArchives::Acquire(key, out);
+        if (!shared) {
+            res = FSUSER_OpenArchive(&out, (FS_ArchiveID)archiveID, archPath);
+        }
+
+        if (R_FAILED(res)) {
+            mi.FinishGood(res);
+            return;
+        }
+
+        ArticProtocolCommon::Buffer* handle_buf = mi.ReserveResultBuffer(0, sizeof(FS_Archive));
+        if (!handle_buf) {
+            if (!shared || !SharedArchives::Release(out)) {
+                FSUSER_CloseArchive(out);
+            }
+            return;
+        }
+
+        *reinterpret_cast<FS_Archive*>(handle_buf->data) = out;
+        if (!shared) {
+            SharedArchives::Add(key, out);
+            AddOpenHandle((u64)out, HandleType::ARCHIVE, 0, HandleTable::HashPath(archPath));
+            if (archiveID == ARCHIVE_ROMFS) {
+                handleCache.AddReadOnlyArchive(out);
+                negativeCache.AddArchive(out, false);
+            } else if (IsWriteBufferedArchive(archiveID)) {
+                writeBuffer.AddArchive(out);
+                // Only the title changes its save data, through the server
+                negativeCache.AddArchive(out, true);
+            }
+        }
+        mi.SetTraceTarget(out, archiveID, 0);
+
+        mi.FinishGood(res);
+    }
+
+    void FSUSER_CloseArchive_(MethodInterface& mi) {
+        bool good = true;
+
+        FS_Archive archive;
+
+        if (good) good = mi.GetParameterS64(*reinterpret_cast<s64*>(&archive));
+        
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        Result res = 0;
+        if (!SharedArchives::Release(archive)) {
+            handleCache.RemoveArchive(archive);
+            negativeCache.RemoveArchive(archive);
+            writeBuffer.RemoveArchive(archive);
+            res = FSUSER_CloseArchive(archive);
+            // The archive handle may be reused, its free bytes must not be
+            Memo::Invalidate(Memo::UNTIL_WRITE);
+            RemoveOpenHandle((u64)archive);
+        }
+        mi.SetTraceTarget(archive, 0, 0);
+
+        mi.FinishGood(res);
+    }
+
+    void FSUSER_OpenFile_(MethodInterface& mi) {
+        bool good = true;
+
+        FS_Archive archive;
+        FS_Path filePath;
+        s32 openFlags;
+        s32 attributes;
+
+        if (good) good = mi.GetParameterS64(*reinterpret_cast<s64*>(&archive));
+        if (good) good = GetFSPath(mi, filePath);
+        if (good) good = mi.GetParameterS32(openFlags);
+        if (good) good = mi.GetParameterS32(attributes);
+        
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        Handle out;
+        Result res = 0;
+        NegativeCache::Probe probe;
+        bool create = openFlags & FS_OPEN_CREATE;
+        bool probed = !create && negativeCache.MakeProbe(NegativeCache::Kind::FILE, archive, filePath, probe);
+        if (probed && negativeCache.Lookup(probe, res)) {
+            mi.FinishGood(res);
+            return;
+        }
+
+        bool readOnly = openFlags == FS_OPEN_READ && handleCache.IsReadOnlyArchive(archive);
+        HandleCache::Key key;
+        s64 size = HandleCache::UNKNOWN_SIZE;
+        bool cached = false;
+        if (readOnly) {
+            key = HandleCache::MakeKey(archive, filePath);
+            cached = AcquireCachedFile(key, out, size, true);
+        }
+        if (!cached) {
+            res = FSUSER_OpenFile(&out, archive, filePath, openFlags, attributes);
+            if (probed) negativeCache.Insert(probe, res);
+            else if (create) ArchiveChanged();
+        }
+
+        if (R_FAILED(res)) {
+            mi.FinishGood(res);
+            return;
+        }
+
+        ArticProtocolCommon::Buffer* handle_buf = mi.ReserveResultBuffer(0, sizeof(Handle));
+        if (!handle_buf) {
+            if (cached) handleCache.Release(out);
+            else FSFILE_Close(out);
+            return;
+        }
+
+        *reinterpret_cast<Handle*>(handle_buf->data) = out;
+
+        // Citra always asks for the size after opening a file, provided it here.
+        u64 fileSize;
+        if (!cached && R_SUCCEEDED(FSFILE_GetSize(out, &fileSize))) {
+            size = static_cast<s64>(fileSize);
+        }
+        if (size != HandleCache::UNKNOWN_SIZE) {
+            ArticProtocolCommon::Buffer* size_buf = mi.ReserveResultBuffer(1, sizeof(u64));
+            if (!size_buf) {
+                if (cached) handleCache.Release(out);
+                else FSFILE_Close(out);
+                return;
+            }
+
+            *reinterpret_cast<u64*>(size_buf->data) = size;
+        }
+        if (!cached) {
+            if (readOnly) RegisterReadOnlyFile(out, filePath);
+            AddOpenedFile(readOnly ? &key : nullptr, out, size, filePath, archive);
+            if ((openFlags & FS_OPEN_WRITE) && writeBuffer.IsBufferedArchive(archive)) {
+                writeBuffer.Register(out, archive);
+            }
+        }
+        mi.SetTraceTarget(out, 0, 0);
+
+        mi.FinishGood(res);
+    }
+
+    void FSUSER_CreateFile_(MethodInterface& mi) {
+        bool good = true;
+
+        FS_Archive archive;
+        FS_Path filePath;
+        s32 attributes;
+        s64 fileSize;
+
+        if (good) good = mi.GetParameterS64(*reinterpret_cast<s64*>(&archive));
+        if (good) good = GetFSPath(mi, filePath);
+        if (good) good = mi.GetParameterS32(attributes);
+        if (good) good = mi.GetParameterS64(fileSize);
+        
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        Handle out;
+        Result res = FSUSER_CreateFile(archive, filePath, attributes, fileSize);
+        ArchiveChanged();
+
+        mi.FinishGood(res);
+    }
+
+    void FSUSER_DeleteFile_(MethodInterface& mi) {
+        bool good = true;
 
         FS_Archive archive;
         FS_Path filePath;
@@ -366,11 +1164,12 @@ namespace ArticFunctions {
         if (!good) return;
 
         Result res = FSUSER_DeleteFile(archive, filePath);
+        ArchiveChanged();
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_RenameFile_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_RenameFile_(MethodInterface& mi) {
         bool good = true;
 
         FS_Archive srcarchive;
@@ -388,11 +1187,12 @@ namespace ArticFunctions {
         if (!good) return;
 
         Result res = FSUSER_RenameFile(srcarchive, srcfilePath, dstarchive, dstfilePath);
+        ArchiveChanged();
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_OpenDirectory_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_OpenDirectory_(MethodInterface& mi) {
         bool good = true;
 
         FS_Archive archive;
@@ -406,7 +1206,16 @@ namespace ArticFunctions {
         if (!good) return;
 
         Handle out;
-        Result res = FSUSER_OpenDirectory(&out, archive, dirPath);
+        NegativeCache::Probe probe;
+        Result res;
+        bool probed = negativeCache.MakeProbe(NegativeCache::Kind::DIRECTORY, archive, dirPath, probe);
+        if (probed && negativeCache.Lookup(probe, res)) {
+            mi.FinishGood(res);
+            return;
+        }
+
+        res = FSUSER_OpenDirectory(&out, archive, dirPath);
+        if (probed) negativeCache.Insert(probe, res);
 
         if (R_FAILED(res)) {
             mi.FinishGood(res);
@@ -420,12 +1229,13 @@ namespace ArticFunctions {
         }
 
         *reinterpret_cast<Handle*>(handle_buf->data) = out;
-        openHandles[(u64)out] = HandleType::DIR;
+        AddOpenHandle((u64)out, HandleType::DIR, archive, HandleTable::HashPath(dirPath));
+        mi.SetTraceTarget(out, 0, 0);
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_CreateDirectory_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_CreateDirectory_(MethodInterface& mi) {
         bool good = true;
 
         FS_Archive archive;
@@ -442,11 +1252,12 @@ namespace ArticFunctions {
 
         Handle out;
         Result res = FSUSER_CreateDirectory(archive, dirPath, attributes);
+        ArchiveChanged();
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_DeleteDirectory_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_DeleteDirectory_(MethodInterface& mi) {
         bool good = true;
 
         FS_Archive archive;
@@ -461,11 +1272,12 @@ namespace ArticFunctions {
 
         Handle out;
         Result res = FSUSER_DeleteDirectory(archive, dirPath);
+        ArchiveChanged();
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_DeleteDirectoryRecursively_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_DeleteDirectoryRecursively_(MethodInterface& mi) {
         bool good = true;
 
         FS_Archive archive;
@@ -480,11 +1292,12 @@ namespace ArticFunctions {
 
         Handle out;
         Result res = FSUSER_DeleteDirectoryRecursively(archive, dirPath);
+        ArchiveChanged();
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_RenameDirectory_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_RenameDirectory_(MethodInterface& mi) {
         bool good = true;
 
         FS_Archive srcarchive;
@@ -502,11 +1315,12 @@ namespace ArticFunctions {
         if (!good) return;
 
         Result res = FSUSER_RenameDirectory(srcarchive, srcdirPath, dstarchive, dstdirPath);
+        ArchiveChanged();
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_ControlArchive_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_ControlArchive_(MethodInterface& mi) {
         bool good = true;
 
         FS_Archive archive;
@@ -521,6 +1335,8 @@ namespace ArticFunctions {
         
         if (good) good = mi.FinishInputParameters();
 
+        if (!good) return;
+
         if (outputSize > 0x1000) {
             mi.FinishInternalError();
             return;
@@ -529,7 +1345,15 @@ namespace ArticFunctions {
         // Cannot use output buffer while using input at the same time, need to allocate
         void* output = malloc(outputSize); 
 
-        Result res = FSUSER_ControlArchive(archive, action, input, inputSize, output, outputSize);
+        // The commit must include the writes still held in memory
+        Result res = 0;
+        if (action == ARCHIVE_ACTION_COMMIT_SAVE_DATA) {
+            res = writeBuffer.FlushArchive(archive);
+        }
+        if (R_SUCCEEDED(res)) {
+            res = FSUSER_ControlArchive(archive, action, input, inputSize, output, outputSize);
+        }
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         ArticProtocolCommon::Buffer* out_buf = mi.ReserveResultBuffer(0, outputSize);
         if (!out_buf) {
@@ -542,7 +1366,7 @@ namespace ArticFunctions {
         free(output);
     }
 
-    void FSUSER_GetFreeBytes_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_GetFreeBytes_(MethodInterface& mi) {
         bool good = true;
 
         FS_Archive archive;
@@ -553,6 +1377,8 @@ namespace ArticFunctions {
 
         if (!good) return;
 
+        if (Memo::Replay(mi, &archive, sizeof(archive))) return;
+
         u64 freeBytes;
         Result res = FSUSER_GetFreeBytes(&freeBytes, archive);
         if (R_FAILED(res)) {
@@ -560,16 +1386,16 @@ namespace ArticFunctions {
             return;
         }
 
-        ArticProtocolCommon::Buffer* size_buf = mi.ReserveResultBuffer(0, sizeof(u64));
+        ArticProtocolCommon::Buffer* size_buf = Memo::ReserveResultBuffer(mi, 0, sizeof(u64));
         if (!size_buf) {
             return;
         }
 
         *reinterpret_cast<u64*>(size_buf->data) = freeBytes;
-        mi.FinishGood(res);
+        Memo::FinishGood(mi, res);
     }
 
-    void FSUSER_GetFormatInfo_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_GetFormatInfo_(MethodInterface& mi) {
         bool good = true;
 
         s32 archiveID;
@@ -582,6 +1408,13 @@ namespace ArticFunctions {
 
         if (!good) return;
 
+        std::vector<u8> memoKey(sizeof(s32) + sizeof(u32) + path.size);
+        u32 pathType = path.type;
+        memcpy(memoKey.data(), &archiveID, sizeof(s32));
+        memcpy(memoKey.data() + sizeof(s32), &pathType, sizeof(u32));
+        memcpy(memoKey.data() + sizeof(s32) + sizeof(u32), path.data, path.size);
+        if (Memo::Replay(mi, memoKey.data(), memoKey.size())) return;
+
         u32 totalSize; u32 directories; u32 files; bool duplicateData;
         Result res = FSUSER_GetFormatInfo(&totalSize, &directories, &files, &duplicateData, (FS_ArchiveID)archiveID, path);
 
@@ -598,16 +1431,16 @@ namespace ArticFunctions {
         archive_format_info.number_files = files;
         archive_format_info.duplicate_data = duplicateData;
 
-        ArticProtocolCommon::Buffer* format_info_buf = mi.ReserveResultBuffer(0, sizeof(archive_format_info));
+        ArticProtocolCommon::Buffer* format_info_buf = Memo::ReserveResultBuffer(mi, 0, sizeof(archive_format_info));
         if (!format_info_buf) {
             return;
         }
 
         memcpy(format_info_buf->data, &archive_format_info, sizeof(archive_format_info));        
-        mi.FinishGood(res);
+        Memo::FinishGood(mi, res);
     }
 
-    void FSUSER_FormatSaveData_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_FormatSaveData_(MethodInterface& mi) {
         bool good = true;
 
         s32 archiveID;
@@ -628,11 +1461,12 @@ namespace ArticFunctions {
         if (!good) return;
 
         Result res = FSUSER_FormatSaveData((FS_ArchiveID)archiveID, path, blocks, directories, files, directoryBuckets, fileBuckets, duplicateData);
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_ObsoletedSetSaveDataSecureValue_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_ObsoletedSetSaveDataSecureValue_(MethodInterface& mi) {
         bool good = true;
 
         s64 secure_value;
@@ -650,11 +1484,12 @@ namespace ArticFunctions {
         if (!good) return;
 
         Result res = FSUSER_SetSaveDataSecureValue((u64)secure_value, (FS_SecureValueSlot)slot, title_id, title_variation);
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_ObsoletedGetSaveDataSecureValue_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_ObsoletedGetSaveDataSecureValue_(MethodInterface& mi) {
         bool good = true;
         
         s32 slot;
@@ -694,7 +1529,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void FSUSER_ControlSecureSave_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_ControlSecureSave_(MethodInterface& mi) {
         bool good = true;
 
         s32 action;
@@ -716,6 +1551,7 @@ namespace ArticFunctions {
         void* output = malloc(outputSize); 
 
         Result res = FSUSER_ControlSecureSave((FS_SecureSaveAction)action, input, inputSize, output, outputSize);
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         ArticProtocolCommon::Buffer* out_buf = mi.ReserveResultBuffer(0, outputSize);
         if (!out_buf) {
@@ -728,7 +1564,7 @@ namespace ArticFunctions {
         free(output);
     }
 
-    void FSUSER_SetSaveDataSecureValue_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_SetSaveDataSecureValue_(MethodInterface& mi) {
         bool good = true;
 
         FS_Archive archive;
@@ -746,11 +1582,12 @@ namespace ArticFunctions {
         if (!good) return;
 
         Result res = FSUSER_NewSetSaveDataSecureValue(archive, (u64)secure_value, (FS_SecureValueSlot)slot, flush != 0);
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_GetSaveDataSecureValue_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_GetSaveDataSecureValue_(MethodInterface& mi) {
         bool good = true;
         
         FS_Archive archive;
@@ -790,7 +1627,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void FSUSER_SetThisSaveDataSecureValue_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_SetThisSaveDataSecureValue_(MethodInterface& mi) {
         bool good = true;
 
         s32 slot;
@@ -804,11 +1641,12 @@ namespace ArticFunctions {
         if (!good) return;
 
         Result res = FSUSER_SetThisSaveDataSecureValue((u64)secure_value, (FS_SecureValueSlot)slot);
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_GetThisSaveDataSecureValue_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_GetThisSaveDataSecureValue_(MethodInterface& mi) {
         bool good = true;
         
         s32 slot;
@@ -846,7 +1684,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void FSUSER_CreateExtSaveData_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_CreateExtSaveData_(MethodInterface& mi) {
         bool good = true;
 
         FS_ExtSaveDataInfo info;
@@ -872,11 +1710,12 @@ namespace ArticFunctions {
         memcpy(&info, formatInfoPtr, formatInfoPtrSize);
 
         Result res = FSUSER_CreateExtSaveData(info, directories, files, size_limit, static_cast<u32>(smdhIconPtrSize), reinterpret_cast<u8*>(smdhIconPtr));
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_DeleteExtSaveData_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_DeleteExtSaveData_(MethodInterface& mi) {
         bool good = true;
 
         FS_ExtSaveDataInfo info;
@@ -895,11 +1734,12 @@ namespace ArticFunctions {
         memcpy(&info, formatInfoPtr, formatInfoPtrSize);
 
         Result res = FSUSER_DeleteExtSaveData(info);
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         mi.FinishGood(res);
     }
 
-    void FSUSER_CreateSysSaveData_(ArticProtocolServer::MethodInterface& mi) {
+    void FSUSER_CreateSysSaveData_(MethodInterface& mi) {
         bool good = true;
         s8 duplicate_data;
         s32 high, low, total_size, block_size, number_directories, number_files, number_directory_buckets, number_file_buckets;
@@ -924,10 +1764,11 @@ namespace ArticFunctions {
         sinfo.saveId = low;
 
         Result res = FSUSER_CreateSystemSaveData(sinfo, (u32)total_size, (u32)block_size, (u32)number_directories, (u32)number_files, (u32)number_directory_buckets, (u32)number_file_buckets, duplicate_data != 0);
+        Memo::Invalidate(Memo::UNTIL_WRITE);
         mi.FinishGood(res);
     }
 
-    void FSFILE_Close_(ArticProtocolServer::MethodInterface& mi) {
+    void FSFILE_Close_(MethodInterface& mi) {
         bool good = true;
         s32 handle;
 
@@ -937,13 +1778,13 @@ namespace ArticFunctions {
 
         if (!good) return;
 
-        Result res = FSFILE_Close(handle);
-        openHandles.erase((u64)handle);
+        Result res = CloseFile(handle);
+        mi.SetTraceTarget(handle, 0, 0);
 
         mi.FinishGood(res);
     }
 
-    void FSFILE_SetSize_(ArticProtocolServer::MethodInterface& mi) {
+    void FSFILE_SetSize_(MethodInterface& mi) {
         bool good = true;
         s32 handle;
         s64 size;
@@ -955,12 +1796,16 @@ namespace ArticFunctions {
 
         if (!good) return;
 
-        Result res = FSFILE_SetSize(handle, size);
+        Result res = writeBuffer.Flush(handle);
+        if (R_SUCCEEDED(res)) {
+            res = FSFILE_SetSize(handle, size);
+        }
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         mi.FinishGood(res);
     }
 
-    void FSFILE_GetSize_(ArticProtocolServer::MethodInterface& mi) {
+    void FSFILE_GetSize_(MethodInterface& mi) {
         bool good = true;
         s32 handle;
 
@@ -970,8 +1815,9 @@ namespace ArticFunctions {
 
         if (!good) return;
 
+        mi.SetTraceTarget(handle, 0, 0);
         u64 fileSize;
-        Result res = FSFILE_GetSize(handle, &fileSize);
+        Result res = writeBuffer.GetSize(handle, fileSize);
         if (R_FAILED(res)) {
             mi.FinishGood(res);
             return;
@@ -986,7 +1832,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void FSFILE_SetAttributes_(ArticProtocolServer::MethodInterface& mi) {
+    void FSFILE_SetAttributes_(MethodInterface& mi) {
         bool good = true;
         s32 handle;
         s32 attributes;
@@ -1003,7 +1849,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void FSFILE_GetAttributes_(ArticProtocolServer::MethodInterface& mi) {
+    void FSFILE_GetAttributes_(MethodInterface& mi) {
         bool good = true;
         s32 handle;
 
@@ -1029,7 +1875,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void FSFILE_Read_(ArticProtocolServer::MethodInterface& mi) {
+    void FSFILE_Read_(MethodInterface& mi) {
         bool good = true;
         s32 handle, size;
         s64 offset;
@@ -1044,61 +1890,293 @@ namespace ArticFunctions {
         if (!good) return;
 
         logger.Debug("Read o=0x%08X, l=0x%08X", (u32)offset, (u32)size);
+        mi.SetTraceTarget(handle, offset, size);
 
-        ArticProtocolCommon::Buffer* read_buf = mi.ReserveResultBuffer(0, size);
+        bool compress;
+        ArticProtocolCommon::Buffer* read_buf = ReserveDataBuffer(mi, size, compress);
         if (!read_buf) {
             return;
         }
 
-        Result res = FSFILE_Read(handle, &bytes_read, offset, read_buf->data, read_buf->bufferSize);
+        Result res = writeBuffer.Read(handle, offset, read_buf->data, size, bytes_read);
         if (R_FAILED(res)) {
             mi.ResizeLastResultBuffer(read_buf, 0);
             mi.FinishGood(res);
             return;
         }
+        handleTable.AddAccess(handle, bytes_read);
 
-        mi.ResizeLastResultBuffer(read_buf, bytes_read);
+        if (!FinishDataBuffer(mi, read_buf, bytes_read, compress)) {
+            return;
+        }
         mi.FinishGood(res);
     }
 
-    void FSFILE_Write_(ArticProtocolServer::MethodInterface& mi) {
+    namespace ReadVector {
+        struct Range {
+            s64 offset;
+            u32 size;
+            u32 reserved;
+        };
+        static_assert(sizeof(Range) == 0x10);
+
+        struct Span {
+            u64 start;
+            u64 end;
+            size_t dataOffset;
+            u32 bytesRead;
+        };
+
+        static constexpr u32 MAX_RANGES = 128;
+        // The response is held in memory twice, bound what one request can ask
+        static constexpr u32 MAX_RANGE_SIZE = 0x100000;
+        static constexpr u32 MAX_DATA = 0x200000;
+        // Ranges closer than this are read with a single FS call, the bytes
+        // between them are read and dropped
+        static constexpr u32 MAX_GAP = 0x200;
+    }
+
+    // s32 handle, then a buffer of Range. Returns one u32 with the bytes read
+    // for every range, in request order, followed by the data of the ranges in
+    // the same order. Ranges are sorted and merged into as few reads as possible.
+    void FSFILE_ReadVector_(MethodInterface& mi) {
+        using namespace ReadVector;
         bool good = true;
-        s32 handle, size, flags;
-        s64 offset;
-        u32 bytes_written;
-        void* dataPtr; size_t dataPtrSize;
+        s32 handle;
+        void* rangesPtr; size_t rangesSize;
 
         if (good) good = mi.GetParameterS32(handle);
-        if (good) good = mi.GetParameterS64(offset);
-        if (good) good = mi.GetParameterS32(size);
-        if (good) good = mi.GetParameterS32(flags);
-        if (good) good = mi.GetParameterBuffer(dataPtr, dataPtrSize);
+        if (good) good = mi.GetParameterBuffer(rangesPtr, rangesSize);
 
         if (good) good = mi.FinishInputParameters();
 
         if (!good) return;
 
-        if (dataPtrSize != size) {
+        u32 count = rangesSize / sizeof(Range);
+        if (count == 0 || count > MAX_RANGES || rangesSize % sizeof(Range) != 0) {
             mi.FinishInternalError();
             return;
         }
 
-        Result res = FSFILE_Write(handle, &bytes_written, offset, dataPtr, size, flags);
-        if (R_FAILED(res)) {
-            mi.FinishGood(res);
+        // Cannot use output buffer while using input at the same time, need to allocate
+        Range* ranges = (Range*)malloc(count * (sizeof(Range) + sizeof(u16) * 2 + sizeof(Span)));
+        if (!ranges) {
+            mi.FinishInternalError();
             return;
         }
-
-        ArticProtocolCommon::Buffer* bytes_written_buf = mi.ReserveResultBuffer(0, sizeof(u32));
-        if (!bytes_written_buf) {
-            return;
+        u16* order = reinterpret_cast<u16*>(ranges + count);
+        u16* rangeSpan = order + count;
+        Span* spans = reinterpret_cast<Span*>(rangeSpan + count);
+        memcpy(ranges, rangesPtr, count * sizeof(Range));
+
+        // Checked before adding, so the total cannot wrap. A valid offset
+        // plus a u32 size always fits in a u64.
+        size_t dataSize = 0;
+        for (u32 i = 0; i < count; i++) {
+            if (ranges[i].offset < 0 || ranges[i].size > MAX_RANGE_SIZE || ranges[i].size > MAX_DATA - dataSize) {
+                logger.Error("ReadVector: Range %u is invalid or too large", (unsigned int)i);
+                free(ranges);
+                mi.FinishInternalError();
+                return;
+            }
+            dataSize += ranges[i].size;
+            order[i] = i;
+        }
+        std::sort(order, order + count, [ranges](u16 a, u16 b) {
+            return ranges[a].offset < ranges[b].offset;
+        });
+
+        u32 spanCount = 0;
+        size_t spanSize = 0;
+        for (u32 i = 0; i < count; i++) {
+            const Range& range = ranges[order[i]];
+            u64 start = range.offset, end = start + range.size;
+            if (spanCount == 0 || start > spans[spanCount - 1].end + MAX_GAP) {
+                spans[spanCount++] = {start, end, 0, 0};
+            } else if (end > spans[spanCount - 1].end) {
+                spans[spanCount - 1].end = end;
+            }
+            rangeSpan[order[i]] = spanCount - 1;
+        }
+        for (u32 i = 0; i < spanCount; i++) {
+            spans[i].dataOffset = spanSize;
+            spanSize += spans[i].end - spans[i].start;
+        }
+        logger.Debug("ReadVector %d ranges in %d reads", (int)count, (int)spanCount);
+        mi.SetTraceTarget(handle, spans[0].start, dataSize);
+
+        u8* spanData = (u8*)malloc(spanSize);
+        if (!spanData && spanSize != 0) {
+            free(ranges);
+            mi.FinishInternalError();
+            return;
+        }
+        Result res = 0;
+        for (u32 i = 0; i < spanCount && R_SUCCEEDED(res); i++) {
+            res = writeBuffer.Read(handle, spans[i].start, spanData + spans[i].dataOffset,
+                static_cast<u32>(spans[i].end - spans[i].start), spans[i].bytesRead);
+        }
+        if (R_FAILED(res)) {
+            free(spanData);
+            free(ranges);
+            mi.FinishGood(res);
+            return;
+        }
+
+        bool compress;
+        size_t tableSize = count * sizeof(u32);
+        ArticProtocolCommon::Buffer* read_buf = ReserveDataBuffer(mi, tableSize + dataSize, compress);
+        if (!read_buf) {
+            free(spanData);
+            free(ranges);
+            return;
+        }
+
+        u8* out = reinterpret_cast<u8*>(read_buf->data) + tableSize;
+        for (u32 i = 0; i < count; i++) {
+            const Span& span = spans[rangeSpan[i]];
+            u64 available = span.start + span.bytesRead;
+            u64 offset = static_cast<u64>(ranges[i].offset);
+            u32 bytes = offset < available ? static_cast<u32>(std::min<u64>(ranges[i].size, available - offset)) : 0;
+            memcpy(out, spanData + span.dataOffset + (offset - span.start), bytes);
+            memcpy(read_buf->data + i * sizeof(u32), &bytes, sizeof(u32));
+            out += bytes;
+        }
+        Stats::AddCopiedBytes(out - (reinterpret_cast<u8*>(read_buf->data) + tableSize));
+        handleTable.AddAccess(handle, out - (reinterpret_cast<u8*>(read_buf->data) + tableSize));
+        free(spanData);
+        free(ranges);
+
+        if (!FinishDataBuffer(mi, read_buf, out - reinterpret_cast<u8*>(read_buf->data), compress)) {
+            return;
+        }
+        mi.FinishGood(0);
+    }
+
+    // s32 handle, s64 offset, s64 size (0 for the whole file), s32 chunk size
+    // (0 for the default), s32 initial credits. Returns a FileStreamer::StartInfo,
+    // the chunks are pushed on the side connection at its port.
+    void FSFILE_StreamStart_(MethodInterface& mi) {
+        bool good = true;
+        s32 handle, chunkSize, credits;
+        s64 offset, size;
+
+        if (good) good = mi.GetParameterS32(handle);
+        if (good) good = mi.GetParameterS64(offset);
+        if (good) good = mi.GetParameterS64(size);
+        if (good) good = mi.GetParameterS32(chunkSize);
+        if (good) good = mi.GetParameterS32(credits);
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        if (offset < 0 || size < 0 || chunkSize < 0 || credits < 0) {
+            mi.FinishInternalError();
+            return;
+        }
+
+        if (!fileStreamer.Start()) {
+            mi.FinishInternalError();
+            return;
+        }
+
+        // The streamer reads the FS directly
+        u32 streamID = 0;
+        Result res = writeBuffer.Flush(handle);
+        if (R_SUCCEEDED(res)) {
+            res = fileStreamer.Open(handle, offset, size, chunkSize, credits, streamID);
+        }
+        if (R_FAILED(res)) {
+            mi.FinishGood(res);
+            return;
+        }
+
+        ArticProtocolCommon::Buffer* info_buf = mi.ReserveResultBuffer(0, sizeof(FileStreamer::StartInfo));
+        if (!info_buf) {
+            fileStreamer.Cancel(streamID);
+            return;
+        }
+        FileStreamer::StartInfo info = {FileStreamer::PORT, streamID};
+        memcpy(info_buf->data, &info, sizeof(info));
+        mi.SetTraceTarget(handle, offset, size);
+
+        mi.FinishGood(0);
+    }
+
+    void FSFILE_StreamCredit_(MethodInterface& mi) {
+        bool good = true;
+        s32 streamID, credits;
+
+        if (good) good = mi.GetParameterS32(streamID);
+        if (good) good = mi.GetParameterS32(credits);
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        if (credits < 0) {
+            mi.FinishInternalError();
+            return;
+        }
+
+        mi.FinishGood(fileStreamer.AddCredits(streamID, credits));
+    }
+
+    void FSFILE_StreamCancel_(MethodInterface& mi) {
+        bool good = true;
+        s32 streamID;
+
+        if (good) good = mi.GetParameterS32(streamID);
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        mi.FinishGood(fileStreamer.Cancel(streamID));
+    }
+
+    void FSFILE_Write_(MethodInterface& mi) {
+        bool good = true;
+        s32 handle, size, flags;
+        s64 offset;
+        u32 bytes_written;
+        void* dataPtr; size_t dataPtrSize;
+
+        if (good) good = mi.GetParameterS32(handle);
+        if (good) good = mi.GetParameterS64(offset);
+        if (good) good = mi.GetParameterS32(size);
+        if (good) good = mi.GetParameterS32(flags);
+        if (good) good = mi.GetParameterBuffer(dataPtr, dataPtrSize);
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        if (dataPtrSize != size) {
+            mi.FinishInternalError();
+            return;
+        }
+
+        mi.SetTraceTarget(handle, offset, size);
+        Result res = writeBuffer.Write(handle, offset, dataPtr, size, flags, bytes_written);
+        Memo::Invalidate(Memo::UNTIL_WRITE);
+        if (R_FAILED(res)) {
+            mi.FinishGood(res);
+            return;
+        }
+        handleTable.AddAccess(handle, bytes_written);
+
+        ArticProtocolCommon::Buffer* bytes_written_buf = mi.ReserveResultBuffer(0, sizeof(u32));
+        if (!bytes_written_buf) {
+            return;
         }
 
         *reinterpret_cast<u32*>(bytes_written_buf->data) = bytes_written;
         mi.FinishGood(res);
     }
 
-    void FSFILE_Flush_(ArticProtocolServer::MethodInterface& mi) {
+    void FSFILE_Flush_(MethodInterface& mi) {
         bool good = true;
         s32 handle;
 
@@ -1108,12 +2186,16 @@ namespace ArticFunctions {
 
         if (!good) return;
 
-        Result res = FSFILE_Flush(handle);
+        Result res = writeBuffer.Flush(handle);
+        if (R_SUCCEEDED(res)) {
+            res = FSFILE_Flush(handle);
+        }
+        Memo::Invalidate(Memo::UNTIL_WRITE);
 
         mi.FinishGood(res);
     }
 
-    void FSDIR_Read_(ArticProtocolServer::MethodInterface& mi) {
+    void FSDIR_Read_(MethodInterface& mi) {
         bool good = true;
         s32 handle;
         s32 entryCount;
@@ -1125,6 +2207,7 @@ namespace ArticFunctions {
 
         if (!good) return;
 
+        mi.SetTraceTarget(handle, 0, entryCount);
         ArticProtocolCommon::Buffer* read_dir_buf = mi.ReserveResultBuffer(0, entryCount * sizeof(FS_DirectoryEntry));
         if (!read_dir_buf) {
             return;
@@ -1139,10 +2222,11 @@ namespace ArticFunctions {
         }
 
         mi.ResizeLastResultBuffer(read_dir_buf, entries_read * sizeof(FS_DirectoryEntry));
+        handleTable.AddAccess(handle, entries_read * sizeof(FS_DirectoryEntry));
         mi.FinishGood(res);
     }
 
-    void FSDIR_Close_(ArticProtocolServer::MethodInterface& mi) {
+    void FSDIR_Close_(MethodInterface& mi) {
         bool good = true;
         s32 handle;
 
@@ -1153,12 +2237,124 @@ namespace ArticFunctions {
         if (!good) return;
 
         Result res = FSDIR_Close(handle);
-        openHandles.erase((u64)handle);
+        RemoveOpenHandle((u64)handle);
+        mi.SetTraceTarget(handle, 0, 0);
 
         mi.FinishGood(res);
     }
 
-    void AM_GetTitleCount_(ArticProtocolServer::MethodInterface& mi) {
+    namespace ListDirectory {
+        // Every entry is a header, the u64 file size if it is not a directory,
+        // then the name (UTF-16), short name and short extension (ASCII)
+        // without terminators. Entries are packed, may be unaligned.
+        struct EntryHeader {
+            u8 flags;
+            u8 shortNameLength;
+            u16 nameLength;
+            u8 shortExtLength;
+        } __attribute__((packed));
+        static_assert(sizeof(EntryHeader) == 5);
+
+        static constexpr u8 FLAG_DIRECTORY = 1 << 0;
+        static constexpr u8 FLAG_HIDDEN = 1 << 1;
+        static constexpr u8 FLAG_ARCHIVE = 1 << 2;
+        static constexpr u8 FLAG_READ_ONLY = 1 << 3;
+
+        // Entries read from the FS at a time
+        static constexpr u32 READ_COUNT = 16;
+
+        template <typename T, size_t N>
+        static size_t TerminatedLength(const T (&str)[N]) {
+            size_t length = 0;
+            while (length < N && str[length] != 0) length++;
+            return length;
+        }
+
+        static void Append(std::vector<u8>& out, const FS_DirectoryEntry& entry) {
+            EntryHeader header;
+            header.flags = ((entry.attributes & FS_ATTRIBUTE_DIRECTORY) ? FLAG_DIRECTORY : 0) |
+                ((entry.attributes & FS_ATTRIBUTE_HIDDEN) ? FLAG_HIDDEN : 0) |
+                ((entry.attributes & FS_ATTRIBUTE_ARCHIVE) ? FLAG_ARCHIVE : 0) |
+                ((entry.attributes & FS_ATTRIBUTE_READ_ONLY) ? FLAG_READ_ONLY : 0);
+            header.nameLength = TerminatedLength(entry.name);
+            header.shortNameLength = TerminatedLength(entry.shortName);
+            header.shortExtLength = TerminatedLength(entry.shortExt);
+
+            bool hasSize = !(header.flags & FLAG_DIRECTORY);
+            size_t pos = out.size();
+            out.resize(pos + sizeof(EntryHeader) + (hasSize ? sizeof(u64) : 0) + header.nameLength * sizeof(u16) +
+                header.shortNameLength + header.shortExtLength);
+            u8* p = out.data() + pos;
+            memcpy(p, &header, sizeof(EntryHeader)); p += sizeof(EntryHeader);
+            if (hasSize) {
+                memcpy(p, &entry.fileSize, sizeof(u64)); p += sizeof(u64);
+            }
+            memcpy(p, entry.name, header.nameLength * sizeof(u16)); p += header.nameLength * sizeof(u16);
+            memcpy(p, entry.shortName, header.shortNameLength); p += header.shortNameLength;
+            memcpy(p, entry.shortExt, header.shortExtLength);
+        }
+    }
+
+    // Opens, reads and closes a directory in one call. Returns the u32 entry
+    // count followed by the entries, see ListDirectory::EntryHeader.
+    void FSUSER_ListDirectory_(MethodInterface& mi) {
+        using namespace ListDirectory;
+        bool good = true;
+
+        FS_Archive archive;
+        FS_Path dirPath;
+
+        if (good) good = mi.GetParameterS64(*reinterpret_cast<s64*>(&archive));
+        if (good) good = GetFSPath(mi, dirPath);
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        Handle dir;
+        Result res = FSUSER_OpenDirectory(&dir, archive, dirPath);
+        if (R_FAILED(res)) {
+            mi.FinishGood(res);
+            return;
+        }
+
+        FS_DirectoryEntry* entries = (FS_DirectoryEntry*)malloc(READ_COUNT * sizeof(FS_DirectoryEntry));
+        if (!entries) {
+            FSDIR_Close(dir);
+            mi.FinishInternalError();
+            return;
+        }
+        std::vector<u8> list(sizeof(u32));
+        u32 count = 0;
+        while (true) {
+            u32 entries_read = 0;
+            res = FSDIR_Read(dir, &entries_read, READ_COUNT, entries);
+            if (R_FAILED(res) || entries_read == 0) break;
+            for (u32 i = 0; i < entries_read; i++) {
+                Append(list, entries[i]);
+            }
+            count += entries_read;
+        }
+        free(entries);
+        FSDIR_Close(dir);
+        mi.SetTraceTarget(0, 0, count);
+        if (R_FAILED(res)) {
+            mi.FinishGood(res);
+            return;
+        }
+        memcpy(list.data(), &count, sizeof(u32));
+
+        ArticProtocolCommon::Buffer* list_buf = mi.ReserveResultBuffer(0, list.size());
+        if (!list_buf) {
+            return;
+        }
+        memcpy(list_buf->data, list.data(), list.size());
+        Stats::AddCopiedBytes(list.size());
+
+        mi.FinishGood(0);
+    }
+
+    void AM_GetTitleCount_(MethodInterface& mi) {
         bool good = true;
         s8 mediatype;
 
@@ -1192,7 +2388,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void AM_GetTitleList_(ArticProtocolServer::MethodInterface& mi) {
+    void AM_GetTitleList_(MethodInterface& mi) {
         bool good = true;
         s32 count;
         s8 mediatype;
@@ -1230,7 +2426,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void AM_GetTitleInfo_(ArticProtocolServer::MethodInterface& mi) {
+    void AM_GetTitleInfo_(MethodInterface& mi) {
         bool good = true;
         s8 mediatype;
         s8 ignorePlatform;
@@ -1278,7 +2474,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void AMAPP_GetDLCContentInfoCount_(ArticProtocolServer::MethodInterface& mi) {
+    void AMAPP_GetDLCContentInfoCount_(MethodInterface& mi) {
         bool good = true;
         s8 mediatype;
         s64 title_id;
@@ -1314,7 +2510,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void AMAPP_FindDLCContentInfos_(ArticProtocolServer::MethodInterface& mi) {
+    void AMAPP_FindDLCContentInfos_(MethodInterface& mi) {
         bool good = true;
         s8 mediatype;
         s64 title_id;
@@ -1358,7 +2554,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void AMAPP_ListDLCContentInfos_(ArticProtocolServer::MethodInterface& mi) {
+    void AMAPP_ListDLCContentInfos_(MethodInterface& mi) {
         bool good = true;
         s32 count;
         s8 mediatype;
@@ -1400,7 +2596,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void AMAPP_GetDLCTitleInfos_(ArticProtocolServer::MethodInterface& mi) {
+    void AMAPP_GetDLCTitleInfos_(MethodInterface& mi) {
         bool good = true;
         s8 mediatype;
         void* titleList; size_t titleListSize;
@@ -1442,7 +2638,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void AMAPP_ListDataTitleTicketInfos_(ArticProtocolServer::MethodInterface& mi) {
+    void AMAPP_ListDataTitleTicketInfos_(MethodInterface& mi) {
         bool good = true;
         s32 count;
         s64 title_id;
@@ -1482,7 +2678,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void AMAPP_GetPatchTitleInfos_(ArticProtocolServer::MethodInterface& mi) {
+    void AMAPP_GetPatchTitleInfos_(MethodInterface& mi) {
         bool good = true;
         s8 mediatype;
         void* titleList; size_t titleListSize;
@@ -1524,7 +2720,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void CFGU_GetConfigInfoBlk2_(ArticProtocolServer::MethodInterface& mi) {
+    void CFGU_GetConfigInfoBlk2_(MethodInterface& mi) {
         bool good = true;
         s32 block_id, size;
 
@@ -1558,6 +2754,449 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
+    namespace Batch {
+        enum class Op : u8 {
+            OPEN_FILE = 0,
+            OPEN_FILE_DIRECTLY = 1,
+            FILE_GET_SIZE = 2,
+            FILE_READ = 3,
+            FILE_CLOSE = 4,
+            OPEN_DIRECTORY = 5,
+            DIR_READ = 6,
+            DIR_CLOSE = 7,
+        };
+
+        // The handle field holds the index of an earlier sub-call in the same
+        // batch, whose returned handle is used instead.
+        static constexpr u8 FLAG_HANDLE_REF = 1 << 0;
+        static constexpr u32 MAX_SUBCALLS = 64;
+        // Data a single sub-call and the whole batch may return. Checked
+        // before anything is reserved, so the sizes cannot wrap around.
+        static constexpr u32 MAX_SUBCALL_DATA = 0x100000;
+        static constexpr u32 MAX_BATCH_DATA = 0x200000;
+        // Same value the kernel returns for an invalid handle
+        static constexpr Result RESULT_BAD_REFERENCE = (Result)0xD8E007F7;
+
+        struct SubCallHeader {
+            Op op;
+            u8 flags;
+            u16 reserved;
+        };
+        static_assert(sizeof(SubCallHeader) == 4);
+
+        struct ResultHeader {
+            s32 result;
+            u32 dataSize;
+        };
+        static_assert(sizeof(ResultHeader) == 8);
+
+        class Reader {
+        public:
+            Reader(const u8* data, size_t size) : cur(data), end(data + size) {}
+
+            template<typename T>
+            bool Read(T& out) {
+                if (static_cast<size_t>(end - cur) < sizeof(T)) return false;
+                memcpy(&out, cur, sizeof(T));
+                cur += sizeof(T);
+                return true;
+            }
+
+            // Same layout as the path parameters: u32 type, u32 size, data
+            bool ReadPath(FS_Path& path) {
+                u32 type, size;
+                if (!Read(type) || !Read(size)) return false;
+                if (static_cast<size_t>(end - cur) < size) return false;
+                path.type = static_cast<FS_PathType>(type);
+                path.size = size;
+                path.data = cur;
+                cur += size;
+                return true;
+            }
+
+            bool AtEnd() const {
+                return cur == end;
+            }
+
+        private:
+            const u8* cur;
+            const u8* end;
+        };
+
+        struct SubCall {
+            SubCallHeader header;
+            s32 handle;
+            s64 archive;
+            s32 archiveID;
+            FS_Path archivePath;
+            FS_Path path;
+            s32 openFlags;
+            s32 attributes;
+            s64 offset;
+            u32 size;
+        };
+
+        static bool ParseSubCall(Reader& reader, SubCall& call) {
+            if (!reader.Read(call.header)) return false;
+            switch (call.header.op)
+            {
+            case Op::OPEN_FILE:
+                return reader.Read(call.archive) && reader.ReadPath(call.path) &&
+                    reader.Read(call.openFlags) && reader.Read(call.attributes);
+            case Op::OPEN_FILE_DIRECTLY:
+                return reader.Read(call.archiveID) && reader.ReadPath(call.archivePath) && reader.ReadPath(call.path) &&
+                    reader.Read(call.openFlags) && reader.Read(call.attributes);
+            case Op::OPEN_DIRECTORY:
+                return reader.Read(call.archive) && reader.ReadPath(call.path);
+            case Op::FILE_GET_SIZE:
+            case Op::FILE_CLOSE:
+            case Op::DIR_CLOSE:
+                return reader.Read(call.handle);
+            case Op::FILE_READ:
+                return reader.Read(call.handle) && reader.Read(call.offset) && reader.Read(call.size);
+            case Op::DIR_READ:
+                return reader.Read(call.handle) && reader.Read(call.size);
+            default:
+                return false;
+            }
+        }
+
+        static bool HasArchivePath(const SubCall& call) {
+            return call.header.op == Op::OPEN_FILE_DIRECTLY;
+        }
+
+        static bool HasPath(const SubCall& call) {
+            return call.header.op == Op::OPEN_FILE || call.header.op == Op::OPEN_FILE_DIRECTLY ||
+                call.header.op == Op::OPEN_DIRECTORY;
+        }
+
+        static size_t PathDataSize(const SubCall& call) {
+            return (HasArchivePath(call) ? call.archivePath.size : 0) + (HasPath(call) ? call.path.size : 0);
+        }
+
+        // Copies the path data of the sub-call to out and points the paths to
+        // the copy, returns the end of the copied data
+        static u8* MovePathData(SubCall& call, u8* out) {
+            if (HasArchivePath(call)) {
+                memcpy(out, call.archivePath.data, call.archivePath.size);
+                call.archivePath.data = out;
+                out += call.archivePath.size;
+            }
+            if (HasPath(call)) {
+                memcpy(out, call.path.data, call.path.size);
+                call.path.data = out;
+                out += call.path.size;
+            }
+            return out;
+        }
+
+        static u64 MaxResultSize(const SubCall& call) {
+            switch (call.header.op)
+            {
+            case Op::OPEN_FILE:
+            case Op::OPEN_FILE_DIRECTLY:
+                return sizeof(Handle) + sizeof(u64);
+            case Op::OPEN_DIRECTORY:
+                return sizeof(Handle);
+            case Op::FILE_GET_SIZE:
+                return sizeof(u64);
+            case Op::FILE_READ:
+                return call.size;
+            case Op::DIR_READ:
+                return static_cast<u64>(call.size) * sizeof(FS_DirectoryEntry);
+            default:
+                return 0;
+            }
+        }
+
+        // Sub-calls that change what later ones see: opens that may create
+        // or write the file, and file closes, which flush buffered writes
+        static bool IsBarrier(const SubCall& call) {
+            switch (call.header.op)
+            {
+            case Op::OPEN_FILE:
+            case Op::OPEN_FILE_DIRECTLY:
+                return call.openFlags != FS_OPEN_READ;
+            case Op::FILE_CLOSE:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        struct State;
+        struct TaskArg {
+            State* state;
+            u32 index;
+        };
+
+        struct State {
+            SubCall calls[MAX_SUBCALLS];
+            Handle handles[MAX_SUBCALLS];
+            Result results[MAX_SUBCALLS];
+            u32 dataSizes[MAX_SUBCALLS];
+            // Sub-calls write their data at a fixed offset in the result buffer,
+            // so they can run concurrently. The results are compacted at the end.
+            size_t offsets[MAX_SUBCALLS];
+            u64 keys[MAX_SUBCALLS];
+            TaskArg tasks[MAX_SUBCALLS];
+            u8* resultData;
+        };
+
+        // Sub-calls on the same handle share a key, so the pool runs them in order.
+        // Handles opened inside the batch get a key that cannot be a real handle.
+        static constexpr u64 BATCH_KEY = 1ULL << 32;
+
+        static void ExecuteSubCall(void* arg) {
+            TaskArg* task = reinterpret_cast<TaskArg*>(arg);
+            State* state = task->state;
+            u32 i = task->index;
+            SubCall& call = state->calls[i];
+            u8* data = state->resultData + state->offsets[i] + sizeof(ResultHeader);
+            u32 dataSize = 0;
+            Result res = 0;
+
+            Handle handle = static_cast<Handle>(call.handle);
+            if (call.header.flags & FLAG_HANDLE_REF) {
+                u32 ref = static_cast<u32>(call.handle);
+                if (ref >= i) {
+                    res = RESULT_BAD_REFERENCE;
+                } else if (R_FAILED(state->results[ref])) {
+                    res = state->results[ref];
+                } else {
+                    handle = state->handles[ref];
+                }
+            }
+
+            if (R_SUCCEEDED(res)) {
+                switch (call.header.op)
+                {
+                case Op::OPEN_FILE:
+                case Op::OPEN_FILE_DIRECTLY:
+                {
+                    bool direct = call.header.op == Op::OPEN_FILE_DIRECTLY;
+                    NegativeCache::Probe probe;
+                    bool create = call.openFlags & FS_OPEN_CREATE;
+                    bool probed = !create && (direct ? negativeCache.MakeProbe(call.archiveID, call.archivePath, call.path, probe) :
+                        negativeCache.MakeProbe(NegativeCache::Kind::FILE, call.archive, call.path, probe));
+                    if (probed && negativeCache.Lookup(probe, res)) break;
+                    bool readOnly = direct ? IsReadOnlyContent(call.archiveID, call.path, call.openFlags) :
+                        call.openFlags == FS_OPEN_READ && handleCache.IsReadOnlyArchive(call.archive);
+                    HandleCache::Key key;
+                    s64 size = HandleCache::UNKNOWN_SIZE;
+                    bool cached = false;
+                    if (readOnly) {
+                        key = direct ? HandleCache::MakeKey(call.archiveID, call.archivePath, call.path) :
+                            HandleCache::MakeKey(call.archive, call.path);
+                        cached = AcquireCachedFile(key, handle, size, true);
+                    }
+                    if (!cached) {
+                        if (direct) {
+                            res = FSUSER_OpenFileDirectly(&handle, (FS_ArchiveID)call.archiveID, call.archivePath, call.path, call.openFlags, call.attributes);
+                            if (create) ArchiveChanged();
+                        } else {
+                            res = FSUSER_OpenFile(&handle, call.archive, call.path, call.openFlags, call.attributes);
+                            if (create) ArchiveChanged();
+                        }
+                        if (probed) negativeCache.Insert(probe, res);
+                        if (R_FAILED(res)) break;
+                        u64 fileSize;
+                        if (R_SUCCEEDED(FSFILE_GetSize(handle, &fileSize))) size = static_cast<s64>(fileSize);
+                        if (direct && readOnly) {
+                            readAhead.Register(handle);
+                            blockCache.Register(handle, call.archiveID, call.archivePath, call.path);
+                        } else if (readOnly) {
+                            RegisterReadOnlyFile(handle, call.path);
+                        }
+                        AddOpenedFile(readOnly ? &key : nullptr, handle, size, call.path, direct ? 0 : call.archive);
+                        if (!direct && (call.openFlags & FS_OPEN_WRITE) && writeBuffer.IsBufferedArchive(call.archive)) {
+                            writeBuffer.Register(handle, call.archive);
+                        }
+                    }
+                    u64 fileSize = size == HandleCache::UNKNOWN_SIZE ? 0 : size;
+                    memcpy(data, &handle, sizeof(Handle));
+                    memcpy(data + sizeof(Handle), &fileSize, sizeof(u64));
+                    dataSize = sizeof(Handle) + sizeof(u64);
+                    state->handles[i] = handle;
+                    break;
+                }
+                case Op::OPEN_DIRECTORY:
+                {
+                    NegativeCache::Probe probe;
+                    bool probed = negativeCache.MakeProbe(NegativeCache::Kind::DIRECTORY, call.archive, call.path, probe);
+                    if (probed && negativeCache.Lookup(probe, res)) break;
+                    res = FSUSER_OpenDirectory(&handle, call.archive, call.path);
+                    if (probed) negativeCache.Insert(probe, res);
+                    if (R_FAILED(res)) break;
+                    memcpy(data, &handle, sizeof(Handle));
+                    dataSize = sizeof(Handle);
+                    state->handles[i] = handle;
+                    AddOpenHandle((u64)handle, HandleType::DIR, call.archive, HandleTable::HashPath(call.path));
+                    break;
+                }
+                case Op::FILE_GET_SIZE:
+                {
+                    u64 fileSize;
+                    res = writeBuffer.GetSize(handle, fileSize);
+                    if (R_FAILED(res)) break;
+                    memcpy(data, &fileSize, sizeof(u64));
+                    dataSize = sizeof(u64);
+                    break;
+                }
+                case Op::FILE_READ:
+                {
+                    u32 bytes_read = 0;
+                    // Reads on the workers stay off the read-ahead, whose
+                    // prefetches need the workers too
+                    res = writeBuffer.Flush(handle);
+                    if (R_SUCCEEDED(res)) res = FSFILE_Read(handle, &bytes_read, call.offset, data, call.size);
+                    if (R_FAILED(res)) break;
+                    dataSize = bytes_read;
+                    handleTable.AddAccess(handle, bytes_read);
+                    break;
+                }
+                case Op::FILE_CLOSE:
+                    res = CloseFile(handle);
+                    break;
+                case Op::DIR_READ:
+                {
+                    u32 entries_read = 0;
+                    res = FSDIR_Read(handle, &entries_read, call.size, reinterpret_cast<FS_DirectoryEntry*>(data));
+                    if (R_FAILED(res)) break;
+                    dataSize = entries_read * sizeof(FS_DirectoryEntry);
+                    handleTable.AddAccess(handle, dataSize);
+                    break;
+                }
+                case Op::DIR_CLOSE:
+                    res = FSDIR_Close(handle);
+                    RemoveOpenHandle((u64)handle);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            state->results[i] = res;
+            state->dataSizes[i] = dataSize;
+        }
+    }
+
+    // Runs an ordered list of sub-calls and returns all their results in one response:
+    // for every sub-call, s32 result, u32 data size and the data. Sub-calls on
+    // different handles run concurrently on the worker pool, except barriers
+    // (see IsBarrier), which run once every earlier sub-call is done and before
+    // any later one starts, so the results are the same as running the list in
+    // order.
+    void Batch_(MethodInterface& mi) {
+        using namespace Batch;
+        bool good = true;
+        void* batchPtr; size_t batchSize;
+
+        if (good) good = mi.GetParameterBuffer(batchPtr, batchSize);
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        State* state = (State*)malloc(sizeof(State));
+        if (!state) {
+            mi.FinishInternalError();
+            return;
+        }
+        mi.SetTraceTarget(0, 0, batchSize);
+
+        Reader reader(reinterpret_cast<const u8*>(batchPtr), batchSize);
+        u32 count = 0;
+        size_t resultSize = 0;
+        size_t pathSize = 0;
+        while (!reader.AtEnd()) {
+            if (count == MAX_SUBCALLS || !ParseSubCall(reader, state->calls[count])) {
+                free(state);
+                mi.FinishInternalError();
+                return;
+            }
+            // resultSize stays below MAX_BATCH_DATA, and the paths lie in
+            // the batch buffer so their sizes cannot add up past its size
+            u64 callSize = MaxResultSize(state->calls[count]);
+            if (callSize > MAX_SUBCALL_DATA || sizeof(ResultHeader) + callSize > MAX_BATCH_DATA - resultSize) {
+                logger.Error("Batch: Sub-call %u returns too much data", (unsigned int)count);
+                free(state);
+                mi.FinishInternalError();
+                return;
+            }
+            pathSize += PathDataSize(state->calls[count]);
+            state->offsets[count] = resultSize;
+            resultSize += sizeof(ResultHeader) + static_cast<size_t>(callSize);
+            count++;
+        }
+
+        // Cannot use output buffer while using input at the same time. Only the
+        // paths are still needed, so those are the only part that is copied.
+        u8* pathData = nullptr;
+        if (pathSize != 0) {
+            pathData = (u8*)malloc(pathSize);
+            if (!pathData) {
+                free(state);
+                mi.FinishInternalError();
+                return;
+            }
+            u8* cur = pathData;
+            for (u32 i = 0; i < count; i++) {
+                cur = MovePathData(state->calls[i], cur);
+            }
+            Stats::AddCopiedBytes(pathSize);
+        }
+
+        ArticProtocolCommon::Buffer* result_buf = mi.ReserveResultBuffer(0, resultSize);
+        if (!result_buf) {
+            free(pathData);
+            free(state);
+            return;
+        }
+        state->resultData = reinterpret_cast<u8*>(result_buf->data);
+
+        workerPool.Start(WorkerPool::DEFAULT_WORKERS);
+        WorkerPool::Group group;
+        for (u32 i = 0; i < count; i++) {
+            SubCall& call = state->calls[i];
+            u32 ref = static_cast<u32>(call.handle);
+            if ((call.header.flags & FLAG_HANDLE_REF) && ref < i) {
+                state->keys[i] = state->keys[ref];
+            } else if (call.header.op == Op::OPEN_FILE || call.header.op == Op::OPEN_FILE_DIRECTLY ||
+                call.header.op == Op::OPEN_DIRECTORY || (call.header.flags & FLAG_HANDLE_REF)) {
+                state->keys[i] = BATCH_KEY | i;
+            } else {
+                state->keys[i] = static_cast<u32>(call.handle);
+            }
+            state->handles[i] = 0;
+            state->tasks[i] = {state, i};
+            bool barrier = IsBarrier(call);
+            if (barrier) group.Wait();
+            workerPool.Submit(state->keys[i], ExecuteSubCall, &state->tasks[i], &group);
+            if (barrier) group.Wait();
+        }
+        group.Wait();
+
+        u8* out = state->resultData;
+        for (u32 i = 0; i < count; i++) {
+            u8* data = state->resultData + state->offsets[i] + sizeof(ResultHeader);
+            // Sub-call results are packed back to back, may be unaligned
+            ResultHeader resHeader = {state->results[i], state->dataSizes[i]};
+            memcpy(out, &resHeader, sizeof(ResultHeader));
+            out += sizeof(ResultHeader);
+            if (out != data) {
+                memmove(out, data, resHeader.dataSize);
+                Stats::AddCopiedBytes(resHeader.dataSize);
+            }
+            out += resHeader.dataSize;
+        }
+
+        mi.ResizeLastResultBuffer(result_buf, out - state->resultData);
+        free(pathData);
+        free(state);
+        mi.FinishGood(0);
+    }
+
     void ArticController::Handler(void* arg) {
         using namespace ArticController;
 
@@ -1658,7 +3297,7 @@ namespace ArticFunctions {
     }
 
     static bool stopController(void);
-    void Controller_Start(ArticProtocolServer::MethodInterface& mi) {
+    void Controller_Start(MethodInterface& mi) {
         bool good = true;
 
         if (good) good = mi.FinishInputParameters();
@@ -1690,7 +3329,7 @@ namespace ArticFunctions {
         mi.FinishGood(0);
     }
 
-    void HIDUSER_EnableAccelerometer_(ArticProtocolServer::MethodInterface& mi) {
+    void HIDUSER_EnableAccelerometer_(MethodInterface& mi) {
         bool good = true;
 
         if (good) mi.FinishInputParameters();
@@ -1700,7 +3339,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void HIDUSER_DisableAccelerometer_(ArticProtocolServer::MethodInterface& mi) {
+    void HIDUSER_DisableAccelerometer_(MethodInterface& mi) {
         bool good = true;
 
         if (good) mi.FinishInputParameters();
@@ -1710,7 +3349,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void HIDUSER_EnableGyroscope_(ArticProtocolServer::MethodInterface& mi) {
+    void HIDUSER_EnableGyroscope_(MethodInterface& mi) {
         bool good = true;
 
         if (good) mi.FinishInputParameters();
@@ -1720,7 +3359,7 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void HIDUSER_DisableGyroscope_(ArticProtocolServer::MethodInterface& mi) {
+    void HIDUSER_DisableGyroscope_(MethodInterface& mi) {
         bool good = true;
 
         if (good) mi.FinishInputParameters();
@@ -1730,11 +3369,13 @@ namespace ArticFunctions {
         mi.FinishGood(res);
     }
 
-    void HIDUSER_GetGyroscopeRawToDpsCoefficient_(ArticProtocolServer::MethodInterface& mi) {
+    void HIDUSER_GetGyroscopeRawToDpsCoefficient_(MethodInterface& mi) {
         bool good = true;
 
         if (good) mi.FinishInputParameters();
 
+        if (Memo::Replay(mi)) return;
+
         float coef;
         Result res = HIDUSER_GetGyroscopeRawToDpsCoefficient(&coef);
         if (R_FAILED(res)) {
@@ -1742,21 +3383,23 @@ namespace ArticFunctions {
             return;
         }
 
-        ArticProtocolCommon::Buffer* coef_buf = mi.ReserveResultBuffer(0, sizeof(float));
+        ArticProtocolCommon::Buffer* coef_buf = Memo::ReserveResultBuffer(mi, 0, sizeof(float));
         if (!coef_buf) {
             return;
         }
         *(float*)coef_buf->data = coef;
 
-        mi.FinishGood(res);
+        Memo::FinishGood(mi, res);
     }
 
     
-    void HIDUSER_GetGyroscopeCalibrateParam_(ArticProtocolServer::MethodInterface& mi) {
+    void HIDUSER_GetGyroscopeCalibrateParam_(MethodInterface& mi) {
         bool good = true;
 
         if (good) mi.FinishInputParameters();
 
+        if (Memo::Replay(mi)) return;
+
         GyroscopeCalibrateParam param = { 0 };
         Result res = HIDUSER_GetGyroscopeCalibrateParam(&param);
         if (R_FAILED(res)) {
@@ -1764,65 +3407,81 @@ namespace ArticFunctions {
             return;
         }
 
-        ArticProtocolCommon::Buffer* coef_buf = mi.ReserveResultBuffer(0, sizeof(param));
+        ArticProtocolCommon::Buffer* coef_buf = Memo::ReserveResultBuffer(mi, 0, sizeof(param));
         if (!coef_buf) {
             return;
         }
         *(GyroscopeCalibrateParam*)coef_buf->data = param;
 
-        mi.FinishGood(res);
-    }
-
-    template<std::size_t N>
-    constexpr auto& METHOD_NAME(char const (&s)[N]) {
-        static_assert(N < sizeof(ArticProtocolCommon::RequestPacket::method), "String exceeds 32 bytes!");
-        return s;
+        Memo::FinishGood(mi, res);
     }
 
-    std::map<std::string, void(*)(ArticProtocolServer::MethodInterface& mi)> functionHandlers = {
-        {METHOD_NAME("Process_GetTitleID"), Process_GetTitleID},
-        {METHOD_NAME("Process_GetProductInfo"), Process_GetProductInfo},
-        {METHOD_NAME("Process_GetExheader"), Process_GetExheader},
+    static void GetMethodOpcodes(MethodInterface& mi);
+    static void GetStats(MethodInterface& mi);
+    static void TraceStart(MethodInterface& mi);
+    static void TraceDump(MethodInterface& mi);
+    static void GetReadAheadStats(MethodInterface& mi);
+    static void GetBlockCacheStats(MethodInterface& mi);
+    static void SetCompression(MethodInterface& mi);
+    static void GetArchiveStats(MethodInterface& mi);
+    static void GetHandleStats(MethodInterface& mi);
+    static void GetWriteBufferStats(MethodInterface& mi);
+    static void SetAsyncWrites(MethodInterface& mi);
+    static void GetNegativeCacheStats(MethodInterface& mi);
+    static void GetMemoStats(MethodInterface& mi);
+
+    static constexpr MethodEntry methodEntries[] = {
+        {METHOD_NAME("Process_GetTitleID"), Process_GetTitleID, Memo::SESSION},
+        {METHOD_NAME("Process_GetProductInfo"), Process_GetProductInfo, Memo::SESSION},
+        {METHOD_NAME("Process_GetExheader"), Process_GetExheader, Memo::SESSION},
         {METHOD_NAME("Process_ReadCode"), Process_ReadCode},
         {METHOD_NAME("Process_ReadIcon"), Process_ReadIcon},
         {METHOD_NAME("Process_ReadBanner"), Process_ReadBanner},
         {METHOD_NAME("Process_ReadLogo"), Process_ReadLogo},
+        {METHOD_NAME("Process_Bootstrap"), Process_Bootstrap},
+        {METHOD_NAME("Process_ReadRomFSMetadata"), Process_ReadRomFSMetadata},
+        {METHOD_NAME("Process_ReadRomFS"), Process_ReadRomFS},
         {METHOD_NAME("FSUSER_OpenFileDirectly"), FSUSER_OpenFileDirectly_},
         {METHOD_NAME("FSUSER_OpenArchive"), FSUSER_OpenArchive_},
-        {METHOD_NAME("FSUSER_CloseArchive"), FSUSER_CloseArchive_},
-        {METHOD_NAME("FSUSER_OpenFile"), FSUSER_OpenFile_},
-        {METHOD_NAME("FSUSER_CreateFile"), FSUSER_CreateFile_},
-        {METHOD_NAME("FSUSER_DeleteFile"), FSUSER_DeleteFile_},
-        {METHOD_NAME("FSUSER_RenameFile"), FSUSER_RenameFile_},
-        {METHOD_NAME("FSUSER_OpenDirectory"), FSUSER_OpenDirectory_},
-        {METHOD_NAME("FSUSER_CreateDirectory"), FSUSER_CreateDirectory_},
-        {METHOD_NAME("FSUSER_DeleteDirectory"), FSUSER_DeleteDirectory_},
-        {METHOD_NAME("FSUSER_DeleteDirectoryRec"), FSUSER_DeleteDirectoryRecursively_},
-        {METHOD_NAME("FSUSER_RenameDirectory"), FSUSER_RenameDirectory_},
-        {METHOD_NAME("FSUSER_ControlArchive"), FSUSER_ControlArchive_},
-        {METHOD_NAME("FSUSER_GetFreeBytes"), FSUSER_GetFreeBytes_},
-        {METHOD_NAME("FSUSER_GetFormatInfo"), FSUSER_GetFormatInfo_},
+        {METHOD_NAME("FSUSER_CloseArchive"), FSUSER_CloseArchive_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_OpenFile"), FSUSER_OpenFile_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_CreateFile"), FSUSER_CreateFile_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_DeleteFile"), FSUSER_DeleteFile_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_RenameFile"), FSUSER_RenameFile_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_OpenDirectory"), FSUSER_OpenDirectory_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_CreateDirectory"), FSUSER_CreateDirectory_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_DeleteDirectory"), FSUSER_DeleteDirectory_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_DeleteDirectoryRec"), FSUSER_DeleteDirectoryRecursively_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_RenameDirectory"), FSUSER_RenameDirectory_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_ControlArchive"), FSUSER_ControlArchive_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_GetFreeBytes"), FSUSER_GetFreeBytes_, RequestOrder::EXCLUSIVE, Memo::UNTIL_WRITE},
+        {METHOD_NAME("FSUSER_GetFormatInfo"), FSUSER_GetFormatInfo_, RequestOrder::EXCLUSIVE, Memo::UNTIL_WRITE},
         {METHOD_NAME("FSUSER_FormatSaveData"), FSUSER_FormatSaveData_},
         {METHOD_NAME("FSUSER_ObsSetSaveDataSecureVal"), FSUSER_ObsoletedSetSaveDataSecureValue_},
         {METHOD_NAME("FSUSER_ObsGetSaveDataSecureVal"), FSUSER_ObsoletedGetSaveDataSecureValue_},
         {METHOD_NAME("FSUSER_ControlSecureSave"), FSUSER_ControlSecureSave_},
-        {METHOD_NAME("FSUSER_SetSaveDataSecureValue"), FSUSER_SetSaveDataSecureValue_},
-        {METHOD_NAME("FSUSER_GetSaveDataSecureValue"), FSUSER_GetSaveDataSecureValue_},
+        {METHOD_NAME("FSUSER_SetSaveDataSecureValue"), FSUSER_SetSaveDataSecureValue_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_GetSaveDataSecureValue"), FSUSER_GetSaveDataSecureValue_, RequestOrder::HANDLE},
         {METHOD_NAME("FSUSER_SetThisSaveDataSecVal"), FSUSER_SetThisSaveDataSecureValue_},
         {METHOD_NAME("FSUSER_GetThisSaveDataSecVal"), FSUSER_GetThisSaveDataSecureValue_},
         {METHOD_NAME("FSUSER_CreateExtSaveData"), FSUSER_CreateExtSaveData_},
         {METHOD_NAME("FSUSER_DeleteExtSaveData"), FSUSER_DeleteExtSaveData_},
         {METHOD_NAME("FSUSER_CreateSysSaveData"), FSUSER_CreateSysSaveData_},
-        {METHOD_NAME("FSFILE_Close"), FSFILE_Close_},
-        {METHOD_NAME("FSFILE_SetAttributes"), FSFILE_SetAttributes_},
-        {METHOD_NAME("FSFILE_GetAttributes"), FSFILE_GetAttributes_},
-        {METHOD_NAME("FSFILE_SetSize"), FSFILE_SetSize_},
-        {METHOD_NAME("FSFILE_GetSize"), FSFILE_GetSize_},
-        {METHOD_NAME("FSFILE_Read"), FSFILE_Read_},
-        {METHOD_NAME("FSFILE_Write"), FSFILE_Write_},
-        {METHOD_NAME("FSFILE_Flush"), FSFILE_Flush_},
-        {METHOD_NAME("FSDIR_Read"), FSDIR_Read_},
-        {METHOD_NAME("FSDIR_Close"), FSDIR_Close_},
+        {METHOD_NAME("FSFILE_Close"), FSFILE_Close_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSFILE_SetAttributes"), FSFILE_SetAttributes_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSFILE_GetAttributes"), FSFILE_GetAttributes_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSFILE_SetSize"), FSFILE_SetSize_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSFILE_GetSize"), FSFILE_GetSize_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSFILE_Read"), FSFILE_Read_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSFILE_ReadVector"), FSFILE_ReadVector_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSFILE_StreamStart"), FSFILE_StreamStart_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSFILE_StreamCredit"), FSFILE_StreamCredit_},
+        {METHOD_NAME("FSFILE_StreamCancel"), FSFILE_StreamCancel_},
+        {METHOD_NAME("FSFILE_Write"), FSFILE_Write_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSFILE_Flush"), FSFILE_Flush_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSDIR_Read"), FSDIR_Read_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSDIR_Close"), FSDIR_Close_, RequestOrder::HANDLE},
+        {METHOD_NAME("FSUSER_ListDirectory"), FSUSER_ListDirectory_, RequestOrder::HANDLE},
         {METHOD_NAME("AM_GetTitleCount"), AM_GetTitleCount_},
         {METHOD_NAME("AM_GetTitleList"), AM_GetTitleList_},
         {METHOD_NAME("AM_GetTitleInfo"), AM_GetTitleInfo_},
@@ -1837,17 +3496,489 @@ namespace ArticFunctions {
         {METHOD_NAME("HIDUSER_DisableAccelerometer"), HIDUSER_DisableAccelerometer_},
         {METHOD_NAME("HIDUSER_EnableGyroscope"), HIDUSER_EnableGyroscope_},
         {METHOD_NAME("HIDUSER_DisableGyroscope"), HIDUSER_DisableGyroscope_},
-        {METHOD_NAME("HIDUSER_GetGyroRawToDpsCoef"), HIDUSER_GetGyroscopeRawToDpsCoefficient_},
-        {METHOD_NAME("HIDUSER_GetGyroCalibrateParam"), HIDUSER_GetGyroscopeCalibrateParam_},
+        {METHOD_NAME("HIDUSER_GetGyroRawToDpsCoef"), HIDUSER_GetGyroscopeRawToDpsCoefficient_, Memo::SESSION},
+        {METHOD_NAME("HIDUSER_GetGyroCalibrateParam"), HIDUSER_GetGyroscopeCalibrateParam_, Memo::SESSION},
+
+        // Compound
+        {METHOD_NAME("#Batch"), Batch_, RequestOrder::EXCLUSIVE},
 
         // UDP Streams
-        {METHOD_NAME("#ArticController"), Controller_Start},
+        {METHOD_NAME("#ArticController"), Controller_Start, RequestOrder::EXCLUSIVE},
+
+        // Session
+        {METHOD_NAME("#GetMethodOpcodes"), GetMethodOpcodes, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#Stats"), GetStats, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#TraceStart"), TraceStart, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#TraceDump"), TraceDump, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#ReadAheadStats"), GetReadAheadStats, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#BlockCacheStats"), GetBlockCacheStats, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#SetCompression"), SetCompression, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#ArchiveStats"), GetArchiveStats, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#HandleStats"), GetHandleStats, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#WriteBufferStats"), GetWriteBufferStats, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#SetAsyncWrites"), SetAsyncWrites, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#NegativeCacheStats"), GetNegativeCacheStats, RequestOrder::EXCLUSIVE},
+        {METHOD_NAME("#MemoStats"), GetMemoStats, RequestOrder::EXCLUSIVE},
     };
 
-    bool obtainExheader() {
-        Result loaderInitCustom(void);
-        void loaderExitCustom(void);
-        Result LOADER_GetLastApplicationProgramInfo(ExHeader_Info* exheaderInfo);
+    static constexpr MethodTable methodTable(methodEntries);
+    static_assert(methodTable.IsValid(), "Failed to find a perfect hash seed for the method table");
+
+    static std::array<Stats::MethodStats, methodTable.Size()> methodStats;
+
+    // Every method is dispatched through a wrapper that records its latency
+    // and payload sizes, and lets memoized methods keep their responses,
+    // generated per table index so there is no lookup left to do at request
+    // time.
+    template<size_t I>
+    static void InstrumentedHandler(ArticProtocolServer::MethodInterface& serverMi) {
+        MethodInterface mi(serverMi);
+        Stats::RequestScope scope(methodStats[I], I, mi);
+        if constexpr (methodTable.Entry(I).memo != Memo::NONE) {
+            Memo::Scope memoScope(I, methodTable.Entry(I).memo, mi);
+            methodTable.Entry(I).handler(mi);
+        } else {
+            methodTable.Entry(I).handler(mi);
+        }
+    }
+
+    template<size_t... I>
+    static constexpr std::array<MethodHandler, sizeof...(I)> MakeInstrumentedHandlers(std::index_sequence<I...>) {
+        return {{InstrumentedHandler<I>...}};
+    }
+
+    static constexpr auto instrumentedHandlers = MakeInstrumentedHandlers(std::make_index_sequence<methodTable.Size()>{});
+
+    MethodHandler GetMethodHandler(const char* method) {
+        int index = methodTable.Find(method);
+        return (index < 0) ? nullptr : instrumentedHandlers[index];
+    }
+
+    MethodHandler GetMethodHandler(u16 opcode) {
+        return (opcode < instrumentedHandlers.size()) ? instrumentedHandlers[opcode] : nullptr;
+    }
+
+    s32 GetMethodOpcode(const char* method) {
+        return methodTable.Find(method);
+    }
+
+    // Shared by the SERIAL requests. Handles and archive handles never take
+    // this value.
+    static constexpr u64 SERIAL_REQUEST_KEY = ~0ULL;
+
+    bool GetRequestKey(u16 opcode, s64 firstParameter, u64& key) {
+        if (opcode >= methodTable.Size()) return false;
+        switch (methodTable.Entry(opcode).order)
+        {
+        case RequestOrder::SERIAL:
+            key = SERIAL_REQUEST_KEY;
+            return true;
+        case RequestOrder::HANDLE:
+            key = static_cast<u64>(firstParameter);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void SubmitRequest(u64 key, void(*task)(void*), void* arg) {
+        // Runs the request on the calling thread if the pool cannot start
+        requestPool.Start(WorkerPool::DEFAULT_WORKERS);
+        requestPool.Submit(key, task, arg);
+    }
+
+    // Names of the opcodes used by "#Stats", trace records and requests sent
+    // by opcode
+    static void GetMethodOpcodes(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        // u16 count, then for every method: u16 opcode, u8 name length, name (no terminator)
+        size_t size = sizeof(u16);
+        for (size_t i = 0; i < methodTable.Size(); i++) {
+            size += sizeof(u16) + sizeof(u8) + methodTable.Entry(i).nameLength;
+        }
+
+        ArticProtocolCommon::Buffer* opcodes_buf = mi.ReserveResultBuffer(0, size);
+        if (!opcodes_buf) {
+            return;
+        }
+
+        u8* out = reinterpret_cast<u8*>(opcodes_buf->data);
+        u16 count = static_cast<u16>(methodTable.Size());
+        memcpy(out, &count, sizeof(u16)); out += sizeof(u16);
+        for (u16 i = 0; i < count; i++) {
+            const MethodEntry& entry = methodTable.Entry(i);
+            memcpy(out, &i, sizeof(u16)); out += sizeof(u16);
+            *out++ = static_cast<u8>(entry.nameLength);
+            memcpy(out, entry.name, entry.nameLength); out += entry.nameLength;
+        }
+
+        mi.FinishGood(0);
+    }
+
+    static void GetReadAheadStats(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        ArticProtocolCommon::Buffer* stats_buf = mi.ReserveResultBuffer(0, sizeof(ReadAhead::Counters));
+        if (!stats_buf) {
+            return;
+        }
+        ReadAhead::Counters counters = readAhead.GetCounters();
+        memcpy(stats_buf->data, &counters, sizeof(counters));
+
+        mi.FinishGood(0);
+    }
+
+    static void GetBlockCacheStats(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        ArticProtocolCommon::Buffer* stats_buf = mi.ReserveResultBuffer(0, sizeof(BlockCache::Counters));
+        if (!stats_buf) {
+            return;
+        }
+        BlockCache::Counters counters = blockCache.GetCounters();
+        memcpy(stats_buf->data, &counters, sizeof(counters));
+
+        mi.FinishGood(0);
+    }
+
+    static void GetArchiveStats(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        ArticProtocolCommon::Buffer* stats_buf = mi.ReserveResultBuffer(0, sizeof(SharedArchives::Counters));
+        if (!stats_buf) {
+            return;
+        }
+        SharedArchives::Counters counters = SharedArchives::GetCounters();
+        memcpy(stats_buf->data, &counters, sizeof(counters));
+
+        mi.FinishGood(0);
+    }
+
+    static void GetNegativeCacheStats(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        ArticProtocolCommon::Buffer* stats_buf = mi.ReserveResultBuffer(0, sizeof(NegativeCache::Counters));
+        if (!stats_buf) {
+            return;
+        }
+        NegativeCache::Counters counters = negativeCache.GetCounters();
+        memcpy(stats_buf->data, &counters, sizeof(counters));
+
+        mi.FinishGood(0);
+    }
+
+    static void GetMemoStats(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        ArticProtocolCommon::Buffer* stats_buf = mi.ReserveResultBuffer(0, sizeof(Memo::Counters));
+        if (!stats_buf) {
+            return;
+        }
+        Memo::Counters counters = Memo::GetCounters();
+        memcpy(stats_buf->data, &counters, sizeof(counters));
+
+        mi.FinishGood(0);
+    }
+
+    static void GetWriteBufferStats(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        ArticProtocolCommon::Buffer* stats_buf = mi.ReserveResultBuffer(0, sizeof(WriteBuffer::Counters));
+        if (!stats_buf) {
+            return;
+        }
+        WriteBuffer::Counters counters = writeBuffer.GetCounters();
+        memcpy(stats_buf->data, &counters, sizeof(counters));
+
+        mi.FinishGood(0);
+    }
+
+    // s8 enable. Writes to save and extdata files are acknowledged once
+    // queued, a failure is returned by the next call on the same handle.
+    // FSFILE_Flush and FSFILE_Close wait for the queued writes of the handle.
+    static void SetAsyncWrites(MethodInterface& mi) {
+        bool good = true;
+        s8 enable;
+
+        if (good) good = mi.GetParameterS8(enable);
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        writeBuffer.SetAsync(enable != 0);
+        logger.Debug("Async writes: %s", enable ? "Enabled" : "Disabled");
+
+        mi.FinishGood(0);
+    }
+
+    // u32 count, then one HandleTable::Record per handle open for the client
+    static void GetHandleStats(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        // Handles opened meanwhile are left out
+        u32 count = handleTable.Count();
+        ArticProtocolCommon::Buffer* stats_buf = mi.ReserveResultBuffer(0, sizeof(u32) + count * sizeof(HandleTable::Record));
+        if (!stats_buf) {
+            return;
+        }
+
+        HandleTable::Record* records = (HandleTable::Record*)malloc(std::max<u32>(count, 1) * sizeof(HandleTable::Record));
+        if (!records) {
+            mi.ResizeLastResultBuffer(stats_buf, 0);
+            mi.FinishInternalError();
+            return;
+        }
+        count = handleTable.Snapshot(records, count);
+        memcpy(stats_buf->data, &count, sizeof(u32));
+        memcpy(stats_buf->data + sizeof(u32), records, count * sizeof(HandleTable::Record));
+        free(records);
+        mi.ResizeLastResultBuffer(stats_buf, sizeof(u32) + count * sizeof(HandleTable::Record));
+
+        mi.FinishGood(0);
+    }
+
+    // s8 enable, s32 estimated link throughput in KB/s (0 for the default).
+    // Applies to FSFILE_Read, Process_ReadCode and the ExeFS reads.
+    static void SetCompression(MethodInterface& mi) {
+        bool good = true;
+        s8 enable;
+        s32 linkKBps;
+
+        if (good) good = mi.GetParameterS8(enable);
+        if (good) good = mi.GetParameterS32(linkKBps);
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        Compression::Enable(enable != 0, linkKBps > 0 ? static_cast<u32>(linkKBps) : 0);
+        logger.Debug("Compression: %s", enable ? "Enabled" : "Disabled");
+
+        mi.FinishGood(0);
+    }
+
+    static void GetStats(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        // u32 count, then one MethodStatsRecord per method in opcode order
+        u32 count = static_cast<u32>(methodTable.Size());
+        ArticProtocolCommon::Buffer* stats_buf = mi.ReserveResultBuffer(0, sizeof(u32) + count * sizeof(Stats::MethodStatsRecord));
+        if (!stats_buf) {
+            return;
+        }
+
+        u8* out = reinterpret_cast<u8*>(stats_buf->data);
+        memcpy(out, &count, sizeof(u32)); out += sizeof(u32);
+        for (u16 i = 0; i < count; i++) {
+            Stats::MethodStatsRecord record;
+            Stats::Serialize(methodStats[i], i, record);
+            memcpy(out, &record, sizeof(record)); out += sizeof(record);
+        }
+
+        mi.FinishGood(0);
+    }
+
+    static size_t TraceNamesSize() {
+        size_t size = 0;
+        for (size_t i = 0; i < methodTable.Size(); i++) {
+            size += sizeof(u8) + methodTable.Entry(i).nameLength;
+        }
+        return size;
+    }
+
+    static size_t TraceDumpSize(u32 recordCount) {
+        return sizeof(Trace::Header) + TraceNamesSize() + recordCount * sizeof(Trace::Record);
+    }
+
+    // Moves up to recordCount records to out, see Trace::Header for the
+    // layout. Returns the amount of bytes written.
+    static size_t SerializeTrace(u8* out, u32 recordCount) {
+        u8* start = out;
+        out += sizeof(Trace::Header);
+        for (size_t i = 0; i < methodTable.Size(); i++) {
+            const MethodEntry& entry = methodTable.Entry(i);
+            *out++ = static_cast<u8>(entry.nameLength);
+            memcpy(out, entry.name, entry.nameLength); out += entry.nameLength;
+        }
+
+        // Records are copied through an aligned temporary, out may be unaligned
+        Trace::Record records[32];
+        u32 written = 0;
+        u32 dropped = 0, totalDropped = 0;
+        while (written < recordCount) {
+            u32 chunk = std::min<u32>(recordCount - written, sizeof(records) / sizeof(records[0]));
+            u32 taken = Trace::Take(records, chunk, dropped);
+            totalDropped += dropped;
+            if (taken == 0) break;
+            memcpy(out, records, taken * sizeof(Trace::Record)); out += taken * sizeof(Trace::Record);
+            written += taken;
+        }
+
+        Trace::Header header = {{'A', 'T', 'R', 'C'}, Trace::VERSION, sizeof(Trace::Record), written,
+            totalDropped, static_cast<u16>(methodTable.Size()), 0};
+        memcpy(start, &header, sizeof(header));
+        return out - start;
+    }
+
+    static Result WriteTraceToSD(u32& recordCount) {
+        recordCount = Trace::Count();
+        size_t size = TraceDumpSize(recordCount);
+        u8* data = (u8*)malloc(size);
+        if (!data) {
+            return MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_COMMON, RD_OUT_OF_MEMORY);
+        }
+        size = SerializeTrace(data, recordCount);
+        memcpy(&recordCount, data + offsetof(Trace::Header, recordCount), sizeof(u32));
+
+        s64 titleID = 0;
+        svcGetProcessInfo(&titleID, CUR_PROCESS_HANDLE, 0x10001);
+        char path[0x40];
+
+        FS_Archive sdmc;
+        Handle file = 0;
+        Result res = FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""));
+        if (R_FAILED(res)) {
+            free(data);
+            return res;
+        }
+        // Both may already exist
+        FSUSER_CreateDirectory(sdmc, fsMakePath(PATH_ASCII, "/ArticBase"), 0);
+        FSUSER_CreateDirectory(sdmc, fsMakePath(PATH_ASCII, "/ArticBase/traces"), 0);
+
+        // Every dump gets its own file so a session can be dumped more than once
+        for (unsigned int index = 0; index < 1000; index++) {
+            snprintf(path, sizeof(path), "/ArticBase/traces/%016llX_%03u.atrc", (unsigned long long)titleID, index);
+            res = FSUSER_CreateFile(sdmc, fsMakePath(PATH_ASCII, path), 0, size);
+            if (R_SUCCEEDED(res)) break;
+        }
+
+        u32 bytes_written = 0;
+        if (R_SUCCEEDED(res)) res = FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, path), FS_OPEN_WRITE, 0);
+        if (R_SUCCEEDED(res)) {
+            res = FSFILE_Write(file, &bytes_written, 0, data, size, FS_WRITE_FLUSH);
+            FSFILE_Close(file);
+        }
+        FSUSER_CloseArchive(sdmc);
+        free(data);
+
+        if (R_SUCCEEDED(res)) {
+            logger.Info("Trace: %u requests written to %s", recordCount, path);
+        }
+        return res;
+    }
+
+    static void TraceStart(MethodInterface& mi) {
+        bool good = true;
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        if (!Trace::Start()) {
+            mi.FinishInternalError();
+            return;
+        }
+
+        mi.FinishGood(0);
+    }
+
+    static void TraceDump(MethodInterface& mi) {
+        bool good = true;
+        s8 toSD;
+
+        if (good) good = mi.GetParameterS8(toSD);
+
+        if (good) good = mi.FinishInputParameters();
+
+        if (!good) return;
+
+        if (!Trace::IsEnabled()) {
+            mi.FinishGood(MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_COMMON, RD_NOT_INITIALIZED));
+            return;
+        }
+
+        if (toSD) {
+            // Returns the amount of records written
+            u32 recordCount;
+            Result res = WriteTraceToSD(recordCount);
+            if (R_FAILED(res)) {
+                mi.FinishGood(res);
+                return;
+            }
+            ArticProtocolCommon::Buffer* count_buf = mi.ReserveResultBuffer(0, sizeof(u32));
+            if (!count_buf) {
+                return;
+            }
+            *reinterpret_cast<u32*>(count_buf->data) = recordCount;
+            mi.FinishGood(0);
+            return;
+        }
+
+        u32 recordCount = Trace::Count();
+        ArticProtocolCommon::Buffer* trace_buf = mi.ReserveResultBuffer(0, TraceDumpSize(recordCount));
+        if (!trace_buf) {
+            return;
+        }
+        size_t size = SerializeTrace(reinterpret_cast<u8*>(trace_buf->data), recordCount);
+        mi.ResizeLastResultBuffer(trace_buf, size);
+
+        mi.FinishGood(0);
+    }
+
+    // Servers that can call GetMethodHandler dispatch through the table, the
+    // protocol library still resolves methods by name through this map. Keep
+    // it generated from the table so both always agree.
+    std::map<std::string, MethodHandler> functionHandlers = [] {
+        std::map<std::string, MethodHandler> handlers;
+        for (size_t i = 0; i < methodTable.Size(); i++) {
+            const MethodEntry& entry = methodTable.Entry(i);
+            handlers.emplace(std::string(entry.name, entry.nameLength), instrumentedHandlers[i]);
+        }
+        return handlers;
+    }();
+
+    bool obtainExheader() {
+        Result loaderInitCustom(void);
+        void loaderExitCustom(void);
+        Result LOADER_GetLastApplicationProgramInfo(ExHeader_Info* exheaderInfo);
 
 
         Result res = loaderInitCustom();
@@ -1862,8 +3993,64 @@ namespace ArticFunctions {
         return true;
     }
 
+    // Writes still in memory go to the FS before their handles are closed
+    static bool flushWriteBuffer(void) {
+        WriteBuffer::Counters counters = writeBuffer.GetCounters();
+        if (counters.buffered != 0 || counters.queued != 0) {
+            logger.Info("WriteBuffer: %u of %u writes buffered, %u merged, %u queued, %u FS writes, %u deferred errors",
+                (unsigned int)counters.buffered, (unsigned int)counters.writes, (unsigned int)counters.merged,
+                (unsigned int)counters.queued, (unsigned int)counters.fsWrites, (unsigned int)counters.deferredErrors);
+        }
+        writeBuffer.Clear();
+        return true;
+    }
+
+    static bool closeRawRomFS() {
+        RawRomFS::Close();
+        return true;
+    }
+
+    static bool clearHandleCache() {
+        HandleCache::Counters counters = handleCache.GetCounters();
+        if (counters.hits != 0) {
+            logger.Info("HandleCache: %u hits, %u misses, %u evictions", (unsigned int)counters.hits,
+                (unsigned int)counters.misses, (unsigned int)counters.evictions);
+        }
+        handleCache.Clear();
+        return true;
+    }
+
+    static bool clearNegativeCache() {
+        NegativeCache::Counters counters = negativeCache.GetCounters();
+        if (counters.absorbed != 0) {
+            logger.Info("NegativeCache: %u probes absorbed, %u misses remembered, %u invalidations",
+                (unsigned int)counters.absorbed, (unsigned int)counters.inserted, (unsigned int)counters.invalidations);
+        }
+        negativeCache.Clear();
+        return true;
+    }
+
+    static bool clearMemo() {
+        Memo::Counters counters = Memo::GetCounters();
+        if (counters.hits != 0) {
+            logger.Info("Memo: %u calls replayed, %u responses kept, %u invalidations",
+                (unsigned int)counters.hits, (unsigned int)counters.stores, (unsigned int)counters.invalidations);
+        }
+        Memo::Clear();
+        return true;
+    }
+
+    static bool resetSharedArchives() {
+        SharedArchives::Counters counters = SharedArchives::GetCounters();
+        if (counters.absorbed != 0) {
+            logger.Info("Archives: %u opened, %u opens absorbed", (unsigned int)counters.opens, (unsigned int)counters.absorbed);
+        }
+        SharedArchives::Clear();
+        return true;
+    }
+
     static bool closeHandles() {
-        auto CloseHandle = [](u64 handle, HandleType type) {
+        handleTable.Drain([](u64 handle, HandleType type) {
             switch (type)
             {
             case HandleType::FILE:
@@ -1881,11 +4068,52 @@ namespace ArticFunctions {
             default:
                 break;
             }
-        };
-        for (auto it = openHandles.begin(); it != openHandles.end(); it++) {
-            CloseHandle(it->first, it->second);
+        });
+        return true;
+    }
+
+    static bool stopStreamer(void) {
+        fileStreamer.Stop();
+        return true;
+    }
+
+    static bool stopWorkerPool(void) {
+        workerPool.Stop();
+        return true;
+    }
+
+    static bool stopRequestPool(void) {
+        requestPool.Stop();
+        return true;
+    }
+
+    static bool stopReadAhead(void) {
+        ReadAhead::Counters counters = readAhead.GetCounters();
+        if (counters.prefetches != 0) {
+            logger.Info("ReadAhead: %u hits, %u partial, %u misses, %u KiB wasted", (unsigned int)counters.hits,
+                (unsigned int)counters.partialHits, (unsigned int)counters.misses, (unsigned int)(counters.wastedBytes / 1024));
+        }
+        readAhead.Clear();
+        return true;
+    }
+
+    static bool clearBlockCache(void) {
+        BlockCache::Counters counters = blockCache.GetCounters();
+        if (counters.hits + counters.misses != 0) {
+            logger.Info("BlockCache: %u hits, %u misses, %u evictions", (unsigned int)counters.hits,
+                (unsigned int)counters.misses, (unsigned int)counters.evictions);
+        }
+        blockCache.Clear();
+        return true;
+    }
+
+    static bool resetCompression(void) {
+        Compression::Counters counters = Compression::GetCounters();
+        if (counters.rawBytes != 0) {
+            logger.Info("Compression: %u KiB sent for %u KiB, %u ms, %u blocks skipped", (unsigned int)(counters.sentBytes / 1024),
+                (unsigned int)(counters.rawBytes / 1024), (unsigned int)(counters.microseconds / 1000), (unsigned int)counters.skippedBlocks);
         }
-        openHandles.clear();
+        Compression::Reset();
         return true;
     }
 
@@ -1905,13 +4133,71 @@ namespace ArticFunctions {
         return true;
     }
 
+    // Builds with TRACE_AUTO_START record every session, otherwise the
+    // client starts the trace with "#TraceStart"
+    static bool startTrace(void) {
+        if (TRACE_AUTO_START && !Trace::Start()) {
+            logger.Error("Trace: Failed to allocate %d records", TRACE_RECORDS);
+        }
+        return true;
+    }
+
     std::vector<bool(*)()> setupFunctions {
         obtainExheader,
+        startTrace,
     };
 
+    // A trace still running when the client goes away is saved to the SD card
+    static bool stopTrace(void) {
+        if (Trace::IsEnabled()) {
+            if (Trace::Count() != 0) {
+                u32 recordCount;
+                Result res = WriteTraceToSD(recordCount);
+                if (R_FAILED(res)) {
+                    logger.Error("Trace: Failed to write to SD: 0x%08X", res);
+                }
+            }
+            if (TRACE_AUTO_START) {
+                Trace::Start();
+            } else {
+                Trace::Stop();
+            }
+        }
+        return true;
+    }
+
+    static bool resetStats(void) {
+        if (ARTIC_COUNT_COPIES) {
+            u64 copied, served;
+            Stats::TakeCopyCounts(copied, served);
+            if (served != 0) {
+                logger.Info("Stats: %llu bytes copied, %llu served (%.3f per byte)",
+                    (unsigned long long)copied, (unsigned long long)served, (double)copied / served);
+            }
+        }
+        for (auto& stats : methodStats) {
+            stats.Reset();
+        }
+        return true;
+    }
+
     std::vector<bool(*)()> destructFunctions {
+        stopStreamer,
+        stopRequestPool,
+        stopWorkerPool,
+        stopReadAhead,
+        clearBlockCache,
+        resetCompression,
+        flushWriteBuffer,
+        closeRawRomFS,
+        clearHandleCache,
+        clearNegativeCache,
+        clearMemo,
+        resetSharedArchives,
         closeHandles,
         stopController,
+        stopTrace,
+        resetStats,
     };
 
     Thread ArticController::thread = nullptr;
@@ -0,0 +1,184 @@
+#include "ArticHandleCache.hpp"
+#include "ArticBlockCache.hpp"
+#include "ArticReadAhead.hpp"
+#include "ArticStreamer.hpp"
+#include "ArticHandleTable.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+#include <algorithm>
+#include <string.h>
+
+namespace ArticFunctions {
+
+    HandleCache handleCache;
+
+    HandleCache::HandleCache() {
+        LightLock_Init(&lock);
+    }
+
+    static void AppendPath(HandleCache::Key& key, const FS_Path& path) {
+        u32 type = path.type, size = path.size;
+        size_t pos = key.size();
+        key.resize(pos + 2 * sizeof(u32) + size);
+        memcpy(key.data() + pos, &type, sizeof(u32));
+        memcpy(key.data() + pos + sizeof(u32), &size, sizeof(u32));
+        memcpy(key.data() + pos + 2 * sizeof(u32), path.data, size);
+    }
+
+    HandleCache::Key HandleCache::MakeKey(s32 archiveID, const FS_Path& archivePath, const FS_Path& filePath) {
+        Key key(1 + sizeof(s32));
+        key[0] = 0;
+        memcpy(key.data() + 1, &archiveID, sizeof(s32));
+        AppendPath(key, archivePath);
+        AppendPath(key, filePath);
+        return key;
+    }
+
+    HandleCache::Key HandleCache::MakeKey(FS_Archive archive, const FS_Path& filePath) {
+        Key key(1 + sizeof(FS_Archive));
+        key[0] = 1;
+        memcpy(key.data() + 1, &archive, sizeof(FS_Archive));
+        AppendPath(key, filePath);
+        return key;
+    }
+
+    void HandleCache::AddReadOnlyArchive(FS_Archive archive) {
+        CTRPluginFramework::Lock l(lock);
+        readOnlyArchives.push_back(archive);
+    }
+
+    bool HandleCache::IsReadOnlyArchive(FS_Archive archive) {
+        CTRPluginFramework::Lock l(lock);
+        return std::find(readOnlyArchives.begin(), readOnlyArchives.end(), archive) != readOnlyArchives.end();
+    }
+
+    void HandleCache::RemoveArchive(FS_Archive archive) {
+        std::vector<Handle> victims;
+        {
+            CTRPluginFramework::Lock l(lock);
+            auto archiveIt = std::find(readOnlyArchives.begin(), readOnlyArchives.end(), archive);
+            if (archiveIt == readOnlyArchives.end()) return;
+            readOnlyArchives.erase(archiveIt);
+
+            // The archive handle may be reused, its files must not be found again.
+            // Handles in use are closed on their last release.
+            for (auto it = entries.begin(); it != entries.end();) {
+                Entry& entry = it->second;
+                if (entry.archive != archive) {
+                    it++;
+                } else if (entry.references == 0) {
+                    victims.push_back(it->first);
+                    idleCount--;
+                    it = entries.erase(it);
+                } else {
+                    entry.key.clear();
+                    it++;
+                }
+            }
+        }
+        Close(victims);
+    }
+
+    bool HandleCache::Acquire(const Key& key, Handle& handle, s64& size) {
+        CTRPluginFramework::Lock l(lock);
+        for (auto& it : entries) {
+            Entry& entry = it.second;
+            if (entry.key != key) continue;
+            if (entry.references++ == 0) idleCount--;
+            entry.lastUse = ++useCounter;
+            handle = it.first;
+            size = entry.size;
+            counters.hits++;
+            return true;
+        }
+        counters.misses++;
+        return false;
+    }
+
+    bool HandleCache::Insert(const Key& key, Handle handle, s64 size, FS_Archive archive) {
+        CTRPluginFramework::Lock l(lock);
+        for (auto& it : entries) {
+            if (it.second.key == key) return false;
+        }
+        entries[handle] = {key, size, archive, 1, ++useCounter};
+        return true;
+    }
+
+    bool HandleCache::Release(Handle handle) {
+        std::vector<Handle> victims;
+        bool idle = false;
+        {
+            CTRPluginFramework::Lock l(lock);
+            auto it = entries.find(handle);
+            if (it == entries.end()) return false;
+            Entry& entry = it->second;
+            if (entry.references == 0) return false;
+
+            if (--entry.references == 0) {
+                if (entry.key.empty()) {
+                    victims.push_back(handle);
+                    entries.erase(it);
+                } else {
+                    entry.lastUse = ++useCounter;
+                    idleCount++;
+                    idle = true;
+                    EvictIdle(victims);
+                }
+            }
+        }
+        // Nobody uses the handle anymore, its streams must not outlive the
+        // close even if the handle stays open in the cache
+        if (idle && std::find(victims.begin(), victims.end(), handle) == victims.end()) {
+            fileStreamer.CancelHandle(handle);
+        }
+        Close(victims);
+        return true;
+    }
+
+    void HandleCache::Clear() {
+        std::vector<Handle> victims;
+        {
+            CTRPluginFramework::Lock l(lock);
+            for (auto& it : entries) {
+                victims.push_back(it.first);
+            }
+            entries.clear();
+            readOnlyArchives.clear();
+            idleCount = 0;
+            counters = {};
+        }
+        for (Handle handle : victims) {
+            handleTable.Remove(handle);
+            FSFILE_Close(handle);
+        }
+    }
+
+    HandleCache::Counters HandleCache::GetCounters() {
+        CTRPluginFramework::Lock l(lock);
+        return counters;
+    }
+
+    void HandleCache::Close(const std::vector<Handle>& handles) {
+        for (Handle handle : handles) {
+            fileStreamer.CancelHandle(handle);
+            blockCache.Unregister(handle);
+            readAhead.Unregister(handle);
+            handleTable.Remove(handle);
+            FSFILE_Close(handle);
+        }
+    }
+
+    void HandleCache::EvictIdle(std::vector<Handle>& victims) {
+        while (idleCount > MAX_IDLE_HANDLES) {
+            auto oldest = entries.end();
+            for (auto it = entries.begin(); it != entries.end(); it++) {
+                if (it->second.references == 0 && (oldest == entries.end() || it->second.lastUse < oldest->second.lastUse)) {
+                    oldest = it;
+                }
+            }
+            victims.push_back(oldest->first);
+            entries.erase(oldest);
+            idleCount--;
+            counters.evictions++;
+        }
+    }
+}
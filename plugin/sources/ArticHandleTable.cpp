@@ -0,0 +1,148 @@
+#include "ArticHandleTable.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+
+namespace ArticFunctions {
+
+    HandleTable handleTable;
+
+    HandleTable::HandleTable() {
+        LightLock_Init(&lock);
+    }
+
+    // FNV-1a over the path type and data
+    u32 HandleTable::HashPath(const FS_Path& path) {
+        u32 hash = 0x811C9DC5;
+        auto add = [&hash](const u8* data, size_t size) {
+            for (size_t i = 0; i < size; i++) {
+                hash = (hash ^ data[i]) * 0x01000193;
+            }
+        };
+        u32 type = path.type;
+        add(reinterpret_cast<const u8*>(&type), sizeof(u32));
+        add(reinterpret_cast<const u8*>(path.data), path.size);
+        return hash;
+    }
+
+    bool HandleTable::Add(u64 handle, HandleType type, bool shared, FS_Archive archive, u32 pathHash) {
+        CTRPluginFramework::Lock l(lock);
+        Slot* target = nullptr;
+        u32 i = Home(handle);
+        for (u32 probe = 0; probe < CAPACITY; probe++, i = (i + 1) & (CAPACITY - 1)) {
+            u64 key = slots[i].key.load(std::memory_order_relaxed);
+            if (key == handle) {
+                // Handle values are reused once closed, an entry still here
+                // belongs to a handle closed behind the table's back
+                target = &slots[i];
+                break;
+            }
+            if (key == TOMBSTONE && !target) {
+                target = &slots[i];
+            } else if (key == EMPTY) {
+                if (!target) target = &slots[i];
+                break;
+            }
+        }
+        if (!target) return false;
+
+        u32 version = target->version.load(std::memory_order_relaxed);
+        target->version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        if (target->key.load(std::memory_order_relaxed) != handle) {
+            count.fetch_add(1, std::memory_order_relaxed);
+        }
+        target->key.store(handle, std::memory_order_relaxed);
+        target->type.store(type, std::memory_order_relaxed);
+        target->shared.store(shared, std::memory_order_relaxed);
+        target->archive.store(archive, std::memory_order_relaxed);
+        target->pathHash.store(pathHash, std::memory_order_relaxed);
+        target->ops.store(0, std::memory_order_relaxed);
+        target->bytes.store(0, std::memory_order_relaxed);
+        target->version.store(version + 2, std::memory_order_release);
+        return true;
+    }
+
+    bool HandleTable::Remove(u64 handle, Info* removed) {
+        CTRPluginFramework::Lock l(lock);
+        u32 i = Home(handle);
+        for (u32 probe = 0; probe < CAPACITY; probe++, i = (i + 1) & (CAPACITY - 1)) {
+            u64 key = slots[i].key.load(std::memory_order_relaxed);
+            if (key == EMPTY) return false;
+            if (key != handle) continue;
+
+            Slot& slot = slots[i];
+            if (removed) {
+                *removed = {slot.type.load(std::memory_order_relaxed), slot.shared.load(std::memory_order_relaxed),
+                    slot.archive.load(std::memory_order_relaxed), slot.pathHash.load(std::memory_order_relaxed),
+                    slot.ops.load(std::memory_order_relaxed), slot.bytes.load(std::memory_order_relaxed)};
+            }
+            // A slot followed by an empty one ends every probe sequence going
+            // through it, so it and the tombstones before it can be emptied
+            bool last = slots[(i + 1) & (CAPACITY - 1)].key.load(std::memory_order_relaxed) == EMPTY;
+            slot.key.store(last ? EMPTY : TOMBSTONE, std::memory_order_release);
+            for (u32 j = (i - 1) & (CAPACITY - 1); last && slots[j].key.load(std::memory_order_relaxed) == TOMBSTONE;
+                j = (j - 1) & (CAPACITY - 1)) {
+                slots[j].key.store(EMPTY, std::memory_order_release);
+            }
+            count.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    const HandleTable::Slot* HandleTable::Find(u64 handle) const {
+        u32 i = Home(handle);
+        for (u32 probe = 0; probe < CAPACITY; probe++, i = (i + 1) & (CAPACITY - 1)) {
+            u64 key = slots[i].key.load(std::memory_order_acquire);
+            if (key == handle) return &slots[i];
+            if (key == EMPTY) return nullptr;
+        }
+        return nullptr;
+    }
+
+    bool HandleTable::Get(u64 handle, Info& out) const {
+        const Slot* slot = Find(handle);
+        if (!slot) return false;
+        while (true) {
+            u32 version = slot->version.load(std::memory_order_acquire);
+            if (version & 1) continue;
+            bool found = slot->key.load(std::memory_order_relaxed) == handle;
+            out = {slot->type.load(std::memory_order_relaxed), slot->shared.load(std::memory_order_relaxed),
+                slot->archive.load(std::memory_order_relaxed), slot->pathHash.load(std::memory_order_relaxed),
+                slot->ops.load(std::memory_order_relaxed), slot->bytes.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->version.load(std::memory_order_relaxed) == version) return found;
+        }
+    }
+
+    void HandleTable::AddAccess(u64 handle, u32 bytes) {
+        // Counters are only approximate if the handle is closed meanwhile
+        Slot* slot = const_cast<Slot*>(Find(handle));
+        if (!slot) return;
+        slot->ops.fetch_add(1, std::memory_order_relaxed);
+        slot->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    u32 HandleTable::Snapshot(Record* out, u32 maxCount) const {
+        u32 written = 0;
+        for (const Slot& slot : slots) {
+            if (written == maxCount) break;
+            u64 key = slot.key.load(std::memory_order_acquire);
+            Info info;
+            if (key == EMPTY || key == TOMBSTONE || !Get(key, info)) continue;
+            out[written++] = {key, static_cast<u8>(info.type), info.shared, 0, info.pathHash, info.archive, info.bytes, info.ops, 0};
+        }
+        return written;
+    }
+
+    void HandleTable::Drain(void (*close)(u64 handle, HandleType type)) {
+        CTRPluginFramework::Lock l(lock);
+        for (Slot& slot : slots) {
+            u64 key = slot.key.load(std::memory_order_relaxed);
+            if (key != EMPTY && key != TOMBSTONE && !slot.shared.load(std::memory_order_relaxed)) {
+                close(key, slot.type.load(std::memory_order_relaxed));
+            }
+            slot.key.store(EMPTY, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,115 @@
+#include "ArticMemo.hpp"
+#include "ArticStats.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+#include <map>
+#include <string.h>
+
+namespace ArticFunctions {
+    namespace Memo {
+
+        struct Response {
+            Policy policy;
+            Result result;
+            // Buffer ID and contents, in the order they were reserved
+            std::vector<std::pair<u32, std::vector<u8>>> buffers;
+        };
+
+        static CTRPluginFramework::Mutex mutex;
+        static std::map<std::vector<u8>, Response> responses;
+        // Bumped by every invalidation, a response built across one is not kept
+        static u32 generations[POLICY_COUNT];
+        static u32 storedCount[POLICY_COUNT];
+        static Counters counters{};
+
+        Scope::Scope(u16 opcode, Policy p, MethodInterface& m) : policy(p), mi(m) {
+            key.resize(sizeof(u16));
+            memcpy(key.data(), &opcode, sizeof(u16));
+            mi.memoScope = this;
+        }
+
+        Scope::~Scope() {
+            mi.memoScope = nullptr;
+        }
+
+        bool Replay(MethodInterface& mi, const void* key, size_t keySize) {
+            Scope* scope = mi.GetMemoScope();
+            if (!scope) return false;
+            scope->key.insert(scope->key.end(), reinterpret_cast<const u8*>(key), reinterpret_cast<const u8*>(key) + keySize);
+            scope->keyed = true;
+
+            CTRPluginFramework::Lock l(mutex);
+            scope->generation = generations[scope->policy];
+            auto it = responses.find(scope->key);
+            if (it == responses.end()) return false;
+            counters.hits++;
+
+            const Response& response = it->second;
+            for (auto& buffer : response.buffers) {
+                ArticProtocolCommon::Buffer* buf = mi.ReserveResultBuffer(buffer.first, buffer.second.size());
+                if (!buf) {
+                    return true;
+                }
+                memcpy(buf->data, buffer.second.data(), buffer.second.size());
+                Stats::AddCopiedBytes(buffer.second.size());
+            }
+            mi.FinishGood(response.result);
+            return true;
+        }
+
+        ArticProtocolCommon::Buffer* ReserveResultBuffer(MethodInterface& mi, u32 bufferID, size_t size) {
+            ArticProtocolCommon::Buffer* buf = mi.ReserveResultBuffer(bufferID, size);
+            Scope* scope = mi.GetMemoScope();
+            if (buf && scope && scope->keyed) scope->buffers.push_back(buf);
+            return buf;
+        }
+
+        void FinishGood(MethodInterface& mi, Result res) {
+            Scope* scope = mi.GetMemoScope();
+            if (scope && scope->keyed && R_SUCCEEDED(res)) {
+                Response response{scope->policy, res, {}};
+                for (ArticProtocolCommon::Buffer* buf : scope->buffers) {
+                    const u8* data = reinterpret_cast<const u8*>(buf->data);
+                    response.buffers.emplace_back(buf->bufferID, std::vector<u8>(data, data + buf->bufferSize));
+                    Stats::AddCopiedBytes(buf->bufferSize);
+                }
+
+                CTRPluginFramework::Lock l(mutex);
+                if (scope->generation == generations[scope->policy]) {
+                    auto inserted = responses.emplace(scope->key, std::move(response));
+                    if (inserted.second) {
+                        storedCount[scope->policy]++;
+                        counters.stores++;
+                    }
+                }
+            }
+            mi.FinishGood(res);
+        }
+
+        void Invalidate(Policy policy) {
+            CTRPluginFramework::Lock l(mutex);
+            generations[policy]++;
+            if (storedCount[policy] == 0) return;
+            for (auto it = responses.begin(); it != responses.end();) {
+                if (it->second.policy == policy) it = responses.erase(it);
+                else it++;
+            }
+            counters.invalidations += storedCount[policy];
+            storedCount[policy] = 0;
+        }
+
+        void Clear() {
+            CTRPluginFramework::Lock l(mutex);
+            responses.clear();
+            for (u32 i = 0; i < POLICY_COUNT; i++) {
+                generations[i]++;
+                storedCount[i] = 0;
+            }
+            counters = {};
+        }
+
+        Counters GetCounters() {
+            CTRPluginFramework::Lock l(mutex);
+            return counters;
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#include "ArticNegativeCache.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+#include <algorithm>
+#include <string.h>
+
+namespace ArticFunctions {
+
+    NegativeCache negativeCache;
+
+    NegativeCache::NegativeCache() {
+        LightLock_Init(&lock);
+    }
+
+    static void AppendPath(NegativeCache::Key& key, const FS_Path& path) {
+        u32 type = path.type, size = path.size;
+        size_t pos = key.size();
+        key.resize(pos + 2 * sizeof(u32) + size);
+        memcpy(key.data() + pos, &type, sizeof(u32));
+        memcpy(key.data() + pos + sizeof(u32), &size, sizeof(u32));
+        memcpy(key.data() + pos + 2 * sizeof(u32), path.data, size);
+    }
+
+    bool NegativeCache::MakeProbe(s32 archiveID, const FS_Path& archivePath, const FS_Path& filePath, Probe& probe) {
+        // Other archives can also be reached through FSUSER_OpenArchive,
+        // where their changes would not drop these entries
+        if (archiveID != ARCHIVE_ROMFS) return false;
+        probe.key.assign(1 + sizeof(s32), 0);
+        memcpy(probe.key.data() + 1, &archiveID, sizeof(s32));
+        AppendPath(probe.key, archivePath);
+        AppendPath(probe.key, filePath);
+        probe.archive = 0;
+        probe.writable = false;
+        CTRPluginFramework::Lock l(lock);
+        probe.generation = generation;
+        return true;
+    }
+
+    bool NegativeCache::MakeProbe(Kind kind, FS_Archive archive, const FS_Path& path, Probe& probe) {
+        {
+            CTRPluginFramework::Lock l(lock);
+            const Archive* tracked = FindArchive(archive);
+            if (!tracked) return false;
+            probe.writable = tracked->writable;
+            probe.generation = generation;
+        }
+        probe.key.assign(1 + sizeof(FS_Archive), 0);
+        probe.key[0] = 1 + static_cast<u8>(kind);
+        memcpy(probe.key.data() + 1, &archive, sizeof(FS_Archive));
+        AppendPath(probe.key, path);
+        probe.archive = archive;
+        return true;
+    }
+
+    const NegativeCache::Archive* NegativeCache::FindArchive(FS_Archive archive) const {
+        for (const Archive& tracked : archives) {
+            if (tracked.archive == archive) return &tracked;
+        }
+        return nullptr;
+    }
+
+    void NegativeCache::AddArchive(FS_Archive archive, bool writable) {
+        CTRPluginFramework::Lock l(lock);
+        archives.push_back({archive, writable});
+    }
+
+    void NegativeCache::RemoveArchive(FS_Archive archive) {
+        CTRPluginFramework::Lock l(lock);
+        auto it = std::find_if(archives.begin(), archives.end(), [archive](const Archive& tracked) {
+            return tracked.archive == archive;
+        });
+        if (it == archives.end()) return;
+        archives.erase(it);
+        // The archive handle may be reused by an unrelated archive
+        DropArchive(archive);
+        generation++;
+    }
+
+    void NegativeCache::Invalidate() {
+        CTRPluginFramework::Lock l(lock);
+        // The handle the change came through says nothing about the other
+        // archives open on the same save data or extdata
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.writable) it = entries.erase(it);
+            else it++;
+        }
+        generation++;
+        counters.invalidations++;
+    }
+
+    void NegativeCache::DropArchive(FS_Archive archive) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.archive == archive) it = entries.erase(it);
+            else it++;
+        }
+    }
+
+    bool NegativeCache::Lookup(const Probe& probe, Result& res) {
+        CTRPluginFramework::Lock l(lock);
+        auto it = entries.find(probe.key);
+        if (it == entries.end()) return false;
+        it->second.lastUse = ++useCounter;
+        res = it->second.result;
+        counters.absorbed++;
+        return true;
+    }
+
+    void NegativeCache::Insert(const Probe& probe, Result res) {
+        if (R_SUMMARY(res) != RS_NOTFOUND || R_MODULE(res) != RM_FS) return;
+        CTRPluginFramework::Lock l(lock);
+        // The path may have been created, or the archive closed, meanwhile
+        if (probe.generation != generation) return;
+
+        if (entries.size() >= MAX_ENTRIES && entries.find(probe.key) == entries.end()) {
+            auto oldest = std::min_element(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+                return a.second.lastUse < b.second.lastUse;
+            });
+            entries.erase(oldest);
+        }
+        entries[probe.key] = {res, probe.archive, probe.writable, ++useCounter};
+        counters.inserted++;
+    }
+
+    void NegativeCache::Clear() {
+        CTRPluginFramework::Lock l(lock);
+        entries.clear();
+        archives.clear();
+        useCounter = 0;
+        generation++;
+        counters = {};
+    }
+
+    NegativeCache::Counters NegativeCache::GetCounters() {
+        CTRPluginFramework::Lock l(lock);
+        return counters;
+    }
+}
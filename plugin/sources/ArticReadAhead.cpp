@@ -0,0 +1,220 @@
+#include "ArticReadAhead.hpp"
+#include "ArticWorkerPool.hpp"
+#include "ArticStats.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+namespace ArticFunctions {
+
+    ReadAhead readAhead;
+
+    ReadAhead::ReadAhead() {
+        LightLock_Init(&lock);
+        CondVar_Init(&loaded);
+    }
+
+    void ReadAhead::Register(Handle handle) {
+        if (READAHEAD_MEMORY == 0) return;
+        CTRPluginFramework::Lock l(lock);
+        Stream& stream = streams[handle];
+        stream.handle = handle;
+    }
+
+    void ReadAhead::Unregister(Handle handle) {
+        CTRPluginFramework::Lock l(lock);
+        auto it = streams.find(handle);
+        if (it == streams.end()) return;
+        WaitLoaded(it->second);
+        DropBuffer(it->second, true);
+        streams.erase(it);
+    }
+
+    void ReadAhead::Clear() {
+        CTRPluginFramework::Lock l(lock);
+        for (auto& it : streams) {
+            DropBuffer(it.second, true);
+        }
+        streams.clear();
+        counters = {};
+    }
+
+    ReadAhead::Counters ReadAhead::GetCounters() {
+        CTRPluginFramework::Lock l(lock);
+        return counters;
+    }
+
+    Result ReadAhead::Read(Handle handle, u64 offset, void* out, u32 size, u32& bytesRead) {
+        u8* dst = reinterpret_cast<u8*>(out);
+        Stream* prefetch = nullptr;
+        u32 served = 0;
+        bool complete = false;
+        {
+            CTRPluginFramework::Lock l(lock);
+            auto it = streams.find(handle);
+            if (it != streams.end()) {
+                Stream& stream = it->second;
+                stream.lastUse = ++useCounter;
+                if (stream.loading && offset >= stream.bufferOffset && offset < stream.bufferOffset + stream.bufferCapacity) {
+                    WaitLoaded(stream);
+                }
+                if (!stream.loading) {
+                    served = ServeFromBuffer(stream, offset, dst, size, complete);
+                }
+
+                bool sequential = offset == stream.nextOffset;
+                if (sequential) {
+                    stream.sequentialReads++;
+                } else {
+                    stream.sequentialReads = 1;
+                    stream.window = MIN_WINDOW;
+                    if (served == 0 && !stream.loading) {
+                        DropBuffer(stream, false);
+                    }
+                }
+                stream.nextOffset = offset + size;
+
+                if (complete) counters.hits++;
+                else if (served != 0) counters.partialHits++;
+                else counters.misses++;
+
+                // Load the next window once the buffered one is used up
+                u64 bufferEnd = stream.bufferOffset + stream.bufferValid;
+                if (sequential && stream.sequentialReads >= SEQUENTIAL_THRESHOLD && !stream.loading &&
+                    !(stream.eof && stream.nextOffset >= bufferEnd) && (stream.bufferValid == 0 || stream.nextOffset >= bufferEnd)) {
+                    // Grow while the previous window was fully used
+                    if (stream.bufferValid != 0 && stream.bufferServed == stream.bufferValid) {
+                        stream.window = std::min<u32>(stream.window * 2, MAX_WINDOW);
+                    }
+                    u32 window = std::min<u32>(std::max(stream.window, std::min(size, MAX_WINDOW)), READAHEAD_MEMORY);
+                    DropBuffer(stream, false);
+                    if (ReserveBuffer(stream, window)) {
+                        stream.window = window;
+                        stream.bufferOffset = stream.nextOffset;
+                        stream.loading = true;
+                        prefetch = &stream;
+                    }
+                }
+            }
+        }
+
+        bytesRead = served;
+        Result res = 0;
+        if (!complete) {
+            u32 fsRead = 0;
+            res = FSFILE_Read(handle, &fsRead, offset + served, dst + served, size - served);
+            bytesRead += fsRead;
+        }
+
+        if (prefetch) {
+            // The stream cannot go away while loading, Unregister waits for it
+            if (workerPool.Start(WorkerPool::DEFAULT_WORKERS)) {
+                workerPool.Submit(handle, PrefetchTask, prefetch);
+            } else {
+                CTRPluginFramework::Lock l(lock);
+                prefetch->loading = false;
+                CondVar_Broadcast(&loaded);
+            }
+        }
+        return res;
+    }
+
+    void ReadAhead::NoteRead(Handle handle, u64 offset, u32 size) {
+        CTRPluginFramework::Lock l(lock);
+        auto it = streams.find(handle);
+        if (it == streams.end()) return;
+        Stream& stream = it->second;
+        stream.lastUse = ++useCounter;
+        u64 end = offset + size;
+        // Data the stream already went past changes nothing
+        if (end <= stream.nextOffset && offset < stream.nextOffset) return;
+        if (offset <= stream.nextOffset) {
+            stream.sequentialReads++;
+        } else {
+            stream.sequentialReads = 1;
+            stream.window = MIN_WINDOW;
+        }
+        stream.nextOffset = end;
+    }
+
+    void ReadAhead::PrefetchTask(void* arg) {
+        readAhead.Prefetch(*reinterpret_cast<Stream*>(arg));
+    }
+
+    void ReadAhead::Prefetch(Stream& stream) {
+        // Only the task touches the buffer while loading is set
+        u32 bytesRead = 0;
+        Result res = FSFILE_Read(stream.handle, &bytesRead, stream.bufferOffset, stream.buffer, stream.bufferCapacity);
+
+        CTRPluginFramework::Lock l(lock);
+        if (R_FAILED(res)) bytesRead = 0;
+        stream.bufferValid = bytesRead;
+        stream.bufferServed = 0;
+        stream.eof = R_SUCCEEDED(res) && bytesRead < stream.bufferCapacity;
+        stream.loading = false;
+        counters.prefetches++;
+        counters.prefetchedBytes += bytesRead;
+        CondVar_Broadcast(&loaded);
+    }
+
+    u32 ReadAhead::ServeFromBuffer(Stream& stream, u64 offset, u8* out, u32 size, bool& complete) {
+        complete = false;
+        if (stream.bufferValid == 0 || offset < stream.bufferOffset || offset >= stream.bufferOffset + stream.bufferValid) {
+            return 0;
+        }
+        u32 start = static_cast<u32>(offset - stream.bufferOffset);
+        u32 count = std::min(size, stream.bufferValid - start);
+        // Copied with the lock held so a prefetch cannot replace the buffer meanwhile
+        memcpy(out, stream.buffer + start, count);
+        Stats::AddCopiedBytes(count);
+        stream.bufferServed = std::max(stream.bufferServed, start + count);
+        // A window that ended at the end of the file has the whole answer
+        complete = count == size || stream.eof;
+        return count;
+    }
+
+    bool ReadAhead::ReserveBuffer(Stream& stream, u32 size) {
+        if (stream.bufferCapacity == size) return true;
+
+        // Take the memory of the least recently used idle streams if needed
+        while (usedMemory - stream.bufferCapacity + size > READAHEAD_MEMORY) {
+            Stream* victim = nullptr;
+            for (auto& it : streams) {
+                Stream& other = it.second;
+                if (&other == &stream || !other.buffer || other.loading) continue;
+                if (!victim || other.lastUse < victim->lastUse) victim = &other;
+            }
+            if (!victim) return false;
+            DropBuffer(*victim, true);
+        }
+
+        DropBuffer(stream, true);
+        stream.buffer = reinterpret_cast<u8*>(malloc(size));
+        if (!stream.buffer) return false;
+        stream.bufferCapacity = size;
+        usedMemory += size;
+        return true;
+    }
+
+    void ReadAhead::DropBuffer(Stream& stream, bool release) {
+        if (stream.bufferValid > stream.bufferServed) {
+            counters.wastedBytes += stream.bufferValid - stream.bufferServed;
+        }
+        stream.bufferValid = 0;
+        stream.bufferServed = 0;
+        stream.eof = false;
+        if (release && stream.buffer) {
+            free(stream.buffer);
+            usedMemory -= stream.bufferCapacity;
+            stream.buffer = nullptr;
+            stream.bufferCapacity = 0;
+        }
+    }
+
+    void ReadAhead::WaitLoaded(Stream& stream) {
+        while (stream.loading) {
+            CondVar_Wait(&loaded, &lock);
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#include "ArticStats.hpp"
+#include "ArticTrace.hpp"
+
+namespace ArticFunctions {
+    namespace Stats {
+
+        static std::atomic<u64> copiedBytes{};
+        static std::atomic<u64> servedBytes{};
+
+        void Histogram::Add(u64 value, u32 shift) {
+            value >>= shift;
+            size_t bucket = 0;
+            if (value != 0) {
+                bucket = (value >> 32) ? BUCKET_COUNT - 1 : 32 - __builtin_clz(static_cast<u32>(value));
+                if (bucket >= BUCKET_COUNT) bucket = BUCKET_COUNT - 1;
+            }
+            buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void Histogram::Reset() {
+            for (auto& b : buckets) {
+                b.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void MethodStats::Reset() {
+            count.store(0, std::memory_order_relaxed);
+            totalMicroseconds.store(0, std::memory_order_relaxed);
+            latency.Reset();
+            requestBytes.Reset();
+            responseBytes.Reset();
+        }
+
+        void Serialize(const MethodStats& stats, u16 opcode, MethodStatsRecord& out) {
+            out.opcode = opcode;
+            out.bucketCount = BUCKET_COUNT;
+            out.count = stats.count.load(std::memory_order_relaxed);
+            out.totalMicroseconds = stats.totalMicroseconds.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < BUCKET_COUNT; i++) {
+                out.latency[i] = stats.latency.Get(i);
+                out.requestBytes[i] = stats.requestBytes.Get(i);
+                out.responseBytes[i] = stats.responseBytes.Get(i);
+            }
+        }
+
+        RequestScope::RequestScope(MethodStats& s, u16 op, const MethodInterface& m) : stats(s), opcode(op), mi(m) {
+            startTick = svcGetSystemTick();
+        }
+
+        RequestScope::~RequestScope() {
+            u64 endTick = svcGetSystemTick();
+            u64 microseconds = (endTick - startTick) / (SYSCLOCK_ARM11 / 1000000);
+            u32 requestBytes = mi.GetRequestBytes();
+            u32 responseBytes = mi.GetResponseBytes();
+            AddServedBytes(responseBytes);
+
+            stats.count.fetch_add(1, std::memory_order_relaxed);
+            stats.totalMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+            stats.latency.Add(microseconds, LATENCY_SHIFT);
+            stats.requestBytes.Add(requestBytes, SIZE_SHIFT);
+            stats.responseBytes.Add(responseBytes, SIZE_SHIFT);
+
+            Trace::Add(opcode, mi.GetTraceTarget(), startTick, endTick, responseBytes);
+        }
+
+        void AddServedBytes(u32 bytes) {
+            if (ARTIC_COUNT_COPIES) servedBytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void AddCopiedBytes(u32 bytes) {
+            if (ARTIC_COUNT_COPIES) copiedBytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void TakeCopyCounts(u64& copied, u64& served) {
+            copied = copiedBytes.exchange(0, std::memory_order_relaxed);
+            served = servedBytes.exchange(0, std::memory_order_relaxed);
+        }
+    }
+}
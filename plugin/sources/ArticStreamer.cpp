@@ -0,0 +1,297 @@
+#include "ArticStreamer.hpp"
+#include "ArticStats.hpp"
+#include "ArticProtocolServer.hpp"
+#include "Main.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+#include <algorithm>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+namespace ArticFunctions {
+
+    FileStreamer fileStreamer;
+
+    FileStreamer::FileStreamer() {
+        LightLock_Init(&lock);
+        CondVar_Init(&wake);
+    }
+
+    bool FileStreamer::Start() {
+        CTRPluginFramework::Lock l(lock);
+        if (run) return true;
+
+        struct sockaddr_in addr = {};
+        listenFD = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFD < 0) {
+            logger.Error("FileStreamer: Cannot create socket");
+            return false;
+        }
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port        = htons(PORT);
+        if (!ArticProtocolServer::SetNonBlock(listenFD, true) ||
+            bind(listenFD, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFD, 1) < 0) {
+            logger.Error("FileStreamer: Failed to listen on port %d", PORT);
+            close(listenFD);
+            listenFD = -1;
+            return false;
+        }
+
+        s32 prio = 0;
+        svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+        run = true;
+        thread = threadCreate(StreamThread, this, THREAD_STACK_SIZE, prio + 1, -2, false);
+        if (!thread) {
+            logger.Error("FileStreamer: Failed to create thread");
+            run = false;
+            close(listenFD);
+            listenFD = -1;
+            return false;
+        }
+        logger.Debug("FileStreamer: Listening on port %d", PORT);
+        return true;
+    }
+
+    void FileStreamer::Stop() {
+        {
+            CTRPluginFramework::Lock l(lock);
+            if (!run) return;
+            run = false;
+            CondVar_Broadcast(&wake);
+        }
+        threadJoin(thread, U64_MAX);
+        threadFree(thread);
+        thread = nullptr;
+
+        CTRPluginFramework::Lock l(lock);
+        if (clientFD >= 0) {
+            close(clientFD);
+            clientFD = -1;
+        }
+        close(listenFD);
+        listenFD = -1;
+        for (Stream& stream : streams) {
+            stream = Stream();
+        }
+        nextStream = 0;
+    }
+
+    Result FileStreamer::Open(Handle handle, u64 offset, u64 size, u32 chunkSize, u32 credits, u32& streamID) {
+        if (chunkSize == 0) chunkSize = DEFAULT_CHUNK;
+        chunkSize = std::clamp(chunkSize, MIN_CHUNK, MAX_CHUNK);
+
+        CTRPluginFramework::Lock l(lock);
+        for (Stream& stream : streams) {
+            if (stream.used) continue;
+            stream = Stream();
+            stream.used = true;
+            stream.id = ++idCounter;
+            stream.handle = handle;
+            stream.offset = offset;
+            stream.end = size != 0 ? offset + size : 0;
+            stream.chunkSize = chunkSize;
+            stream.credits = credits;
+            streamID = stream.id;
+            CondVar_Broadcast(&wake);
+            return 0;
+        }
+        return MAKERESULT(RL_TEMPORARY, RS_OUTOFRESOURCE, RM_COMMON, RD_BUSY);
+    }
+
+    Result FileStreamer::AddCredits(u32 streamID, u32 credits) {
+        CTRPluginFramework::Lock l(lock);
+        Stream* stream = FindStream(streamID);
+        if (!stream) {
+            return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_COMMON, RD_NOT_FOUND);
+        }
+        stream->credits = static_cast<u32>(std::min<u64>(static_cast<u64>(stream->credits) + credits, UINT32_MAX));
+        CondVar_Broadcast(&wake);
+        return 0;
+    }
+
+    Result FileStreamer::Cancel(u32 streamID) {
+        CTRPluginFramework::Lock l(lock);
+        Stream* stream = FindStream(streamID);
+        if (!stream) {
+            return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_COMMON, RD_NOT_FOUND);
+        }
+        CancelLocked(*stream);
+        return 0;
+    }
+
+    void FileStreamer::CancelHandle(Handle handle) {
+        CTRPluginFramework::Lock l(lock);
+        for (Stream& stream : streams) {
+            if (stream.used && !stream.cancelled && stream.handle == handle) {
+                CancelLocked(stream);
+            }
+        }
+    }
+
+    void FileStreamer::CancelLocked(Stream& stream) {
+        stream.cancelled = true;
+        CondVar_Broadcast(&wake);
+        while (stream.reading) {
+            CondVar_Wait(&wake, &lock);
+        }
+        // Without a client there is nobody to send the last chunk to, and
+        // the slot would stay taken until one connects
+        if (clientFD < 0) {
+            stream.used = false;
+        }
+    }
+
+    FileStreamer::Stream* FileStreamer::FindStream(u32 streamID) {
+        for (Stream& stream : streams) {
+            if (stream.used && !stream.cancelled && stream.id == streamID) {
+                return &stream;
+            }
+        }
+        return nullptr;
+    }
+
+    FileStreamer::Stream* FileStreamer::NextStream() {
+        for (size_t i = 0; i < MAX_STREAMS; i++) {
+            Stream& stream = streams[(nextStream + i) % MAX_STREAMS];
+            if (stream.used && (stream.cancelled || stream.credits != 0)) {
+                nextStream = (nextStream + i + 1) % MAX_STREAMS;
+                return &stream;
+            }
+        }
+        return nullptr;
+    }
+
+    void FileStreamer::StreamThread(void* arg) {
+        reinterpret_cast<FileStreamer*>(arg)->StreamLoop();
+        threadExit(0);
+    }
+
+    bool FileStreamer::Accept() {
+        struct sockaddr_in addr = {};
+        socklen_t addrSize = sizeof(addr);
+        int fd = accept(listenFD, (struct sockaddr *)&addr, &addrSize);
+        if (fd < 0) return false;
+        if (!ArticProtocolServer::SetNonBlock(fd, true)) {
+            close(fd);
+            return false;
+        }
+        CTRPluginFramework::Lock l(lock);
+        if (clientFD >= 0) close(clientFD);
+        clientFD = fd;
+        logger.Debug("FileStreamer: Client connected");
+        return true;
+    }
+
+    bool FileStreamer::Send(const void* data, size_t size) {
+        const u8* p = reinterpret_cast<const u8*>(data);
+        while (size != 0) {
+            ssize_t sent = send(clientFD, p, size, 0);
+            if (sent <= 0) {
+                // Nothing sent without an error means the connection is gone
+                int err = sent < 0 ? errno : 0;
+                if (err != EWOULDBLOCK && err != EAGAIN) return false;
+                // The client is not keeping up, wait for it
+                {
+                    CTRPluginFramework::Lock l(lock);
+                    if (!run) return false;
+                }
+                svcSleepThread(1000000);
+                continue;
+            }
+            p += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    void FileStreamer::StreamLoop() {
+        while (true) {
+            {
+                CTRPluginFramework::Lock l(lock);
+                if (!run) break;
+            }
+            // A new connection replaces the current one
+            Accept();
+            if (clientFD < 0) {
+                svcSleepThread(10000000);
+                continue;
+            }
+
+            ChunkHeader header = {};
+            Stream* stream;
+            Handle handle = 0;
+            u32 size = 0;
+            {
+                CTRPluginFramework::Lock l(lock);
+                stream = NextStream();
+                if (!stream) {
+                    // Wake up now and then to look for a new connection
+                    CondVar_WaitTimeout(&wake, &lock, 10000000);
+                    continue;
+                }
+                header.streamID = stream->id;
+                header.offset = stream->offset;
+                if (stream->cancelled) {
+                    header.flags = FLAG_LAST | FLAG_CANCELLED;
+                    stream->used = false;
+                } else {
+                    handle = stream->handle;
+                    size = stream->chunkSize;
+                    if (stream->end != 0) {
+                        size = static_cast<u32>(std::min<u64>(size, stream->end - stream->offset));
+                    }
+                    stream->credits--;
+                    stream->reading = true;
+                }
+            }
+
+            u8* data = nullptr;
+            if (!(header.flags & FLAG_LAST)) {
+                // Streams read the FS directly, their chunks are large and
+                // sequential and would only flush the caches
+                data = reinterpret_cast<u8*>(malloc(sizeof(ChunkHeader) + size));
+                u32 bytesRead = 0;
+                Result res = data ? FSFILE_Read(handle, &bytesRead, header.offset, data + sizeof(ChunkHeader), size) :
+                    MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_COMMON, RD_OUT_OF_MEMORY);
+
+                CTRPluginFramework::Lock l(lock);
+                stream->reading = false;
+                header.result = res;
+                if (R_SUCCEEDED(res)) {
+                    header.size = bytesRead;
+                    stream->offset += bytesRead;
+                }
+                if (R_FAILED(res) || bytesRead < size || (stream->end != 0 && stream->offset >= stream->end)) {
+                    header.flags |= FLAG_LAST;
+                    stream->used = false;
+                }
+                CondVar_Broadcast(&wake);
+            }
+
+            bool sent;
+            if (data) {
+                memcpy(data, &header, sizeof(ChunkHeader));
+                sent = Send(data, sizeof(ChunkHeader) + header.size);
+                free(data);
+            } else {
+                sent = Send(&header, sizeof(ChunkHeader));
+            }
+            Stats::AddServedBytes(sizeof(ChunkHeader) + header.size);
+
+            if (!sent) {
+                // Whatever was in flight is lost, the streams cannot resume
+                logger.Debug("FileStreamer: Client disconnected");
+                CTRPluginFramework::Lock l(lock);
+                close(clientFD);
+                clientFD = -1;
+                for (Stream& other : streams) {
+                    other.used = false;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#include "ArticTrace.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+
+#include <atomic>
+#include <stdlib.h>
+
+namespace ArticFunctions {
+    namespace Trace {
+
+        static CTRPluginFramework::Mutex traceMutex;
+        static Record* records = nullptr;
+        static u32 head = 0;
+        static u32 count = 0;
+        static u32 dropped = 0;
+        static u64 startTick = 0;
+        static std::atomic<bool> enabled{false};
+
+        bool Start() {
+            CTRPluginFramework::Lock l(traceMutex);
+            if (!records) {
+                records = static_cast<Record*>(malloc(TRACE_RECORDS * sizeof(Record)));
+                if (!records) return false;
+            }
+            head = count = dropped = 0;
+            startTick = svcGetSystemTick();
+            enabled = true;
+            return true;
+        }
+
+        void Stop() {
+            CTRPluginFramework::Lock l(traceMutex);
+            enabled = false;
+            free(records);
+            records = nullptr;
+            head = count = dropped = 0;
+        }
+
+        bool IsEnabled() {
+            return enabled.load(std::memory_order_relaxed);
+        }
+
+        void Add(u16 opcode, const Target& target, u64 requestStartTick, u64 endTick, u32 responseBytes) {
+            static constexpr u64 TICKS_PER_US = SYSCLOCK_ARM11 / 1000000;
+            if (!IsEnabled()) return;
+
+            CTRPluginFramework::Lock l(traceMutex);
+            if (!records) return;
+            // Requests that started before the trace was (re)started are not recorded
+            if (requestStartTick < startTick) return;
+
+            Record& rec = records[(head + count) % TRACE_RECORDS];
+            rec.startMicroseconds = (requestStartTick - startTick) / TICKS_PER_US;
+            rec.handle = target.handle;
+            rec.offset = target.offset;
+            rec.size = target.size;
+            rec.serviceMicroseconds = static_cast<u32>((endTick - requestStartTick) / TICKS_PER_US);
+            rec.responseBytes = responseBytes;
+            rec.opcode = opcode;
+            rec.reserved = 0;
+
+            if (count < TRACE_RECORDS) {
+                count++;
+            } else {
+                head = (head + 1) % TRACE_RECORDS;
+                dropped++;
+            }
+        }
+
+        u32 Take(Record* out, u32 maxCount, u32& droppedCount) {
+            CTRPluginFramework::Lock l(traceMutex);
+            u32 taken = (count < maxCount) ? count : maxCount;
+            for (u32 i = 0; i < taken; i++) {
+                out[i] = records[(head + i) % TRACE_RECORDS];
+            }
+            head = (head + taken) % TRACE_RECORDS;
+            count -= taken;
+            droppedCount = dropped;
+            dropped = 0;
+            return taken;
+        }
+
+        u32 Count() {
+            CTRPluginFramework::Lock l(traceMutex);
+            return count;
+        }
+    }
+}
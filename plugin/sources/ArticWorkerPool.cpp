@@ -0,0 +1,164 @@
+#include "ArticWorkerPool.hpp"
+#include "Main.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+
+namespace ArticFunctions {
+
+    WorkerPool workerPool;
+    WorkerPool requestPool;
+
+    WorkerPool::Group::Group() {
+        LightLock_Init(&lock);
+        CondVar_Init(&cond);
+    }
+
+    void WorkerPool::Group::Add() {
+        CTRPluginFramework::Lock l(lock);
+        pending++;
+    }
+
+    void WorkerPool::Group::Done() {
+        CTRPluginFramework::Lock l(lock);
+        if (--pending == 0) {
+            CondVar_Broadcast(&cond);
+        }
+    }
+
+    void WorkerPool::Group::Wait() {
+        CTRPluginFramework::Lock l(lock);
+        while (pending != 0) {
+            CondVar_Wait(&cond, &lock);
+        }
+    }
+
+    WorkerPool::WorkerPool() {
+        LightLock_Init(&lock);
+        CondVar_Init(&taskAvailable);
+        CondVar_Init(&slotAvailable);
+    }
+
+    bool WorkerPool::Start(size_t count) {
+        CTRPluginFramework::Lock l(lock);
+        if (run) {
+            return workerCount != 0;
+        }
+        if (count > MAX_WORKERS) count = MAX_WORKERS;
+
+        s32 prio = 0;
+        svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+
+        // Spread the workers over the cores the process can use. The New 3DS
+        // extra core is only available if the title enabled it, fall back to
+        // the default core otherwise.
+        bool isNew3DS = false;
+        APT_CheckNew3DS(&isNew3DS);
+        int cores[] = {-2, 2};
+        size_t coreCount = isNew3DS ? 2 : 1;
+
+        run = true;
+        workerCount = 0;
+        for (size_t i = 0; i < count; i++) {
+            contexts[i] = {this, i};
+            running[i] = false;
+            Thread thread = threadCreate(WorkerThread, &contexts[i], WORKER_STACK_SIZE, prio, cores[i % coreCount], false);
+            if (!thread && cores[i % coreCount] != -2) {
+                thread = threadCreate(WorkerThread, &contexts[i], WORKER_STACK_SIZE, prio, -2, false);
+            }
+            if (!thread) {
+                logger.Error("WorkerPool: Failed to create worker %d", (int)i);
+                break;
+            }
+            threads[i] = thread;
+            workerCount++;
+        }
+        logger.Debug("WorkerPool: Started %d workers", (int)workerCount);
+        return workerCount != 0;
+    }
+
+    void WorkerPool::Stop() {
+        size_t count;
+        {
+            CTRPluginFramework::Lock l(lock);
+            if (!run) return;
+            run = false;
+            count = workerCount;
+            CondVar_Broadcast(&taskAvailable);
+        }
+        for (size_t i = 0; i < count; i++) {
+            threadJoin(threads[i], U64_MAX);
+            threadFree(threads[i]);
+            threads[i] = nullptr;
+        }
+        CTRPluginFramework::Lock l(lock);
+        workerCount = 0;
+    }
+
+    void WorkerPool::Submit(u64 key, Task task, void* arg, Group* group) {
+        if (group) group->Add();
+        {
+            CTRPluginFramework::Lock l(lock);
+            if (run && workerCount != 0) {
+                while (queuedCount == MAX_QUEUED_TASKS) {
+                    CondVar_Wait(&slotAvailable, &lock);
+                }
+                queue[queuedCount++] = {key, task, arg, group};
+                CondVar_Broadcast(&taskAvailable);
+                return;
+            }
+        }
+        task(arg);
+        if (group) group->Done();
+    }
+
+    bool WorkerPool::IsKeyBusy(u64 key) const {
+        for (size_t i = 0; i < workerCount; i++) {
+            if (running[i] && runningKeys[i] == key) return true;
+        }
+        return false;
+    }
+
+    void WorkerPool::WorkerThread(void* arg) {
+        WorkerContext* context = reinterpret_cast<WorkerContext*>(arg);
+        context->pool->WorkerLoop(context->index);
+    }
+
+    void WorkerPool::WorkerLoop(size_t workerIndex) {
+        LightLock_Lock(&lock);
+        while (true) {
+            // Take the oldest task whose key is not already running. An older
+            // task with the same key is always found first, keeping the order.
+            size_t index = queuedCount;
+            for (size_t i = 0; i < queuedCount; i++) {
+                if (!IsKeyBusy(queue[i].key)) {
+                    index = i;
+                    break;
+                }
+            }
+
+            if (index == queuedCount) {
+                if (!run && queuedCount == 0) break;
+                CondVar_Wait(&taskAvailable, &lock);
+                continue;
+            }
+
+            QueuedTask task = queue[index];
+            for (size_t i = index + 1; i < queuedCount; i++) {
+                queue[i - 1] = queue[i];
+            }
+            queuedCount--;
+            runningKeys[workerIndex] = task.key;
+            running[workerIndex] = true;
+            CondVar_Signal(&slotAvailable);
+            LightLock_Unlock(&lock);
+
+            task.task(task.arg);
+            if (task.group) task.group->Done();
+
+            LightLock_Lock(&lock);
+            running[workerIndex] = false;
+            // Tasks waiting on this key may be runnable now
+            CondVar_Broadcast(&taskAvailable);
+        }
+        LightLock_Unlock(&lock);
+    }
+}
@@ -0,0 +1,384 @@
+#include "ArticWriteBuffer.hpp"
+#include "ArticBlockCache.hpp"
+#include "ArticStats.hpp"
+#include "ArticMemo.hpp"
+#include "Main.hpp"
+#include "CTRPluginFramework/CTRPluginFramework.hpp"
+#include <algorithm>
+#include <string.h>
+
+namespace ArticFunctions {
+
+    WriteBuffer writeBuffer;
+
+    WriteBuffer::WriteBuffer() {
+        LightLock_Init(&lock);
+        CondVar_Init(&jobAvailable);
+        CondVar_Init(&jobDone);
+    }
+
+    void WriteBuffer::AddArchive(FS_Archive archive) {
+        if (HANDLE_CAPACITY == 0) return;
+        CTRPluginFramework::Lock l(lock);
+        archives.push_back(archive);
+    }
+
+    bool WriteBuffer::IsBufferedArchive(FS_Archive archive) {
+        CTRPluginFramework::Lock l(lock);
+        return std::find(archives.begin(), archives.end(), archive) != archives.end();
+    }
+
+    Result WriteBuffer::RemoveArchive(FS_Archive archive) {
+        CTRPluginFramework::Lock l(lock);
+        auto it = std::find(archives.begin(), archives.end(), archive);
+        if (it == archives.end()) return 0;
+        archives.erase(it);
+
+        Result res = 0;
+        for (Slot& slot : slots) {
+            if (slot.handle.load(std::memory_order_relaxed) == 0 || slot.archive != archive) continue;
+            Result flushRes = DrainSlot(slot);
+            if (R_SUCCEEDED(res)) res = flushRes;
+            slot.handle.store(0, std::memory_order_relaxed);
+        }
+        return res;
+    }
+
+    Result WriteBuffer::FlushArchive(FS_Archive archive) {
+        CTRPluginFramework::Lock l(lock);
+        Result res = 0;
+        for (Slot& slot : slots) {
+            if (slot.handle.load(std::memory_order_relaxed) == 0 || slot.archive != archive) continue;
+            Result flushRes = DrainSlot(slot);
+            if (R_SUCCEEDED(res)) res = flushRes;
+        }
+        return res;
+    }
+
+    bool WriteBuffer::Register(Handle handle, FS_Archive archive) {
+        CTRPluginFramework::Lock l(lock);
+        for (Slot& slot : slots) {
+            if (slot.handle.load(std::memory_order_relaxed) != 0) continue;
+            slot.archive = archive;
+            slot.ranges.clear();
+            slot.pendingBytes = 0;
+            slot.pendingFlags = 0;
+            slot.error = 0;
+            slot.handle.store(handle, std::memory_order_release);
+            return true;
+        }
+        return false;
+    }
+
+    Result WriteBuffer::Unregister(Handle handle) {
+        if (!IsBuffered(handle)) return 0;
+        CTRPluginFramework::Lock l(lock);
+        Slot* slot = Find(handle);
+        if (!slot) return 0;
+        Result res = DrainSlot(*slot);
+        slot->handle.store(0, std::memory_order_relaxed);
+        return res;
+    }
+
+    void WriteBuffer::Clear() {
+        SetAsync(false);
+        CTRPluginFramework::Lock l(lock);
+        for (Slot& slot : slots) {
+            if (slot.handle.load(std::memory_order_relaxed) == 0) continue;
+            FlushSlot(slot);
+            slot.handle.store(0, std::memory_order_relaxed);
+        }
+        archives.clear();
+        counters = {};
+    }
+
+    void WriteBuffer::SetAsync(bool enable) {
+        Thread thread;
+        {
+            CTRPluginFramework::Lock l(lock);
+            if (enable == async) return;
+            if (enable) {
+                s32 prio = 0;
+                svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+                writerRun = true;
+                writer = threadCreate(WriterThread, this, WRITER_STACK_SIZE, prio + 1, -2, false);
+                if (!writer) {
+                    logger.Error("WriteBuffer: Failed to create writer thread");
+                    writerRun = false;
+                    return;
+                }
+                async = true;
+                return;
+            }
+            // Pending ranges are written synchronously from now on, the
+            // thread writes what is queued before it exits
+            async = false;
+            writerRun = false;
+            CondVar_Broadcast(&jobAvailable);
+            thread = writer;
+            writer = nullptr;
+        }
+        threadJoin(thread, U64_MAX);
+        threadFree(thread);
+    }
+
+    WriteBuffer::Counters WriteBuffer::GetCounters() {
+        CTRPluginFramework::Lock l(lock);
+        return counters;
+    }
+
+    bool WriteBuffer::IsBuffered(Handle handle) const {
+        for (const Slot& slot : slots) {
+            if (slot.handle.load(std::memory_order_acquire) == handle) return true;
+        }
+        return false;
+    }
+
+    WriteBuffer::Slot* WriteBuffer::Find(Handle handle) {
+        for (Slot& slot : slots) {
+            if (slot.handle.load(std::memory_order_relaxed) == handle) return &slot;
+        }
+        return nullptr;
+    }
+
+    Result WriteBuffer::Write(Handle handle, u64 offset, const void* data, u32 size, u32 flags, u32& bytesWritten) {
+        if (!IsBuffered(handle)) {
+            return FSFILE_Write(handle, &bytesWritten, offset, data, size, flags);
+        }
+        CTRPluginFramework::Lock l(lock);
+        Slot* slot = Find(handle);
+        if (!slot) {
+            return FSFILE_Write(handle, &bytesWritten, offset, data, size, flags);
+        }
+        counters.writes++;
+
+        // An earlier queued write failed, this write is not done
+        Result res = TakeError(*slot);
+        if (R_FAILED(res)) return res;
+
+        // A flushing write must reach the media, the pending data goes first
+        // so it cannot land on top of the newer data later
+        bool direct = size > MAX_BUFFERED_WRITE || (flags & FS_WRITE_FLUSH);
+        if (!direct && slot->pendingBytes + size > HANDLE_CAPACITY) {
+            res = FlushSlot(*slot);
+            if (R_FAILED(res)) return res;
+        }
+        if (!direct && Buffer(*slot, offset, reinterpret_cast<const u8*>(data), size, flags)) {
+            bytesWritten = size;
+            return 0;
+        }
+
+        res = FlushSlot(*slot);
+        if (R_FAILED(res)) return res;
+        if (!async) {
+            return FSFILE_Write(handle, &bytesWritten, offset, data, size, flags);
+        }
+        const u8* bytes = reinterpret_cast<const u8*>(data);
+        WaitForRoom(size);
+        Queue(*slot, offset, std::vector<u8>(bytes, bytes + size), flags);
+        Stats::AddCopiedBytes(size);
+        counters.queued++;
+        bytesWritten = size;
+        return 0;
+    }
+
+    bool WriteBuffer::Buffer(Slot& slot, u64 offset, const u8* data, u32 size, u32 flags) {
+        u64 start = offset, end = offset + size;
+
+        // Every pending range touching [start, end] is merged with the write
+        auto first = slot.ranges.upper_bound(start);
+        if (first != slot.ranges.begin()) {
+            auto prev = std::prev(first);
+            if (prev->first + prev->second.size() >= start) first = prev;
+        }
+        auto last = first;
+        u64 mergedStart = start, mergedEnd = end;
+        size_t replacedBytes = 0;
+        for (; last != slot.ranges.end() && last->first <= end; last++) {
+            mergedStart = std::min(mergedStart, last->first);
+            mergedEnd = std::max<u64>(mergedEnd, last->first + last->second.size());
+            replacedBytes += last->second.size();
+        }
+        if (mergedEnd - mergedStart > HANDLE_CAPACITY) return false;
+
+        // Appending to the range in front, the common case, reuses its memory
+        std::vector<u8> merged;
+        auto copyFrom = first;
+        if (first != last && first->first == mergedStart) {
+            merged = std::move(first->second);
+            copyFrom++;
+        }
+        merged.resize(mergedEnd - mergedStart);
+        for (auto it = copyFrom; it != last; it++) {
+            memcpy(merged.data() + (it->first - mergedStart), it->second.data(), it->second.size());
+            Stats::AddCopiedBytes(it->second.size());
+        }
+        memcpy(merged.data() + (start - mergedStart), data, size);
+        Stats::AddCopiedBytes(size);
+
+        slot.ranges.erase(first, last);
+        slot.ranges.emplace(mergedStart, std::move(merged));
+        slot.pendingBytes += (mergedEnd - mergedStart) - replacedBytes;
+        slot.pendingFlags |= flags;
+        counters.buffered++;
+        if (replacedBytes != 0) counters.merged++;
+        counters.bufferedBytes += size;
+        return true;
+    }
+
+    Result WriteBuffer::FlushSlot(Slot& slot) {
+        if (async) {
+            WaitForRoom(slot.pendingBytes);
+            for (auto& range : slot.ranges) {
+                Queue(slot, range.first, std::move(range.second), slot.pendingFlags);
+            }
+            slot.ranges.clear();
+            slot.pendingBytes = 0;
+            slot.pendingFlags = 0;
+            return 0;
+        }
+
+        Handle handle = slot.handle.load(std::memory_order_relaxed);
+        Result res = 0;
+        // Data that failed to be written is dropped, like a failed direct write
+        for (auto& range : slot.ranges) {
+            u32 bytesWritten = 0;
+            Result writeRes = FSFILE_Write(handle, &bytesWritten, range.first, range.second.data(), range.second.size(), slot.pendingFlags);
+            counters.fsWrites++;
+            if (R_SUCCEEDED(res)) res = writeRes;
+        }
+        slot.ranges.clear();
+        slot.pendingBytes = 0;
+        slot.pendingFlags = 0;
+        return res;
+    }
+
+    Result WriteBuffer::WaitSlot(Slot& slot) {
+        while (slot.queuedJobs != 0) {
+            CondVar_Wait(&jobDone, &lock);
+        }
+        return TakeError(slot);
+    }
+
+    Result WriteBuffer::DrainSlot(Slot& slot) {
+        Result res = FlushSlot(slot);
+        Result waitRes = WaitSlot(slot);
+        return R_FAILED(waitRes) ? waitRes : res;
+    }
+
+    Result WriteBuffer::TakeError(Slot& slot) {
+        Result res = slot.error;
+        if (R_FAILED(res)) {
+            slot.error = 0;
+            counters.deferredErrors++;
+        }
+        return res;
+    }
+
+    void WriteBuffer::WaitForRoom(u32 size) {
+        // A write larger than the whole queue only waits for it to empty
+        while (queuedBytes != 0 && queuedBytes + size > MAX_QUEUED_BYTES) {
+            CondVar_Wait(&jobDone, &lock);
+        }
+    }
+
+    void WriteBuffer::Queue(Slot& slot, u64 offset, std::vector<u8>&& data, u32 flags) {
+        queuedBytes += data.size();
+        slot.queuedJobs++;
+        jobs.push_back({&slot, slot.handle.load(std::memory_order_relaxed), offset, std::move(data), flags});
+        CondVar_Signal(&jobAvailable);
+    }
+
+    void WriteBuffer::WriterThread(void* arg) {
+        reinterpret_cast<WriteBuffer*>(arg)->WriterLoop();
+    }
+
+    void WriteBuffer::WriterLoop() {
+        LightLock_Lock(&lock);
+        while (true) {
+            while (jobs.empty() && writerRun) {
+                CondVar_Wait(&jobAvailable, &lock);
+            }
+            if (jobs.empty()) break;
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            LightLock_Unlock(&lock);
+
+            // Jobs run in queue order, so writes to the same handle land in
+            // the order they were acknowledged
+            u32 bytesWritten = 0;
+            Result res = FSFILE_Write(job.handle, &bytesWritten, job.offset, job.data.data(), job.data.size(), job.flags);
+            // Responses stored since the write was acknowledged may have read
+            // the data before it landed
+            Memo::Invalidate(Memo::UNTIL_WRITE);
+
+            LightLock_Lock(&lock);
+            counters.fsWrites++;
+            if (R_FAILED(res) && R_SUCCEEDED(job.slot->error)) {
+                job.slot->error = res;
+            }
+            job.slot->queuedJobs--;
+            queuedBytes -= job.data.size();
+            CondVar_Broadcast(&jobDone);
+        }
+        LightLock_Unlock(&lock);
+    }
+
+    Result WriteBuffer::Read(Handle handle, u64 offset, void* out, u32 size, u32& bytesRead) {
+        if (!IsBuffered(handle)) {
+            return blockCache.Read(handle, offset, out, size, bytesRead);
+        }
+        CTRPluginFramework::Lock l(lock);
+        // Queued writes must reach the FS before it is read
+        Slot* slot = Find(handle);
+        Result res = slot ? WaitSlot(*slot) : 0;
+        if (R_FAILED(res)) return res;
+        res = blockCache.Read(handle, offset, out, size, bytesRead);
+        if (R_FAILED(res) || !slot || slot->ranges.empty()) return res;
+
+        // Pending data past the end of the file extends it, the FS fills the
+        // gap before it with zeros when it is written
+        u8* dst = reinterpret_cast<u8*>(out);
+        auto lastRange = std::prev(slot->ranges.end());
+        u64 pendingEnd = lastRange->first + lastRange->second.size();
+        if (pendingEnd > offset + bytesRead && bytesRead < size) {
+            u32 extended = static_cast<u32>(std::min<u64>(size, pendingEnd - offset));
+            memset(dst + bytesRead, 0, extended - bytesRead);
+            bytesRead = extended;
+        }
+
+        u64 end = offset + bytesRead;
+        auto it = slot->ranges.upper_bound(offset);
+        if (it != slot->ranges.begin()) it--;
+        for (; it != slot->ranges.end() && it->first < end; it++) {
+            u64 rangeStart = std::max(offset, it->first);
+            u64 rangeEnd = std::min<u64>(end, it->first + it->second.size());
+            if (rangeStart >= rangeEnd) continue;
+            memcpy(dst + (rangeStart - offset), it->second.data() + (rangeStart - it->first), rangeEnd - rangeStart);
+            Stats::AddCopiedBytes(rangeEnd - rangeStart);
+        }
+        return res;
+    }
+
+    Result WriteBuffer::GetSize(Handle handle, u64& size) {
+        if (!IsBuffered(handle)) {
+            return FSFILE_GetSize(handle, &size);
+        }
+        CTRPluginFramework::Lock l(lock);
+        Slot* slot = Find(handle);
+        Result res = slot ? WaitSlot(*slot) : 0;
+        if (R_FAILED(res)) return res;
+        res = FSFILE_GetSize(handle, &size);
+        if (R_FAILED(res) || !slot || slot->ranges.empty()) return res;
+        auto lastRange = std::prev(slot->ranges.end());
+        size = std::max<u64>(size, lastRange->first + lastRange->second.size());
+        return res;
+    }
+
+    Result WriteBuffer::Flush(Handle handle) {
+        if (!IsBuffered(handle)) return 0;
+        CTRPluginFramework::Lock l(lock);
+        Slot* slot = Find(handle);
+        return slot ? DrainSlot(*slot) : 0;
+    }
+}
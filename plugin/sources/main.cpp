@@ -8,13 +8,8 @@
 #include <stdarg.h>
 #include <unistd.h>
 
-#include <fcntl.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-
-#include "ArticProtocolServer.hpp"
 #include "ArticFunctions.hpp"
+#include "Server.hpp"
 #include "CTRPluginFramework/Clock.hpp"
 #include "plgldr.h"
 
@@ -26,10 +21,6 @@
 #define SOC_BUFFERSIZE  0x400000
 
 Logger logger;
-static bool should_run = true;
-static int listen_fd = -1;
-static int accept_fd = -1;
-static ArticProtocolServer* articBase = nullptr;
 static bool wasControllerMode = false;
 static bool everControllerMode = false;
 static bool reloadBottomText = false;
@@ -79,95 +70,10 @@ void Start(void* arg) {
         logger.Error("Server: Cannot initialize sockets");
         return;
     }
-    while (should_run) {
-        svcSleepThread(500000000);
-        struct sockaddr_in servaddr = {0};
-        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (listen_fd < 0) {
-            logger.Error("Server: Cannot create socket");
-            continue;
-        }
-
-        if (!ArticProtocolServer::SetNonBlock(listen_fd, true)) {
-            logger.Error("Server:: Failed to set non-block");
-            close(listen_fd);
-            listen_fd = -1;
-            continue;
-        }
-
-        servaddr.sin_family      = AF_INET;
-        servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-        servaddr.sin_port        = htons(SERVER_PORT);
-        res = bind(listen_fd, (struct sockaddr *) &servaddr, sizeof(servaddr));
-        if (res < 0) {
-            logger.Error("Server: Failed to bind() to port %d", SERVER_PORT);
-            close(listen_fd);
-            listen_fd = -1;
-            continue;
-        }
-
-        res = listen(listen_fd, 1);
-        if (res < 0) {
-            if (should_run) {
-                logger.Error("Server: Failed to listen()");
-            }
-            close(listen_fd);
-            listen_fd = -1;
-            continue;
-        }
-        
-        struct in_addr host_id;
-        host_id.s_addr = gethostid();
-        logger.Info("Server: Listening on: %s:%d", inet_ntoa(host_id), SERVER_PORT);
-
-        struct sockaddr_in peeraddr = {0};
-        socklen_t peeraddr_len = sizeof(peeraddr);
-        bool error = false;
-        while (true) {
-            accept_fd = accept(listen_fd, (struct sockaddr *) &peeraddr, &peeraddr_len);
-            if (accept_fd < 0 || peeraddr_len == 0) {
-                if (errno == EWOULDBLOCK && should_run) {
-                    svcSleepThread(10000000);
-                    continue;
-                }
-                if (should_run) {
-                    logger.Error("Server: Failed to accept()");
-                }
-                error = true;
-                break;
-            }
-            break;
-        }
-        if (listen_fd >= 0) {
-            close(listen_fd);
-            listen_fd = -1;
-        }
-        if (error)
-            continue;
-
-        logger.Info("Server: Connected: %s:%d", inet_ntoa(peeraddr.sin_addr), ntohs(peeraddr.sin_port));
-
-        if (!ArticProtocolServer::SetNonBlock(accept_fd, true)) {
-            logger.Error("Server: Failed to set non-block");
-            shutdown(accept_fd, SHUT_RDWR);
-            close(accept_fd);
-            accept_fd = -1;
-            continue;
-        }
-        
-        articBase = new ArticProtocolServer(accept_fd);
-        articBase->Serve();
-        accept_fd = -1;
-        delete articBase;
-        articBase = nullptr;
-        logger.Info("Server: Disconnected");
-
-        for (auto it = ArticFunctions::destructFunctions.begin(); it != ArticFunctions::destructFunctions.end(); it++) {
-            (*it)();
-        }
+    Server::Run([]() {
         isControllerMode = false;
         everControllerMode = false;
-    }
+    });
     socExit();
     free(SOC_buffer);
 }
@@ -297,9 +203,8 @@ void Main() {
         }
 
         if ((kDown & KEY_Y) && !isControllerMode) {
-            if (articBase) {
+            if (Server::Restart()) {
                 logger.Info("Server: Restarting");
-                articBase->QueryStop();
             } else {
                 logger.Debug("Server: Not started yet.");
             }
@@ -321,7 +226,7 @@ void Main() {
 
         if (clock.HasTimePassed(CTRPluginFramework::Seconds(1)))
         {
-            if (articBase) {
+            if (Server::IsConnected()) {
                 CTRPluginFramework::Time t = clock.GetElapsedTime();
                 float bytes = transferedBytes / t.AsSeconds();
                 transferedBytes = 0;
@@ -342,14 +247,7 @@ void Main() {
 		gspWaitForVBlank();
 	}
 
-    should_run = false;
-    if (listen_fd >= 0) {
-        close(listen_fd);
-        listen_fd = -1;
-    }
-    if (articBase) {
-        articBase->QueryStop();
-    }
+    Server::Stop();
 
     if (serverThread) {
         threadJoin(serverThread, U64_MAX);